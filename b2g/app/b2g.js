@@ -338,6 +338,9 @@ pref("image.mem.allow_locking_in_content_processes", true);
 // in the surface cache.  1/8 of main memory is 32MB on a 256MB device, which is
 // about the same as the old 'max_decoded_image_kb'.
 pref("image.mem.surfacecache.max_size_kb", 131072);  // 128MB
+// Keep LZ4-compressed copies of expired surfaces so that scrolling back to an
+// image doesn't require a full redecode.
+pref("image.mem.surfacecache.compressed.max_size_kb", 16384);  // 16MB
 pref("image.mem.surfacecache.size_factor", 8);  // 1/8 of main memory
 pref("image.mem.surfacecache.discard_factor", 2);  // Discard 1/2 of the surface cache at a time.
 pref("image.mem.surfacecache.min_expiration_ms", 86400000); // 24h, we rely on the out of memory hook
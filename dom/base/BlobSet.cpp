@@ -8,6 +8,7 @@
 #include "mozilla/CheckedInt.h"
 #include "mozilla/dom/File.h"
 #include "MultipartBlobImpl.h"
+#include "nsContentUtils.h"
 
 namespace mozilla {
 namespace dom {
@@ -123,8 +124,15 @@ BlobSet::Flush()
     // If we have some data, create a blob for it
     // and put it on the stack
 
-    RefPtr<BlobImpl> blobImpl =
-      new BlobImplMemory(mData, mDataLen, EmptyString());
+    // Large data is moved to a temporary file in the background.
+    RefPtr<BlobImpl> blobImpl;
+    uint32_t threshold = nsContentUtils::BlobMemoryToTemporaryFileThreshold();
+    if (threshold && mDataLen > threshold) {
+      blobImpl =
+        new BlobImplMemoryToTemporaryFile(mData, mDataLen, EmptyString());
+    } else {
+      blobImpl = new BlobImplMemory(mData, mDataLen, EmptyString());
+    }
     mBlobImpls.AppendElement(blobImpl);
 
     mData = nullptr; // The nsDOMMemoryFile takes ownership of the buffer
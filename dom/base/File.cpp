@@ -32,13 +32,18 @@
 #include "nsPrintfCString.h"
 #include "mozilla/SHA1.h"
 #include "mozilla/CheckedInt.h"
+#include "mozilla/Mutex.h"
 #include "mozilla/Preferences.h"
 #include "mozilla/Attributes.h"
 #include "mozilla/dom/BlobBinding.h"
+#include "mozilla/dom/ContentChild.h"
 #include "mozilla/dom/DOMError.h"
 #include "mozilla/dom/FileBinding.h"
 #include "mozilla/dom/WorkerPrivate.h"
 #include "mozilla/dom/WorkerRunnable.h"
+#include "mozilla/unused.h"
+#include "nsAnonymousTemporaryFile.h"
+#include "nsServiceManagerUtils.h"
 #include "nsThreadUtils.h"
 
 namespace mozilla {
@@ -1170,6 +1175,78 @@ BlobImplMemory::DataOwner::EnsureMemoryReporterRegistered()
 
 NS_IMPL_ISUPPORTS_INHERITED0(BlobImplTemporaryBlob, BlobImpl)
 
+/* static */ StaticMutex
+BlobImplTemporaryBlob::FileUsage::sFileUsageMutex;
+
+/* static */ uint64_t
+BlobImplTemporaryBlob::FileUsage::sFileCount = 0;
+
+/* static */ uint64_t
+BlobImplTemporaryBlob::FileUsage::sFileBytes = 0;
+
+/* static */ bool
+BlobImplTemporaryBlob::FileUsage::sMemoryReporterRegistered = false;
+
+class BlobImplTemporaryBlobMemoryReporter final
+  : public nsIMemoryReporter
+{
+  ~BlobImplTemporaryBlobMemoryReporter() {}
+
+public:
+  NS_DECL_THREADSAFE_ISUPPORTS
+
+  NS_IMETHOD CollectReports(nsIMemoryReporterCallback *aCallback,
+                            nsISupports *aClosure, bool aAnonymize) override
+  {
+    typedef BlobImplTemporaryBlob::FileUsage FileUsage;
+
+    uint64_t count;
+    uint64_t bytes;
+    {
+      StaticMutexAutoLock lock(FileUsage::sFileUsageMutex);
+      count = FileUsage::sFileCount;
+      bytes = FileUsage::sFileBytes;
+    }
+
+    nsresult rv = aCallback->Callback(
+      /* process */ NS_LITERAL_CSTRING(""),
+      NS_LITERAL_CSTRING("blob-temporary-files"),
+      KIND_OTHER, UNITS_COUNT, int64_t(count),
+      NS_LITERAL_CSTRING(
+        "Number of temporary files holding the data of blobs that were too "
+        "large to keep in memory."),
+      aClosure);
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    rv = aCallback->Callback(
+      /* process */ NS_LITERAL_CSTRING(""),
+      NS_LITERAL_CSTRING("blob-temporary-file-data"),
+      KIND_OTHER, UNITS_BYTES, int64_t(bytes),
+      NS_LITERAL_CSTRING(
+        "Disk space used by temporary files holding the data of blobs that "
+        "were too large to keep in memory."),
+      aClosure);
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    return NS_OK;
+  }
+};
+
+NS_IMPL_ISUPPORTS(BlobImplTemporaryBlobMemoryReporter, nsIMemoryReporter)
+
+/* static */ void
+BlobImplTemporaryBlob::FileUsage::EnsureMemoryReporterRegistered()
+{
+  sFileUsageMutex.AssertCurrentThreadOwns();
+  if (sMemoryReporterRegistered) {
+    return;
+  }
+
+  RegisterStrongMemoryReporter(new BlobImplTemporaryBlobMemoryReporter());
+
+  sMemoryReporterRegistered = true;
+}
+
 already_AddRefed<BlobImpl>
 BlobImplTemporaryBlob::CreateSlice(uint64_t aStart, uint64_t aLength,
                                    const nsAString& aContentType,
@@ -1195,5 +1272,217 @@ BlobImplTemporaryBlob::GetInternalStream(nsIInputStream** aStream,
   stream.forget(aStream);
 }
 
+////////////////////////////////////////////////////////////////////////////
+// BlobImplMemoryToTemporaryFile implementation
+
+class BlobImplMemoryToTemporaryFile::Storage final
+{
+  typedef BlobImplMemory::DataOwner DataOwner;
+  typedef nsTemporaryFileInputStream::FileDescOwner FileDescOwner;
+  typedef BlobImplTemporaryBlob::FileUsage FileUsage;
+
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(BlobImplMemoryToTemporaryFile::Storage)
+
+  Storage(void* aMemoryBuffer, uint64_t aLength)
+    : mMutex("BlobImplMemoryToTemporaryFile::Storage::mMutex")
+    , mLength(aLength)
+    , mDataOwner(new DataOwner(aMemoryBuffer, aLength))
+  {}
+
+  // Starts moving the data to a temporary file without blocking. May be
+  // called on any thread.
+  void MoveToTemporaryFile();
+
+  void GetInternalStream(uint64_t aStart, uint64_t aLength,
+                         nsIInputStream** aStream, ErrorResult& aRv);
+
+  bool IsInMemory()
+  {
+    MutexAutoLock lock(mMutex);
+    return !mFileDescOwner;
+  }
+
+private:
+  ~Storage() {}
+
+  // These run on the stream transport service.
+  void OpenAndWriteToTemporaryFile();
+  void WriteToTemporaryFile(PRFileDesc* aFD);
+
+  Mutex mMutex;
+  const uint64_t mLength;
+
+  // mDataOwner is set until the data has been written to the file, then
+  // mFileDescOwner and mFileUsage are. Streams created before that keep the
+  // DataOwner, and so the memory, alive until they are released.
+  RefPtr<DataOwner> mDataOwner;
+  RefPtr<FileDescOwner> mFileDescOwner;
+  RefPtr<FileUsage> mFileUsage;
+};
+
+void
+BlobImplMemoryToTemporaryFile::Storage::MoveToTemporaryFile()
+{
+  if (!NS_IsMainThread()) {
+    NS_DispatchToMainThread(
+      NewRunnableMethod(this, &Storage::MoveToTemporaryFile));
+    return;
+  }
+
+  nsCOMPtr<nsIEventTarget> target =
+    do_GetService(NS_STREAMTRANSPORTSERVICE_CONTRACTID);
+  if (NS_WARN_IF(!target)) {
+    return;
+  }
+
+  // In content processes the parent opens the file, so ask for it
+  // asynchronously instead of using NS_OpenAnonymousTemporaryFile.
+  if (ContentChild* child = ContentChild::GetSingleton()) {
+    RefPtr<Storage> self = this;
+    child->AsyncOpenAnonymousTemporaryFile([self, target](PRFileDesc* aFD) {
+      if (!aFD) {
+        return;
+      }
+
+      nsCOMPtr<nsIRunnable> runnable =
+        NewRunnableMethod<PRFileDesc*>(self, &Storage::WriteToTemporaryFile,
+                                       aFD);
+      if (NS_WARN_IF(NS_FAILED(target->Dispatch(runnable,
+                                                NS_DISPATCH_NORMAL)))) {
+        PR_Close(aFD);
+      }
+    });
+    return;
+  }
+
+  nsCOMPtr<nsIRunnable> runnable =
+    NewRunnableMethod(this, &Storage::OpenAndWriteToTemporaryFile);
+  Unused << NS_WARN_IF(NS_FAILED(target->Dispatch(runnable,
+                                                  NS_DISPATCH_NORMAL)));
+}
+
+void
+BlobImplMemoryToTemporaryFile::Storage::OpenAndWriteToTemporaryFile()
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+
+  PRFileDesc* fd;
+  nsresult rv = NS_OpenAnonymousTemporaryFile(&fd);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return;
+  }
+
+  WriteToTemporaryFile(fd);
+}
+
+void
+BlobImplMemoryToTemporaryFile::Storage::WriteToTemporaryFile(PRFileDesc* aFD)
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+  MOZ_ASSERT(aFD);
+
+  // Only this method clears mDataOwner, and the data it owns never changes,
+  // so it can be written without holding the lock.
+  RefPtr<DataOwner> dataOwner;
+  {
+    MutexAutoLock lock(mMutex);
+    dataOwner = mDataOwner;
+  }
+
+  const char* data = static_cast<const char*>(dataOwner->mData);
+  uint64_t remaining = mLength;
+  while (remaining) {
+    int32_t count = int32_t(std::min<uint64_t>(remaining, INT32_MAX));
+    int32_t written = PR_Write(aFD, data, count);
+    if (NS_WARN_IF(written <= 0)) {
+      // Keep the data in memory.
+      PR_Close(aFD);
+      return;
+    }
+
+    data += written;
+    remaining -= written;
+  }
+
+  RefPtr<FileUsage> fileUsage = new FileUsage(mLength);
+
+  MutexAutoLock lock(mMutex);
+  mFileDescOwner = new FileDescOwner(aFD);
+  mFileUsage = fileUsage.forget();
+  mDataOwner = nullptr;
+}
+
+void
+BlobImplMemoryToTemporaryFile::Storage::GetInternalStream(uint64_t aStart,
+                                                          uint64_t aLength,
+                                                          nsIInputStream** aStream,
+                                                          ErrorResult& aRv)
+{
+  MutexAutoLock lock(mMutex);
+
+  if (mFileDescOwner) {
+    nsCOMPtr<nsIInputStream> stream =
+      new nsTemporaryFileInputStream(mFileDescOwner, aStart, aStart + aLength);
+    stream.forget(aStream);
+    return;
+  }
+
+  if (aLength > INT32_MAX) {
+    aRv.Throw(NS_ERROR_FAILURE);
+    return;
+  }
+
+  aRv = DataOwnerAdapter::Create(mDataOwner, aStart, aLength, aStream);
+}
+
+NS_IMPL_ISUPPORTS_INHERITED0(BlobImplMemoryToTemporaryFile, BlobImpl)
+
+BlobImplMemoryToTemporaryFile::BlobImplMemoryToTemporaryFile(void* aMemoryBuffer,
+                                                             uint64_t aLength,
+                                                             const nsAString& aContentType)
+  : BlobImplBase(aContentType, aLength)
+  , mStorage(new Storage(aMemoryBuffer, aLength))
+{
+  mStorage->MoveToTemporaryFile();
+}
+
+BlobImplMemoryToTemporaryFile::BlobImplMemoryToTemporaryFile(const BlobImplMemoryToTemporaryFile* aOther,
+                                                             uint64_t aStart,
+                                                             uint64_t aLength,
+                                                             const nsAString& aContentType)
+  : BlobImplBase(aContentType, aOther->mStart + aStart, aLength)
+  , mStorage(aOther->mStorage)
+{
+  mImmutable = aOther->mImmutable;
+}
+
+BlobImplMemoryToTemporaryFile::~BlobImplMemoryToTemporaryFile()
+{
+}
+
+already_AddRefed<BlobImpl>
+BlobImplMemoryToTemporaryFile::CreateSlice(uint64_t aStart, uint64_t aLength,
+                                           const nsAString& aContentType,
+                                           ErrorResult& aRv)
+{
+  RefPtr<BlobImpl> impl =
+    new BlobImplMemoryToTemporaryFile(this, aStart, aLength, aContentType);
+  return impl.forget();
+}
+
+void
+BlobImplMemoryToTemporaryFile::GetInternalStream(nsIInputStream** aStream,
+                                                 ErrorResult& aRv)
+{
+  mStorage->GetInternalStream(mStart, mLength, aStream, aRv);
+}
+
+bool
+BlobImplMemoryToTemporaryFile::IsMemoryFile() const
+{
+  return mStorage->IsInMemory();
+}
+
 } // namespace dom
 } // namespace mozilla
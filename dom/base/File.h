@@ -630,6 +630,7 @@ public:
     , mStartPos(aStartPos)
   {
     mFileDescOwner = new nsTemporaryFileInputStream::FileDescOwner(aFD);
+    mFileUsage = new FileUsage(aStartPos + aLength);
   }
 
   virtual void GetInternalStream(nsIInputStream** aStream,
@@ -639,6 +640,44 @@ public:
   CreateSlice(uint64_t aStart, uint64_t aLength,
               const nsAString& aContentType, ErrorResult& aRv) override;
 
+  // Reports the temporary file to the memory reporter for as long as the blob
+  // or any of its slices is alive.
+  class FileUsage final
+  {
+  public:
+    NS_INLINE_DECL_THREADSAFE_REFCOUNTING(FileUsage)
+
+    explicit FileUsage(uint64_t aLength)
+      : mLength(aLength)
+    {
+      mozilla::StaticMutexAutoLock lock(sFileUsageMutex);
+
+      EnsureMemoryReporterRegistered();
+      sFileCount++;
+      sFileBytes += mLength;
+    }
+
+  private:
+    ~FileUsage()
+    {
+      mozilla::StaticMutexAutoLock lock(sFileUsageMutex);
+
+      sFileCount--;
+      sFileBytes -= mLength;
+    }
+
+  public:
+    static void EnsureMemoryReporterRegistered();
+
+    // These may only be accessed while holding sFileUsageMutex.
+    static mozilla::StaticMutex sFileUsageMutex;
+    static uint64_t sFileCount;
+    static uint64_t sFileBytes;
+    static bool sMemoryReporterRegistered;
+
+    const uint64_t mLength;
+  };
+
 private:
   BlobImplTemporaryBlob(const BlobImplTemporaryBlob* aOther,
                         uint64_t aStart, uint64_t aLength,
@@ -646,12 +685,50 @@ private:
     : BlobImplBase(aContentType, aLength)
     , mStartPos(aStart)
     , mFileDescOwner(aOther->mFileDescOwner)
+    , mFileUsage(aOther->mFileUsage)
   {}
 
   ~BlobImplTemporaryBlob() {}
 
   uint64_t mStartPos;
   RefPtr<nsTemporaryFileInputStream::FileDescOwner> mFileDescOwner;
+  RefPtr<FileUsage> mFileUsage;
+};
+
+// A memory blob that moves its data to an anonymous temporary file. The data
+// is written on a background thread, and is read from memory until then. Used
+// by BlobSet for data larger than
+// nsContentUtils::BlobMemoryToTemporaryFileThreshold().
+class BlobImplMemoryToTemporaryFile final : public BlobImplBase
+{
+public:
+  NS_DECL_ISUPPORTS_INHERITED
+
+  // Takes ownership of aMemoryBuffer, which must come from malloc.
+  BlobImplMemoryToTemporaryFile(void* aMemoryBuffer, uint64_t aLength,
+                                const nsAString& aContentType);
+
+  virtual void GetInternalStream(nsIInputStream** aStream,
+                                 ErrorResult& aRv) override;
+
+  virtual already_AddRefed<BlobImpl>
+  CreateSlice(uint64_t aStart, uint64_t aLength,
+              const nsAString& aContentType, ErrorResult& aRv) override;
+
+  virtual bool IsMemoryFile() const override;
+
+  // The data shared by a blob and its slices.
+  class Storage;
+
+private:
+  // Create slice
+  BlobImplMemoryToTemporaryFile(const BlobImplMemoryToTemporaryFile* aOther,
+                                uint64_t aStart, uint64_t aLength,
+                                const nsAString& aContentType);
+
+  ~BlobImplMemoryToTemporaryFile();
+
+  RefPtr<Storage> mStorage;
 };
 
 class BlobImplFile : public BlobImplBase
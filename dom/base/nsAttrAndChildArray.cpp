@@ -14,6 +14,8 @@
 #include "mozilla/CheckedInt.h"
 #include "mozilla/MathAlgorithms.h"
 #include "mozilla/MemoryReporting.h"
+#include "mozilla/Move.h"
+#include "mozilla/UniquePtr.h"
 
 #include "nsMappedAttributeElement.h"
 #include "nsString.h"
@@ -22,8 +24,16 @@
 #include "nsMappedAttributes.h"
 #include "nsUnicharUtils.h"
 #include "nsContentUtils.h" // nsAutoScriptBlocker
+#include "nsDataHashtable.h"
+#include "nsHashKeys.h"
+#include "nsTArray.h"
+
+#include <algorithm>
 
 using mozilla::CheckedUint32;
+using mozilla::MakeUnique;
+using mozilla::Move;
+using mozilla::UniquePtr;
 
 /*
 CACHE_POINTER_SHIFT indicates how many steps to downshift the |this| pointer.
@@ -78,6 +88,345 @@ GetIndexFromCache(const nsAttrAndChildArray* aArray)
 }
 
 
+/*
+Children lists reaching CHUNKED_CHILDREN_THRESHOLD are moved into a
+ChunkedChildList, and moved back into mBuffer once they are shorter than half
+of that, so that a list hovering around the threshold doesn't switch back and
+forth. A chunk holds at most CHUNK_MAX_LENGTH children, and chunks are filled
+to half of that when a list is converted or a chunk is split.
+*/
+
+#define CHUNKED_CHILDREN_THRESHOLD 4096
+#define CHUNK_MAX_LENGTH 512
+
+struct nsAttrAndChildArray::ChunkedChildList
+{
+  struct Chunk
+  {
+    // The position of the chunk in mChunks.
+    uint32_t mIndex;
+    // The index of the first child of the chunk. Only valid if mIndex is
+    // below mFirstStaleStart.
+    uint32_t mStart;
+    uint32_t mLength;
+    nsIContent* mChildren[CHUNK_MAX_LENGTH];
+  };
+
+  ChunkedChildList()
+    : mFirstStaleStart(0)
+    , mCursor(0)
+    , mFlatChildrenValid(false)
+  {
+  }
+
+  void AppendChildren(nsIContent* const* aChildren, uint32_t aCount);
+  void CopyChildren(void** aDest) const;
+
+  nsIContent* ChildAt(uint32_t aPos)
+  {
+    uint32_t offset;
+    Chunk* chunk = Locate(aPos, &offset);
+    return chunk->mChildren[offset];
+  }
+
+  int32_t IndexOf(const nsINode* aPossibleChild);
+  void InsertAt(nsIContent* aChild, uint32_t aPos);
+  nsIContent* TakeAt(uint32_t aPos);
+  nsIContent* const* GetFlatChildren();
+
+  size_t SizeOfIncludingThis(mozilla::MallocSizeOf aMallocSizeOf) const;
+
+private:
+  /**
+   * Returns the chunk holding the child at aPos and sets *aOffset to its
+   * offset in the chunk. aPos may be the number of children, in which case
+   * this returns the last chunk and its length.
+   */
+  Chunk* Locate(uint32_t aPos, uint32_t* aOffset);
+
+  void InvalidateStartsAfter(uint32_t aIndex)
+  {
+    if (mFirstStaleStart > aIndex + 1) {
+      mFirstStaleStart = aIndex + 1;
+    }
+    DropFlatChildren();
+  }
+
+  void DropFlatChildren()
+  {
+    // Free the copy rather than keep it around for the next GetChildArray,
+    // which would double the memory the chunks are meant to save.
+    mFlatChildren.Clear();
+    mFlatChildren.Compact();
+    mFlatChildrenValid = false;
+  }
+
+  void RenumberFrom(uint32_t aIndex)
+  {
+    for (uint32_t i = aIndex; i < mChunks.Length(); ++i) {
+      mChunks[i]->mIndex = i;
+    }
+  }
+
+  void EnsureStart(uint32_t aIndex)
+  {
+    for (; mFirstStaleStart <= aIndex; ++mFirstStaleStart) {
+      Chunk* chunk = mChunks[mFirstStaleStart].get();
+      if (!mFirstStaleStart) {
+        chunk->mStart = 0;
+        continue;
+      }
+      Chunk* previous = mChunks[mFirstStaleStart - 1].get();
+      chunk->mStart = previous->mStart + previous->mLength;
+    }
+  }
+
+  void SplitChunk(Chunk* aChunk);
+  void RemoveChunk(Chunk* aChunk);
+  void MergeChunks(Chunk* aChunk, Chunk* aNext);
+
+  // Never empty, and none of the chunks are empty.
+  nsTArray<UniquePtr<Chunk>> mChunks;
+  // Maps every child to the chunk holding it.
+  nsDataHashtable<nsPtrHashKey<const nsINode>, Chunk*> mChunkForChild;
+  // The cumulative child indices are updated lazily, since most mutations
+  // happen in only a few places of the list.
+  uint32_t mFirstStaleStart;
+  // The chunk last located, so that walking the children in order doesn't
+  // need a search for each of them.
+  uint32_t mCursor;
+  // A copy of the children for GetChildArray, built on demand and freed by the
+  // next mutation.
+  nsTArray<nsIContent*> mFlatChildren;
+  bool mFlatChildrenValid;
+};
+
+void
+nsAttrAndChildArray::ChunkedChildList::AppendChildren(
+  nsIContent* const* aChildren, uint32_t aCount)
+{
+  MOZ_ASSERT(mChunks.IsEmpty(), "only used to fill a new list");
+
+  for (uint32_t i = 0; i < aCount; i += CHUNK_MAX_LENGTH / 2) {
+    UniquePtr<Chunk> chunk = MakeUnique<Chunk>();
+    chunk->mIndex = mChunks.Length();
+    chunk->mLength = std::min(aCount - i, uint32_t(CHUNK_MAX_LENGTH / 2));
+    memcpy(chunk->mChildren, aChildren + i,
+           chunk->mLength * sizeof(nsIContent*));
+    for (uint32_t j = 0; j < chunk->mLength; ++j) {
+      mChunkForChild.Put(chunk->mChildren[j], chunk.get());
+    }
+    mChunks.AppendElement(Move(chunk));
+  }
+}
+
+void
+nsAttrAndChildArray::ChunkedChildList::CopyChildren(void** aDest) const
+{
+  for (uint32_t i = 0; i < mChunks.Length(); ++i) {
+    memcpy(aDest, mChunks[i]->mChildren,
+           mChunks[i]->mLength * sizeof(nsIContent*));
+    aDest += mChunks[i]->mLength;
+  }
+}
+
+nsAttrAndChildArray::ChunkedChildList::Chunk*
+nsAttrAndChildArray::ChunkedChildList::Locate(uint32_t aPos,
+                                              uint32_t* aOffset)
+{
+  // Check the chunk last used and the one after it first.
+  for (uint32_t i = mCursor; i < mCursor + 2 && i < mChunks.Length(); ++i) {
+    Chunk* chunk = mChunks[i].get();
+    if (i >= mFirstStaleStart) {
+      break;
+    }
+    if (aPos >= chunk->mStart &&
+        (aPos < chunk->mStart + chunk->mLength ||
+         (aPos == chunk->mStart + chunk->mLength &&
+          i == mChunks.Length() - 1))) {
+      mCursor = i;
+      *aOffset = aPos - chunk->mStart;
+      return chunk;
+    }
+  }
+
+  // Make sure the start of the chunk holding aPos is known.
+  while (mFirstStaleStart < mChunks.Length()) {
+    if (mFirstStaleStart) {
+      Chunk* previous = mChunks[mFirstStaleStart - 1].get();
+      if (aPos < previous->mStart + previous->mLength) {
+        break;
+      }
+    }
+    EnsureStart(mFirstStaleStart);
+  }
+
+  // Find the last chunk starting at or before aPos.
+  uint32_t low = 0, high = mFirstStaleStart;
+  while (high - low > 1) {
+    uint32_t middle = low + (high - low) / 2;
+    if (mChunks[middle]->mStart <= aPos) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  Chunk* chunk = mChunks[low].get();
+  NS_ASSERTION(aPos - chunk->mStart <= chunk->mLength, "out-of-bounds");
+  mCursor = low;
+  *aOffset = aPos - chunk->mStart;
+  return chunk;
+}
+
+int32_t
+nsAttrAndChildArray::ChunkedChildList::IndexOf(const nsINode* aPossibleChild)
+{
+  Chunk* chunk = mChunkForChild.Get(aPossibleChild);
+  if (!chunk) {
+    return -1;
+  }
+
+  EnsureStart(chunk->mIndex);
+  for (uint32_t i = 0; i < chunk->mLength; ++i) {
+    if (chunk->mChildren[i] == aPossibleChild) {
+      mCursor = chunk->mIndex;
+      return static_cast<int32_t>(chunk->mStart + i);
+    }
+  }
+
+  NS_NOTREACHED("child not in the chunk it is mapped to");
+  return -1;
+}
+
+void
+nsAttrAndChildArray::ChunkedChildList::InsertAt(nsIContent* aChild,
+                                                uint32_t aPos)
+{
+  uint32_t offset;
+  Chunk* chunk = Locate(aPos, &offset);
+  if (chunk->mLength == CHUNK_MAX_LENGTH) {
+    SplitChunk(chunk);
+    chunk = Locate(aPos, &offset);
+  }
+
+  memmove(&chunk->mChildren[offset + 1], &chunk->mChildren[offset],
+          (chunk->mLength - offset) * sizeof(nsIContent*));
+  chunk->mChildren[offset] = aChild;
+  ++chunk->mLength;
+  mChunkForChild.Put(aChild, chunk);
+
+  InvalidateStartsAfter(chunk->mIndex);
+}
+
+nsIContent*
+nsAttrAndChildArray::ChunkedChildList::TakeAt(uint32_t aPos)
+{
+  uint32_t offset;
+  Chunk* chunk = Locate(aPos, &offset);
+  nsIContent* child = chunk->mChildren[offset];
+
+  --chunk->mLength;
+  memmove(&chunk->mChildren[offset], &chunk->mChildren[offset + 1],
+          (chunk->mLength - offset) * sizeof(nsIContent*));
+  mChunkForChild.Remove(child);
+
+  if (!chunk->mLength) {
+    RemoveChunk(chunk);
+    return child;
+  }
+
+  InvalidateStartsAfter(chunk->mIndex);
+
+  // Keep the number of chunks proportional to the number of children when
+  // children are removed all over the list.
+  uint32_t next = chunk->mIndex + 1;
+  if (next < mChunks.Length() &&
+      chunk->mLength + mChunks[next]->mLength <= CHUNK_MAX_LENGTH / 2) {
+    MergeChunks(chunk, mChunks[next].get());
+  }
+
+  return child;
+}
+
+void
+nsAttrAndChildArray::ChunkedChildList::SplitChunk(Chunk* aChunk)
+{
+  UniquePtr<Chunk> next = MakeUnique<Chunk>();
+  uint32_t keep = aChunk->mLength / 2;
+  next->mLength = aChunk->mLength - keep;
+  memcpy(next->mChildren, &aChunk->mChildren[keep],
+         next->mLength * sizeof(nsIContent*));
+  for (uint32_t i = 0; i < next->mLength; ++i) {
+    mChunkForChild.Put(next->mChildren[i], next.get());
+  }
+  aChunk->mLength = keep;
+
+  uint32_t index = aChunk->mIndex;
+  mChunks.InsertElementAt(index + 1, Move(next));
+  RenumberFrom(index + 1);
+  InvalidateStartsAfter(index);
+}
+
+void
+nsAttrAndChildArray::ChunkedChildList::RemoveChunk(Chunk* aChunk)
+{
+  uint32_t index = aChunk->mIndex;
+  mChunks.RemoveElementAt(index);
+  RenumberFrom(index);
+
+  if (mFirstStaleStart > index) {
+    mFirstStaleStart = index;
+  }
+  if (mCursor >= mChunks.Length()) {
+    mCursor = 0;
+  }
+  DropFlatChildren();
+}
+
+void
+nsAttrAndChildArray::ChunkedChildList::MergeChunks(Chunk* aChunk,
+                                                   Chunk* aNext)
+{
+  memcpy(&aChunk->mChildren[aChunk->mLength], aNext->mChildren,
+         aNext->mLength * sizeof(nsIContent*));
+  for (uint32_t i = 0; i < aNext->mLength; ++i) {
+    mChunkForChild.Put(aNext->mChildren[i], aChunk);
+  }
+  aChunk->mLength += aNext->mLength;
+
+  RemoveChunk(aNext);
+}
+
+nsIContent* const*
+nsAttrAndChildArray::ChunkedChildList::GetFlatChildren()
+{
+  if (!mFlatChildrenValid) {
+    MOZ_ASSERT(mFlatChildren.IsEmpty());
+    for (uint32_t i = 0; i < mChunks.Length(); ++i) {
+      mFlatChildren.AppendElements(mChunks[i]->mChildren,
+                                   mChunks[i]->mLength);
+    }
+    mFlatChildrenValid = true;
+  }
+
+  return mFlatChildren.Elements();
+}
+
+size_t
+nsAttrAndChildArray::ChunkedChildList::SizeOfIncludingThis(
+  mozilla::MallocSizeOf aMallocSizeOf) const
+{
+  size_t n = aMallocSizeOf(this);
+  n += mChunks.ShallowSizeOfExcludingThis(aMallocSizeOf);
+  for (uint32_t i = 0; i < mChunks.Length(); ++i) {
+    n += aMallocSizeOf(mChunks[i].get());
+  }
+  n += mChunkForChild.ShallowSizeOfExcludingThis(aMallocSizeOf);
+  n += mFlatChildren.ShallowSizeOfExcludingThis(aMallocSizeOf);
+  return n;
+}
+
 /**
  * Due to a compiler bug in VisualAge C++ for AIX, we need to return the
  * address of the first index into mBuffer here, instead of simply returning
@@ -127,6 +476,10 @@ nsAttrAndChildArray::GetChildArray(uint32_t* aChildCount) const
     return nullptr;
   }
 
+  if (HasChunkedChildren()) {
+    return GetChunkedChildren()->GetFlatChildren();
+  }
+
   return reinterpret_cast<nsIContent**>(mImpl->mBuffer + AttrSlotsSize());
 }
 
@@ -142,6 +495,36 @@ nsAttrAndChildArray::InsertChildAt(nsIContent* aChild, uint32_t aPos)
   NS_ENSURE_TRUE(childCount < ATTRCHILD_ARRAY_MAX_CHILD_COUNT,
                  NS_ERROR_FAILURE);
 
+  if (!HasChunkedChildren() && childCount >= CHUNKED_CHILDREN_THRESHOLD) {
+    MakeChildrenChunked();
+  }
+
+  if (HasChunkedChildren()) {
+    NS_PRECONDITION(!aChild->GetNextSibling(), "aChild with next sibling?");
+    NS_PRECONDITION(!aChild->GetPreviousSibling(), "aChild with prev sibling?");
+
+    ChunkedChildList* children = GetChunkedChildren();
+    nsIContent* next =
+      aPos < childCount ? children->ChildAt(aPos) : nullptr;
+    nsIContent* previous =
+      next ? next->mPreviousSibling : children->ChildAt(childCount - 1);
+
+    children->InsertAt(aChild, aPos);
+    NS_ADDREF(aChild);
+    if (previous) {
+      aChild->mPreviousSibling = previous;
+      previous->mNextSibling = aChild;
+    }
+    if (next) {
+      aChild->mNextSibling = next;
+      next->mPreviousSibling = aChild;
+    }
+
+    SetChildCount(childCount + 1);
+
+    return NS_OK;
+  }
+
   // First try to fit new child in existing childlist
   if (mImpl && offset + childCount < mImpl->mBufferSize) {
     void** pos = mImpl->mBuffer + offset + aPos;
@@ -202,8 +585,10 @@ nsAttrAndChildArray::TakeChildAt(uint32_t aPos)
   NS_ASSERTION(aPos < ChildCount(), "out-of-bounds");
 
   uint32_t childCount = ChildCount();
+  bool chunked = HasChunkedChildren();
   void** pos = mImpl->mBuffer + AttrSlotsSize() + aPos;
-  nsIContent* child = static_cast<nsIContent*>(*pos);
+  nsIContent* child = chunked ? GetChunkedChildren()->TakeAt(aPos)
+                              : static_cast<nsIContent*>(*pos);
   if (child->mPreviousSibling) {
     child->mPreviousSibling->mNextSibling = child->mNextSibling;
   }
@@ -212,6 +597,14 @@ nsAttrAndChildArray::TakeChildAt(uint32_t aPos)
   }
   child->mPreviousSibling = child->mNextSibling = nullptr;
 
+  if (chunked) {
+    SetChildCount(childCount - 1);
+    if (childCount - 1 < CHUNKED_CHILDREN_THRESHOLD / 2) {
+      MakeChildrenFlat();
+    }
+    return dont_AddRef(child);
+  }
+
   memmove(pos, pos + 1, (childCount - aPos - 1) * sizeof(nsIContent*));
   SetChildCount(childCount - 1);
 
@@ -224,6 +617,9 @@ nsAttrAndChildArray::IndexOfChild(const nsINode* aPossibleChild) const
   if (!mImpl) {
     return -1;
   }
+  if (HasChunkedChildren()) {
+    return GetChunkedChildren()->IndexOf(aPossibleChild);
+  }
   void** children = mImpl->mBuffer + AttrSlotsSize();
   // Use signed here since we compare count to cursor which has to be signed
   int32_t i, count = ChildCount();
@@ -636,7 +1032,7 @@ nsAttrAndChildArray::Compact()
   // First compress away empty attrslots
   uint32_t slotCount = AttrSlotCount();
   uint32_t attrCount = NonMappedAttrCount();
-  uint32_t childCount = ChildCount();
+  uint32_t childCount = ChildSlotCount();
 
   if (attrCount < slotCount) {
     memmove(mImpl->mBuffer + attrCount * ATTRSIZE,
@@ -670,15 +1066,20 @@ nsAttrAndChildArray::Clear()
     NS_RELEASE(mImpl->mMappedAttrs);
   }
 
+  ChunkedChildList* chunked =
+    HasChunkedChildren() ? GetChunkedChildren() : nullptr;
+
   uint32_t i, slotCount = AttrSlotCount();
   for (i = 0; i < slotCount && AttrSlotIsTaken(i); ++i) {
     ATTRS(mImpl)[i].~InternalAttr();
   }
 
   nsAutoScriptBlocker scriptBlocker;
-  uint32_t end = slotCount * ATTRSIZE + ChildCount();
-  for (i = slotCount * ATTRSIZE; i < end; ++i) {
-    nsIContent* child = static_cast<nsIContent*>(mImpl->mBuffer[i]);
+  void** children = mImpl->mBuffer + slotCount * ATTRSIZE;
+  uint32_t childCount = ChildCount();
+  for (i = 0; i < childCount; ++i) {
+    nsIContent* child = chunked ? chunked->ChildAt(i)
+                                : static_cast<nsIContent*>(children[i]);
     // making this false so tree teardown doesn't end up being
     // O(N*D) (number of nodes times average depth of tree).
     child->UnbindFromTree(false); // XXX is it better to let the owner do this?
@@ -697,6 +1098,8 @@ nsAttrAndChildArray::Clear()
     NS_RELEASE(child);
   }
 
+  delete chunked;
+
   SetAttrSlotAndChildCount(0, 0);
 }
 
@@ -830,7 +1233,7 @@ bool
 nsAttrAndChildArray::AddAttrSlot()
 {
   uint32_t slotCount = AttrSlotCount();
-  uint32_t childCount = ChildCount();
+  uint32_t childCount = ChildSlotCount();
 
   CheckedUint32 size = slotCount;
   size += 1;
@@ -860,6 +1263,50 @@ nsAttrAndChildArray::AddAttrSlot()
   return true;
 }
 
+nsIContent*
+nsAttrAndChildArray::ChunkedChildAt(uint32_t aPos) const
+{
+  return GetChunkedChildren()->ChildAt(aPos);
+}
+
+void
+nsAttrAndChildArray::MakeChildrenChunked()
+{
+  uint32_t offset = AttrSlotsSize();
+  UniquePtr<ChunkedChildList> children = MakeUnique<ChunkedChildList>();
+  children->AppendChildren(
+    reinterpret_cast<nsIContent**>(mImpl->mBuffer + offset), ChildCount());
+  mImpl->mBuffer[offset] = reinterpret_cast<void*>(
+    reinterpret_cast<uintptr_t>(children.release()) |
+    ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG);
+
+  // The children only take a single slot now.
+  uint32_t newSize = offset + 1;
+  Impl* newImpl = static_cast<Impl*>(
+    realloc(mImpl, (newSize + NS_IMPL_EXTRA_SIZE) * sizeof(void*)));
+  if (newImpl) {
+    mImpl = newImpl;
+    mImpl->mBufferSize = newSize;
+  }
+}
+
+void
+nsAttrAndChildArray::MakeChildrenFlat()
+{
+  ChunkedChildList* children = GetChunkedChildren();
+  uint32_t offset = AttrSlotsSize();
+  uint32_t childCount = ChildCount();
+
+  // Stay chunked if there's no memory for a flat list.
+  if (offset + childCount > mImpl->mBufferSize &&
+      !GrowBy(offset + childCount - mImpl->mBufferSize)) {
+    return;
+  }
+
+  children->CopyChildren(mImpl->mBuffer + offset);
+  delete children;
+}
+
 inline void
 nsAttrAndChildArray::SetChildAtPos(void** aPos, nsIContent* aChild,
                                    uint32_t aIndex, uint32_t aChildCount)
@@ -895,6 +1342,10 @@ nsAttrAndChildArray::SizeOfExcludingThis(mozilla::MallocSizeOf aMallocSizeOf) co
       nsAttrValue* value = &ATTRS(mImpl)[i].mValue;
       n += value->SizeOfExcludingThis(aMallocSizeOf);
     }
+
+    if (HasChunkedChildren()) {
+      n += GetChunkedChildren()->SizeOfIncludingThis(aMallocSizeOf);
+    }
   }
 
   return n;
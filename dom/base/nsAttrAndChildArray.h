@@ -13,6 +13,7 @@
 #define nsAttrAndChildArray_h___
 
 #include "mozilla/Attributes.h"
+#include "mozilla/Likely.h"
 #include "mozilla/MemoryReporting.h"
 #include "mozilla/dom/BorrowedAttrInfo.h"
 
@@ -45,6 +46,10 @@ class nsMappedAttributeElement;
 
 #define ATTRSIZE (sizeof(InternalAttr) / sizeof(void*))
 
+// Tag bit set on the single child slot of an array whose children are kept
+// in a ChunkedChildList.
+#define ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG uintptr_t(1)
+
 class nsAttrAndChildArray
 {
   typedef mozilla::dom::BorrowedAttrInfo BorrowedAttrInfo;
@@ -59,7 +64,12 @@ public:
   nsIContent* ChildAt(uint32_t aPos) const
   {
     NS_ASSERTION(aPos < ChildCount(), "out-of-bounds access in nsAttrAndChildArray");
-    return reinterpret_cast<nsIContent*>(mImpl->mBuffer[AttrSlotsSize() + aPos]);
+    void* const* children = mImpl->mBuffer + AttrSlotsSize();
+    if (MOZ_UNLIKELY(reinterpret_cast<uintptr_t>(children[0]) &
+                     ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG)) {
+      return ChunkedChildAt(aPos);
+    }
+    return reinterpret_cast<nsIContent*>(children[aPos]);
   }
   nsIContent* GetSafeChildAt(uint32_t aPos) const;
   nsIContent * const * GetChildArray(uint32_t* aChildCount) const;
@@ -141,6 +151,41 @@ private:
 
   void Clear();
 
+  /**
+   * Children lists longer than a few thousand nodes are moved out of mBuffer
+   * into a ChunkedChildList, which keeps them in fixed-size chunks so that
+   * inserting, removing and finding the index of a child don't take time
+   * linear in the number of children.  mBuffer then holds a single child
+   * slot, pointing to the list and tagged with
+   * ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG.
+   */
+  struct ChunkedChildList;
+
+  bool HasChunkedChildren() const
+  {
+    return ChildCount() &&
+           (reinterpret_cast<uintptr_t>(mImpl->mBuffer[AttrSlotsSize()]) &
+            ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG);
+  }
+
+  ChunkedChildList* GetChunkedChildren() const
+  {
+    NS_ASSERTION(HasChunkedChildren(), "children are not chunked");
+    return reinterpret_cast<ChunkedChildList*>(
+      reinterpret_cast<uintptr_t>(mImpl->mBuffer[AttrSlotsSize()]) &
+      ~ATTRCHILD_ARRAY_CHUNKED_CHILDREN_TAG);
+  }
+
+  // The number of slots the children take up in mBuffer.
+  uint32_t ChildSlotCount() const
+  {
+    return HasChunkedChildren() ? 1 : ChildCount();
+  }
+
+  nsIContent* ChunkedChildAt(uint32_t aPos) const;
+  void MakeChildrenChunked();
+  void MakeChildrenFlat();
+
   uint32_t NonMappedAttrCount() const;
   uint32_t MappedAttrCount() const;
 
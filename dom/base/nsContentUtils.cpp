@@ -65,6 +65,7 @@
 #include "mozilla/MouseEvents.h"
 #include "mozilla/Preferences.h"
 #include "mozilla/dom/Selection.h"
+#include "mozilla/StaticPtr.h"
 #include "mozilla/TextEvents.h"
 #include "nsAString.h"
 #include "nsAttrName.h"
@@ -95,6 +96,7 @@
 #include "nsGenericHTMLElement.h"
 #include "nsGenericHTMLFrameElement.h"
 #include "nsGkAtoms.h"
+#include "nsHashKeys.h"
 #include "nsHostObjectProtocolHandler.h"
 #include "nsHtml5Module.h"
 #include "nsHtml5StringParser.h"
@@ -173,6 +175,7 @@
 #include "nsNetCID.h"
 #include "nsNetUtil.h"
 #include "nsNodeInfoManager.h"
+#include "nsNodeUtils.h"
 #include "nsNullPrincipal.h"
 #include "nsParserCIID.h"
 #include "nsParserConstants.h"
@@ -279,9 +282,12 @@ bool nsContentUtils::sEncodeDecodeURLHash = false;
 bool nsContentUtils::sGettersDecodeURLHash = false;
 bool nsContentUtils::sPrivacyResistFingerprinting = false;
 bool nsContentUtils::sSendPerformanceTimingNotifications = false;
+bool nsContentUtils::sHTMLFragmentCacheEnabled = true;
 
 uint32_t nsContentUtils::sHandlingInputTimeout = 1000;
 
+uint32_t nsContentUtils::sBlobMemoryToTemporaryFileThreshold = 1024 * 1024;
+
 uint32_t nsContentUtils::sCookiesLifetimePolicy = nsICookieService::ACCEPT_NORMALLY;
 uint32_t nsContentUtils::sCookiesBehavior = nsICookieService::BEHAVIOR_ACCEPT;
 
@@ -476,6 +482,13 @@ nsContentUtils::HandlingUserInputTimeout()
   return TimeDuration::FromMilliseconds(sHandlingInputTimeout);
 }
 
+/* static */
+uint32_t
+nsContentUtils::BlobMemoryToTemporaryFileThreshold()
+{
+  return sBlobMemoryToTemporaryFileThreshold;
+}
+
 // static
 nsresult
 nsContentUtils::Init()
@@ -582,6 +595,10 @@ nsContentUtils::Init()
                                "dom.event.handling-user-input-time-limit",
                                1000);
 
+  Preferences::AddUintVarCache(&sBlobMemoryToTemporaryFileThreshold,
+                               "dom.blob.memory_to_temporary_file",
+                               1024 * 1024);
+
   Preferences::AddBoolVarCache(&sSendPerformanceTimingNotifications,
                                "dom.performance.enable_notify_performance_timing", false);
 
@@ -601,6 +618,9 @@ nsContentUtils::Init()
   Preferences::AddBoolVarCache(&sDoNotTrackEnabled,
                                "privacy.donottrackheader.enabled", false);
 
+  Preferences::AddBoolVarCache(&sHTMLFragmentCacheEnabled,
+                               "dom.html_fragment_cache.enabled", true);
+
   Element::InitCCCallbacks();
 
   nsCOMPtr<nsIUUIDGenerator> uuidGenerator =
@@ -4489,15 +4509,194 @@ nsContentUtils::CreateContextualFragment(nsINode* aContextNode,
   return frag.forget().downcast<DocumentFragment>();
 }
 
+namespace {
+
+// Sources longer than this are not worth keeping a copy of.
+const uint32_t kMaxCachedFragmentLength = 16 * 1024;
+const uint32_t kMaxCachedFragments = 32;
+
+/**
+ * Remembers the fragments that innerHTML has parsed recently, so that setting
+ * the same markup again in the same context clones the nodes instead of
+ * running the parser. A source only gets its nodes cached the second time it
+ * is seen, so that markup assigned once does not pay for an extra clone.
+ */
+class HTMLFragmentCache final
+{
+public:
+  struct Key
+  {
+    const nsAString& mSource;
+    uint32_t mHash;
+    // Only compared, never dereferenced: entries without a fragment do not
+    // keep the document alive.
+    nsIDocument* mDocument;
+    nsIAtom* mContextLocalName;
+    int32_t mContextNamespace;
+    bool mQuirks;
+    bool mPreventScriptExecution;
+  };
+
+  /**
+   * Looks up the fragment parsed from aKey, making it the most recently used
+   * one. Records the key if it has not been seen before.
+   *
+   * @param aSeenBefore set to whether aKey was in the cache
+   * @return the cached fragment, or nullptr if there is none yet.
+   */
+  DocumentFragment* Lookup(const Key& aKey, bool* aSeenBefore)
+  {
+    for (size_t i = mEntries.Length(); i-- > 0; ) {
+      if (!mEntries[i].Matches(aKey)) {
+        continue;
+      }
+      if (i != mEntries.Length() - 1) {
+        Entry entry(Move(mEntries[i]));
+        mEntries.RemoveElementAt(i);
+        mEntries.AppendElement(Move(entry));
+      }
+      *aSeenBefore = true;
+      return mEntries.LastElement().mFragment;
+    }
+
+    *aSeenBefore = false;
+    if (mEntries.Length() >= kMaxCachedFragments) {
+      mEntries.RemoveElementAt(0);
+    }
+    Entry* entry = mEntries.AppendElement();
+    entry->mSource = aKey.mSource;
+    entry->mHash = aKey.mHash;
+    entry->mDocument = aKey.mDocument;
+    entry->mContextLocalName = aKey.mContextLocalName;
+    entry->mContextNamespace = aKey.mContextNamespace;
+    entry->mQuirks = aKey.mQuirks;
+    entry->mPreventScriptExecution = aKey.mPreventScriptExecution;
+    return nullptr;
+  }
+
+  void Put(const Key& aKey, DocumentFragment* aFragment)
+  {
+    for (size_t i = mEntries.Length(); i-- > 0; ) {
+      if (mEntries[i].Matches(aKey)) {
+        mEntries[i].mFragment = aFragment;
+        return;
+      }
+    }
+  }
+
+  void DropDocument(nsIDocument* aDocument)
+  {
+    for (size_t i = mEntries.Length(); i-- > 0; ) {
+      if (mEntries[i].mDocument == aDocument) {
+        mEntries.RemoveElementAt(i);
+      }
+    }
+  }
+
+private:
+  struct Entry
+  {
+    bool Matches(const Key& aKey) const
+    {
+      return mHash == aKey.mHash &&
+             mDocument == aKey.mDocument &&
+             mContextLocalName == aKey.mContextLocalName &&
+             mContextNamespace == aKey.mContextNamespace &&
+             mQuirks == aKey.mQuirks &&
+             mPreventScriptExecution == aKey.mPreventScriptExecution &&
+             mSource.Equals(aKey.mSource);
+    }
+
+    nsString mSource;
+    uint32_t mHash;
+    nsIDocument* mDocument;
+    nsCOMPtr<nsIAtom> mContextLocalName;
+    int32_t mContextNamespace;
+    bool mQuirks;
+    bool mPreventScriptExecution;
+    RefPtr<DocumentFragment> mFragment;
+  };
+
+  // Least recently used first.
+  nsTArray<Entry> mEntries;
+};
+
+StaticAutoPtr<HTMLFragmentCache> sHTMLFragmentCache;
+
+bool
+IsCacheableFragment(const nsAString& aSourceBuffer, nsIContent* aTargetNode)
+{
+  if (aSourceBuffer.Length() > kMaxCachedFragmentLength) {
+    return false;
+  }
+  // Cached fragments keep their document alive until it is destroyed, which
+  // only happens to documents shown in a window. Cloning would run custom
+  // element callbacks that parsing does not.
+  nsIDocument* doc = aTargetNode->OwnerDoc();
+  if (!doc->GetInnerWindow() || nsDocument::RegisterEnabled()) {
+    return false;
+  }
+  // The tree builder drops <form> tags in a form, so the result depends on
+  // more than the context element then.
+  for (nsIContent* content = aTargetNode; content;
+       content = content->GetParent()) {
+    if (content->IsHTMLElement(nsGkAtoms::form)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Appends deep clones of the children of aSource from aStartIndex on to
+ * aTarget, notifying like the parser does.
+ */
+nsresult
+AppendClonedChildren(nsINode* aSource, uint32_t aStartIndex, nsINode* aTarget,
+                     bool aNotify)
+{
+  mozAutoDocUpdate updateBatch(aTarget->OwnerDoc(), UPDATE_CONTENT_MODEL,
+                               aNotify);
+  for (nsIContent* child = aSource->GetChildAt(aStartIndex); child;
+       child = child->GetNextSibling()) {
+    ErrorResult error;
+    nsCOMPtr<nsINode> clone = child->CloneNode(true, error);
+    if (NS_WARN_IF(error.Failed())) {
+      return error.StealNSResult();
+    }
+    nsCOMPtr<nsIContent> content = do_QueryInterface(clone);
+    MOZ_ASSERT(content);
+    uint32_t index = aTarget->GetChildCount();
+    nsresult rv = aTarget->AppendChildTo(content, false);
+    NS_ENSURE_SUCCESS(rv, rv);
+    if (aNotify) {
+      nsNodeUtils::ContentAppended(aTarget->AsContent(), content, index);
+    }
+  }
+  return NS_OK;
+}
+
+} // namespace
+
 /* static */
 void
 nsContentUtils::DropFragmentParsers()
 {
   NS_IF_RELEASE(sHTMLFragmentParser);
+  sHTMLFragmentCache = nullptr;
   NS_IF_RELEASE(sXMLFragmentParser);
   NS_IF_RELEASE(sXMLFragmentSink);
 }
 
+/* static */
+void
+nsContentUtils::DropCachedFragments(nsIDocument* aDocument)
+{
+  if (sHTMLFragmentCache) {
+    sHTMLFragmentCache->DropDocument(aDocument);
+  }
+}
+
 /* static */
 void
 nsContentUtils::XPCOMShutdown()
@@ -4522,10 +4721,31 @@ nsContentUtils::ParseFragmentHTML(const nsAString& aSourceBuffer,
   }
   mozilla::AutoRestore<bool> guard(nsContentUtils::sFragmentParsingActive);
   nsContentUtils::sFragmentParsingActive = true;
+
+  bool cacheable = sHTMLFragmentCacheEnabled &&
+                   IsCacheableFragment(aSourceBuffer, aTargetNode);
+  HTMLFragmentCache::Key key = {
+    aSourceBuffer, cacheable ? HashString(aSourceBuffer) : 0,
+    aTargetNode->OwnerDoc(), aContextLocalName, aContextNamespace, aQuirks,
+    aPreventScriptExecution
+  };
+  bool seenBefore = false;
+  if (cacheable) {
+    if (!sHTMLFragmentCache) {
+      sHTMLFragmentCache = new HTMLFragmentCache();
+    }
+    RefPtr<DocumentFragment> cached =
+      sHTMLFragmentCache->Lookup(key, &seenBefore);
+    if (cached) {
+      return AppendClonedChildren(cached, 0, aTargetNode, true);
+    }
+  }
+
   if (!sHTMLFragmentParser) {
     NS_ADDREF(sHTMLFragmentParser = new nsHtml5StringParser());
     // Now sHTMLFragmentParser owns the object
   }
+  uint32_t oldChildCount = aTargetNode->GetChildCount();
   nsresult rv =
     sHTMLFragmentParser->ParseFragment(aSourceBuffer,
                                        aTargetNode,
@@ -4533,6 +4753,14 @@ nsContentUtils::ParseFragmentHTML(const nsAString& aSourceBuffer,
                                        aContextNamespace,
                                        aQuirks,
                                        aPreventScriptExecution);
+  if (NS_SUCCEEDED(rv) && seenBefore && sHTMLFragmentCache) {
+    RefPtr<DocumentFragment> fragment =
+      new DocumentFragment(aTargetNode->OwnerDoc()->NodeInfoManager());
+    if (NS_SUCCEEDED(AppendClonedChildren(aTargetNode, oldChildCount,
+                                          fragment, false))) {
+      sHTMLFragmentCache->Put(key, fragment);
+    }
+  }
   return rv;
 }
 
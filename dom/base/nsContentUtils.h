@@ -1356,6 +1356,12 @@ public:
                                     bool aQuirks,
                                     bool aPreventScriptExecution);
 
+  /**
+   * Forgets the fragments ParseFragmentHTML cached for aDocument. Called when
+   * the document is destroyed.
+   */
+  static void DropCachedFragments(nsIDocument* aDocument);
+
   /**
    * Invoke the fragment parsing algorithm (innerHTML) using the XML parser.
    *
@@ -2105,6 +2111,13 @@ public:
    */
   static TimeDuration HandlingUserInputTimeout();
 
+  /**
+   * Returns the size in bytes above which data appended to a blob is moved
+   * from memory to a temporary file, or 0 if it never is. May be called on
+   * any thread.
+   */
+  static uint32_t BlobMemoryToTemporaryFileThreshold();
+
   static void GetShiftText(nsAString& text);
   static void GetControlText(nsAString& text);
   static void GetMetaText(nsAString& text);
@@ -2761,6 +2774,7 @@ private:
   static bool sTrustedFullScreenOnly;
   static bool sIsCutCopyAllowed;
   static uint32_t sHandlingInputTimeout;
+  static uint32_t sBlobMemoryToTemporaryFileThreshold;
   static bool sIsPerformanceTimingEnabled;
   static bool sIsResourceTimingEnabled;
   static bool sIsUserTimingLoggingEnabled;
@@ -2770,6 +2784,7 @@ private:
   static bool sGettersDecodeURLHash;
   static bool sPrivacyResistFingerprinting;
   static bool sSendPerformanceTimingNotifications;
+  static bool sHTMLFragmentCacheEnabled;
   static uint32_t sCookiesLifetimePolicy;
   static uint32_t sCookiesBehavior;
 
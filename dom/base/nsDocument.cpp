@@ -1851,6 +1851,7 @@ NS_IMPL_CYCLE_COLLECTION_TRAVERSE_BEGIN_INTERNAL(nsDocument)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mFirstBaseNodeWithHref)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mDOMImplementation)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mImageMaps)
+  NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mSelectorClassList)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mOrientationPendingPromise)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mOriginalDocument)
   NS_IMPL_CYCLE_COLLECTION_TRAVERSE(mCachedEncoder)
@@ -1939,6 +1940,8 @@ NS_IMPL_CYCLE_COLLECTION_UNLINK_BEGIN(nsDocument)
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mMaybeEndOutermostXBLUpdateRunner)
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mDOMImplementation)
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mImageMaps)
+  NS_IMPL_CYCLE_COLLECTION_UNLINK(mSelectorClassList)
+  tmp->mSelectorClass = nullptr;
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mCachedEncoder)
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mUndoManager)
   NS_IMPL_CYCLE_COLLECTION_UNLINK(mDocumentTimeline)
@@ -8960,6 +8963,8 @@ nsDocument::Destroy()
   mExternalResourceMap.Shutdown();
 
   mRegistry = nullptr;
+
+  nsContentUtils::DropCachedFragments(this);
 }
 
 void
@@ -10480,6 +10485,19 @@ nsDocument::FindImageMap(const nsAString& aUseMapValue)
   return nullptr;
 }
 
+nsContentList*
+nsDocument::GetElementsWithClassForSelectors(nsIAtom* aClass)
+{
+  // Only the last list is kept, since every live list has to be updated on
+  // each mutation of the document.
+  if (!mSelectorClassList || mSelectorClass != aClass) {
+    mSelectorClassList = nsContentUtils::GetElementsByClassName(
+      this, nsDependentAtomString(aClass));
+    mSelectorClass = aClass;
+  }
+  return mSelectorClassList;
+}
+
 #define DEPRECATED_OPERATION(_op) #_op "Warning",
 static const char* kDeprecationWarnings[] = {
 #include "nsDeprecatedOperationList.h"
@@ -1124,6 +1124,9 @@ public:
 
   virtual Element* FindImageMap(const nsAString& aNormalizedMapName) override;
 
+  virtual nsContentList*
+    GetElementsWithClassForSelectors(nsIAtom* aClass) override;
+
   virtual nsTArray<Element*> GetFullscreenStack() const override;
   virtual void AsyncRequestFullScreen(
     mozilla::UniquePtr<FullscreenRequest>&& aRequest) override;
@@ -1751,6 +1754,10 @@ private:
 
   RefPtr<nsContentList> mImageMaps;
 
+  // The list last returned by GetElementsWithClassForSelectors and its class.
+  RefPtr<nsContentList> mSelectorClassList;
+  nsCOMPtr<nsIAtom> mSelectorClass;
+
   nsCString mScrollToRef;
   uint8_t mScrolledToRefAlready : 1;
   uint8_t mChangeScrollPosWhenScrollingToRef : 1;
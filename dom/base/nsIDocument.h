@@ -2338,6 +2338,15 @@ public:
 
   virtual Element* FindImageMap(const nsAString& aNormalizedMapName) = 0;
 
+  /**
+   * Returns a live list of the elements of this document that have aClass,
+   * for selector matching to start from.  The document holds on to the list
+   * it returned last, so repeated queries for a class don't have to walk the
+   * tree again unless it changed.  The list is only guaranteed to be alive
+   * until the next call.
+   */
+  virtual nsContentList* GetElementsWithClassForSelectors(nsIAtom* aClass) = 0;
+
   // Add aLink to the set of links that need their status resolved.
   void RegisterPendingLinkUpdate(mozilla::dom::Link* aLink);
 
@@ -2838,19 +2838,106 @@ FindMatchingElements(nsINode* aRoot, nsCSSSelectorList* aSelectorList, T &aList,
     return;
   }
 
+  // Likewise, a selector with a class only has to be matched against the
+  // elements with that class, which the document keeps a live list of.  This
+  // works in quirks mode too, since the list then ignores case as well.  Only
+  // do this when querying the whole document: for an element the list would
+  // have to be filtered by ancestry, which can cost more than walking the
+  // element's subtree.
+  if (aRoot == doc &&
+      !aSelectorList->mNext &&
+      aSelectorList->mSelectors->mClassList) {
+    nsIAtom* className = aSelectorList->mSelectors->mClassList->mAtom;
+    nsContentList* elements = doc->GetElementsWithClassForSelectors(className);
+    for (uint32_t i = 0; ; ++i) {
+      nsIContent* content = elements->Item(i, false);
+      if (!content) {
+        break;
+      }
+      Element* element = content->AsElement();
+      if (nsCSSRuleProcessor::SelectorListMatches(element, matchingContext,
+                                                  aSelectorList)) {
+        aList.AppendElement(element);
+        if (onlyFirstMatch) {
+          return;
+        }
+      }
+    }
+    return;
+  }
+
+  // Otherwise walk the whole subtree.  If the selectors need the element to
+  // have certain ancestors, keep a Bloom filter of the ancestors of the
+  // current element, so most elements that can't match are rejected without
+  // walking up the tree.  That needs all the ancestors of aRoot, so only do
+  // it when aRoot is in the document.
+  AutoTArray<uint32_t, 4 * nsCSSRuleProcessor::eMaxAncestorHashes> hashes;
+  bool useAncestorFilter = false;
+  if (aRoot->IsInUncomposedDoc()) {
+    bool quirks = doc->GetCompatibilityMode() == eCompatibility_NavQuirks;
+    for (nsCSSSelectorList* list = aSelectorList; list; list = list->mNext) {
+      uint32_t* selectorHashes =
+        hashes.AppendElements(nsCSSRuleProcessor::eMaxAncestorHashes);
+      nsCSSRuleProcessor::GetAncestorHashes(list->mSelectors, quirks,
+                                            selectorHashes);
+      useAncestorFilter = useAncestorFilter || selectorHashes[0];
+    }
+  }
+
   Collector results;
-  for (nsIContent* cur = aRoot->GetFirstChild();
-       cur;
-       cur = cur->GetNextNode(aRoot)) {
-    if (cur->IsElement() &&
-        nsCSSRuleProcessor::SelectorListMatches(cur->AsElement(),
-                                                matchingContext,
-                                                aSelectorList)) {
-      if (onlyFirstMatch) {
-        aList.AppendElement(cur->AsElement());
-        return;
+  if (useAncestorFilter) {
+    matchingContext.InitAncestors(aRoot->IsElement() ? aRoot->AsElement()
+                                                     : nullptr);
+    nsIContent* cur = aRoot->GetFirstChild();
+    while (cur) {
+      if (cur->IsElement()) {
+        Element* element = cur->AsElement();
+        if (nsCSSRuleProcessor::SelectorListMatches(element, matchingContext,
+                                                    aSelectorList,
+                                                    hashes.Elements())) {
+          if (onlyFirstMatch) {
+            aList.AppendElement(element);
+            return;
+          }
+          results.AppendElement(element);
+        }
+        nsIContent* child = element->GetFirstChild();
+        if (child) {
+          matchingContext.mAncestorFilter.PushAncestor(element);
+          cur = child;
+          continue;
+        }
+      }
+
+      // Go to the next node, leaving the elements whose children we're done
+      // with.
+      while (cur && !cur->GetNextSibling()) {
+        nsINode* parent = cur->GetParentNode();
+        if (parent == aRoot) {
+          cur = nullptr;
+        } else {
+          matchingContext.mAncestorFilter.PopAncestor();
+          cur = parent->AsContent();
+        }
+      }
+      if (cur) {
+        cur = cur->GetNextSibling();
+      }
+    }
+  } else {
+    for (nsIContent* cur = aRoot->GetFirstChild();
+         cur;
+         cur = cur->GetNextNode(aRoot)) {
+      if (cur->IsElement() &&
+          nsCSSRuleProcessor::SelectorListMatches(cur->AsElement(),
+                                                  matchingContext,
+                                                  aSelectorList)) {
+        if (onlyFirstMatch) {
+          aList.AppendElement(cur->AsElement());
+          return;
+        }
+        results.AppendElement(cur->AsElement());
       }
-      results.AppendElement(cur->AsElement());
     }
   }
 
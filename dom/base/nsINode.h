@@ -491,7 +491,8 @@ public:
    * NOTHING), and will never ever peform an out-of-bounds access here.  This
    * method may return null if there are no children, or it may return a
    * garbage pointer.  In all cases the out param will be set to the number of
-   * children.
+   * children.  Nodes with very many children may have to copy them to an
+   * array first, so this shouldn't be used to get at a single child.
    */
   virtual nsIContent * const * GetChildArray(uint32_t* aChildCount) const = 0;
 
@@ -1262,10 +1263,9 @@ public:
   nsIContent* GetFirstChild() const { return mFirstChild; }
   nsIContent* GetLastChild() const
   {
-    uint32_t count;
-    nsIContent* const* children = GetChildArray(&count);
+    uint32_t count = GetChildCount();
 
-    return count > 0 ? children[count - 1] : nullptr;
+    return count > 0 ? GetChildAt(count - 1) : nullptr;
   }
 
   /**
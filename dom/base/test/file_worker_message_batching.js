@@ -0,0 +1,29 @@
+var lastMicrotask = -1;
+
+onmessage = function(event) {
+  var data = event.data;
+  switch (data.command) {
+    case "echo":
+      // Each message is its own task, so the microtask queued by the previous
+      // one must already have run.
+      postMessage({ command: "echo", index: data.index,
+                    microtaskRan: lastMicrotask == data.index - 1 });
+      Promise.resolve().then(function() { lastMicrotask = data.index; });
+      break;
+
+    case "burst":
+      for (var i = 0; i < data.count; i++) {
+        postMessage({ command: "burst", index: i });
+      }
+      break;
+
+    case "port":
+      data.port.onmessage = function() {};
+      break;
+
+    case "close":
+      postMessage({ command: "closing" });
+      close();
+      break;
+  }
+};
@@ -0,0 +1,145 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h" // For MOZ_GTEST_BENCH
+
+#include "mozilla/dom/Element.h"
+#include "nsIDocument.h"
+#include "nsIDOMDocument.h"
+#include "nsNetUtil.h"
+#include "nsNullPrincipal.h"
+#include "nsTArray.h"
+
+using namespace mozilla;
+using namespace mozilla::dom;
+
+/**
+ * Measures mutations of elements with tens of thousands of children, which
+ * keep them in chunks rather than in one array.
+ * test_huge_child_lists.html checks the resulting child order.
+ */
+
+#define CHILD_COUNT 50000
+
+class HugeChildList
+{
+public:
+  HugeChildList()
+  {
+    nsCOMPtr<nsIURI> uri;
+    nsresult rv = NS_NewURI(getter_AddRefs(uri), "about:blank");
+    MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+    nsCOMPtr<nsIPrincipal> principal = nsNullPrincipal::Create();
+    nsCOMPtr<nsIDOMDocument> domDocument;
+    rv = NS_NewDOMDocument(getter_AddRefs(domDocument), EmptyString(),
+                           EmptyString(), nullptr, uri, uri, principal, true,
+                           nullptr, DocumentFlavorHTML);
+    MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+    mDocument = do_QueryInterface(domDocument);
+    mParent = NewChild();
+  }
+
+  already_AddRefed<Element> NewChild()
+  {
+    return mDocument->CreateElem(NS_LITERAL_STRING("span"), nullptr,
+                                 kNameSpaceID_XHTML);
+  }
+
+  void Append(uint32_t aCount)
+  {
+    for (uint32_t i = 0; i < aCount; i++) {
+      RefPtr<Element> child = NewChild();
+      MOZ_RELEASE_ASSERT(NS_SUCCEEDED(mParent->AppendChildTo(child, false)));
+      mExpected.AppendElement(child);
+    }
+  }
+
+  void Insert(uint32_t aCount, uint32_t aStride)
+  {
+    for (uint32_t i = 0; i < aCount; i++) {
+      uint32_t index = (i * aStride) % (mExpected.Length() + 1);
+      RefPtr<Element> child = NewChild();
+      MOZ_RELEASE_ASSERT(NS_SUCCEEDED(mParent->InsertChildAt(child, index,
+                                                             false)));
+      mExpected.InsertElementAt(index, child);
+    }
+  }
+
+  void Remove(uint32_t aCount, uint32_t aStride)
+  {
+    for (uint32_t i = 0; i < aCount; i++) {
+      uint32_t index = (i * aStride) % mExpected.Length();
+      mParent->RemoveChildAt(index, false);
+      mExpected.RemoveElementAt(index);
+    }
+  }
+
+  void CheckOrder()
+  {
+    ASSERT_EQ(mExpected.Length(), mParent->GetChildCount());
+
+    uint32_t index = 0;
+    for (nsIContent* child = mParent->GetFirstChild(); child;
+         child = child->GetNextSibling(), index++) {
+      ASSERT_EQ(mExpected[index], child);
+      ASSERT_EQ(mExpected[index], mParent->GetChildAt(index));
+    }
+  }
+
+  void CheckIndices(uint32_t aCount, uint32_t aStride)
+  {
+    for (uint32_t i = 0; i < aCount; i++) {
+      uint32_t index = (i * aStride) % mExpected.Length();
+      ASSERT_EQ(int32_t(index), mParent->IndexOf(mExpected[index]));
+    }
+  }
+
+private:
+  nsCOMPtr<nsIDocument> mDocument;
+  RefPtr<Element> mParent;
+  nsTArray<RefPtr<Element>> mExpected;
+};
+
+TEST(HugeChildLists, Order)
+{
+  HugeChildList list;
+  list.Append(CHILD_COUNT);
+  list.Insert(CHILD_COUNT / 10, 7919);
+  list.Remove(CHILD_COUNT / 10, 104729);
+  list.CheckOrder();
+  list.CheckIndices(CHILD_COUNT / 10, 7919);
+
+  // Back below the threshold for chunking.
+  list.Remove(CHILD_COUNT - 1000, 1);
+  list.CheckOrder();
+}
+
+MOZ_GTEST_BENCH(HugeChildLists, Append, [] {
+  HugeChildList list;
+  list.Append(CHILD_COUNT);
+});
+
+MOZ_GTEST_BENCH(HugeChildLists, InsertAtFront, [] {
+  HugeChildList list;
+  list.Append(CHILD_COUNT);
+  list.Insert(CHILD_COUNT / 2, 0);
+});
+
+MOZ_GTEST_BENCH(HugeChildLists, InsertInMiddle, [] {
+  HugeChildList list;
+  list.Append(CHILD_COUNT);
+  list.Insert(CHILD_COUNT / 10, 7919);
+});
+
+MOZ_GTEST_BENCH(HugeChildLists, IndexOf, [] {
+  HugeChildList list;
+  list.Append(CHILD_COUNT);
+  list.Insert(CHILD_COUNT / 10, 7919);
+  list.CheckIndices(CHILD_COUNT, 104729);
+});
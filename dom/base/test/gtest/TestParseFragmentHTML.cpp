@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h" // For MOZ_GTEST_BENCH
+
+#include "mozilla/ErrorResult.h"
+#include "mozilla/dom/DocumentFragment.h"
+#include "mozilla/dom/Element.h"
+#include "nsContentUtils.h"
+#include "nsGkAtoms.h"
+#include "nsIDocument.h"
+#include "nsIDOMDocument.h"
+#include "nsNetUtil.h"
+#include "nsNullPrincipal.h"
+
+using namespace mozilla;
+using namespace mozilla::dom;
+
+/**
+ * Measures the two ways nsContentUtils::ParseFragmentHTML can build the
+ * nodes for repeated innerHTML markup: running the fragment parser, or
+ * deep-cloning a fragment parsed before, which is what the fragment cache
+ * does. The cache itself only serves documents shown in a window, so it is
+ * covered by test_innerhtml_fragment_cache.html instead.
+ */
+
+#define ITERATIONS 5000
+
+static const char kTemplate[] =
+  "<div class=\"card\" data-id=\"1\"><h2 title=\"t\">Title &amp; more</h2>"
+  "<input type=\"checkbox\" checked><select><option>a<option selected>b"
+  "</select><template><span>inside</span></template><!-- note --></div>text";
+
+static already_AddRefed<Element>
+CreateFragmentTarget()
+{
+  nsCOMPtr<nsIURI> uri;
+  nsresult rv = NS_NewURI(getter_AddRefs(uri), "about:blank");
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+  nsCOMPtr<nsIPrincipal> principal = nsNullPrincipal::Create();
+  nsCOMPtr<nsIDOMDocument> domDocument;
+  rv = NS_NewDOMDocument(getter_AddRefs(domDocument), EmptyString(),
+                         EmptyString(), nullptr, uri, uri, principal, true,
+                         nullptr, DocumentFlavorHTML);
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+  nsCOMPtr<nsIDocument> document = do_QueryInterface(domDocument);
+  return document->CreateElem(NS_LITERAL_STRING("div"), nullptr,
+                              kNameSpaceID_XHTML);
+}
+
+static void
+RemoveChildren(nsINode* aNode)
+{
+  for (uint32_t count = aNode->GetChildCount(); count; --count) {
+    aNode->RemoveChildAt(count - 1, false);
+  }
+}
+
+static nsresult
+ParseTemplate(Element* aTarget)
+{
+  return nsContentUtils::ParseFragmentHTML(NS_ConvertASCIItoUTF16(kTemplate),
+                                           aTarget, nsGkAtoms::div,
+                                           kNameSpaceID_XHTML, false, true);
+}
+
+static already_AddRefed<DocumentFragment>
+ParseTemplateToFragment(Element* aTarget)
+{
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(ParseTemplate(aTarget)));
+
+  RefPtr<DocumentFragment> fragment =
+    aTarget->OwnerDoc()->CreateDocumentFragment();
+  while (nsIContent* child = aTarget->GetFirstChild()) {
+    ErrorResult rv;
+    fragment->AppendChild(*child, rv);
+    MOZ_RELEASE_ASSERT(!rv.Failed());
+  }
+  return fragment.forget();
+}
+
+static void
+AppendClone(Element* aTarget, DocumentFragment* aFragment)
+{
+  ErrorResult rv;
+  nsCOMPtr<nsINode> clone = aFragment->CloneNode(true, rv);
+  MOZ_RELEASE_ASSERT(!rv.Failed());
+  aTarget->AppendChild(*clone, rv);
+  MOZ_RELEASE_ASSERT(!rv.Failed());
+}
+
+TEST(ParseFragmentHTML, CloneMatchesParse)
+{
+  RefPtr<Element> parsed = CreateFragmentTarget();
+  ASSERT_TRUE(NS_SUCCEEDED(ParseTemplate(parsed)));
+
+  RefPtr<Element> cloned = CreateFragmentTarget();
+  RefPtr<DocumentFragment> fragment = ParseTemplateToFragment(cloned);
+  AppendClone(cloned, fragment);
+
+  nsAutoString parsedHTML, clonedHTML;
+  parsed->GetInnerHTML(parsedHTML);
+  cloned->GetInnerHTML(clonedHTML);
+  ASSERT_TRUE(parsedHTML.Equals(clonedHTML));
+}
+
+MOZ_GTEST_BENCH(ParseFragmentHTML, Parse, [] {
+  RefPtr<Element> target = CreateFragmentTarget();
+  for (int i = 0; i < ITERATIONS; i++) {
+    RemoveChildren(target);
+    ASSERT_TRUE(NS_SUCCEEDED(ParseTemplate(target)));
+  }
+});
+
+MOZ_GTEST_BENCH(ParseFragmentHTML, CloneParsedFragment, [] {
+  RefPtr<Element> target = CreateFragmentTarget();
+  RefPtr<DocumentFragment> fragment = ParseTemplateToFragment(target);
+  for (int i = 0; i < ITERATIONS; i++) {
+    RemoveChildren(target);
+    AppendClone(target, fragment);
+  }
+});
@@ -38,7 +38,7 @@ const int32_t kFirstShippedSchemaVersion = 15;
 namespace {
 
 // Update this whenever the DB schema is changed.
-const int32_t kLatestSchemaVersion = 21;
+const int32_t kLatestSchemaVersion = 22;
 
 // ---------
 // The following constants define the SQL schema.  These are defined in the
@@ -160,6 +160,16 @@ const char* const kTableStorage =
     "PRIMARY KEY(namespace, key) "
   ")";
 
+// Bodies that compress to a few KB are stored here instead of in their own
+// file in the morgue directory.  This saves creating, renaming, opening and
+// removing a file for each of them.  Rows are removed along with the entries
+// that reference them.
+const char* const kTableInlineBodies =
+  "CREATE TABLE inline_bodies ("
+    "id TEXT NOT NULL PRIMARY KEY, "
+    "data BLOB NOT NULL"
+  ")";
+
 // ---------
 // End schema definition
 // ---------
@@ -471,6 +481,9 @@ CreateOrMigrateSchema(mozIStorageConnection* aConn)
     rv = aConn->ExecuteSimpleSQL(nsDependentCString(kTableStorage));
     if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
 
+    rv = aConn->ExecuteSimpleSQL(nsDependentCString(kTableInlineBodies));
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
     rv = aConn->SetSchemaVersion(kLatestSchemaVersion);
     if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
 
@@ -1081,6 +1094,66 @@ StorageGetKeys(mozIStorageConnection* aConn, Namespace aNamespace,
   return rv;
 }
 
+nsresult
+InsertInlineBody(mozIStorageConnection* aConn, const nsID& aBodyId,
+                 const nsACString& aData)
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+  MOZ_ASSERT(aConn);
+
+  nsCOMPtr<mozIStorageStatement> state;
+  nsresult rv = aConn->CreateStatement(NS_LITERAL_CSTRING(
+    "INSERT INTO inline_bodies (id, data) VALUES (:id, :data);"
+  ), getter_AddRefs(state));
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  rv = BindId(state, NS_LITERAL_CSTRING("id"), &aBodyId);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  rv = state->BindUTF8StringAsBlobByName(NS_LITERAL_CSTRING("data"), aData);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  rv = state->Execute();
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  return rv;
+}
+
+nsresult
+ReadInlineBody(mozIStorageConnection* aConn, const nsID& aBodyId,
+               bool* aFoundOut, nsACString& aDataOut)
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+  MOZ_ASSERT(aConn);
+  MOZ_ASSERT(aFoundOut);
+
+  *aFoundOut = false;
+
+  nsCOMPtr<mozIStorageStatement> state;
+  nsresult rv = aConn->CreateStatement(NS_LITERAL_CSTRING(
+    "SELECT data FROM inline_bodies WHERE id=:id;"
+  ), getter_AddRefs(state));
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  rv = BindId(state, NS_LITERAL_CSTRING("id"), &aBodyId);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  bool hasMoreData = false;
+  rv = state->ExecuteStep(&hasMoreData);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  if (!hasMoreData) {
+    return rv;
+  }
+
+  rv = state->GetBlobAsUTF8String(0, aDataOut);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  *aFoundOut = true;
+
+  return rv;
+}
+
 namespace {
 
 nsresult
@@ -1381,6 +1454,8 @@ DeleteEntries(mozIStorageConnection* aConn,
   rv = BindListParamsToQuery(state, aEntryIdList, aPos, aLen);
   if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
 
+  uint32_t firstDeletedBodyId = aDeletedBodyIdListOut.Length();
+
   bool hasMoreData = false;
   while (NS_SUCCEEDED(state->ExecuteStep(&hasMoreData)) && hasMoreData) {
     // extract 0 to 2 nsID structs per row
@@ -1426,6 +1501,25 @@ DeleteEntries(mozIStorageConnection* aConn,
     }
   }
 
+  // Inline bodies are copied when a stream is opened on them, so they can go
+  // right away.  Their IDs are still reported so that callers treat all
+  // bodies the same.
+  if (firstDeletedBodyId < aDeletedBodyIdListOut.Length()) {
+    rv = aConn->CreateStatement(NS_LITERAL_CSTRING(
+      "DELETE FROM inline_bodies WHERE id=:id;"
+    ), getter_AddRefs(state));
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+    for (uint32_t i = firstDeletedBodyId; i < aDeletedBodyIdListOut.Length();
+         ++i) {
+      rv = BindId(state, NS_LITERAL_CSTRING("id"), &aDeletedBodyIdListOut[i]);
+      if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+      rv = state->Execute();
+      if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+    }
+  }
+
   // Dependent records removed via ON DELETE CASCADE
 
   query = NS_LITERAL_CSTRING(
@@ -2401,6 +2495,8 @@ Validate(mozIStorageConnection* aConn)
     Expect("response_url_list", "table", kTableResponseUrlList),
     Expect("storage", "table", kTableStorage),
     Expect("sqlite_autoindex_storage_1", "index"), // auto-gen by sqlite
+    Expect("inline_bodies", "table", kTableInlineBodies),
+    Expect("sqlite_autoindex_inline_bodies_1", "index"), // auto-gen by sqlite
   };
   const uint32_t expectLength = sizeof(expect) / sizeof(Expect);
 
@@ -2479,6 +2575,7 @@ nsresult MigrateFrom17To18(mozIStorageConnection* aConn, bool& aRewriteSchema);
 nsresult MigrateFrom18To19(mozIStorageConnection* aConn, bool& aRewriteSchema);
 nsresult MigrateFrom19To20(mozIStorageConnection* aConn, bool& aRewriteSchema);
 nsresult MigrateFrom20To21(mozIStorageConnection* aConn, bool& aRewriteSchema);
+nsresult MigrateFrom21To22(mozIStorageConnection* aConn, bool& aRewriteSchema);
 
 // Configure migration functions to run for the given starting version.
 Migration sMigrationList[] = {
@@ -2488,6 +2585,7 @@ Migration sMigrationList[] = {
   Migration(18, MigrateFrom18To19),
   Migration(19, MigrateFrom19To20),
   Migration(20, MigrateFrom20To21),
+  Migration(21, MigrateFrom21To22),
 };
 
 uint32_t sMigrationListLength = sizeof(sMigrationList) / sizeof(Migration);
@@ -2959,6 +3057,21 @@ nsresult MigrateFrom20To21(mozIStorageConnection* aConn, bool& aRewriteSchema)
   return rv;
 }
 
+nsresult MigrateFrom21To22(mozIStorageConnection* aConn, bool& aRewriteSchema)
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+  MOZ_ASSERT(aConn);
+
+  // Add the inline_bodies table.  Existing bodies stay in their files.
+  nsresult rv = aConn->ExecuteSimpleSQL(nsDependentCString(kTableInlineBodies));
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  rv = aConn->SetSchemaVersion(22);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  return rv;
+}
+
 } // anonymous namespace
 
 } // namespace db
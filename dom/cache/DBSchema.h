@@ -113,6 +113,17 @@ nsresult
 StorageGetKeys(mozIStorageConnection* aConn, Namespace aNamespace,
                nsTArray<nsString>& aKeysOut);
 
+// Stores a small body in the database instead of in its own file.  It is
+// removed when the entries using it are deleted.
+nsresult
+InsertInlineBody(mozIStorageConnection* aConn, const nsID& aBodyId,
+                 const nsACString& aData);
+
+// Sets aFoundOut to false if the body is stored in its own file.
+nsresult
+ReadInlineBody(mozIStorageConnection* aConn, const nsID& aBodyId,
+               bool* aFoundOut, nsACString& aDataOut);
+
 // Note, this works best when its NOT executed within a transaction.
 nsresult
 IncrementalVacuum(mozIStorageConnection* aConn);
@@ -12,6 +12,7 @@
 #include "nsIFile.h"
 #include "nsIUUIDGenerator.h"
 #include "nsNetCID.h"
+#include "nsNetUtil.h"
 #include "nsISimpleEnumerator.h"
 #include "nsServiceManagerUtils.h"
 #include "nsString.h"
@@ -27,6 +28,10 @@ using mozilla::dom::quota::PERSISTENCE_TYPE_DEFAULT;
 
 namespace {
 
+// Compressed bodies up to this size are stored in the database.  SQLite reads
+// blobs of a few pages faster than the file system opens a file.
+const int64_t kMaxInlineBodySize = 8 * 1024;
+
 enum BodyFileType
 {
   BODY_FILE_FINAL,
@@ -195,14 +200,39 @@ BodyCancelWrite(nsIFile* aBaseDir, nsISupports* aCopyContext)
 
 // static
 nsresult
-BodyFinalizeWrite(nsIFile* aBaseDir, const nsID& aId)
+BodyFinalizeWrite(nsIFile* aBaseDir, const nsID& aId,
+                  nsACString& aInlineDataOut)
 {
   MOZ_ASSERT(aBaseDir);
 
+  aInlineDataOut.SetIsVoid(true);
+
   nsCOMPtr<nsIFile> tmpFile;
   nsresult rv = BodyIdToFile(aBaseDir, aId, BODY_FILE_TMP, getter_AddRefs(tmpFile));
   if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
 
+  int64_t fileSize;
+  rv = tmpFile->GetFileSize(&fileSize);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  if (fileSize <= kMaxInlineBodySize) {
+    nsCOMPtr<nsIInputStream> stream;
+    rv = NS_NewLocalFileInputStream(getter_AddRefs(stream), tmpFile);
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+    nsAutoCString data;
+    rv = NS_ReadInputStreamToString(stream, data, fileSize);
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+    stream->Close();
+
+    rv = tmpFile->Remove(false /* recursive */);
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+    aInlineDataOut = data;
+    return rv;
+  }
+
   nsCOMPtr<nsIFile> finalFile;
   rv = BodyIdToFile(aBaseDir, aId, BODY_FILE_FINAL, getter_AddRefs(finalFile));
   if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
@@ -40,8 +40,13 @@ BodyStartWriteStream(const QuotaInfo& aQuotaInfo, nsIFile* aBaseDir,
 void
 BodyCancelWrite(nsIFile* aBaseDir, nsISupports* aCopyContext);
 
+// Moves a completely written body into place.  Bodies that compressed to a
+// few KB are read into aInlineDataOut and their file is removed instead, so
+// that the caller can store them in the database.  aInlineDataOut is left
+// void otherwise.
 nsresult
-BodyFinalizeWrite(nsIFile* aBaseDir, const nsID& aId);
+BodyFinalizeWrite(nsIFile* aBaseDir, const nsID& aId,
+                  nsACString& aInlineDataOut);
 
 nsresult
 BodyOpen(const QuotaInfo& aQuotaInfo, nsIFile* aBaseDir, const nsID& aId,
@@ -26,6 +26,7 @@
 #include "nsID.h"
 #include "nsIFile.h"
 #include "nsIThread.h"
+#include "nsStringStream.h"
 #include "nsThreadUtils.h"
 #include "nsTObserverArray.h"
 
@@ -160,6 +161,25 @@ bool IsHeadRequest(const CacheRequestOrVoid& aRequest, const CacheQueryParams& a
   return false;
 }
 
+// Opens a body for reading, whether it is stored in the database or in its
+// own file.
+nsresult
+OpenBody(const QuotaInfo& aQuotaInfo, nsIFile* aDBDir,
+         mozIStorageConnection* aConn, const nsID& aBodyId,
+         nsIInputStream** aStreamOut)
+{
+  nsAutoCString data;
+  bool found = false;
+  nsresult rv = db::ReadInlineBody(aConn, aBodyId, &found, data);
+  if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+  if (found) {
+    return NS_NewCStringInputStream(aStreamOut, data);
+  }
+
+  return BodyOpen(aQuotaInfo, aDBDir, aBodyId, aStreamOut);
+}
+
 } // namespace
 
 // ----------------------------------------------------------------------------
@@ -503,7 +523,8 @@ public:
     }
 
     nsCOMPtr<nsIInputStream> stream;
-    rv = BodyOpen(aQuotaInfo, aDBDir, mResponse.mBodyId, getter_AddRefs(stream));
+    rv = OpenBody(aQuotaInfo, aDBDir, aConn, mResponse.mBodyId,
+                  getter_AddRefs(stream));
     if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
     if (NS_WARN_IF(!stream)) { return NS_ERROR_FILE_NOT_FOUND; }
 
@@ -568,7 +589,7 @@ public:
       }
 
       nsCOMPtr<nsIInputStream> stream;
-      rv = BodyOpen(aQuotaInfo, aDBDir, mSavedResponses[i].mBodyId,
+      rv = OpenBody(aQuotaInfo, aDBDir, aConn, mSavedResponses[i].mBodyId,
                     getter_AddRefs(stream));
       if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
       if (NS_WARN_IF(!stream)) { return NS_ERROR_FILE_NOT_FOUND; }
@@ -754,14 +775,14 @@ private:
     for (uint32_t i = 0; i < mList.Length(); ++i) {
       Entry& e = mList[i];
       if (e.mRequestStream) {
-        rv = BodyFinalizeWrite(mDBDir, e.mRequestBodyId);
+        rv = FinalizeBody(e.mRequestBodyId);
         if (NS_WARN_IF(NS_FAILED(rv))) {
           DoResolve(rv);
           return;
         }
       }
       if (e.mResponseStream) {
-        rv = BodyFinalizeWrite(mDBDir, e.mResponseBodyId);
+        rv = FinalizeBody(e.mResponseBodyId);
         if (NS_WARN_IF(NS_FAILED(rv))) {
           DoResolve(rv);
           return;
@@ -917,6 +938,21 @@ private:
       mTargetThread->Dispatch(runnable, nsIThread::DISPATCH_NORMAL));
   }
 
+  nsresult
+  FinalizeBody(const nsID& aBodyId)
+  {
+    nsAutoCString inlineData;
+    nsresult rv = BodyFinalizeWrite(mDBDir, aBodyId, inlineData);
+    if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+
+    if (!inlineData.IsVoid()) {
+      rv = db::InsertInlineBody(mConn, aBodyId, inlineData);
+      if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
+    }
+
+    return rv;
+  }
+
   void
   DoResolve(nsresult aRv)
   {
@@ -1059,7 +1095,7 @@ public:
       }
 
       nsCOMPtr<nsIInputStream> stream;
-      rv = BodyOpen(aQuotaInfo, aDBDir, mSavedRequests[i].mBodyId,
+      rv = OpenBody(aQuotaInfo, aDBDir, aConn, mSavedRequests[i].mBodyId,
                     getter_AddRefs(stream));
       if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
       if (NS_WARN_IF(!stream)) { return NS_ERROR_FILE_NOT_FOUND; }
@@ -1123,7 +1159,7 @@ public:
     }
 
     nsCOMPtr<nsIInputStream> stream;
-    rv = BodyOpen(aQuotaInfo, aDBDir, mSavedResponse.mBodyId,
+    rv = OpenBody(aQuotaInfo, aDBDir, aConn, mSavedResponse.mBodyId,
                   getter_AddRefs(stream));
     if (NS_WARN_IF(NS_FAILED(rv))) { return rv; }
     if (NS_WARN_IF(!stream)) { return NS_ERROR_FILE_NOT_FOUND; }
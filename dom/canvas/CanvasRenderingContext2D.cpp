@@ -75,6 +75,7 @@
 
 #include "mozilla/Alignment.h"
 #include "mozilla/Assertions.h"
+#include "mozilla/AutoRestore.h"
 #include "mozilla/CheckedInt.h"
 #include "mozilla/DebugOnly.h"
 #include "mozilla/dom/ContentParent.h"
@@ -90,6 +91,7 @@
 #include "mozilla/gfx/PathHelpers.h"
 #include "mozilla/gfx/DataSurfaceHelpers.h"
 #include "mozilla/gfx/PatternHelpers.h"
+#include "mozilla/gfx/Swizzle.h"
 #include "mozilla/ipc/DocumentRendererParent.h"
 #include "mozilla/ipc/PDocumentRendererParent.h"
 #include "mozilla/layers/PersistentBufferProvider.h"
@@ -1066,6 +1068,8 @@ CanvasRenderingContext2D::CanvasRenderingContext2D()
   , mIsEntireFrameInvalid(false)
   , mPredictManyRedrawCalls(false)
   , mIsCapturedFrameInvalid(false)
+  , mOnlyPutImageData(true)
+  , mIsPuttingImageData(false)
   , mPathTransformWillUpdate(false)
   , mInvalidateCount(0)
 {
@@ -1167,6 +1171,9 @@ CanvasRenderingContext2D::Reset()
   mPredictManyRedrawCalls = false;
   mIsCapturedFrameInvalid = false;
 
+  DiscardImageDataShadow();
+  mOnlyPutImageData = true;
+
   return NS_OK;
 }
 
@@ -1247,6 +1254,7 @@ CanvasRenderingContext2D::StyleColorToString(const nscolor& aColor, nsAString& a
 nsresult
 CanvasRenderingContext2D::Redraw()
 {
+  DiscardImageDataShadow();
   mIsCapturedFrameInvalid = true;
 
   if (mIsEntireFrameInvalid) {
@@ -1270,6 +1278,7 @@ CanvasRenderingContext2D::Redraw()
 void
 CanvasRenderingContext2D::Redraw(const gfx::Rect& aR)
 {
+  DiscardImageDataShadow();
   mIsCapturedFrameInvalid = true;
 
   ++mInvalidateCount;
@@ -1309,6 +1318,7 @@ CanvasRenderingContext2D::DidRefresh()
 void
 CanvasRenderingContext2D::RedrawUser(const gfxRect& aR)
 {
+  DiscardImageDataShadow();
   mIsCapturedFrameInvalid = true;
 
   if (mIsEntireFrameInvalid) {
@@ -1655,8 +1665,12 @@ CanvasRenderingContext2D::EnsureTarget(const gfx::Rect* aCoveredRect,
       mCanvasElement->InvalidateCanvas();
     }
     // Calling Redraw() tells our invalidation machinery that the entire
-    // canvas is already invalid, which can speed up future drawing.
+    // canvas is already invalid, which can speed up future drawing. The new
+    // target is blank, so it does not count as drawing for the purposes of
+    // the image data shadow.
+    bool onlyPutImageData = mOnlyPutImageData;
     Redraw();
+    mOnlyPutImageData = onlyPutImageData;
   } else {
     EnsureErrorTarget();
     mTarget = sErrorTarget;
@@ -5335,9 +5349,16 @@ CanvasRenderingContext2D::GetImageDataArray(JSContext* aCx,
   IntRect srcRect(0, 0, mWidth, mHeight);
   IntRect destRect(aX, aY, aWidth, aHeight);
   IntRect srcReadRect = srcRect.Intersect(destRect);
+  if (srcReadRect.IsEmpty()) {
+    *aRetval = darray;
+    return NS_OK;
+  }
+
+  EnsureImageDataShadow();
+
   RefPtr<DataSourceSurface> readback;
   DataSourceSurface::MappedSurface rawData;
-  if (!srcReadRect.IsEmpty()) {
+  if (!mImageDataShadow) {
     RefPtr<SourceSurface> snapshot = mTarget->Snapshot();
     if (snapshot) {
       readback = snapshot->GetDataSurface();
@@ -5355,67 +5376,28 @@ CanvasRenderingContext2D::GetImageDataArray(JSContext* aCx,
   uint8_t* data = JS_GetUint8ClampedArrayData(darray, &isShared, nogc);
   MOZ_ASSERT(!isShared);        // Should not happen, data was created above
 
-  uint8_t* src;
-  uint32_t srcStride;
-  if (readback) {
-    srcStride = rawData.mStride;
-    src = rawData.mData + srcReadRect.y * srcStride + srcReadRect.x * 4;
-  } else {
-    src = data;
-    srcStride = aWidth * 4;
-  }
-
-  uint8_t* dst = data + dstWriteRect.y * (aWidth * 4) + dstWriteRect.x * 4;
+  uint32_t dstStride = aWidth * 4;
+  uint8_t* dst = data + dstWriteRect.y * dstStride + dstWriteRect.x * 4;
 
-  if (mOpaque) {
+  if (mImageDataShadow) {
+    uint32_t srcStride = mWidth * 4;
+    const uint8_t* src = mImageDataShadow.get() +
+                         srcReadRect.y * srcStride + srcReadRect.x * 4;
     for (int32_t j = 0; j < dstWriteRect.height; ++j) {
-      for (int32_t i = 0; i < dstWriteRect.width; ++i) {
-        // XXX Is there some useful swizzle MMX we can use here?
-#if MOZ_LITTLE_ENDIAN
-        uint8_t b = *src++;
-        uint8_t g = *src++;
-        uint8_t r = *src++;
-        src++;
-#else
-        src++;
-        uint8_t r = *src++;
-        uint8_t g = *src++;
-        uint8_t b = *src++;
-#endif
-        *dst++ = r;
-        *dst++ = g;
-        *dst++ = b;
-        *dst++ = 255;
-      }
-      src += srcStride - (dstWriteRect.width * 4);
-      dst += (aWidth * 4) - (dstWriteRect.width * 4);
+      memcpy(dst, src, dstWriteRect.width * 4);
+      src += srcStride;
+      dst += dstStride;
     }
-  } else
-  for (int32_t j = 0; j < dstWriteRect.height; ++j) {
-    for (int32_t i = 0; i < dstWriteRect.width; ++i) {
-      // XXX Is there some useful swizzle MMX we can use here?
-#if MOZ_LITTLE_ENDIAN
-      uint8_t b = *src++;
-      uint8_t g = *src++;
-      uint8_t r = *src++;
-      uint8_t a = *src++;
-#else
-      uint8_t a = *src++;
-      uint8_t r = *src++;
-      uint8_t g = *src++;
-      uint8_t b = *src++;
-#endif
-      // Convert to non-premultiplied color
-      *dst++ = gfxUtils::sUnpremultiplyTable[a * 256 + r];
-      *dst++ = gfxUtils::sUnpremultiplyTable[a * 256 + g];
-      *dst++ = gfxUtils::sUnpremultiplyTable[a * 256 + b];
-      *dst++ = a;
-    }
-    src += srcStride - (dstWriteRect.width * 4);
-    dst += (aWidth * 4) - (dstWriteRect.width * 4);
-  }
-
-  if (readback) {
+  } else {
+    uint8_t* src = rawData.mData + srcReadRect.y * rawData.mStride +
+                   srcReadRect.x * 4;
+    // Convert to non-premultiplied RGBA, reading the data straight into the
+    // array.
+    UnpremultiplyData(src, rawData.mStride,
+                      mOpaque ? SurfaceFormat::X8R8G8B8_UINT32
+                              : SurfaceFormat::A8R8G8B8_UINT32,
+                      dst, dstStride, SurfaceFormat::R8G8B8A8,
+                      dstWriteRect.Size());
     readback->Unmap();
   }
 
@@ -5423,6 +5405,50 @@ CanvasRenderingContext2D::GetImageDataArray(JSContext* aCx,
   return NS_OK;
 }
 
+void
+CanvasRenderingContext2D::EnsureImageDataShadow()
+{
+  if (mImageDataShadow || !mOnlyPutImageData || mOpaque || mDocShell ||
+      !IsTargetValid() ||
+      int64_t(mWidth) * mHeight > gfxPrefs::CanvasImageDataShadowMaxPixels()) {
+    return;
+  }
+
+  RefPtr<SourceSurface> snapshot = mTarget->Snapshot();
+  RefPtr<DataSourceSurface> readback =
+    snapshot ? snapshot->GetDataSurface() : nullptr;
+  DataSourceSurface::MappedSurface rawData;
+  if (!readback || !readback->Map(DataSourceSurface::READ, &rawData)) {
+    return;
+  }
+
+  uint32_t stride = mWidth * 4;
+  UniquePtr<uint8_t[]> shadow(new (fallible) uint8_t[stride * mHeight]);
+  if (shadow) {
+    UnpremultiplyData(rawData.mData, rawData.mStride,
+                      SurfaceFormat::A8R8G8B8_UINT32,
+                      shadow.get(), stride, SurfaceFormat::R8G8B8A8,
+                      IntSize(mWidth, mHeight));
+    mImageDataShadow = Move(shadow);
+    gCanvasAzureMemoryUsed += stride * mHeight;
+  }
+  readback->Unmap();
+}
+
+void
+CanvasRenderingContext2D::DiscardImageDataShadow()
+{
+  if (mIsPuttingImageData) {
+    // PutImageData_explicit updates the shadow itself.
+    return;
+  }
+  mOnlyPutImageData = false;
+  if (mImageDataShadow) {
+    mImageDataShadow = nullptr;
+    gCanvasAzureMemoryUsed -= mWidth * mHeight * 4;
+  }
+}
+
 void
 CanvasRenderingContext2D::EnsureErrorTarget()
 {
@@ -5559,38 +5585,13 @@ CanvasRenderingContext2D::PutImageData_explicit(int32_t aX, int32_t aY, uint32_t
 
   uint32_t copyX = dirtyRect.x - aX;
   uint32_t copyY = dirtyRect.y - aY;
-  //uint8_t *src = aArray->Data();
-  uint8_t *dst = imgsurf->Data();
   uint8_t* srcLine = aArray->Data() + copyY * (aW * 4) + copyX * 4;
-#if 0
-  printf("PutImageData_explicit: dirty x=%d y=%d w=%d h=%d copy x=%d y=%d w=%d h=%d ext x=%d y=%d w=%d h=%d\n",
-       dirtyRect.x, dirtyRect.y, copyWidth, copyHeight,
-       copyX, copyY, copyWidth, copyHeight,
-       x, y, w, h);
-#endif
-  for (uint32_t j = 0; j < copyHeight; j++) {
-    uint8_t *src = srcLine;
-    for (uint32_t i = 0; i < copyWidth; i++) {
-      uint8_t r = *src++;
-      uint8_t g = *src++;
-      uint8_t b = *src++;
-      uint8_t a = *src++;
-
-      // Convert to premultiplied color (losslessly if the input came from getImageData)
-#if MOZ_LITTLE_ENDIAN
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + b];
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + g];
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + r];
-      *dst++ = a;
-#else
-      *dst++ = a;
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + r];
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + g];
-      *dst++ = gfxUtils::sPremultiplyTable[a * 256 + b];
-#endif
-    }
-    srcLine += aW * 4;
-  }
+  // Convert to premultiplied color (losslessly if the input came from
+  // getImageData).
+  PremultiplyData(srcLine, aW * 4, SurfaceFormat::R8G8B8A8,
+                  imgsurf->Data(), imgsurf->Stride(),
+                  SurfaceFormat::A8R8G8B8_UINT32,
+                  IntSize(copyWidth, copyHeight));
 
   EnsureTarget();
   if (!IsTargetValid()) {
@@ -5613,6 +5614,18 @@ CanvasRenderingContext2D::PutImageData_explicit(int32_t aX, int32_t aY, uint32_t
                                dirtyRect.width, dirtyRect.height),
                        IntPoint(dirtyRect.x, dirtyRect.y));
 
+  if (mImageDataShadow) {
+    uint32_t shadowStride = mWidth * 4;
+    UnpremultiplyData(imgsurf->Data(), imgsurf->Stride(),
+                      SurfaceFormat::A8R8G8B8_UINT32,
+                      mImageDataShadow.get() + dirtyRect.y * shadowStride +
+                        dirtyRect.x * 4,
+                      shadowStride, SurfaceFormat::R8G8B8A8,
+                      IntSize(copyWidth, copyHeight));
+  }
+
+  AutoRestore<bool> autoRestore(mIsPuttingImageData);
+  mIsPuttingImageData = true;
   Redraw(gfx::Rect(dirtyRect.x, dirtyRect.y, dirtyRect.width, dirtyRect.height));
 
   return NS_OK;
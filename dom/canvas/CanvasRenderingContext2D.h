@@ -558,6 +558,18 @@ protected:
                                  bool aHasDirtyRect, int32_t aDirtyX, int32_t aDirtyY,
                                  int32_t aDirtyWidth, int32_t aDirtyHeight);
 
+  /**
+   * Creates mImageDataShadow from the current contents of the canvas, if the
+   * canvas has only been drawn to with putImageData.
+   */
+  void EnsureImageDataShadow();
+
+  /**
+   * Releases mImageDataShadow. Unless we are in the middle of putImageData,
+   * this also stops us from keeping a shadow until the next reset.
+   */
+  void DiscardImageDataShadow();
+
   /**
    * Internal method to complete initialisation, expects mTarget to have been set
    */
@@ -786,6 +798,17 @@ protected:
    */
   bool mIsCapturedFrameInvalid;
 
+  /**
+   * Unpremultiplied R8G8B8A8 copy of the whole canvas, kept for canvases that
+   * are only drawn to with putImageData so that getImageData does not have to
+   * read back and unpremultiply the target. Null when not in use.
+   */
+  UniquePtr<uint8_t[]> mImageDataShadow;
+  // True until something other than putImageData draws to the canvas.
+  bool mOnlyPutImageData;
+  // Set while putImageData invalidates the canvas, which keeps the shadow.
+  bool mIsPuttingImageData;
+
   /**
     * We also have a device space pathbuilder. The reason for this is as
     * follows, when a path is being built, but the transform changes, we
@@ -2591,6 +2591,7 @@ BackgroundCursorChild::BackgroundCursorChild(IDBRequest* aRequest,
   , mCursor(nullptr)
   , mStrongRequest(aRequest)
   , mDirection(aDirection)
+  , mDiscardPrefetchedResponses(false)
 {
   MOZ_ASSERT(aObjectStore);
   aObjectStore->AssertIsOnOwningThread();
@@ -2614,6 +2615,7 @@ BackgroundCursorChild::BackgroundCursorChild(IDBRequest* aRequest,
   , mCursor(nullptr)
   , mStrongRequest(aRequest)
   , mDirection(aDirection)
+  , mDiscardPrefetchedResponses(false)
 {
   MOZ_ASSERT(aIndex);
   aIndex->AssertIsOnOwningThread();
@@ -2666,13 +2668,22 @@ BackgroundCursorChild::SendContinueInternal(const CursorRequestParams& aParams,
 
   switch (params.type()) {
     case CursorRequestParams::TContinueParams: {
-      if (key.IsUnset()) {
+      const Key& continueKey = params.get_ContinueParams().key();
+      if (continueKey.IsUnset()) {
         break;
       }
+
+      // Skip over any cached records that come before the requested key. If
+      // that leaves nothing cached we ask the parent, positioned at the last
+      // record we skipped.
+      const bool forward =
+        mDirection == IDBCursor::NEXT || mDirection == IDBCursor::NEXT_UNIQUE;
       while (!mCachedResponses.IsEmpty()) {
-        if (mCachedResponses[0].mKey == key) {
+        const Key& cachedKey = mCachedResponses[0].mKey;
+        if (forward ? cachedKey >= continueKey : cachedKey <= continueKey) {
           break;
         }
+        key = Move(mCachedResponses[0].mKey);
         mCachedResponses.RemoveElementAt(0);
       }
       break;
@@ -2748,6 +2759,19 @@ BackgroundCursorChild::InvalidateCachedResponses()
 {
   AssertIsOnOwningThread();
 
+  if (mStrongCursor && !mCachedResponses.IsEmpty()) {
+    // A continue() is about to be served from the cache. Its result was fixed
+    // when it was called, but the records after it may now be stale.
+    mCachedResponses.TruncateLength(1);
+    return;
+  }
+
+  if (mStrongCursor || mStrongRequest) {
+    // The response to the request in flight reflects the data as it was when
+    // the request was made, but any extra records sent with it may not.
+    mDiscardPrefetchedResponses = true;
+  }
+
   mCachedResponses.Clear();
 }
 
@@ -2799,7 +2823,8 @@ BackgroundCursorChild::HandleResponse(
   MOZ_ASSERT(!mStrongRequest);
   MOZ_ASSERT(!mStrongCursor);
 
-  MOZ_ASSERT(aResponses.Length() == 1);
+  MOZ_ASSERT(!aResponses.IsEmpty());
+  MOZ_ASSERT(mCachedResponses.IsEmpty());
 
   // XXX Fix this somehow...
   auto& responses =
@@ -2818,7 +2843,9 @@ BackgroundCursorChild::HandleResponse(
     if (mCursor) {
       if (mCursor->IsContinueCalled()) {
         mCursor->Reset(Move(response.key()), Move(cloneReadInfo));
-      } else {
+      } else if (!mDiscardPrefetchedResponses) {
+        // Only the first record answers the request; the rest were
+        // prefetched and are served locally by later continue() calls.
         CachedResponse cachedResponse;
         cachedResponse.mKey = Move(response.key());
         cachedResponse.mCloneInfo = Move(cloneReadInfo);
@@ -3010,6 +3037,8 @@ BackgroundCursorChild::RecvResponse(const CursorResponse& aResponse)
       MOZ_CRASH("Should never get here!");
   }
 
+  mDiscardPrefetchedResponses = false;
+
   mTransaction->OnRequestFinished(/* aActorDestroyedNormally */ true);
 
   return true;
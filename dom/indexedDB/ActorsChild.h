@@ -717,6 +717,10 @@ class BackgroundCursorChild final
 
   nsTArray<CachedResponse> mCachedResponses;
 
+  // Set if the transaction modified data while a request was in flight; any
+  // records prefetched along with the response may be stale.
+  bool mDiscardPrefetchedResponses;
+
 public:
   BackgroundCursorChild(IDBRequest* aRequest,
                         IDBObjectStore* aObjectStore,
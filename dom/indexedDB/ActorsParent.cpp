@@ -96,6 +96,7 @@
 #include "prsystem.h"
 #include "prtime.h"
 #include "ReportInternalError.h"
+#include "SimpleValue.h"
 #include "snappy/snappy.h"
 
 #define DISABLE_ASSERTS_FOR_FUZZING 0
@@ -152,7 +153,7 @@ static_assert(JS_STRUCTURED_CLONE_VERSION == 6,
               "Need to update the major schema version.");
 
 // Major schema version. Bump for almost everything.
-const uint32_t kMajorSchemaVersion = 23;
+const uint32_t kMajorSchemaVersion = 24;
 
 // Minor schema version. Should almost always be 0 (maybe bump on release
 // branches if we have to).
@@ -212,6 +213,14 @@ const uint32_t kMaxIdleConnectionThreadCount = 2;
 static_assert(kMaxConnectionThreadCount >= kMaxIdleConnectionThreadCount,
               "Idle thread limit must be less than total thread limit!");
 
+// The maximum number of extra connections (each with its own thread) that may
+// be opened for a single database to run readonly transactions while its
+// primary connection is busy. Only used for databases in WAL mode.
+const uint32_t kMaxReadConnectionCount = 3;
+
+static_assert(kMaxConnectionThreadCount > kMaxReadConnectionCount,
+              "Read connections must leave threads for other databases!");
+
 // The length of time that database connections will be held open after all
 // transactions have completed before doing idle maintenance.
 const uint32_t kConnectionIdleMaintenanceMS = 2 * 1000; // 2 seconds
@@ -223,6 +232,10 @@ const uint32_t kConnectionIdleCloseMS = 10 * 1000; // 10 seconds
 // The length of time that idle threads will stay alive before being shut down.
 const uint32_t kConnectionThreadIdleMS = 30 * 1000; // 30 seconds
 
+// The maximum amount of structured clone data that records prefetched by a
+// cursor may add to a single response.
+const uint32_t kMaxCursorPrefetchBytes = 1024 * 1024; // 1MB
+
 #define SAVEPOINT_CLAUSE "SAVEPOINT sp;"
 
 const uint32_t kFileCopyBufferSize = 32768;
@@ -4100,6 +4113,19 @@ UpgradeSchemaFrom22_0To23_0(mozIStorageConnection* aConnection,
   return NS_OK;
 }
 
+nsresult
+UpgradeSchemaFrom23_0To24_0(mozIStorageConnection* aConnection)
+{
+  // The only change between 23 and 24 was the addition of the simple value
+  // format. Older versions can't read it, so the upgrade is one-way.
+  nsresult rv = aConnection->SetSchemaVersion(MakeSchemaVersion(24, 0));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  return NS_OK;
+}
+
 nsresult
 GetDatabaseFileURL(nsIFile* aDatabaseFile,
                    PersistenceType aPersistenceType,
@@ -4592,7 +4618,7 @@ CreateStorageConnection(nsIFile* aDBFile,
       }
     } else  {
       // This logic needs to change next time we change the schema!
-      static_assert(kSQLiteSchemaVersion == int32_t((23 << 4) + 0),
+      static_assert(kSQLiteSchemaVersion == int32_t((24 << 4) + 0),
                     "Upgrade function needed due to schema version increase.");
 
       while (schemaVersion != kSQLiteSchemaVersion) {
@@ -4636,6 +4662,8 @@ CreateStorageConnection(nsIFile* aDBFile,
           rv = UpgradeSchemaFrom21_0To22_0(connection);
         } else if (schemaVersion == MakeSchemaVersion(22, 0)) {
           rv = UpgradeSchemaFrom22_0To23_0(connection, aOrigin);
+        } else if (schemaVersion == MakeSchemaVersion(23, 0)) {
+          rv = UpgradeSchemaFrom23_0To24_0(connection);
         } else {
           IDB_WARNING("Unable to open IndexedDB database, no upgrade path is "
                       "available!");
@@ -5017,6 +5045,9 @@ public:
   void
   FinishWriteTransaction();
 
+  nsresult
+  RestartReadTransaction();
+
   nsresult
   StartSavepoint();
 
@@ -5282,6 +5313,7 @@ private:
   struct IdleDatabaseInfo;
   struct IdleResource;
   struct IdleThreadInfo;
+  struct ReadConnectionInfo;
   struct ThreadInfo;
   class ThreadRunnable;
   struct TransactionInfo;
@@ -5377,6 +5409,15 @@ private:
   void
   ShutdownThread(ThreadInfo& aThreadInfo);
 
+  bool
+  AcquireThread(ThreadInfo& aThreadInfo);
+
+  void
+  ReleaseThread(ThreadInfo& aThreadInfo);
+
+  ReadConnectionInfo*
+  GetReadConnectionForTransaction(DatabaseInfo* aDatabaseInfo);
+
   void
   CloseIdleDatabases();
 
@@ -5450,10 +5491,14 @@ private:
 class ConnectionPool::CloseConnectionRunnable final
   : public ConnectionRunnable
 {
+  // Null when closing the primary connection.
+  ReadConnectionInfo* mReadConnection;
+
 public:
-  explicit
-  CloseConnectionRunnable(DatabaseInfo* aDatabaseInfo)
+  CloseConnectionRunnable(DatabaseInfo* aDatabaseInfo,
+                          ReadConnectionInfo* aReadConnection)
     : ConnectionRunnable(aDatabaseInfo)
+    , mReadConnection(aReadConnection)
   { }
 
   NS_DECL_ISUPPORTS_INHERITED
@@ -5478,6 +5523,25 @@ struct ConnectionPool::ThreadInfo
   ~ThreadInfo();
 };
 
+// An extra connection to a database that only runs readonly transactions.
+struct ConnectionPool::ReadConnectionInfo final
+{
+  // Only touched on mThreadInfo.mThread.
+  RefPtr<DatabaseConnection> mConnection;
+
+  // Only modified on the owning thread while holding mDatabasesMutex.
+  ThreadInfo mThreadInfo;
+
+  // Only touched on the owning thread.
+  uint32_t mRunningTransactionCount;
+
+  explicit
+  ReadConnectionInfo(const ThreadInfo& aThreadInfo)
+    : mThreadInfo(aThreadInfo)
+    , mRunningTransactionCount(0)
+  { }
+};
+
 struct ConnectionPool::DatabaseInfo final
 {
   friend class nsAutoPtr<DatabaseInfo>;
@@ -5490,8 +5554,18 @@ struct ConnectionPool::DatabaseInfo final
   nsTArray<TransactionInfo*> mScheduledWriteTransactions;
   TransactionInfo* mRunningWriteTransaction;
   ThreadInfo mThreadInfo;
+  // Only modified on the owning thread, but searched on connection threads
+  // while holding mDatabasesMutex.
+  nsTArray<nsAutoPtr<ReadConnectionInfo>> mReadConnections;
   uint32_t mReadTransactionCount;
   uint32_t mWriteTransactionCount;
+  // The number of readonly transactions running on the primary connection.
+  uint32_t mPrimaryReadTransactionCount;
+  // The number of CloseConnectionRunnables that have not yet completed.
+  uint32_t mPendingCloseCount;
+  // Set on the connection thread once the primary connection is known to be
+  // in WAL mode, which lets readers on other connections run alongside it.
+  Atomic<bool> mReadConnectionsAllowed;
   bool mNeedsCheckpoint;
   bool mIdle;
   bool mCloseOnIdle;
@@ -5696,6 +5770,8 @@ struct ConnectionPool::TransactionInfo final
   nsTHashtable<nsPtrHashKey<TransactionInfo>> mBlockedOn;
   nsTHashtable<nsPtrHashKey<TransactionInfo>> mBlocking;
   nsTArray<nsCOMPtr<nsIRunnable>> mQueuedRunnables;
+  // Null if the transaction runs on the database's primary connection.
+  ReadConnectionInfo* mReadConnection;
   const bool mIsWriteTransaction;
   bool mRunning;
 
@@ -5712,6 +5788,14 @@ struct ConnectionPool::TransactionInfo final
                   bool aIsWriteTransaction,
                   TransactionDatabaseOperationBase* aTransactionOp);
 
+  nsIThread*
+  ConnectionThread() const
+  {
+    return mReadConnection ?
+           mReadConnection->mThreadInfo.mThread.get() :
+           mDatabaseInfo->mThreadInfo.mThread.get();
+  }
+
   void
   Schedule();
 
@@ -6640,12 +6724,29 @@ protected:
   bool mCommittedOrAborted;
   bool mForceAborted;
 
+#ifdef DEBUG
+  // The thread of the connection this transaction started on. Only touched
+  // on that thread.
+  PRThread* mDEBUGConnectionThread;
+#endif
+
 public:
   void
   AssertIsOnConnectionThread() const
   {
     MOZ_ASSERT(mDatabase);
-    mDatabase->AssertIsOnConnectionThread();
+
+    if (mMode == IDBTransaction::READ_ONLY) {
+      // Readonly transactions may run on one of the database's read
+      // connections rather than on its primary connection, but they never
+      // move once started.
+      MOZ_ASSERT(!NS_IsMainThread());
+      MOZ_ASSERT(!IsOnBackgroundThread());
+      MOZ_ASSERT_IF(mDEBUGConnectionThread,
+                    PR_GetCurrentThread() == mDEBUGConnectionThread);
+    } else {
+      mDatabase->AssertIsOnConnectionThread();
+    }
   }
 
   bool
@@ -6684,9 +6785,16 @@ public:
   }
 
   void
-  SetActiveOnConnectionThread()
+  SetActiveOnConnectionThread(DatabaseConnection* aConnection)
   {
+    MOZ_ASSERT(aConnection);
+    aConnection->AssertIsOnConnectionThread();
     AssertIsOnConnectionThread();
+
+#ifdef DEBUG
+    mDEBUGConnectionThread = PR_GetCurrentThread();
+#endif
+
     mHasBeenActiveOnConnectionThread = true;
   }
 
@@ -8435,6 +8543,12 @@ private:
 
   CursorOpBase* mCurrentlyRunningOp;
 
+  // The number of extra records sent along with the next continue() response,
+  // only touched on the connection thread. This doubles while the child keeps
+  // consuming whole batches and drops back to zero when it discards one.
+  uint32_t mPrefetchCount;
+  const uint32_t mMaxPrefetchCount;
+
   const Type mType;
   const Direction mDirection;
 
@@ -10255,6 +10369,54 @@ DatabaseConnection::FinishWriteTransaction()
   mInReadTransaction = true;
 }
 
+nsresult
+DatabaseConnection::RestartReadTransaction()
+{
+  AssertIsOnConnectionThread();
+  MOZ_ASSERT(mStorageConnection);
+
+  PROFILER_LABEL("IndexedDB",
+                 "DatabaseConnection::RestartReadTransaction",
+                 js::ProfileEntry::Category::STORAGE);
+
+  if (mInWriteTransaction) {
+    // Nothing else can have written to the database since this transaction
+    // began.
+    return NS_OK;
+  }
+
+  if (mInReadTransaction) {
+    CachedStatement rollbackStmt;
+    nsresult rv =
+      GetCachedStatement(NS_LITERAL_CSTRING("ROLLBACK;"), &rollbackStmt);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    rv = rollbackStmt->Execute();
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    mInReadTransaction = false;
+  }
+
+  CachedStatement beginStmt;
+  nsresult rv = GetCachedStatement(NS_LITERAL_CSTRING("BEGIN;"), &beginStmt);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = beginStmt->Execute();
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  mInReadTransaction = true;
+
+  return NS_OK;
+}
+
 nsresult
 DatabaseConnection::StartSavepoint()
 {
@@ -11604,14 +11766,62 @@ ConnectionPool::GetOrCreateConnection(const Database* aDatabase,
                  js::ProfileEntry::Category::STORAGE);
 
   DatabaseInfo* dbInfo;
+  ReadConnectionInfo* readConnection = nullptr;
   {
     MutexAutoLock lock(mDatabasesMutex);
 
     dbInfo = mDatabases.Get(aDatabase->Id());
+    MOZ_ASSERT(dbInfo);
+
+    nsIThread* currentThread = NS_GetCurrentThread();
+
+    for (uint32_t count = dbInfo->mReadConnections.Length(), index = 0;
+         index < count;
+         index++) {
+      ReadConnectionInfo* info = dbInfo->mReadConnections[index];
+      if (info->mThreadInfo.mThread == currentThread) {
+        readConnection = info;
+        break;
+      }
+    }
   }
 
   MOZ_ASSERT(dbInfo);
 
+  if (readConnection) {
+    RefPtr<DatabaseConnection> connection = readConnection->mConnection;
+    if (!connection) {
+      nsCOMPtr<mozIStorageConnection> storageConnection;
+      nsresult rv =
+        GetStorageConnection(aDatabase->FilePath(),
+                             aDatabase->Type(),
+                             aDatabase->Group(),
+                             aDatabase->Origin(),
+                             aDatabase->TelemetryId(),
+                             getter_AddRefs(storageConnection));
+      if (NS_WARN_IF(NS_FAILED(rv))) {
+        return rv;
+      }
+
+      connection =
+        new DatabaseConnection(storageConnection, aDatabase->GetFileManager());
+
+      rv = connection->Init();
+      if (NS_WARN_IF(NS_FAILED(rv))) {
+        return rv;
+      }
+
+      readConnection->mConnection = connection;
+
+      IDB_DEBUG_LOG(("ConnectionPool created read connection 0x%p for '%s'",
+                     connection.get(),
+                     NS_ConvertUTF16toUTF8(aDatabase->FilePath()).get()));
+    }
+
+    connection.forget(aConnection);
+    return NS_OK;
+  }
+
   RefPtr<DatabaseConnection> connection = dbInfo->mConnection;
   if (!connection) {
     MOZ_ASSERT(!dbInfo->mDEBUGConnectionThread);
@@ -11636,6 +11846,25 @@ ConnectionPool::GetOrCreateConnection(const Database* aDatabase,
       return rv;
     }
 
+    // Readonly transactions can only run on other connections while this one
+    // is writing if the database is in WAL mode.
+    nsCOMPtr<mozIStorageStatement> stmt;
+    rv = storageConnection->CreateStatement(NS_LITERAL_CSTRING(
+      "PRAGMA journal_mode;"
+    ), getter_AddRefs(stmt));
+    if (NS_SUCCEEDED(rv)) {
+      bool hasResult;
+      rv = stmt->ExecuteStep(&hasResult);
+      if (NS_SUCCEEDED(rv) && hasResult) {
+        nsCString journalMode;
+        rv = stmt->GetUTF8String(0, journalMode);
+        if (NS_SUCCEEDED(rv)) {
+          dbInfo->mReadConnectionsAllowed = journalMode.EqualsLiteral("wal");
+        }
+      }
+    }
+    Unused << NS_WARN_IF(NS_FAILED(rv));
+
     dbInfo->mConnection = connection;
 
     IDB_DEBUG_LOG(("ConnectionPool created connection 0x%p for '%s'",
@@ -11781,7 +12010,8 @@ ConnectionPool::Dispatch(uint64_t aTransactionId, nsIRunnable* aRunnable)
                   dbInfo->mRunningWriteTransaction == transactionInfo);
 
     MOZ_ALWAYS_SUCCEEDS(
-      dbInfo->mThreadInfo.mThread->Dispatch(aRunnable, NS_DISPATCH_NORMAL));
+      transactionInfo->ConnectionThread()->Dispatch(aRunnable,
+                                                    NS_DISPATCH_NORMAL));
   } else {
     transactionInfo->mQueuedRunnables.AppendElement(aRunnable);
   }
@@ -12027,6 +12257,149 @@ ConnectionPool::ShutdownThread(ThreadInfo& aThreadInfo)
   mTotalThreadCount--;
 }
 
+bool
+ConnectionPool::AcquireThread(ThreadInfo& aThreadInfo)
+{
+  AssertIsOnOwningThread();
+  MOZ_ASSERT(!aThreadInfo.mThread);
+  MOZ_ASSERT(!aThreadInfo.mRunnable);
+
+  if (!mIdleThreads.IsEmpty()) {
+    const uint32_t lastIndex = mIdleThreads.Length() - 1;
+
+    ThreadInfo& threadInfo = mIdleThreads[lastIndex].mThreadInfo;
+
+    aThreadInfo.mRunnable.swap(threadInfo.mRunnable);
+    aThreadInfo.mThread.swap(threadInfo.mThread);
+
+    mIdleThreads.RemoveElementAt(lastIndex);
+
+    AdjustIdleTimer();
+    return true;
+  }
+
+  if (mTotalThreadCount >= kMaxConnectionThreadCount) {
+    return false;
+  }
+
+  // This will set the thread up with the profiler.
+  RefPtr<ThreadRunnable> runnable = new ThreadRunnable();
+
+  nsCOMPtr<nsIThread> newThread;
+  if (NS_WARN_IF(NS_FAILED(NS_NewThread(getter_AddRefs(newThread),
+                                        runnable)))) {
+    return false;
+  }
+
+  MOZ_ASSERT(newThread);
+
+  IDB_DEBUG_LOG(("ConnectionPool created thread %lu",
+                 runnable->SerialNumber()));
+
+  aThreadInfo.mThread.swap(newThread);
+  aThreadInfo.mRunnable.swap(runnable);
+
+  mTotalThreadCount++;
+  return true;
+}
+
+void
+ConnectionPool::ReleaseThread(ThreadInfo& aThreadInfo)
+{
+  AssertIsOnOwningThread();
+  MOZ_ASSERT(aThreadInfo.mThread);
+  MOZ_ASSERT(aThreadInfo.mRunnable);
+
+  if (mShutdownRequested) {
+    ShutdownThread(aThreadInfo);
+    return;
+  }
+
+  MOZ_ASSERT(!mIdleThreads.Contains(aThreadInfo));
+
+  mIdleThreads.InsertElementSorted(aThreadInfo);
+
+  aThreadInfo.mRunnable = nullptr;
+  aThreadInfo.mThread = nullptr;
+
+  if (mIdleThreads.Length() > kMaxIdleConnectionThreadCount) {
+    ShutdownThread(mIdleThreads[0].mThreadInfo);
+    mIdleThreads.RemoveElementAt(0);
+  }
+
+  AdjustIdleTimer();
+}
+
+ConnectionPool::ReadConnectionInfo*
+ConnectionPool::GetReadConnectionForTransaction(DatabaseInfo* aDatabaseInfo)
+{
+  AssertIsOnOwningThread();
+  MOZ_ASSERT(aDatabaseInfo);
+  MOZ_ASSERT(aDatabaseInfo->mThreadInfo.mThread);
+  MOZ_ASSERT(!aDatabaseInfo->mClosing);
+
+  // Readers on other connections can only run alongside a writer in WAL mode.
+  if (!aDatabaseInfo->mReadConnectionsAllowed) {
+    return nullptr;
+  }
+
+  const uint32_t primaryLoad = aDatabaseInfo->mPrimaryReadTransactionCount +
+                               (aDatabaseInfo->mRunningWriteTransaction ? 1 : 0);
+
+  // The primary connection is preferred whenever nothing else is running on
+  // it.
+  if (!primaryLoad) {
+    return nullptr;
+  }
+
+  ReadConnectionInfo* leastBusy = nullptr;
+
+  for (uint32_t count = aDatabaseInfo->mReadConnections.Length(), index = 0;
+       index < count;
+       index++) {
+    ReadConnectionInfo* readConnection = aDatabaseInfo->mReadConnections[index];
+    if (!leastBusy ||
+        readConnection->mRunningTransactionCount <
+          leastBusy->mRunningTransactionCount) {
+      leastBusy = readConnection;
+    }
+  }
+
+  if (leastBusy && !leastBusy->mRunningTransactionCount) {
+    return leastBusy;
+  }
+
+  // Don't take threads away from databases that are waiting for one.
+  if (aDatabaseInfo->mReadConnections.Length() < kMaxReadConnectionCount &&
+      mQueuedTransactions.IsEmpty()) {
+    ThreadInfo threadInfo;
+    if (AcquireThread(threadInfo)) {
+      nsAutoPtr<ReadConnectionInfo> readConnection(
+        new ReadConnectionInfo(threadInfo));
+
+      // The connection itself is opened lazily on its own thread.
+      threadInfo.mRunnable = nullptr;
+      threadInfo.mThread = nullptr;
+
+      ReadConnectionInfo* result = readConnection;
+      {
+        MutexAutoLock lock(mDatabasesMutex);
+
+        aDatabaseInfo->mReadConnections.AppendElement(readConnection.forget());
+      }
+
+      return result;
+    }
+  }
+
+  // Everything is busy, share whichever connection has the least work.
+  if (leastBusy && leastBusy->mRunningTransactionCount < primaryLoad) {
+    return leastBusy;
+  }
+
+  return nullptr;
+}
+
 void
 ConnectionPool::CloseIdleDatabases()
 {
@@ -12179,6 +12552,17 @@ ConnectionPool::ScheduleTransaction(TransactionInfo* aTransactionInfo,
 
     dbInfo->mRunningWriteTransaction = aTransactionInfo;
     dbInfo->mNeedsCheckpoint = true;
+  } else {
+    MOZ_ASSERT(!aTransactionInfo->mReadConnection);
+
+    ReadConnectionInfo* readConnection =
+      GetReadConnectionForTransaction(dbInfo);
+    if (readConnection) {
+      aTransactionInfo->mReadConnection = readConnection;
+      readConnection->mRunningTransactionCount++;
+    } else {
+      dbInfo->mPrimaryReadTransactionCount++;
+    }
   }
 
   MOZ_ASSERT(!aTransactionInfo->mRunning);
@@ -12195,8 +12579,8 @@ ConnectionPool::ScheduleTransaction(TransactionInfo* aTransactionInfo,
       queuedRunnables[index].swap(runnable);
 
       MOZ_ALWAYS_SUCCEEDS(
-        dbInfo->mThreadInfo.mThread->Dispatch(runnable.forget(),
-                                              NS_DISPATCH_NORMAL));
+        aTransactionInfo->ConnectionThread()->Dispatch(runnable.forget(),
+                                                       NS_DISPATCH_NORMAL));
     }
 
     queuedRunnables.Clear();
@@ -12227,6 +12611,16 @@ ConnectionPool::NoteFinishedTransaction(uint64_t aTransactionId)
   MOZ_ASSERT(dbInfo->mThreadInfo.mThread);
   MOZ_ASSERT(dbInfo->mThreadInfo.mRunnable);
 
+  if (!transactionInfo->mIsWriteTransaction) {
+    if (ReadConnectionInfo* readConnection = transactionInfo->mReadConnection) {
+      MOZ_ASSERT(readConnection->mRunningTransactionCount);
+      readConnection->mRunningTransactionCount--;
+    } else {
+      MOZ_ASSERT(dbInfo->mPrimaryReadTransactionCount);
+      dbInfo->mPrimaryReadTransactionCount--;
+    }
+  }
+
   // Schedule the next write transaction if there are any queued.
   if (dbInfo->mRunningWriteTransaction == transactionInfo) {
     MOZ_ASSERT(transactionInfo->mIsWriteTransaction);
@@ -12388,6 +12782,31 @@ ConnectionPool::NoteClosedDatabase(DatabaseInfo* aDatabaseInfo)
 
   aDatabaseInfo->mClosing = false;
 
+  // Read connections are reopened on demand, so their threads can always be
+  // released now.
+  if (!aDatabaseInfo->mReadConnections.IsEmpty()) {
+    nsTArray<nsAutoPtr<ReadConnectionInfo>> readConnections;
+    {
+      MutexAutoLock lock(mDatabasesMutex);
+
+      readConnections.SwapElements(aDatabaseInfo->mReadConnections);
+    }
+
+    for (uint32_t count = readConnections.Length(), index = 0;
+         index < count;
+         index++) {
+      ReadConnectionInfo* readConnection = readConnections[index];
+      MOZ_ASSERT(!readConnection->mConnection);
+      MOZ_ASSERT(!readConnection->mRunningTransactionCount);
+
+      if (!mQueuedTransactions.IsEmpty()) {
+        ScheduleQueuedTransactions(readConnection->mThreadInfo);
+      } else {
+        ReleaseThread(readConnection->mThreadInfo);
+      }
+    }
+  }
+
   // Figure out what to do with this database's thread. It may have already been
   // given to another database, in which case there's nothing to do here.
   // Otherwise we prioritize the thread as follows:
@@ -12407,23 +12826,7 @@ ConnectionPool::NoteClosedDatabase(DatabaseInfo* aDatabaseInfo)
       // Give the thread to another database.
       ScheduleQueuedTransactions(aDatabaseInfo->mThreadInfo);
     } else if (!aDatabaseInfo->TotalTransactionCount()) {
-      if (mShutdownRequested) {
-        ShutdownThread(aDatabaseInfo->mThreadInfo);
-      } else {
-        MOZ_ASSERT(!mIdleThreads.Contains(aDatabaseInfo->mThreadInfo));
-
-        mIdleThreads.InsertElementSorted(aDatabaseInfo->mThreadInfo);
-
-        aDatabaseInfo->mThreadInfo.mRunnable = nullptr;
-        aDatabaseInfo->mThreadInfo.mThread = nullptr;
-
-        if (mIdleThreads.Length() > kMaxIdleConnectionThreadCount) {
-          ShutdownThread(mIdleThreads[0].mThreadInfo);
-          mIdleThreads.RemoveElementAt(0);
-        }
-
-        AdjustIdleTimer();
-      }
+      ReleaseThread(aDatabaseInfo->mThreadInfo);
     }
   }
 
@@ -12544,15 +12947,33 @@ ConnectionPool::CloseDatabase(DatabaseInfo* aDatabaseInfo)
   MOZ_ASSERT(aDatabaseInfo->mThreadInfo.mRunnable);
   MOZ_ASSERT(!aDatabaseInfo->mClosing);
 
+  MOZ_ASSERT(!aDatabaseInfo->mPendingCloseCount);
+
   aDatabaseInfo->mIdle = false;
   aDatabaseInfo->mNeedsCheckpoint = false;
   aDatabaseInfo->mClosing = true;
+  aDatabaseInfo->mPendingCloseCount =
+    aDatabaseInfo->mReadConnections.Length() + 1;
 
-  nsCOMPtr<nsIRunnable> runnable = new CloseConnectionRunnable(aDatabaseInfo);
+  nsCOMPtr<nsIRunnable> runnable =
+    new CloseConnectionRunnable(aDatabaseInfo, nullptr);
 
   MOZ_ALWAYS_SUCCEEDS(
     aDatabaseInfo->mThreadInfo.mThread->Dispatch(runnable.forget(),
                                                  NS_DISPATCH_NORMAL));
+
+  for (uint32_t count = aDatabaseInfo->mReadConnections.Length(), index = 0;
+       index < count;
+       index++) {
+    ReadConnectionInfo* readConnection = aDatabaseInfo->mReadConnections[index];
+    MOZ_ASSERT(!readConnection->mRunningTransactionCount);
+
+    runnable = new CloseConnectionRunnable(aDatabaseInfo, readConnection);
+
+    MOZ_ALWAYS_SUCCEEDS(
+      readConnection->mThreadInfo.mThread->Dispatch(runnable.forget(),
+                                                    NS_DISPATCH_NORMAL));
+  }
 }
 
 bool
@@ -12651,7 +13072,16 @@ CloseConnectionRunnable::Run()
     nsCOMPtr<nsIEventTarget> owningThread;
     mOwningThread.swap(owningThread);
 
-    if (mDatabaseInfo->mConnection) {
+    if (mReadConnection) {
+      if (mReadConnection->mConnection) {
+        mReadConnection->mConnection->Close();
+
+        IDB_DEBUG_LOG(("ConnectionPool closed read connection 0x%p",
+                       mReadConnection->mConnection.get()));
+
+        mReadConnection->mConnection = nullptr;
+      }
+    } else if (mDatabaseInfo->mConnection) {
       mDatabaseInfo->AssertIsOnConnectionThread();
 
       mDatabaseInfo->mConnection->Close();
@@ -12671,6 +13101,13 @@ CloseConnectionRunnable::Run()
     return NS_OK;
   }
 
+  MOZ_ASSERT(mDatabaseInfo->mPendingCloseCount);
+
+  if (--mDatabaseInfo->mPendingCloseCount) {
+    // Still waiting for other connections to this database to close.
+    return NS_OK;
+  }
+
   RefPtr<ConnectionPool> connectionPool = mDatabaseInfo->mConnectionPool;
   MOZ_ASSERT(connectionPool);
 
@@ -12686,6 +13123,9 @@ DatabaseInfo::DatabaseInfo(ConnectionPool* aConnectionPool,
   , mRunningWriteTransaction(nullptr)
   , mReadTransactionCount(0)
   , mWriteTransactionCount(0)
+  , mPrimaryReadTransactionCount(0)
+  , mPendingCloseCount(0)
+  , mReadConnectionsAllowed(false)
   , mNeedsCheckpoint(false)
   , mIdle(false)
   , mCloseOnIdle(false)
@@ -12711,6 +13151,8 @@ DatabaseInfo::~DatabaseInfo()
   MOZ_ASSERT(!mRunningWriteTransaction);
   MOZ_ASSERT(!mThreadInfo.mThread);
   MOZ_ASSERT(!mThreadInfo.mRunnable);
+  MOZ_ASSERT(mReadConnections.IsEmpty());
+  MOZ_ASSERT(!mPendingCloseCount);
   MOZ_ASSERT(!TotalTransactionCount());
 
   MOZ_COUNT_DTOR(ConnectionPool::DatabaseInfo);
@@ -13040,6 +13482,7 @@ TransactionInfo::TransactionInfo(
   , mTransactionId(aTransactionId)
   , mLoggingSerialNumber(aLoggingSerialNumber)
   , mObjectStoreNames(aObjectStoreNames)
+  , mReadConnection(nullptr)
   , mIsWriteTransaction(aIsWriteTransaction)
   , mRunning(false)
 #ifdef DEBUG
@@ -14261,7 +14704,7 @@ StartTransactionOp::DoDatabaseWork(DatabaseConnection* aConnection)
   MOZ_ASSERT(aConnection);
   aConnection->AssertIsOnConnectionThread();
 
-  Transaction()->SetActiveOnConnectionThread();
+  Transaction()->SetActiveOnConnectionThread(aConnection);
 
   if (Transaction()->GetMode() == IDBTransaction::CLEANUP) {
     nsresult rv = aConnection->DisableQuotaChecks();
@@ -14275,6 +14718,13 @@ StartTransactionOp::DoDatabaseWork(DatabaseConnection* aConnection)
     if (NS_WARN_IF(NS_FAILED(rv))) {
       return rv;
     }
+  } else {
+    // If this is a read connection its snapshot may predate writes committed
+    // through the primary connection since it last read.
+    nsresult rv = aConnection->RestartReadTransaction();
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
   }
 
   return NS_OK;
@@ -14331,6 +14781,9 @@ TransactionBase::TransactionBase(Database* aDatabase, Mode aMode)
   , mCommitOrAbortReceived(false)
   , mCommittedOrAborted(false)
   , mForceAborted(false)
+#ifdef DEBUG
+  , mDEBUGConnectionThread(nullptr)
+#endif
 {
   AssertIsOnBackgroundThread();
   MOZ_ASSERT(aDatabase);
@@ -16056,6 +16509,11 @@ Cursor::Cursor(TransactionBase* aTransaction,
   , mObjectStoreId(aObjectStoreMetadata->mCommonMetadata.id())
   , mIndexId(aIndexMetadata ? aIndexMetadata->mCommonMetadata.id() : 0)
   , mCurrentlyRunningOp(nullptr)
+  , mPrefetchCount(0)
+    // Only object store cursors can send more than one record per response.
+  , mMaxPrefetchCount(aType == OpenCursorParams::TObjectStoreOpenCursorParams ?
+                      IndexedDatabaseManager::MaxCursorPrefetch() :
+                      0)
   , mType(aType)
   , mDirection(aDirection)
   , mUniqueIndex(aIndexMetadata ?
@@ -21897,7 +22355,7 @@ VersionChangeOp::DoDatabaseWork(DatabaseConnection* aConnection)
                IDB_LOG_ID_STRING(mBackgroundChildLoggingId),
                mLoggingSerialNumber);
 
-  Transaction()->SetActiveOnConnectionThread();
+  Transaction()->SetActiveOnConnectionThread(aConnection);
 
   nsresult rv = aConnection->BeginWriteTransaction();
   if (NS_WARN_IF(NS_FAILED(rv))) {
@@ -22705,11 +23163,24 @@ TransactionDatabaseOperationBase::RunOnConnectionThread()
     MOZ_ASSERT(database);
 
     // Here we're actually going to perform the database operation.
-    nsresult rv = database->EnsureConnection();
+    RefPtr<DatabaseConnection> connection;
+    nsresult rv;
+
+    if (mTransaction->GetMode() == IDBTransaction::READ_ONLY) {
+      // The connection pool may have given this transaction a read connection
+      // of its own, so don't cache the result on the Database.
+      rv = gConnectionPool->GetOrCreateConnection(database,
+                                                  getter_AddRefs(connection));
+    } else {
+      rv = database->EnsureConnection();
+      if (NS_SUCCEEDED(rv)) {
+        connection = database->GetConnection();
+      }
+    }
+
     if (NS_WARN_IF(NS_FAILED(rv))) {
       mResultCode = rv;
     } else {
-      DatabaseConnection* connection = database->GetConnection();
       MOZ_ASSERT(connection);
       MOZ_ASSERT(connection->GetStorageConnection());
 
@@ -24213,27 +24684,49 @@ UpdateIndexDataValuesFunction::OnFunctionCall(mozIStorageValueArray* aValues,
     return rv;
   }
 
-  JS::Rooted<JS::Value> clone(mCx);
-  if (NS_WARN_IF(!IDBObjectStore::DeserializeIndexValue(mCx,
-                                                        cloneInfo,
-                                                        &clone))) {
-    return NS_ERROR_DOM_DATA_CLONE_ERR;
-  }
-
   const IndexMetadata& metadata = mOp->mMetadata;
   const int64_t& objectStoreId = mOp->mObjectStoreId;
 
   AutoTArray<IndexUpdateInfo, 32> updateInfos;
-  rv = IDBObjectStore::AppendIndexUpdateInfo(metadata.id(),
-                                             metadata.keyPath(),
-                                             metadata.unique(),
-                                             metadata.multiEntry(),
-                                             metadata.locale(),
-                                             mCx,
-                                             clone,
-                                             updateInfos);
-  if (NS_WARN_IF(NS_FAILED(rv))) {
-    return rv;
+
+  // Simple values can usually be indexed straight from the stored bytes
+  // without creating any JS objects.
+  rv = NS_ERROR_NOT_AVAILABLE;
+  if (SimpleValue::IsSimpleValue(cloneInfo.mData.Elements(),
+                                 cloneInfo.mData.Length())) {
+    rv = SimpleValue::AppendIndexUpdateInfo(metadata.id(),
+                                            metadata.keyPath(),
+                                            metadata.multiEntry(),
+                                            metadata.locale(),
+                                            cloneInfo.mData.Elements(),
+                                            cloneInfo.mData.Length(),
+                                            updateInfos);
+    if (rv != NS_ERROR_NOT_AVAILABLE && NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+  }
+
+  if (rv == NS_ERROR_NOT_AVAILABLE) {
+    updateInfos.Clear();
+
+    JS::Rooted<JS::Value> clone(mCx);
+    if (NS_WARN_IF(!IDBObjectStore::DeserializeIndexValue(mCx,
+                                                          cloneInfo,
+                                                          &clone))) {
+      return NS_ERROR_DOM_DATA_CLONE_ERR;
+    }
+
+    rv = IDBObjectStore::AppendIndexUpdateInfo(metadata.id(),
+                                               metadata.keyPath(),
+                                               metadata.unique(),
+                                               metadata.multiEntry(),
+                                               metadata.locale(),
+                                               mCx,
+                                               clone,
+                                               updateInfos);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
   }
 
   if (updateInfos.IsEmpty()) {
@@ -26726,7 +27219,8 @@ CursorOpBase::PopulateResponseFromStatement(
     bool aInitializeResponse)
 {
   Transaction()->AssertIsOnConnectionThread();
-  MOZ_ASSERT(mResponse.type() == CursorResponse::T__None);
+  MOZ_ASSERT_IF(aInitializeResponse,
+                mResponse.type() == CursorResponse::T__None);
   MOZ_ASSERT_IF(mFiles.IsEmpty(), aInitializeResponse);
 
   nsresult rv = mCursor->mKey.SetFromStatement(aStmt, 0);
@@ -27761,9 +28255,27 @@ ContinueOp::DoDatabaseWork(DatabaseConnection* aConnection)
   const nsCString& continueQuery =
     hasContinueKey ? mCursor->mContinueToQuery : mCursor->mContinueQuery;
 
+  // The child tells us which record it is positioned at. If that is the last
+  // record we sent then it used up any records we prefetched, so send more
+  // this time. Otherwise it discarded some (because the transaction modified
+  // data, or it skipped past them) and we have to pick up from its position.
+  uint32_t extraCount = 0;
+  const bool childIsBehind = !mKey.IsUnset() && mKey != mCursor->mKey;
+
+  if (mCursor->mMaxPrefetchCount) {
+    if (childIsBehind) {
+      mCursor->mPrefetchCount = 0;
+    } else {
+      mCursor->mPrefetchCount =
+        std::min(std::max(mCursor->mPrefetchCount * 2, 1u),
+                 mCursor->mMaxPrefetchCount);
+    }
+    extraCount = mCursor->mPrefetchCount;
+  }
+
   MOZ_ASSERT(advanceCount > 0);
   nsAutoCString countString;
-  countString.AppendInt(advanceCount);
+  countString.AppendInt(advanceCount + extraCount);
 
   nsCString query = continueQuery + countString;
 
@@ -27778,6 +28290,8 @@ ContinueOp::DoDatabaseWork(DatabaseConnection* aConnection)
     currentKey = mParams.get_ContinueParams().key();
   } else if (localeAware) {
     currentKey = mCursor->mSortKey;
+  } else if (mCursor->mMaxPrefetchCount && childIsBehind) {
+    currentKey = mKey;
   }
 
   const bool usingRangeKey = !mCursor->mRangeKey.IsUnset();
@@ -27843,8 +28357,19 @@ ContinueOp::DoDatabaseWork(DatabaseConnection* aConnection)
     return rv;
   }
 
-  uint32_t extraCount = 1;
-  for (uint32_t i = 0; i < extraCount; i++) {
+  if (!extraCount) {
+    return NS_OK;
+  }
+
+  MOZ_ASSERT(mResponse.type() ==
+               CursorResponse::TArrayOfObjectStoreCursorResponse);
+
+  auto& responses = mResponse.get_ArrayOfObjectStoreCursorResponse();
+  size_t responseSize = responses[0].cloneInfo().data().Length();
+
+  for (uint32_t i = 0;
+       i < extraCount && responseSize < kMaxCursorPrefetchBytes;
+       i++) {
     rv = stmt->ExecuteStep(&hasResult);
     if (NS_WARN_IF(NS_FAILED(rv))) {
       return rv;
@@ -27858,6 +28383,8 @@ ContinueOp::DoDatabaseWork(DatabaseConnection* aConnection)
     if (NS_WARN_IF(NS_FAILED(rv))) {
       return rv;
     }
+
+    responseSize += responses.LastElement().cloneInfo().data().Length();
   }
 
   return NS_OK;
@@ -46,6 +46,7 @@
 #include "nsQueryObject.h"
 #include "ProfilerHelpers.h"
 #include "ReportInternalError.h"
+#include "SimpleValue.h"
 #include "WorkerPrivate.h"
 #include "WorkerScope.h"
 
@@ -75,6 +76,7 @@ struct IDBObjectStore::StructuredCloneWriteInfo
   };
 
   JSAutoStructuredCloneBuffer mCloneBuffer;
+  FallibleTArray<uint8_t> mSimpleValueData;
   nsTArray<BlobOrMutableFile> mBlobOrMutableFiles;
   IDBDatabase* mDatabase;
   uint64_t mOffsetToKeyProp;
@@ -97,6 +99,7 @@ struct IDBObjectStore::StructuredCloneWriteInfo
 
     MOZ_COUNT_CTOR(StructuredCloneWriteInfo);
 
+    mSimpleValueData.SwapElements(aCloneWriteInfo.mSimpleValueData);
     mBlobOrMutableFiles.SwapElements(aCloneWriteInfo.mBlobOrMutableFiles);
     aCloneWriteInfo.mOffsetToKeyProp = 0;
   }
@@ -111,6 +114,7 @@ struct IDBObjectStore::StructuredCloneWriteInfo
   {
     return this->mCloneBuffer.nbytes() == aOther.mCloneBuffer.nbytes() &&
            this->mCloneBuffer.data() == aOther.mCloneBuffer.data() &&
+           this->mSimpleValueData == aOther.mSimpleValueData &&
            this->mBlobOrMutableFiles == aOther.mBlobOrMutableFiles &&
            this->mDatabase == aOther.mDatabase &&
            this->mOffsetToKeyProp == aOther.mOffsetToKeyProp;
@@ -1006,32 +1010,28 @@ IDBObjectStore::AppendIndexUpdateInfo(
   }
   if (isArray) {
     JS::Rooted<JSObject*> array(aCx, &val.toObject());
-    uint32_t arrayLength;
-    if (NS_WARN_IF(!JS_GetArrayLength(aCx, array, &arrayLength))) {
-      IDB_REPORT_INTERNAL_ERR();
-      return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
+
+    AutoTArray<Key, 16> values;
+    rv = Key::AppendKeysFromArray(aCx, array, values);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
     }
 
-    for (uint32_t arrayIndex = 0; arrayIndex < arrayLength; arrayIndex++) {
-      JS::Rooted<JS::Value> arrayItem(aCx);
-      if (NS_WARN_IF(!JS_GetElement(aCx, array, arrayIndex, &arrayItem))) {
-        IDB_REPORT_INTERNAL_ERR();
-        return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
-      }
+    aUpdateInfoArray.SetCapacity(aUpdateInfoArray.Length() + values.Length());
 
-      Key value;
-      if (NS_FAILED(value.SetFromJSVal(aCx, arrayItem)) ||
-          value.IsUnset()) {
-        // Not a value we can do anything with, ignore it.
-        continue;
-      }
+#ifdef ENABLE_INTL_API
+    // All items share the index's collator.
+    Key::LocaleConverter localeConverter(aLocale);
+#endif
 
+    for (uint32_t index = 0, count = values.Length(); index < count; index++) {
       IndexUpdateInfo* updateInfo = aUpdateInfoArray.AppendElement();
       updateInfo->indexId() = aIndexID;
-      updateInfo->value() = value;
+      updateInfo->value() = values[index];
 #ifdef ENABLE_INTL_API
       if (localeAware) {
-        rv = value.ToLocaleBasedKey(updateInfo->localizedValue(), aLocale);
+        rv = localeConverter.Convert(values[index],
+                                     updateInfo->localizedValue());
         if (NS_WARN_IF(NS_FAILED(rv))) {
           return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
         }
@@ -1091,6 +1091,16 @@ IDBObjectStore::DeserializeValue(JSContext* aCx,
     return true;
   }
 
+  if (SimpleValue::IsSimpleValue(aCloneReadInfo.mData.Elements(),
+                                 aCloneReadInfo.mData.Length())) {
+    JSAutoRequest ar(aCx);
+
+    return SimpleValue::Read(aCx,
+                             aCloneReadInfo.mData.Elements(),
+                             aCloneReadInfo.mData.Length(),
+                             aValue);
+  }
+
   auto* data = reinterpret_cast<uint64_t*>(aCloneReadInfo.mData.Elements());
   size_t dataLen = aCloneReadInfo.mData.Length();
 
@@ -1131,6 +1141,16 @@ IDBObjectStore::DeserializeIndexValue(JSContext* aCx,
     return true;
   }
 
+  if (SimpleValue::IsSimpleValue(aCloneReadInfo.mData.Elements(),
+                                 aCloneReadInfo.mData.Length())) {
+    JSAutoRequest ar(aCx);
+
+    return SimpleValue::Read(aCx,
+                             aCloneReadInfo.mData.Elements(),
+                             aCloneReadInfo.mData.Length(),
+                             aValue);
+  }
+
   size_t dataLen = aCloneReadInfo.mData.Length();
 
   uint64_t* data =
@@ -1276,6 +1296,13 @@ IDBObjectStore::GetAddInfo(JSContext* aCx,
                                          aKey,
                                          &GetAddInfoCallback,
                                          &data);
+  } else if (SimpleValue::Write(aCx, aValue,
+                                aCloneWriteInfo.mSimpleValueData)) {
+    // Plain records skip the structured clone algorithm entirely. This can't
+    // be done for autoIncrement key paths since the parent needs the offset
+    // of the key property inside the structured clone data.
+    aCloneWriteInfo.mOffsetToKeyProp = 0;
+    rv = NS_OK;
   } else {
     rv = GetAddInfoCallback(aCx, &data);
   }
@@ -1322,17 +1349,21 @@ IDBObjectStore::AddOrPut(JSContext* aCx,
   }
 
   FallibleTArray<uint8_t> cloneData;
-  if (NS_WARN_IF(!cloneData.SetLength(cloneWriteInfo.mCloneBuffer.nbytes(),
-                                      fallible))) {
-    aRv = NS_ERROR_OUT_OF_MEMORY;
-    return nullptr;
-  }
+  if (!cloneWriteInfo.mSimpleValueData.IsEmpty()) {
+    cloneData.SwapElements(cloneWriteInfo.mSimpleValueData);
+  } else {
+    if (NS_WARN_IF(!cloneData.SetLength(cloneWriteInfo.mCloneBuffer.nbytes(),
+                                        fallible))) {
+      aRv = NS_ERROR_OUT_OF_MEMORY;
+      return nullptr;
+    }
 
-  // XXX Remove this
-  memcpy(cloneData.Elements(), cloneWriteInfo.mCloneBuffer.data(),
-         cloneWriteInfo.mCloneBuffer.nbytes());
+    // XXX Remove this
+    memcpy(cloneData.Elements(), cloneWriteInfo.mCloneBuffer.data(),
+           cloneWriteInfo.mCloneBuffer.nbytes());
 
-  cloneWriteInfo.mCloneBuffer.clear();
+    cloneWriteInfo.mCloneBuffer.clear();
+  }
 
   ObjectStoreAddPutParams commonParams;
   commonParams.objectStoreId() = Id();
@@ -35,6 +35,35 @@ using namespace mozilla::dom::indexedDB;
 using namespace mozilla::dom::workers;
 using namespace mozilla::ipc;
 
+namespace {
+
+bool
+IsWriteRequest(const RequestParams& aParams)
+{
+  switch (aParams.type()) {
+    case RequestParams::TObjectStoreAddParams:
+    case RequestParams::TObjectStorePutParams:
+    case RequestParams::TObjectStoreDeleteParams:
+    case RequestParams::TObjectStoreClearParams:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+void
+InvalidateCachedCursorResponses(
+                  const ManagedContainer<PBackgroundIDBCursorChild>& aCursors)
+{
+  for (auto iter = aCursors.ConstIter(); !iter.Done(); iter.Next()) {
+    auto* actor = static_cast<BackgroundCursorChild*>(iter.Get()->GetKey());
+    actor->InvalidateCachedResponses();
+  }
+}
+
+} // namespace
+
 class IDBTransaction::WorkerHolder final
   : public mozilla::dom::workers::WorkerHolder
 {
@@ -293,6 +322,11 @@ IDBTransaction::StartRequest(IDBRequest* aRequest, const RequestParams& aParams)
   MOZ_ASSERT(aRequest);
   MOZ_ASSERT(aParams.type() != RequestParams::T__None);
 
+  // Cursors may have prefetched records that this request is about to change.
+  if (IsWriteRequest(aParams)) {
+    InvalidateCursorCaches();
+  }
+
   BackgroundRequestChild* actor = new BackgroundRequestChild(aRequest);
 
   if (mMode == VERSION_CHANGE) {
@@ -355,6 +389,26 @@ IDBTransaction::RefreshSpec(bool aMayDelete)
   }
 }
 
+void
+IDBTransaction::InvalidateCursorCaches()
+{
+  AssertIsOnOwningThread();
+
+  if (mMode == VERSION_CHANGE) {
+    MOZ_ASSERT(mBackgroundActor.mVersionChangeBackgroundActor);
+
+    InvalidateCachedCursorResponses(
+      mBackgroundActor.mVersionChangeBackgroundActor->
+        ManagedPBackgroundIDBCursorChild());
+  } else {
+    MOZ_ASSERT(mBackgroundActor.mNormalBackgroundActor);
+
+    InvalidateCachedCursorResponses(
+      mBackgroundActor.mNormalBackgroundActor->
+        ManagedPBackgroundIDBCursorChild());
+  }
+}
+
 void
 IDBTransaction::OnNewRequest()
 {
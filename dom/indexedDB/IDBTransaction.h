@@ -336,6 +336,9 @@ private:
 
   void
   OnRequestFinished(bool aActorDestroyedNormally);
+
+  void
+  InvalidateCursorCaches();
 };
 
 } // namespace dom
@@ -138,6 +138,9 @@ const uint32_t kDeleteTimeoutMs = 1000;
 const char kTestingPref[] = IDB_PREF_BRANCH_ROOT "testing";
 const char kPrefExperimental[] = IDB_PREF_BRANCH_ROOT "experimental";
 const char kPrefFileHandle[] = "dom.fileHandle.enabled";
+const char kPrefCursorPrefetchMax[] = IDB_PREF_BRANCH_ROOT "cursorPrefetch.max";
+
+const uint32_t kDefaultMaxCursorPrefetch = 256;
 
 #define IDB_PREF_LOGGING_BRANCH_ROOT IDB_PREF_BRANCH_ROOT "logging."
 
@@ -266,6 +269,8 @@ IndexedDatabaseManager::~IndexedDatabaseManager()
 bool IndexedDatabaseManager::sIsMainProcess = false;
 bool IndexedDatabaseManager::sFullSynchronousMode = false;
 
+uint32_t IndexedDatabaseManager::sMaxCursorPrefetch = 0;
+
 mozilla::LazyLogModule IndexedDatabaseManager::sLoggingModule("IndexedDB");
 
 Atomic<IndexedDatabaseManager::LoggingMode>
@@ -372,6 +377,12 @@ IndexedDatabaseManager::Init()
   // hit.
   sFullSynchronousMode = Preferences::GetBool("dom.indexedDB.fullSynchronous");
 
+  // Cursors that are iterated without being modified have the parent send
+  // additional records along with each response, doubling the number sent
+  // every time the child runs out, up to this limit. Zero disables prefetch.
+  sMaxCursorPrefetch =
+    Preferences::GetUint(kPrefCursorPrefetchMax, kDefaultMaxCursorPrefetch);
+
   Preferences::RegisterCallback(LoggingModePrefChangedCallback,
                                 kPrefLoggingDetails);
 #ifdef MOZ_ENABLE_PROFILER_SPS
@@ -690,6 +701,17 @@ IndexedDatabaseManager::FullSynchronous()
   return sFullSynchronousMode;
 }
 
+// static
+uint32_t
+IndexedDatabaseManager::MaxCursorPrefetch()
+{
+  MOZ_ASSERT(gDBManager,
+             "MaxCursorPrefetch() called before indexedDB has been "
+             "initialized!");
+
+  return sMaxCursorPrefetch;
+}
+
 // static
 bool
 IndexedDatabaseManager::ExperimentalFeaturesEnabled()
@@ -102,6 +102,9 @@ public:
   static bool
   FullSynchronous();
 
+  static uint32_t
+  MaxCursorPrefetch();
+
   static LoggingMode
   GetLoggingMode()
 #ifdef DEBUG
@@ -240,6 +243,7 @@ private:
 
   static bool sIsMainProcess;
   static bool sFullSynchronousMode;
+  static uint32_t sMaxCursorPrefetch;
   static LazyLogModule sLoggingModule;
   static Atomic<LoggingMode> sLoggingMode;
   static mozilla::Atomic<bool> sLowDiskSpaceMode;
@@ -14,6 +14,7 @@
 #include "jsfriendapi.h"
 #include "mozilla/EndianUtils.h"
 #include "mozilla/FloatingPoint.h"
+#include "mozilla/unused.h"
 #include "mozIStorageStatement.h"
 #include "mozIStorageValueArray.h"
 #include "nsAlgorithm.h"
@@ -104,8 +105,42 @@ namespace indexedDB {
  [[]]          // 0x80
 */
 #ifdef ENABLE_INTL_API
+Key::LocaleConverter::~LocaleConverter()
+{
+  if (mCollator) {
+    ucol_close(mCollator);
+  }
+}
+
+UCollator*
+Key::LocaleConverter::GetCollator()
+{
+  if (!mCollator) {
+    UErrorCode uerror = U_ZERO_ERROR;
+    mCollator = ucol_open(mLocale.get(), &uerror);
+    if (NS_WARN_IF(U_FAILURE(uerror))) {
+      mCollator = nullptr;
+    }
+  }
+
+  return mCollator;
+}
+
+nsresult
+Key::LocaleConverter::Convert(const Key& aKey, Key& aTarget)
+{
+  return aKey.ToLocaleBasedKeyInternal(aTarget, *this);
+}
+
 nsresult
 Key::ToLocaleBasedKey(Key& aTarget, const nsCString& aLocale) const
+{
+  LocaleConverter converter(aLocale);
+  return ToLocaleBasedKeyInternal(aTarget, converter);
+}
+
+nsresult
+Key::ToLocaleBasedKeyInternal(Key& aTarget, LocaleConverter& aConverter) const
 {
   if (IsUnset()) {
     aTarget.Unset();
@@ -191,7 +226,7 @@ Key::ToLocaleBasedKey(Key& aTarget, const nsCString& aLocale) const
 
       nsDependentString str;
       DecodeString(it, end, str);
-      aTarget.EncodeLocaleString(str, typeOffset, aLocale);
+      aTarget.EncodeLocaleString(str, typeOffset, aConverter);
     }
   }
   aTarget.TrimBuffer();
@@ -211,12 +246,25 @@ Key::EncodeJSValInternal(JSContext* aCx, JS::Handle<JS::Value> aVal,
   }
 
   if (aVal.isString()) {
-    nsAutoJSString str;
-    if (!str.init(aCx, aVal)) {
+    // Encode straight from the string's chars instead of copying them into an
+    // nsString first. Latin-1 strings don't need to be inflated at all.
+    JSFlatString* flat = JS_FlattenString(aCx, aVal.toString());
+    if (!flat) {
       IDB_REPORT_INTERNAL_ERR();
       return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
     }
-    EncodeString(str, aTypeOffset);
+
+    JSString* str = JS_FORGET_STRING_FLATNESS(flat);
+    const size_t length = JS_GetStringLength(str);
+
+    JS::AutoCheckCannotGC nogc;
+    if (JS_StringHasLatin1Chars(str)) {
+      const JS::Latin1Char* chars = JS_GetLatin1FlatStringChars(nogc, flat);
+      EncodeString(chars, chars + length, aTypeOffset);
+    } else {
+      const char16_t* chars = JS_GetTwoByteFlatStringChars(nogc, flat);
+      EncodeString(chars, chars + length, aTypeOffset);
+    }
     return NS_OK;
   }
 
@@ -383,6 +431,90 @@ Key::DecodeJSValInternal(const unsigned char*& aPos, const unsigned char* aEnd,
 #define TWO_BYTE_ADJUST (-0x7F)
 #define THREE_BYTE_SHIFT 6
 
+namespace {
+
+// Most keys are ASCII, so runs of single byte characters are scanned a word
+// at a time before falling back to the per-character loops.
+typedef uint64_t ScanWord;
+
+template <typename T>
+struct CharScanMasks;
+
+template <>
+struct CharScanMasks<uint8_t>
+{
+  static const ScanWord kHigh = UINT64_C(0x8080808080808080);
+  static const ScanWord kOnes = UINT64_C(0x0101010101010101);
+};
+
+template <>
+struct CharScanMasks<char16_t>
+{
+  static const ScanWord kHigh = UINT64_C(0xFF80FF80FF80FF80);
+  static const ScanWord kOnes = UINT64_C(0x0001000100010001);
+};
+
+// Returns the number of leading characters of [aStart, aEnd) that are at most
+// ONE_BYTE_LIMIT and are thus encoded as a single byte.
+template <typename T>
+size_t
+OneByteCharRunLength(const T* aStart, const T* aEnd)
+{
+  static_assert(ONE_BYTE_LIMIT == 0x7E, "Masks need to be updated");
+
+  typedef CharScanMasks<T> Masks;
+  const size_t charsPerWord = sizeof(ScanWord) / sizeof(T);
+
+  const T* iter = aStart;
+  while (size_t(aEnd - iter) >= charsPerWord) {
+    ScanWord word;
+    memcpy(&word, iter, sizeof(word));
+
+    // Every lane is below 0x80 if no high bit is set. Adding one to such lanes
+    // can't carry across them and only sets a high bit for 0x7F.
+    if ((word | (word + Masks::kOnes)) & Masks::kHigh) {
+      break;
+    }
+
+    iter += charsPerWord;
+  }
+
+  while (iter < aEnd && *iter <= ONE_BYTE_LIMIT) {
+    ++iter;
+  }
+
+  return iter - aStart;
+}
+
+// Returns the number of leading bytes of an encoded string that each decode to
+// a single character, stopping at the terminator.
+size_t
+OneByteEncodedRunLength(const unsigned char* aStart, const unsigned char* aEnd)
+{
+  typedef CharScanMasks<uint8_t> Masks;
+
+  const unsigned char* iter = aStart;
+  while (size_t(aEnd - iter) >= sizeof(ScanWord)) {
+    ScanWord word;
+    memcpy(&word, iter, sizeof(word));
+
+    // Stop at bytes with the high bit set and at zero bytes.
+    if ((word | ((word - Masks::kOnes) & ~word)) & Masks::kHigh) {
+      break;
+    }
+
+    iter += sizeof(ScanWord);
+  }
+
+  while (iter < aEnd && *iter && !(*iter & 0x80)) {
+    ++iter;
+  }
+
+  return iter - aStart;
+}
+
+} // namespace
+
 nsresult
 Key::EncodeJSVal(JSContext* aCx,
                  JS::Handle<JS::Value> aVal,
@@ -412,9 +544,11 @@ Key::EncodeString(const T* aStart, const T* aEnd, uint8_t aTypeOffset)
   const T* start = aStart;
   const T* end = aEnd;
   for (const T* iter = start; iter < end; ++iter) {
-    if (*iter > ONE_BYTE_LIMIT) {
-      size += char16_t(*iter) > TWO_BYTE_LIMIT ? 2 : 1;
+    iter += OneByteCharRunLength(iter, end);
+    if (iter == end) {
+      break;
     }
+    size += char16_t(*iter) > TWO_BYTE_LIMIT ? 2 : 1;
   }
 
   // Allocate memory for the new size
@@ -430,6 +564,14 @@ Key::EncodeString(const T* aStart, const T* aEnd, uint8_t aTypeOffset)
 
   // Encode string
   for (const T* iter = start; iter < end; ++iter) {
+    const T* runEnd = iter + OneByteCharRunLength(iter, end);
+    for (; iter < runEnd; ++iter) {
+      *(buffer++) = *iter + ONE_BYTE_ADJUST;
+    }
+    if (iter == end) {
+      break;
+    }
+
     if (*iter <= ONE_BYTE_LIMIT) {
       *(buffer++) = *iter + ONE_BYTE_ADJUST;
     }
@@ -455,7 +597,7 @@ Key::EncodeString(const T* aStart, const T* aEnd, uint8_t aTypeOffset)
 #ifdef ENABLE_INTL_API
 nsresult
 Key::EncodeLocaleString(const nsDependentString& aString, uint8_t aTypeOffset,
-                        const nsCString& aLocale)
+                        LocaleConverter& aConverter)
 {
   const int length = aString.Length();
   if (length == 0) {
@@ -463,12 +605,10 @@ Key::EncodeLocaleString(const nsDependentString& aString, uint8_t aTypeOffset,
   }
   const UChar* ustr = reinterpret_cast<const UChar*>(aString.BeginReading());
 
-  UErrorCode uerror = U_ZERO_ERROR;
-  UCollator* collator = ucol_open(aLocale.get(), &uerror);
-  if (NS_WARN_IF(U_FAILURE(uerror))) {
+  UCollator* collator = aConverter.GetCollator();
+  if (NS_WARN_IF(!collator)) {
     return NS_ERROR_FAILURE;
   }
-  MOZ_ASSERT(collator);
 
   AutoTArray<uint8_t, 128> keyBuffer;
   int32_t sortKeyLength = ucol_getSortKey(collator, ustr, length,
@@ -481,7 +621,6 @@ Key::EncodeLocaleString(const nsDependentString& aString, uint8_t aTypeOffset,
                                     sortKeyLength);
   }
 
-  ucol_close(collator);
   if (NS_WARN_IF(sortKeyLength == 0)) {
     return NS_ERROR_FAILURE;
   }
@@ -514,11 +653,17 @@ Key::DecodeString(const unsigned char*& aPos, const unsigned char* aEnd,
 
   // First measure how big the decoded string will be.
   uint32_t size = 0;
-  const unsigned char* iter; 
-  for (iter = buffer; iter < aEnd && *iter != eTerminator; ++iter) {
-    if (*iter & 0x80) {
-      iter += (*iter & 0x40) ? 2 : 1;
+  const unsigned char* iter = buffer;
+  while (iter < aEnd) {
+    const size_t run = OneByteEncodedRunLength(iter, aEnd);
+    iter += run;
+    size += run;
+
+    if (iter == aEnd || *iter == eTerminator) {
+      break;
     }
+
+    iter += (*iter & 0x40) ? 3 : 2;
     ++size;
   }
   
@@ -534,6 +679,14 @@ Key::DecodeString(const unsigned char*& aPos, const unsigned char* aEnd,
   }
 
   for (iter = buffer; iter < aEnd;) {
+    const unsigned char* runEnd = iter + OneByteEncodedRunLength(iter, aEnd);
+    for (; iter < runEnd; ++iter) {
+      *(out++) = char16_t(*iter - ONE_BYTE_ADJUST);
+    }
+    if (iter == aEnd) {
+      break;
+    }
+
     if (!(*iter & 0x80)) {
       *out = *(iter++) - ONE_BYTE_ADJUST;
     }
@@ -668,6 +821,41 @@ Key::SetFromJSVal(JSContext* aCx,
   return NS_OK;
 }
 
+// static
+nsresult
+Key::AppendKeysFromArray(JSContext* aCx,
+                         JS::Handle<JSObject*> aArray,
+                         nsTArray<Key>& aKeys)
+{
+  MOZ_ASSERT(aCx);
+  MOZ_ASSERT(aArray);
+
+  uint32_t length;
+  if (NS_WARN_IF(!JS_GetArrayLength(aCx, aArray, &length))) {
+    IDB_REPORT_INTERNAL_ERR();
+    return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
+  }
+
+  // Only a hint, the array may be sparse.
+  Unused << aKeys.SetCapacity(aKeys.Length() + length, fallible);
+
+  JS::Rooted<JS::Value> item(aCx);
+  for (uint32_t index = 0; index < length; index++) {
+    if (NS_WARN_IF(!JS_GetElement(aCx, aArray, index, &item))) {
+      IDB_REPORT_INTERNAL_ERR();
+      return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
+    }
+
+    Key* key = aKeys.AppendElement();
+    if (NS_FAILED(key->SetFromJSVal(aCx, item)) || key->IsUnset()) {
+      // Not a value we can do anything with, ignore it.
+      aKeys.RemoveElementAt(aKeys.Length() - 1);
+    }
+  }
+
+  return NS_OK;
+}
+
 nsresult
 Key::ToJSVal(JSContext* aCx,
              JS::MutableHandle<JS::Value> aVal) const
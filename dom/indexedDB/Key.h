@@ -8,11 +8,17 @@
 #define mozilla_dom_indexeddb_key_h__
 
 #include "js/RootingAPI.h"
+#include "mozilla/FloatingPoint.h"
 #include "nsString.h"
+#include "nsTArrayForwardDeclare.h"
 
 class mozIStorageStatement;
 class mozIStorageValueArray;
 
+#ifdef ENABLE_INTL_API
+struct UCollator;
+#endif
+
 namespace IPC {
 
 template <typename> struct ParamTraits;
@@ -195,6 +201,16 @@ public:
     TrimBuffer();
   }
 
+  void
+  SetFromFloat(double aFloat)
+  {
+    MOZ_ASSERT(!mozilla::IsNaN(aFloat));
+
+    mBuffer.Truncate();
+    EncodeNumber(aFloat, eFloat);
+    TrimBuffer();
+  }
+
   nsresult
   SetFromJSVal(JSContext* aCx, JS::Handle<JS::Value> aVal);
 
@@ -207,7 +223,36 @@ public:
   nsresult
   AppendItem(JSContext* aCx, bool aFirstOfArray, JS::Handle<JS::Value> aVal);
 
+  // Appends a key for every item of aArray that is a valid key, skipping the
+  // rest. Used to index arrays for multiEntry indexes.
+  static nsresult
+  AppendKeysFromArray(JSContext* aCx,
+                      JS::Handle<JSObject*> aArray,
+                      nsTArray<Key>& aKeys);
+
 #ifdef ENABLE_INTL_API
+  // Converts keys for a single locale. The collator is opened on first use
+  // and shared by all the keys converted afterwards.
+  class MOZ_STACK_CLASS LocaleConverter final
+  {
+    const nsCString& mLocale;
+    UCollator* mCollator;
+
+  public:
+    explicit LocaleConverter(const nsCString& aLocale)
+      : mLocale(aLocale)
+      , mCollator(nullptr)
+    { }
+
+    ~LocaleConverter();
+
+    nsresult
+    Convert(const Key& aKey, Key& aTarget);
+
+    UCollator*
+    GetCollator();
+  };
+
   nsresult
   ToLocaleBasedKey(Key& aTarget, const nsCString& aLocale) const;
 #endif
@@ -290,7 +335,10 @@ private:
 #ifdef ENABLE_INTL_API
   nsresult
   EncodeLocaleString(const nsDependentString& aString, uint8_t aTypeOffset,
-                     const nsCString& aLocale);
+                     LocaleConverter& aConverter);
+
+  nsresult
+  ToLocaleBasedKeyInternal(Key& aTarget, LocaleConverter& aConverter) const;
 #endif
 
   void
@@ -0,0 +1,1092 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "SimpleValue.h"
+
+#include "Key.h"
+#include "KeyPath.h"
+#include "js/Class.h"
+#include "js/Proxy.h"
+#include "jsapi.h"
+#include "jsfriendapi.h"
+#include "mozilla/Casting.h"
+#include "mozilla/EndianUtils.h"
+#include "mozilla/FloatingPoint.h"
+#include "mozilla/dom/indexedDB/PBackgroundIDBSharedTypes.h"
+#include "nsCharSeparatedTokenizer.h"
+#include "nsString.h"
+#include "nsTArray.h"
+
+namespace mozilla {
+namespace dom {
+namespace indexedDB {
+
+namespace {
+
+// Stored where structured clone data keeps the tag of its first value. Doubles
+// never have a high word above 0xFFF00000 and builtin and user tags start at
+// 0xFFFF0000, so this can't be mistaken for a structured clone buffer.
+const uint32_t kSimpleValueTag = 0xFFF15356;
+
+// The payload length followed by kSimpleValueTag.
+const size_t kHeaderLength = 2 * sizeof(uint32_t);
+
+const uint32_t kMaxRecursionDepth = 64;
+
+// Shared or cyclic references have to be preserved, which is left to
+// structured clone. Objects are tracked with a linear search so larger values
+// aren't considered simple.
+const uint32_t kMaxObjectCount = 256;
+
+enum ValueType : uint8_t
+{
+  eUndefined = 0,
+  eNull,
+  eFalse,
+  eTrue,
+  eInt32,
+  eDouble,
+  eLatin1String,
+  eTwoByteString,
+  // Arrays and objects store the byte length of their contents followed by
+  // their element or property count.
+  eArray,
+  eObject
+};
+
+class MOZ_STACK_CLASS ValueWriter final
+{
+  JSContext* mCx;
+  FallibleTArray<uint8_t>& mData;
+  JS::AutoObjectVector mObjects;
+
+public:
+  ValueWriter(JSContext* aCx, FallibleTArray<uint8_t>& aData)
+    : mCx(aCx)
+    , mData(aData)
+    , mObjects(aCx)
+  { }
+
+  bool
+  WriteValue(JS::Handle<JS::Value> aValue, uint32_t aDepth);
+
+private:
+  bool
+  WriteType(ValueType aType)
+  {
+    return !!mData.AppendElement(uint8_t(aType), fallible);
+  }
+
+  bool
+  WriteUint32(uint32_t aValue)
+  {
+    uint8_t* bytes = mData.AppendElements(sizeof(aValue), fallible);
+    if (!bytes) {
+      return false;
+    }
+
+    LittleEndian::writeUint32(bytes, aValue);
+    return true;
+  }
+
+  bool
+  WriteDouble(double aValue)
+  {
+    uint8_t* bytes = mData.AppendElements(sizeof(aValue), fallible);
+    if (!bytes) {
+      return false;
+    }
+
+    LittleEndian::writeUint64(bytes, BitwiseCast<uint64_t>(aValue));
+    return true;
+  }
+
+  bool
+  WriteString(JSString* aString);
+
+  bool
+  WriteArray(JS::Handle<JSObject*> aObject, uint32_t aDepth);
+
+  bool
+  WriteObject(JS::Handle<JSObject*> aObject, uint32_t aDepth);
+
+  bool
+  BeginContainer(ValueType aType, size_t aCount, size_t* aSizeOffset);
+
+  bool
+  EndContainer(size_t aSizeOffset);
+
+  bool
+  NoteObject(JSObject* aObject);
+
+  bool
+  GetDataProperty(JS::Handle<JSObject*> aObject,
+                  JS::Handle<jsid> aId,
+                  JS::MutableHandle<JS::Value> aValue);
+};
+
+class ValueReader final
+{
+  const uint8_t* mCurrent;
+  const uint8_t* mEnd;
+
+public:
+  ValueReader()
+    : mCurrent(nullptr)
+    , mEnd(nullptr)
+  { }
+
+  ValueReader(const uint8_t* aData, size_t aDataLength)
+    : mCurrent(aData)
+    , mEnd(aData + aDataLength)
+  { }
+
+  size_t
+  Remaining() const
+  {
+    return size_t(mEnd - mCurrent);
+  }
+
+  bool
+  ReadBytes(size_t aLength, const uint8_t** aBytes)
+  {
+    if (aLength > Remaining()) {
+      return false;
+    }
+
+    *aBytes = mCurrent;
+    mCurrent += aLength;
+    return true;
+  }
+
+  bool
+  ReadType(ValueType* aType)
+  {
+    const uint8_t* bytes;
+    if (!ReadBytes(1, &bytes) || *bytes > eObject) {
+      return false;
+    }
+
+    *aType = ValueType(*bytes);
+    return true;
+  }
+
+  bool
+  ReadUint32(uint32_t* aValue)
+  {
+    const uint8_t* bytes;
+    if (!ReadBytes(sizeof(*aValue), &bytes)) {
+      return false;
+    }
+
+    *aValue = LittleEndian::readUint32(bytes);
+    return true;
+  }
+
+  bool
+  ReadDouble(double* aValue)
+  {
+    const uint8_t* bytes;
+    if (!ReadBytes(sizeof(*aValue), &bytes)) {
+      return false;
+    }
+
+    *aValue = BitwiseCast<double>(LittleEndian::readUint64(bytes));
+    return true;
+  }
+
+  // Reads the characters of a string whose type has already been read.
+  bool
+  ReadStringChars(ValueType aType, uint32_t* aLength, const uint8_t** aChars)
+  {
+    MOZ_ASSERT(aType == eLatin1String || aType == eTwoByteString);
+
+    if (!ReadUint32(aLength)) {
+      return false;
+    }
+
+    const size_t charSize =
+      aType == eLatin1String ? sizeof(JS::Latin1Char) : sizeof(char16_t);
+
+    if (*aLength > Remaining() / charSize) {
+      return false;
+    }
+
+    return ReadBytes(*aLength * charSize, aChars);
+  }
+
+  bool
+  ReadString(ValueType aType, nsAString& aString);
+
+  // Reads the header of an array or object whose type has already been read
+  // and checks that its contents are in bounds.
+  bool
+  ReadContainer(uint32_t* aCount)
+  {
+    uint32_t size;
+    if (!ReadUint32(&size) || size > Remaining() || !ReadUint32(aCount)) {
+      return false;
+    }
+
+    // Every element or property takes at least one byte.
+    return *aCount <= Remaining();
+  }
+
+  bool
+  SkipValue();
+
+  // Looks up an own property of an object whose type has already been read.
+  // On success the reader is left at the property's value.
+  bool
+  FindProperty(const nsAString& aName, bool* aFound);
+};
+
+bool
+ValueWriter::WriteValue(JS::Handle<JS::Value> aValue, uint32_t aDepth)
+{
+  if (aValue.isUndefined()) {
+    return WriteType(eUndefined);
+  }
+
+  if (aValue.isNull()) {
+    return WriteType(eNull);
+  }
+
+  if (aValue.isBoolean()) {
+    return WriteType(aValue.toBoolean() ? eTrue : eFalse);
+  }
+
+  if (aValue.isInt32()) {
+    return WriteType(eInt32) && WriteUint32(uint32_t(aValue.toInt32()));
+  }
+
+  if (aValue.isDouble()) {
+    return WriteType(eDouble) && WriteDouble(aValue.toDouble());
+  }
+
+  if (aValue.isString()) {
+    return WriteString(aValue.toString());
+  }
+
+  if (!aValue.isObject() || aDepth >= kMaxRecursionDepth) {
+    return false;
+  }
+
+  JS::Rooted<JSObject*> obj(mCx, &aValue.toObject());
+
+  // Proxies (including cross-compartment wrappers) may run script.
+  if (js::IsProxy(obj) || !NoteObject(obj)) {
+    return false;
+  }
+
+  js::ESClass cls;
+  if (!js::GetBuiltinClass(mCx, obj, &cls)) {
+    return false;
+  }
+
+  if (cls == js::ESClass::Array) {
+    return WriteArray(obj, aDepth + 1);
+  }
+
+  if (cls == js::ESClass::Object) {
+    return WriteObject(obj, aDepth + 1);
+  }
+
+  return false;
+}
+
+bool
+ValueWriter::WriteString(JSString* aString)
+{
+  MOZ_ASSERT(aString);
+
+  const size_t length = JS_GetStringLength(aString);
+  if (length > UINT32_MAX) {
+    return false;
+  }
+
+  JSFlatString* flat = JS_FlattenString(mCx, aString);
+  if (!flat) {
+    return false;
+  }
+
+  JS::AutoCheckCannotGC nogc;
+
+  if (JS_StringHasLatin1Chars(JS_FORGET_STRING_FLATNESS(flat))) {
+    const JS::Latin1Char* chars = JS_GetLatin1FlatStringChars(nogc, flat);
+    if (!WriteType(eLatin1String) || !WriteUint32(uint32_t(length))) {
+      return false;
+    }
+
+    return !!mData.AppendElements(chars, length, fallible);
+  }
+
+  const char16_t* chars = JS_GetTwoByteFlatStringChars(nogc, flat);
+  if (!WriteType(eTwoByteString) || !WriteUint32(uint32_t(length))) {
+    return false;
+  }
+
+  uint8_t* bytes = mData.AppendElements(length * sizeof(char16_t), fallible);
+  if (!bytes) {
+    return false;
+  }
+
+  NativeEndian::copyAndSwapToLittleEndian(bytes, chars, length);
+  return true;
+}
+
+bool
+ValueWriter::WriteArray(JS::Handle<JSObject*> aObject, uint32_t aDepth)
+{
+  uint32_t length;
+  if (!JS_GetArrayLength(mCx, aObject, &length)) {
+    return false;
+  }
+
+  JS::Rooted<JS::IdVector> ids(mCx, JS::IdVector(mCx));
+  if (!JS_Enumerate(mCx, aObject, &ids)) {
+    return false;
+  }
+
+  // Holes and named properties are only preserved by structured clone.
+  if (ids.length() != length) {
+    return false;
+  }
+
+  size_t sizeOffset;
+  if (!BeginContainer(eArray, length, &sizeOffset)) {
+    return false;
+  }
+
+  JS::Rooted<jsid> id(mCx);
+  JS::Rooted<JS::Value> value(mCx);
+
+  for (uint32_t index = 0; index < length; index++) {
+    id = ids[index];
+
+    if (!JSID_IS_INT(id) || uint32_t(JSID_TO_INT(id)) != index) {
+      return false;
+    }
+
+    if (!GetDataProperty(aObject, id, &value) ||
+        !WriteValue(value, aDepth)) {
+      return false;
+    }
+  }
+
+  return EndContainer(sizeOffset);
+}
+
+bool
+ValueWriter::WriteObject(JS::Handle<JSObject*> aObject, uint32_t aDepth)
+{
+  JS::Rooted<JS::IdVector> ids(mCx, JS::IdVector(mCx));
+  if (!JS_Enumerate(mCx, aObject, &ids)) {
+    return false;
+  }
+
+  size_t sizeOffset;
+  if (!BeginContainer(eObject, ids.length(), &sizeOffset)) {
+    return false;
+  }
+
+  JS::Rooted<jsid> id(mCx);
+  JS::Rooted<JS::Value> idValue(mCx);
+  JS::Rooted<JSString*> name(mCx);
+  JS::Rooted<JS::Value> value(mCx);
+
+  for (size_t index = 0, count = ids.length(); index < count; index++) {
+    id = ids[index];
+
+    if (JSID_IS_STRING(id)) {
+      name = JSID_TO_STRING(id);
+    } else if (JSID_IS_INT(id)) {
+      if (!JS_IdToValue(mCx, id, &idValue)) {
+        return false;
+      }
+
+      name = JS::ToString(mCx, idValue);
+      if (!name) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    if (!WriteString(name) ||
+        !GetDataProperty(aObject, id, &value) ||
+        !WriteValue(value, aDepth)) {
+      return false;
+    }
+  }
+
+  return EndContainer(sizeOffset);
+}
+
+bool
+ValueWriter::BeginContainer(ValueType aType,
+                            size_t aCount,
+                            size_t* aSizeOffset)
+{
+  MOZ_ASSERT(aType == eArray || aType == eObject);
+  MOZ_ASSERT(aSizeOffset);
+
+  if (aCount > UINT32_MAX || !WriteType(aType)) {
+    return false;
+  }
+
+  *aSizeOffset = mData.Length();
+
+  // The size is filled in by EndContainer().
+  return WriteUint32(0) && WriteUint32(uint32_t(aCount));
+}
+
+bool
+ValueWriter::EndContainer(size_t aSizeOffset)
+{
+  MOZ_ASSERT(aSizeOffset + sizeof(uint32_t) <= mData.Length());
+
+  const size_t size = mData.Length() - aSizeOffset - sizeof(uint32_t);
+  if (size > UINT32_MAX) {
+    return false;
+  }
+
+  LittleEndian::writeUint32(mData.Elements() + aSizeOffset, uint32_t(size));
+  return true;
+}
+
+bool
+ValueWriter::NoteObject(JSObject* aObject)
+{
+  if (mObjects.length() >= kMaxObjectCount) {
+    return false;
+  }
+
+  for (size_t index = 0, count = mObjects.length(); index < count; index++) {
+    if (mObjects[index] == aObject) {
+      return false;
+    }
+  }
+
+  return mObjects.append(aObject);
+}
+
+bool
+ValueWriter::GetDataProperty(JS::Handle<JSObject*> aObject,
+                             JS::Handle<jsid> aId,
+                             JS::MutableHandle<JS::Value> aValue)
+{
+  JS::Rooted<JS::PropertyDescriptor> desc(mCx);
+  if (!JS_GetOwnPropertyDescriptorById(mCx, aObject, aId, &desc)) {
+    return false;
+  }
+
+  // Calling getters here would be observable if structured clone ends up
+  // being used after all.
+  if (!desc.object() || desc.hasGetterOrSetter()) {
+    return false;
+  }
+
+  aValue.set(desc.value());
+  return true;
+}
+
+bool
+ValueReader::ReadString(ValueType aType, nsAString& aString)
+{
+  uint32_t length;
+  const uint8_t* chars;
+  if (!ReadStringChars(aType, &length, &chars)) {
+    return false;
+  }
+
+  if (aType == eLatin1String) {
+    AppendASCIItoUTF16(
+      Substring(reinterpret_cast<const char*>(chars), length), aString);
+    return true;
+  }
+
+  const size_t offset = aString.Length();
+  if (!aString.SetLength(offset + length, fallible)) {
+    return false;
+  }
+
+  NativeEndian::copyAndSwapFromLittleEndian(aString.BeginWriting() + offset,
+                                            chars,
+                                            length);
+  return true;
+}
+
+bool
+ValueReader::SkipValue()
+{
+  ValueType type;
+  if (!ReadType(&type)) {
+    return false;
+  }
+
+  const uint8_t* bytes;
+
+  switch (type) {
+    case eUndefined:
+    case eNull:
+    case eFalse:
+    case eTrue:
+      return true;
+
+    case eInt32:
+      return ReadBytes(sizeof(uint32_t), &bytes);
+
+    case eDouble:
+      return ReadBytes(sizeof(double), &bytes);
+
+    case eLatin1String:
+    case eTwoByteString: {
+      uint32_t length;
+      return ReadStringChars(type, &length, &bytes);
+    }
+
+    case eArray:
+    case eObject: {
+      uint32_t size;
+      return ReadUint32(&size) && ReadBytes(size, &bytes);
+    }
+
+    default:
+      MOZ_CRASH("Should never get here!");
+  }
+}
+
+bool
+ValueReader::FindProperty(const nsAString& aName, bool* aFound)
+{
+  MOZ_ASSERT(aFound);
+
+  uint32_t count;
+  if (!ReadContainer(&count)) {
+    return false;
+  }
+
+  for (uint32_t index = 0; index < count; index++) {
+    ValueType type;
+    if (!ReadType(&type) ||
+        (type != eLatin1String && type != eTwoByteString)) {
+      return false;
+    }
+
+    uint32_t length;
+    const uint8_t* chars;
+    if (!ReadStringChars(type, &length, &chars)) {
+      return false;
+    }
+
+    bool equal = length == aName.Length();
+
+    for (uint32_t charIndex = 0; equal && charIndex < length; charIndex++) {
+      const char16_t ch =
+        type == eLatin1String ?
+        char16_t(chars[charIndex]) :
+        char16_t(LittleEndian::readUint16(chars + charIndex * 2));
+      equal = ch == aName[charIndex];
+    }
+
+    if (equal) {
+      *aFound = true;
+      return true;
+    }
+
+    if (!SkipValue()) {
+      return false;
+    }
+  }
+
+  *aFound = false;
+  return true;
+}
+
+bool
+ReadJSString(JSContext* aCx,
+             ValueReader& aReader,
+             ValueType aType,
+             JS::MutableHandle<JSString*> aString)
+{
+  uint32_t length;
+  const uint8_t* chars;
+  if (!aReader.ReadStringChars(aType, &length, &chars)) {
+    return false;
+  }
+
+  if (aType == eLatin1String) {
+    aString.set(
+      JS_NewStringCopyN(aCx, reinterpret_cast<const char*>(chars), length));
+    return !!aString;
+  }
+
+  nsAutoString buffer;
+  if (!buffer.SetLength(length, fallible)) {
+    return false;
+  }
+
+  NativeEndian::copyAndSwapFromLittleEndian(buffer.BeginWriting(),
+                                            chars,
+                                            length);
+
+  aString.set(JS_NewUCStringCopyN(aCx, buffer.get(), length));
+  return !!aString;
+}
+
+bool
+ReadJSValue(JSContext* aCx,
+            ValueReader& aReader,
+            uint32_t aDepth,
+            JS::MutableHandle<JS::Value> aValue)
+{
+  ValueType type;
+  if (!aReader.ReadType(&type)) {
+    return false;
+  }
+
+  switch (type) {
+    case eUndefined:
+      aValue.setUndefined();
+      return true;
+
+    case eNull:
+      aValue.setNull();
+      return true;
+
+    case eFalse:
+    case eTrue:
+      aValue.setBoolean(type == eTrue);
+      return true;
+
+    case eInt32: {
+      uint32_t value;
+      if (!aReader.ReadUint32(&value)) {
+        return false;
+      }
+
+      aValue.setInt32(int32_t(value));
+      return true;
+    }
+
+    case eDouble: {
+      double value;
+      if (!aReader.ReadDouble(&value)) {
+        return false;
+      }
+
+      aValue.setDouble(JS::CanonicalizeNaN(value));
+      return true;
+    }
+
+    case eLatin1String:
+    case eTwoByteString: {
+      JS::Rooted<JSString*> string(aCx);
+      if (!ReadJSString(aCx, aReader, type, &string)) {
+        return false;
+      }
+
+      aValue.setString(string);
+      return true;
+    }
+
+    case eArray:
+    case eObject:
+      break;
+
+    default:
+      MOZ_CRASH("Should never get here!");
+  }
+
+  uint32_t count;
+  if (aDepth >= kMaxRecursionDepth || !aReader.ReadContainer(&count)) {
+    return false;
+  }
+
+  JS::Rooted<JS::Value> value(aCx);
+
+  if (type == eArray) {
+    JS::Rooted<JSObject*> array(aCx, JS_NewArrayObject(aCx, count));
+    if (!array) {
+      return false;
+    }
+
+    for (uint32_t index = 0; index < count; index++) {
+      if (!ReadJSValue(aCx, aReader, aDepth + 1, &value) ||
+          !JS_DefineElement(aCx, array, index, value, JSPROP_ENUMERATE)) {
+        return false;
+      }
+    }
+
+    aValue.setObject(*array);
+    return true;
+  }
+
+  JS::Rooted<JSObject*> obj(aCx, JS_NewPlainObject(aCx));
+  if (!obj) {
+    return false;
+  }
+
+  JS::Rooted<JSString*> name(aCx);
+  JS::Rooted<jsid> id(aCx);
+
+  for (uint32_t index = 0; index < count; index++) {
+    ValueType nameType;
+    if (!aReader.ReadType(&nameType) ||
+        (nameType != eLatin1String && nameType != eTwoByteString) ||
+        !ReadJSString(aCx, aReader, nameType, &name) ||
+        !JS_StringToId(aCx, name, &id) ||
+        !ReadJSValue(aCx, aReader, aDepth + 1, &value) ||
+        !JS_DefinePropertyById(aCx, obj, id, value, JSPROP_ENUMERATE)) {
+      return false;
+    }
+  }
+
+  aValue.setObject(*obj);
+  return true;
+}
+
+enum class KeyPathResult
+{
+  NotFound,
+  Value,
+  Length,
+  NeedsDeserialization
+};
+
+// Follows the steps of GetJSValFromKeyPathString() in KeyPath.cpp. Only own
+// properties are stored, so a missing property is only known to produce no key
+// if it's the last step; anything found on the prototype chain is a function
+// or an object, neither of which are valid keys.
+KeyPathResult
+EvaluateKeyPathString(const ValueReader& aValue,
+                      const nsAString& aKeyPathString,
+                      ValueReader* aResult,
+                      uint32_t* aLength)
+{
+  ValueReader current = aValue;
+
+  // Valid key paths never contain whitespace.
+  nsCharSeparatedTokenizer tokenizer(aKeyPathString, '.');
+
+  while (tokenizer.hasMoreTokens()) {
+    const nsDependentSubstring& token = tokenizer.nextToken();
+    const bool lastToken = !tokenizer.hasMoreTokens();
+
+    ValueType type;
+    if (!current.ReadType(&type)) {
+      return KeyPathResult::NeedsDeserialization;
+    }
+
+    switch (type) {
+      case eLatin1String:
+      case eTwoByteString:
+        if (lastToken && token.EqualsLiteral("length")) {
+          return current.ReadUint32(aLength) ?
+                 KeyPathResult::Length :
+                 KeyPathResult::NeedsDeserialization;
+        }
+        return KeyPathResult::NotFound;
+
+      case eArray:
+        if (token.EqualsLiteral("length")) {
+          if (!current.ReadContainer(aLength)) {
+            return KeyPathResult::NeedsDeserialization;
+          }
+
+          // A number has no further properties.
+          return lastToken ? KeyPathResult::Length : KeyPathResult::NotFound;
+        }
+        return lastToken ?
+               KeyPathResult::NotFound :
+               KeyPathResult::NeedsDeserialization;
+
+      case eObject: {
+        bool found;
+        if (!current.FindProperty(token, &found)) {
+          return KeyPathResult::NeedsDeserialization;
+        }
+
+        if (!found) {
+          return lastToken ?
+                 KeyPathResult::NotFound :
+                 KeyPathResult::NeedsDeserialization;
+        }
+
+        // Explicitly undefined values are treated as missing.
+        ValueReader value = current;
+        ValueType valueType;
+        if (!value.ReadType(&valueType)) {
+          return KeyPathResult::NeedsDeserialization;
+        }
+
+        if (valueType == eUndefined) {
+          return KeyPathResult::NotFound;
+        }
+
+        break;
+      }
+
+      default:
+        return KeyPathResult::NotFound;
+    }
+  }
+
+  *aResult = current;
+  return KeyPathResult::Value;
+}
+
+// Converts the value at aReader to a key, leaving aKey unset for values that
+// aren't valid keys. Array keys are left to Key::SetFromJSVal().
+nsresult
+GetKey(ValueReader aReader, Key& aKey)
+{
+  ValueType type;
+  if (!aReader.ReadType(&type)) {
+    return NS_ERROR_FILE_CORRUPTED;
+  }
+
+  switch (type) {
+    case eInt32: {
+      uint32_t value;
+      if (!aReader.ReadUint32(&value)) {
+        return NS_ERROR_FILE_CORRUPTED;
+      }
+
+      aKey.SetFromFloat(double(int32_t(value)));
+      return NS_OK;
+    }
+
+    case eDouble: {
+      double value;
+      if (!aReader.ReadDouble(&value)) {
+        return NS_ERROR_FILE_CORRUPTED;
+      }
+
+      if (!IsNaN(value)) {
+        aKey.SetFromFloat(value);
+      }
+      return NS_OK;
+    }
+
+    case eLatin1String:
+    case eTwoByteString: {
+      nsAutoString string;
+      if (!aReader.ReadString(type, string)) {
+        return NS_ERROR_FILE_CORRUPTED;
+      }
+
+      aKey.SetFromString(string);
+      return NS_OK;
+    }
+
+    case eArray:
+      return NS_ERROR_NOT_AVAILABLE;
+
+    default:
+      return NS_OK;
+  }
+}
+
+nsresult
+AppendUpdateInfo(int64_t aIndexID,
+                 const Key& aKey,
+                 const nsCString& aLocale,
+                 nsTArray<IndexUpdateInfo>& aUpdateInfoArray)
+{
+  MOZ_ASSERT(!aKey.IsUnset());
+
+  IndexUpdateInfo* updateInfo = aUpdateInfoArray.AppendElement();
+  updateInfo->indexId() = aIndexID;
+  updateInfo->value() = aKey;
+
+#ifdef ENABLE_INTL_API
+  if (!aLocale.IsEmpty()) {
+    nsresult rv = aKey.ToLocaleBasedKey(updateInfo->localizedValue(), aLocale);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return NS_ERROR_DOM_INDEXEDDB_UNKNOWN_ERR;
+    }
+  }
+#endif
+
+  return NS_OK;
+}
+
+} // namespace
+
+// static
+bool
+SimpleValue::IsSimpleValue(const uint8_t* aData, size_t aDataLength)
+{
+  if (aDataLength <= kHeaderLength) {
+    return false;
+  }
+
+  MOZ_ASSERT(aData);
+
+  return LittleEndian::readUint32(aData + sizeof(uint32_t)) ==
+           kSimpleValueTag &&
+         LittleEndian::readUint32(aData) <= aDataLength - kHeaderLength;
+}
+
+// static
+bool
+SimpleValue::Write(JSContext* aCx,
+                   JS::Handle<JS::Value> aValue,
+                   FallibleTArray<uint8_t>& aData)
+{
+  MOZ_ASSERT(aCx);
+  MOZ_ASSERT(aData.IsEmpty());
+
+  if (!aData.SetLength(kHeaderLength, fallible)) {
+    return false;
+  }
+
+  ValueWriter writer(aCx, aData);
+
+  if (!writer.WriteValue(aValue, 0) ||
+      aData.Length() - kHeaderLength > UINT32_MAX) {
+    // Only allocation failures can leave an exception here. Structured clone
+    // will report those again if they persist.
+    if (JS_IsExceptionPending(aCx)) {
+      JS_ClearPendingException(aCx);
+    }
+
+    aData.Clear();
+    return false;
+  }
+
+  LittleEndian::writeUint32(aData.Elements(),
+                            uint32_t(aData.Length() - kHeaderLength));
+  LittleEndian::writeUint32(aData.Elements() + sizeof(uint32_t),
+                            kSimpleValueTag);
+
+  // Keep the 8-byte granularity of structured clone data.
+  const size_t padding = (8 - aData.Length() % 8) % 8;
+  uint8_t* bytes = aData.AppendElements(padding, fallible);
+  if (!bytes) {
+    aData.Clear();
+    return false;
+  }
+
+  memset(bytes, 0, padding);
+  return true;
+}
+
+// static
+bool
+SimpleValue::Read(JSContext* aCx,
+                  const uint8_t* aData,
+                  size_t aDataLength,
+                  JS::MutableHandle<JS::Value> aValue)
+{
+  MOZ_ASSERT(aCx);
+  MOZ_ASSERT(IsSimpleValue(aData, aDataLength));
+
+  ValueReader reader(aData + kHeaderLength, LittleEndian::readUint32(aData));
+
+  return ReadJSValue(aCx, reader, 0, aValue) && !reader.Remaining();
+}
+
+// static
+nsresult
+SimpleValue::AppendIndexUpdateInfo(int64_t aIndexID,
+                                   const KeyPath& aKeyPath,
+                                   bool aMultiEntry,
+                                   const nsCString& aLocale,
+                                   const uint8_t* aData,
+                                   size_t aDataLength,
+                                   nsTArray<IndexUpdateInfo>& aUpdateInfoArray)
+{
+  MOZ_ASSERT(IsSimpleValue(aData, aDataLength));
+
+  // Array key paths produce array keys.
+  if (!aKeyPath.IsString()) {
+    return NS_ERROR_NOT_AVAILABLE;
+  }
+
+  const ValueReader value(aData + kHeaderLength,
+                          LittleEndian::readUint32(aData));
+
+  ValueReader result;
+  uint32_t length;
+
+  switch (EvaluateKeyPathString(value, aKeyPath.mStrings[0], &result,
+                                &length)) {
+    case KeyPathResult::NotFound:
+      return NS_OK;
+
+    case KeyPathResult::NeedsDeserialization:
+      return NS_ERROR_NOT_AVAILABLE;
+
+    case KeyPathResult::Length: {
+      Key key;
+      key.SetFromFloat(double(length));
+      return AppendUpdateInfo(aIndexID, key, aLocale, aUpdateInfoArray);
+    }
+
+    case KeyPathResult::Value:
+      break;
+
+    default:
+      MOZ_CRASH("Should never get here!");
+  }
+
+  nsresult rv;
+
+  if (aMultiEntry) {
+    ValueReader array = result;
+    ValueType type;
+    if (!array.ReadType(&type)) {
+      return NS_ERROR_FILE_CORRUPTED;
+    }
+
+    if (type == eArray) {
+      uint32_t count;
+      if (!array.ReadContainer(&count)) {
+        return NS_ERROR_FILE_CORRUPTED;
+      }
+
+      for (uint32_t index = 0; index < count; index++) {
+        Key key;
+        rv = GetKey(array, key);
+        if (NS_FAILED(rv)) {
+          return rv;
+        }
+
+        if (!key.IsUnset()) {
+          rv = AppendUpdateInfo(aIndexID, key, aLocale, aUpdateInfoArray);
+          if (NS_WARN_IF(NS_FAILED(rv))) {
+            return rv;
+          }
+        }
+
+        if (!array.SkipValue()) {
+          return NS_ERROR_FILE_CORRUPTED;
+        }
+      }
+
+      return NS_OK;
+    }
+  }
+
+  Key key;
+  rv = GetKey(result, key);
+  if (NS_FAILED(rv)) {
+    return rv;
+  }
+
+  if (key.IsUnset()) {
+    return NS_OK;
+  }
+
+  return AppendUpdateInfo(aIndexID, key, aLocale, aUpdateInfoArray);
+}
+
+} // namespace indexedDB
+} // namespace dom
+} // namespace mozilla
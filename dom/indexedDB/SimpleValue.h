@@ -0,0 +1,68 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_dom_indexeddb_simplevalue_h__
+#define mozilla_dom_indexeddb_simplevalue_h__
+
+#include "js/TypeDecls.h"
+#include "nsStringFwd.h"
+#include "nsTArrayForwardDeclare.h"
+
+namespace mozilla {
+namespace dom {
+namespace indexedDB {
+
+class IndexUpdateInfo;
+class KeyPath;
+
+// A compact serialization used instead of structured clone for values that
+// only contain primitives, plain objects and dense arrays, i.e. the JSON-like
+// records most sites store. Containers record their encoded size so that key
+// paths can be evaluated on the serialized bytes without a JSContext.
+//
+// The data starts with an 8-byte header whose tag can never begin a
+// structured clone buffer, so both formats can share the same storage.
+class SimpleValue final
+{
+public:
+  static bool
+  IsSimpleValue(const uint8_t* aData, size_t aDataLength);
+
+  // Serializes aValue into aData. Returns false without running any script if
+  // aValue needs the full structured clone algorithm, in which case aData is
+  // left empty.
+  static bool
+  Write(JSContext* aCx,
+        JS::Handle<JS::Value> aValue,
+        FallibleTArray<uint8_t>& aData);
+
+  static bool
+  Read(JSContext* aCx,
+       const uint8_t* aData,
+       size_t aDataLength,
+       JS::MutableHandle<JS::Value> aValue);
+
+  // Like IDBObjectStore::AppendIndexUpdateInfo but works on serialized data.
+  // Returns NS_ERROR_NOT_AVAILABLE if the key path or the value it leads to
+  // can only be handled by deserializing the value.
+  static nsresult
+  AppendIndexUpdateInfo(int64_t aIndexID,
+                        const KeyPath& aKeyPath,
+                        bool aMultiEntry,
+                        const nsCString& aLocale,
+                        const uint8_t* aData,
+                        size_t aDataLength,
+                        nsTArray<IndexUpdateInfo>& aUpdateInfoArray);
+
+private:
+  SimpleValue() = delete;
+};
+
+} // namespace indexedDB
+} // namespace dom
+} // namespace mozilla
+
+#endif // mozilla_dom_indexeddb_simplevalue_h__
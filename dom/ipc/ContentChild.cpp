@@ -96,6 +96,7 @@
 #include "nsVariant.h"
 #include "nsXULAppAPI.h"
 #include "nsIScriptError.h"
+#include "private/pprio.h"
 #include "nsIConsoleService.h"
 #include "nsJSEnvironment.h"
 #include "SandboxHal.h"
@@ -571,6 +572,7 @@ ContentChild::ContentChild()
  : mID(uint64_t(-1))
  , mCanOverrideProcessName(true)
  , mIsAlive(true)
+ , mNextAnonymousTemporaryFileID(0)
 {
   // This process is a content process, so it's clearly running in
   // multiprocess mode!
@@ -3493,5 +3495,42 @@ ContentChild::RecvGetFilesResponse(const nsID& aUUID,
   return true;
 }
 
+void
+ContentChild::AsyncOpenAnonymousTemporaryFile(const AnonymousTemporaryFileCallback& aCallback)
+{
+  MOZ_ASSERT(NS_IsMainThread());
+
+  uint64_t id = mNextAnonymousTemporaryFileID++;
+  if (!SendRequestAnonymousTemporaryFile(id)) {
+    aCallback(nullptr);
+    return;
+  }
+
+  mPendingAnonymousTemporaryFiles.Put(id,
+                                      new AnonymousTemporaryFileCallback(aCallback));
+}
+
+bool
+ContentChild::RecvProvideAnonymousTemporaryFile(const uint64_t& aID,
+                                                const FileDescOrError& aFD)
+{
+  nsAutoPtr<AnonymousTemporaryFileCallback> callback;
+  mPendingAnonymousTemporaryFiles.RemoveAndForget(aID, callback);
+  if (NS_WARN_IF(!callback)) {
+    return true;
+  }
+
+  PRFileDesc* prfd = nullptr;
+  if (aFD.type() == FileDescOrError::TFileDescriptor) {
+    auto rawFD = aFD.get_FileDescriptor().ClonePlatformHandle();
+    prfd = PR_ImportFile(PROsfd(rawFD.release()));
+  } else {
+    NS_WARNING("Failed to open an anonymous temporary file");
+  }
+
+  (*callback)(prfd);
+  return true;
+}
+
 } // namespace dom
 } // namespace mozilla
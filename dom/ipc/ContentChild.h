@@ -8,11 +8,13 @@
 #define mozilla_dom_ContentChild_h
 
 #include "mozilla/Attributes.h"
+#include "mozilla/Function.h"
 #include "mozilla/dom/ContentBridgeParent.h"
 #include "mozilla/dom/nsIContentChild.h"
 #include "mozilla/dom/PBrowserOrId.h"
 #include "mozilla/dom/PContentChild.h"
 #include "nsAutoPtr.h"
+#include "nsClassHashtable.h"
 #include "nsHashKeys.h"
 #include "nsIObserver.h"
 #include "nsTHashtable.h"
@@ -20,6 +22,7 @@
 
 #include "nsWeakPtr.h"
 #include "nsIWindowProvider.h"
+#include "prio.h"
 
 
 struct ChromePackage;
@@ -637,6 +640,18 @@ public:
   RecvGetFilesResponse(const nsID& aUUID,
                        const GetFilesResponseResult& aResult) override;
 
+  typedef mozilla::function<void(PRFileDesc*)> AnonymousTemporaryFileCallback;
+
+  // Like NS_OpenAnonymousTemporaryFile, but doesn't block on the parent
+  // process. aCallback is called later on the main thread with the new file,
+  // or with null if it couldn't be opened.
+  void
+  AsyncOpenAnonymousTemporaryFile(const AnonymousTemporaryFileCallback& aCallback);
+
+  virtual bool
+  RecvProvideAnonymousTemporaryFile(const uint64_t& aID,
+                                    const FileDescOrError& aFD) override;
+
   virtual bool
   RecvBlobURLRegistration(const nsCString& aURI, PBlobChild* aBlobChild,
                           const IPC::Principal& aPrincipal) override;
@@ -686,6 +701,11 @@ private:
   // received.
  nsRefPtrHashtable<nsIDHashKey, GetFilesHelperChild> mGetFilesPendingRequests;
 
+  // Callbacks waiting for RecvProvideAnonymousTemporaryFile, by request ID.
+  nsClassHashtable<nsUint64HashKey, AnonymousTemporaryFileCallback>
+    mPendingAnonymousTemporaryFiles;
+  uint64_t mNextAnonymousTemporaryFileID;
+
   DISALLOW_EVIL_CONSTRUCTORS(ContentChild);
 };
 
@@ -4948,6 +4948,18 @@ ContentParent::RecvOpenAnonymousTemporaryFile(FileDescOrError *aFD)
   return true;
 }
 
+bool
+ContentParent::RecvRequestAnonymousTemporaryFile(const uint64_t& aID)
+{
+  FileDescOrError result;
+  if (!RecvOpenAnonymousTemporaryFile(&result)) {
+    return false;
+  }
+
+  Unused << SendProvideAnonymousTemporaryFile(aID, result);
+  return true;
+}
+
 static NS_DEFINE_CID(kFormProcessorCID, NS_FORMPROCESSOR_CID);
 
 bool
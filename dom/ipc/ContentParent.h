@@ -1119,6 +1119,9 @@ private:
   virtual bool
   RecvOpenAnonymousTemporaryFile(FileDescOrError* aFD) override;
 
+  virtual bool
+  RecvRequestAnonymousTemporaryFile(const uint64_t& aID) override;
+
   virtual bool
   RecvKeygenProcessValue(const nsString& oldValue, const nsString& challenge,
                          const nsString& keytype, const nsString& keyparams,
@@ -8,6 +8,7 @@
 
 #include "mozIStorageConnection.h"
 #include "mozIStorageService.h"
+#include "mozIStorageStatement.h"
 #include "nsIBinaryInputStream.h"
 #include "nsIBinaryOutputStream.h"
 #include "nsIFile.h"
@@ -126,7 +127,7 @@ const uint32_t kSQLitePageSizeOverride = 512;
 const uint32_t kMajorStorageVersion = 1;
 
 // Minor storage version. Bump for backwards-compatible changes.
-const uint32_t kMinorStorageVersion = 0;
+const uint32_t kMinorStorageVersion = 1;
 
 // The storage version we store in the SQLite database is a (signed) 32-bit
 // integer. The major version is left-shifted 16 bits so the max value is
@@ -182,14 +183,12 @@ enum AppId {
  * SQLite functions
  ******************************************************************************/
 
-#if 0
 int32_t
 MakeStorageVersion(uint32_t aMajorStorageVersion,
                    uint32_t aMinorStorageVersion)
 {
   return int32_t((aMajorStorageVersion << 16) + aMinorStorageVersion);
 }
-#endif
 
 uint32_t
 GetMajorStorageVersion(int32_t aStorageVersion)
@@ -197,6 +196,169 @@ GetMajorStorageVersion(int32_t aStorageVersion)
   return uint32_t(aStorageVersion >> 16);
 }
 
+// The usage index keeps the usage of every temporary and default storage
+// origin as of the last clean shutdown or reset, along with the access time the
+// origin had then, so that initializing temporary storage doesn't have to ask
+// every client to scan its files. Origins with Cache API data are always
+// scanned, see InitializeOrigin.
+nsresult
+CreateUsageIndexTable(mozIStorageConnection* aConnection)
+{
+  MOZ_ASSERT(aConnection);
+
+  nsresult rv = aConnection->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "CREATE TABLE usage_index ("
+      "repository_id INTEGER NOT NULL, "
+      "origin TEXT NOT NULL, "
+      "access_time INTEGER NOT NULL, "
+      "usage INTEGER NOT NULL, "
+      "PRIMARY KEY (repository_id, origin)"
+    ");"
+  ));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  return NS_OK;
+}
+
+nsresult
+OpenStorageConnection(const nsAString& aBasePath,
+                      mozIStorageConnection** aConnection)
+{
+  nsresult rv;
+
+  nsCOMPtr<nsIFile> storageFile =
+    do_CreateInstance(NS_LOCAL_FILE_CONTRACTID, &rv);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = storageFile->InitWithPath(aBasePath);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = storageFile->Append(NS_LITERAL_STRING(STORAGE_FILE_NAME));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  nsCOMPtr<mozIStorageService> ss =
+    do_GetService(MOZ_STORAGE_SERVICE_CONTRACTID, &rv);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  nsCOMPtr<mozIStorageConnection> connection;
+  rv = ss->OpenUnsharedDatabase(storageFile, getter_AddRefs(connection));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  connection.forget(aConnection);
+  return NS_OK;
+}
+
+struct IndexedUsage
+{
+  int64_t mAccessTime;
+  uint64_t mUsage;
+};
+
+typedef nsDataHashtable<nsCStringHashKey, IndexedUsage> UsageIndex;
+
+struct UsageIndexRow
+{
+  PersistenceType mPersistenceType;
+  nsCString mOrigin;
+  int64_t mAccessTime;
+  uint64_t mUsage;
+};
+
+// Reads the indexed usage of the origins in one repository and removes it
+// from the index, so that it can't be trusted again unless the next shutdown
+// is clean.
+nsresult
+TakeUsageIndex(const nsAString& aBasePath,
+               PersistenceType aPersistenceType,
+               UsageIndex& aUsageIndex)
+{
+  nsCOMPtr<mozIStorageConnection> connection;
+  nsresult rv = OpenStorageConnection(aBasePath, getter_AddRefs(connection));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  mozStorageTransaction transaction(connection, false,
+                                  mozIStorageConnection::TRANSACTION_IMMEDIATE);
+
+  nsCOMPtr<mozIStorageStatement> stmt;
+  rv = connection->CreateStatement(NS_LITERAL_CSTRING(
+    "SELECT origin, access_time, usage "
+    "FROM usage_index "
+    "WHERE repository_id = :repository_id;"
+  ), getter_AddRefs(stmt));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = stmt->BindInt32ByName(NS_LITERAL_CSTRING("repository_id"),
+                             aPersistenceType);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  bool hasResult;
+  while (NS_SUCCEEDED((rv = stmt->ExecuteStep(&hasResult))) && hasResult) {
+    nsCString origin;
+    rv = stmt->GetUTF8String(0, origin);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    IndexedUsage indexedUsage;
+    indexedUsage.mAccessTime = stmt->AsInt64(1);
+
+    int64_t usage = stmt->AsInt64(2);
+    if (NS_WARN_IF(usage < 0)) {
+      continue;
+    }
+    indexedUsage.mUsage = uint64_t(usage);
+
+    aUsageIndex.Put(origin, indexedUsage);
+  }
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = connection->CreateStatement(NS_LITERAL_CSTRING(
+    "DELETE FROM usage_index "
+    "WHERE repository_id = :repository_id;"
+  ), getter_AddRefs(stmt));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = stmt->BindInt32ByName(NS_LITERAL_CSTRING("repository_id"),
+                             aPersistenceType);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = stmt->Execute();
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = transaction.Commit();
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  return NS_OK;
+}
+
 /******************************************************************************
  * Quota manager class declarations
  ******************************************************************************/
@@ -3196,10 +3358,11 @@ QuotaManager::Shutdown()
   // QuotaManager on the IO thread. This should probably use
   // NewNonOwningRunnableMethod ...
   RefPtr<Runnable> runnable =
-    NewRunnableMethod(this, &QuotaManager::ReleaseIOThreadObjects);
+    NewRunnableMethod(this, &QuotaManager::ShutdownOnIOThread);
   MOZ_ASSERT(runnable);
 
-  // Give clients a chance to cleanup IO thread only objects.
+  // Save the usage index and give clients a chance to cleanup IO thread only
+  // objects.
   if (NS_FAILED(mIOThread->Dispatch(runnable, NS_DISPATCH_NORMAL))) {
     NS_WARNING("Failed to dispatch runnable!");
   }
@@ -3214,6 +3377,122 @@ QuotaManager::Shutdown()
   }
 }
 
+void
+QuotaManager::ShutdownOnIOThread()
+{
+  AssertIsOnIOThread();
+
+  // All clients have finished their work by now, so the usage we track is
+  // final. If temporary storage was never initialized, the index from the
+  // previous session is still valid.
+  if (mTemporaryStorageInitialized) {
+    nsresult rv = SaveUsageIndex();
+    Unused << NS_WARN_IF(NS_FAILED(rv));
+  }
+
+  ReleaseIOThreadObjects();
+}
+
+nsresult
+QuotaManager::SaveUsageIndex()
+{
+  AssertIsOnIOThread();
+  MOZ_ASSERT(mTemporaryStorageInitialized);
+
+  nsTArray<UsageIndexRow> rows;
+
+  {
+    MutexAutoLock lock(mQuotaMutex);
+
+    for (auto iter = mGroupInfoPairs.Iter(); !iter.Done(); iter.Next()) {
+      GroupInfoPair* pair = iter.Data();
+      MOZ_ASSERT(pair);
+
+      for (const PersistenceType type : kAllPersistenceTypes) {
+        if (type == PERSISTENCE_TYPE_PERSISTENT) {
+          continue;
+        }
+
+        RefPtr<GroupInfo> groupInfo = pair->LockedGetGroupInfo(type);
+        if (!groupInfo) {
+          continue;
+        }
+
+        for (RefPtr<OriginInfo>& originInfo : groupInfo->mOriginInfos) {
+          UsageIndexRow* row = rows.AppendElement();
+          row->mPersistenceType = type;
+          row->mOrigin = originInfo->mOrigin;
+          row->mAccessTime = originInfo->mAccessTime;
+          row->mUsage = originInfo->mUsage;
+        }
+      }
+    }
+  }
+
+  nsCOMPtr<mozIStorageConnection> connection;
+  nsresult rv = OpenStorageConnection(mBasePath, getter_AddRefs(connection));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  mozStorageTransaction transaction(connection, false,
+                                  mozIStorageConnection::TRANSACTION_IMMEDIATE);
+
+  rv = connection->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "DELETE FROM usage_index;"
+  ));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  nsCOMPtr<mozIStorageStatement> stmt;
+  rv = connection->CreateStatement(NS_LITERAL_CSTRING(
+    "INSERT INTO usage_index (repository_id, origin, access_time, usage) "
+    "VALUES (:repository_id, :origin, :access_time, :usage);"
+  ), getter_AddRefs(stmt));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  for (const UsageIndexRow& row : rows) {
+    rv = stmt->BindInt32ByName(NS_LITERAL_CSTRING("repository_id"),
+                               row.mPersistenceType);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    rv = stmt->BindUTF8StringByName(NS_LITERAL_CSTRING("origin"),
+                                    row.mOrigin);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    rv = stmt->BindInt64ByName(NS_LITERAL_CSTRING("access_time"),
+                               row.mAccessTime);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    rv = stmt->BindInt64ByName(NS_LITERAL_CSTRING("usage"),
+                               int64_t(row.mUsage));
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+
+    rv = stmt->Execute();
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return rv;
+    }
+  }
+
+  rv = transaction.Commit();
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  return NS_OK;
+}
+
 void
 QuotaManager::InitQuotaForOrigin(PersistenceType aPersistenceType,
                                  const nsACString& aGroup,
@@ -3660,6 +3939,13 @@ QuotaManager::InitializeRepository(PersistenceType aPersistenceType)
     return rv;
   }
 
+  // The index only saves work, origins missing from it are simply scanned.
+  UsageIndex usageIndex;
+  rv = TakeUsageIndex(mBasePath, aPersistenceType, usageIndex);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    usageIndex.Clear();
+  }
+
   nsCOMPtr<nsISimpleEnumerator> entries;
   rv = directory->GetDirectoryEntries(getter_AddRefs(entries));
   if (NS_WARN_IF(NS_FAILED(rv))) {
@@ -3719,8 +4005,16 @@ QuotaManager::InitializeRepository(PersistenceType aPersistenceType)
       continue;
     }
 
+    // The access time is saved whenever an origin starts or stops being used,
+    // so an indexed usage with a different access time may be stale.
+    Nullable<uint64_t> indexedUsage;
+    IndexedUsage indexed;
+    if (usageIndex.Get(origin, &indexed) && indexed.mAccessTime == timestamp) {
+      indexedUsage.SetValue(indexed.mUsage);
+    }
+
     rv = InitializeOrigin(aPersistenceType, group, origin, isApp, timestamp,
-                          childDirectory);
+                          childDirectory, indexedUsage);
     if (NS_WARN_IF(NS_FAILED(rv))) {
       return rv;
     }
@@ -3769,7 +4063,8 @@ QuotaManager::InitializeOrigin(PersistenceType aPersistenceType,
                                const nsACString& aOrigin,
                                bool aIsApp,
                                int64_t aAccessTime,
-                               nsIFile* aDirectory)
+                               nsIFile* aDirectory,
+                               const Nullable<uint64_t>& aIndexedUsage)
 {
   AssertIsOnIOThread();
 
@@ -3777,10 +4072,29 @@ QuotaManager::InitializeOrigin(PersistenceType aPersistenceType,
 
   bool trackQuota = IsQuotaEnforced(aPersistenceType, aOrigin, aIsApp);
 
+  // The Cache API doesn't tell us when its usage goes down, so the usage saved
+  // in the index is inflated for origins that use it, and we recompute theirs.
+  bool useIndexedUsage = !aIndexedUsage.IsNull();
+  if (trackQuota && useIndexedUsage) {
+    nsCOMPtr<nsIFile> cacheDirectory;
+    rv = aDirectory->Clone(getter_AddRefs(cacheDirectory));
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    rv = cacheDirectory->Append(NS_LITERAL_STRING(DOMCACHE_DIRECTORY_NAME));
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    bool exists;
+    rv = cacheDirectory->Exists(&exists);
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    useIndexedUsage = !exists;
+  }
+
   // We need to initialize directories of all clients if they exists and also
-  // get the total usage to initialize the quota.
+  // get the total usage to initialize the quota. Clients don't compute usage
+  // that we already have from the usage index.
   nsAutoPtr<UsageInfo> usageInfo;
-  if (trackQuota) {
+  if (trackQuota && !useIndexedUsage) {
     usageInfo = new UsageInfo();
   }
 
@@ -3833,8 +4147,10 @@ QuotaManager::InitializeOrigin(PersistenceType aPersistenceType,
   }
 
   if (trackQuota) {
-    InitQuotaForOrigin(aPersistenceType, aGroup, aOrigin, aIsApp,
-                       usageInfo->TotalUsage(), aAccessTime);
+    uint64_t usage =
+      usageInfo ? usageInfo->TotalUsage() : aIndexedUsage.Value();
+    InitQuotaForOrigin(aPersistenceType, aGroup, aOrigin, aIsApp, usage,
+                       aAccessTime);
   }
 
   return NS_OK;
@@ -4137,6 +4453,11 @@ QuotaManager::UpgradeStorageFrom0ToCurrent(mozIStorageConnection* aConnection)
   }
 #endif
 
+  rv = CreateUsageIndexTable(aConnection);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
   rv = aConnection->SetSchemaVersion(kStorageVersion);
   if (NS_WARN_IF(NS_FAILED(rv))) {
     return rv;
@@ -4145,6 +4466,25 @@ QuotaManager::UpgradeStorageFrom0ToCurrent(mozIStorageConnection* aConnection)
   return NS_OK;
 }
 
+nsresult
+QuotaManager::UpgradeStorageFrom1_0To1_1(mozIStorageConnection* aConnection)
+{
+  AssertIsOnIOThread();
+  MOZ_ASSERT(aConnection);
+
+  nsresult rv = CreateUsageIndexTable(aConnection);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  rv = aConnection->SetSchemaVersion(MakeStorageVersion(1, 1));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+
+  return NS_OK;
+}
+
 #if 0
 nsresult
 QuotaManager::UpgradeStorageFrom1To2(mozIStorageConnection* aConnection)
@@ -4272,13 +4612,13 @@ QuotaManager::EnsureStorageIsInitialized()
       MOZ_ASSERT(storageVersion == kStorageVersion);
     } else {
       // This logic needs to change next time we change the storage!
-      static_assert(kStorageVersion == int32_t((1 << 16) + 0),
+      static_assert(kStorageVersion == int32_t((1 << 16) + 1),
                     "Upgrade function needed due to storage version increase.");
 
       while (storageVersion != kStorageVersion) {
-        /* if (storageVersion == MakeStorageVersion(1, 0)) {
-          rv = UpgradeStorageFrom1To2(connection);
-        } else */ {
+        if (storageVersion == MakeStorageVersion(1, 0)) {
+          rv = UpgradeStorageFrom1_0To1_1(connection);
+        } else {
           NS_WARNING("Unable to initialize storage, no upgrade path is "
                      "available!");
           return NS_ERROR_FAILURE;
@@ -6235,6 +6575,11 @@ ResetOrClearOp::DoDirectoryWork(QuotaManager* aQuotaManager)
 
   if (mClear) {
     DeleteFiles(aQuotaManager);
+  } else if (aQuotaManager->IsTemporaryStorageInitialized()) {
+    // A reset waits for all clients like shutdown does, so the usage we track
+    // is final and can be indexed for the next initialization.
+    nsresult rv = aQuotaManager->SaveUsageIndex();
+    Unused << NS_WARN_IF(NS_FAILED(rv));
   }
 
   aQuotaManager->RemoveQuota();
@@ -162,6 +162,9 @@ public:
                          const nsACString& aGroup,
                          const nsACString& aOrigin);
 
+  nsresult
+  SaveUsageIndex();
+
   void
   RemoveQuota();
 
@@ -404,6 +407,9 @@ private:
   void
   Shutdown();
 
+  void
+  ShutdownOnIOThread();
+
   already_AddRefed<DirectoryLockImpl>
   CreateDirectoryLock(Nullable<PersistenceType> aPersistenceType,
                       const nsACString& aGroup,
@@ -451,6 +457,9 @@ private:
   nsresult
   UpgradeStorageFrom0ToCurrent(mozIStorageConnection* aConnection);
 
+  nsresult
+  UpgradeStorageFrom1_0To1_1(mozIStorageConnection* aConnection);
+
 #if 0
   nsresult
   UpgradeStorageFrom1To2(mozIStorageConnection* aConnection);
@@ -465,7 +474,9 @@ private:
                    const nsACString& aOrigin,
                    bool aIsApp,
                    int64_t aAccessTime,
-                   nsIFile* aDirectory);
+                   nsIFile* aDirectory,
+                   const Nullable<uint64_t>& aIndexedUsage =
+                     Nullable<uint64_t>());
 
   void
   CheckTemporaryStorageLimits();
@@ -0,0 +1,266 @@
+/**
+ * Any copyright is dedicated to the Public Domain.
+ * http://creativecommons.org/publicdomain/zero/1.0/
+ */
+
+// Tests that the usage index saved in storage.sqlite when quota management is
+// reset is used for the next initialization of temporary storage, but only
+// while it can still be trusted.
+//
+// Origin usage is always computed from disk, while group usage is the usage
+// the quota manager tracks, which is where indexed usage ends up. The test
+// group only has one origin, so the two can be compared directly.
+
+var { classes: Cc, interfaces: Ci, results: Cr, utils: Cu } = Components;
+
+Cu.import("resource://gre/modules/Services.jsm");
+
+Cu.importGlobalProperties(["indexedDB"]);
+
+const kURL = "http://example.com";
+const kOriginDirectory = "http+++example.com";
+const kRepositoryId = 2; // PERSISTENCE_TYPE_DEFAULT
+const kStorageVersion_1_0 = 1 << 16;
+const kStorageVersion_1_1 = (1 << 16) + 1;
+const kBogusUsage = 1000000;
+
+function getQuotaManagerService()
+{
+  return Cc["@mozilla.org/dom/quota-manager-service;1"]
+           .getService(Ci.nsIQuotaManagerService);
+}
+
+function getPrincipal()
+{
+  let uri = Services.io.newURI(kURL, null, null);
+  return Services.scriptSecurityManager.createCodebasePrincipal(uri, {});
+}
+
+function requestFinished(aRequest)
+{
+  return new Promise(function(aResolve, aReject) {
+    aRequest.callback = function(aRequest) {
+      if (aRequest.resultCode == Cr.NS_OK) {
+        aResolve(aRequest);
+      } else {
+        aReject(aRequest.resultCode);
+      }
+    };
+  });
+}
+
+function reset()
+{
+  return requestFinished(getQuotaManagerService().reset());
+}
+
+function clear()
+{
+  return requestFinished(getQuotaManagerService().clear());
+}
+
+function* getUsage(aGroup)
+{
+  let request =
+    yield requestFinished(
+      getQuotaManagerService().getUsageForPrincipal(getPrincipal(), null,
+                                                    aGroup));
+  return request.usage;
+}
+
+function writeData()
+{
+  return new Promise(function(aResolve, aReject) {
+    let request = indexedDB.openForPrincipal(getPrincipal(), "usage_index");
+    request.onerror = aReject;
+    request.onupgradeneeded = function() {
+      let db = request.result;
+      let objectStore = db.createObjectStore("data");
+      let data = new Uint8Array(100000);
+      for (let i = 0; i < data.length; i++) {
+        data[i] = Math.floor(Math.random() * 256);
+      }
+      objectStore.put(data, 1);
+    };
+    request.onsuccess = function() {
+      request.result.close();
+      aResolve();
+    };
+  });
+}
+
+function openStorageConnection()
+{
+  let file = do_get_profile();
+  file.append("storage.sqlite");
+  return Services.storage.openUnsharedDatabase(file);
+}
+
+function getIndexedOrigin(aConnection)
+{
+  let stmt = aConnection.createStatement(
+    "SELECT access_time, usage " +
+    "FROM usage_index " +
+    "WHERE repository_id = :repository_id AND origin = :origin"
+  );
+  stmt.params.repository_id = kRepositoryId;
+  stmt.params.origin = kURL;
+
+  let row = null;
+  if (stmt.executeStep()) {
+    row = { accessTime: stmt.row.access_time, usage: stmt.row.usage };
+  }
+  stmt.finalize();
+
+  return row;
+}
+
+function updateIndexedOrigin(aConnection, aAccessTime, aUsage)
+{
+  let stmt = aConnection.createStatement(
+    "UPDATE usage_index " +
+    "SET access_time = :access_time, usage = :usage " +
+    "WHERE repository_id = :repository_id AND origin = :origin"
+  );
+  stmt.params.access_time = aAccessTime;
+  stmt.params.usage = aUsage;
+  stmt.params.repository_id = kRepositoryId;
+  stmt.params.origin = kURL;
+  stmt.execute();
+  stmt.finalize();
+}
+
+// Overwrites the access time at the start of the origin's metadata file the
+// way the quota manager does when an origin stops being used.
+function writeOriginAccessTime(aAccessTime)
+{
+  let file = do_get_profile();
+  file.append("storage");
+  file.append("default");
+  file.append(kOriginDirectory);
+  file.append(".metadata-v2");
+  do_check_true(file.exists());
+
+  let ostream = Cc["@mozilla.org/network/file-output-stream;1"]
+                  .createInstance(Ci.nsIFileOutputStream);
+  // PR_WRONLY, without PR_TRUNCATE so the rest of the file is kept.
+  ostream.init(file, 0x02, -1, 0);
+
+  let bstream = Cc["@mozilla.org/binaryoutputstream;1"]
+                  .createInstance(Ci.nsIBinaryOutputStream);
+  bstream.setOutputStream(ostream);
+  bstream.write64(aAccessTime);
+  bstream.close();
+}
+
+function* setupOrigin()
+{
+  yield clear();
+  yield writeData();
+
+  // Make the quota manager track the usage of the origin and save it.
+  let usage = yield* getUsage(true);
+  do_check_true(usage > 0);
+
+  yield reset();
+}
+
+function run_test()
+{
+  do_get_profile();
+
+  Services.prefs.setBoolPref("dom.quotaManager.testing", true);
+
+  run_next_test();
+}
+
+add_task(function* testCleanRestart() {
+  yield* setupOrigin();
+
+  let connection = openStorageConnection();
+  let indexed = getIndexedOrigin(connection);
+  connection.close();
+
+  do_check_neq(indexed, null);
+
+  let usage = yield* getUsage(false);
+  let trackedUsage = yield* getUsage(true);
+
+  do_check_eq(indexed.usage, usage);
+  do_check_eq(trackedUsage, usage);
+
+  // Initialization takes the rows, so that a crash before the next reset or
+  // shutdown makes the following initialization scan the origin again.
+  connection = openStorageConnection();
+  do_check_eq(getIndexedOrigin(connection), null);
+  connection.close();
+});
+
+add_task(function* testIndexedUsageIsUsed() {
+  yield* setupOrigin();
+
+  let connection = openStorageConnection();
+  let indexed = getIndexedOrigin(connection);
+  do_check_neq(indexed, null);
+  updateIndexedOrigin(connection, indexed.accessTime, kBogusUsage);
+  connection.close();
+
+  // The origin wasn't scanned, the index was trusted.
+  let trackedUsage = yield* getUsage(true);
+  do_check_eq(trackedUsage, kBogusUsage);
+});
+
+add_task(function* testChangedAccessTime() {
+  yield* setupOrigin();
+
+  let connection = openStorageConnection();
+  let indexed = getIndexedOrigin(connection);
+  do_check_neq(indexed, null);
+  updateIndexedOrigin(connection, indexed.accessTime, kBogusUsage);
+  connection.close();
+
+  // Something used the origin after the index was saved, e.g. an older build
+  // that doesn't know about the index.
+  writeOriginAccessTime(indexed.accessTime + 1);
+
+  let usage = yield* getUsage(false);
+  let trackedUsage = yield* getUsage(true);
+
+  do_check_neq(trackedUsage, kBogusUsage);
+  do_check_eq(trackedUsage, usage);
+});
+
+add_task(function* testUpgradeFrom1_0() {
+  yield* setupOrigin();
+
+  // Turn storage.sqlite back into what a 1.0 build would have left behind.
+  let connection = openStorageConnection();
+  connection.executeSimpleSQL("DROP TABLE usage_index");
+  connection.schemaVersion = kStorageVersion_1_0;
+  connection.close();
+
+  let usage = yield* getUsage(false);
+  let trackedUsage = yield* getUsage(true);
+
+  do_check_eq(trackedUsage, usage);
+
+  connection = openStorageConnection();
+  do_check_eq(connection.schemaVersion, kStorageVersion_1_1);
+  do_check_true(connection.tableExists("usage_index"));
+  do_check_eq(getIndexedOrigin(connection), null);
+  connection.close();
+
+  // The upgraded storage saves the index like any other.
+  yield reset();
+
+  connection = openStorageConnection();
+  let indexed = getIndexedOrigin(connection);
+  connection.close();
+
+  do_check_neq(indexed, null);
+  do_check_eq(indexed.usage, usage);
+});
+
+add_task(function* cleanup() {
+  yield clear();
+});
@@ -192,27 +192,18 @@ DOMStorageDBThread::SyncPreload(DOMStorageCacheBridge* aCache, bool aForceSync)
     return;
   }
 
-  // Bypass sync load when an update is pending in the queue to write, we would
-  // get incosistent data in the cache.  Also don't allow sync main-thread preload
-  // when DB open and init is still pending on the background thread.
+  // Don't allow sync main-thread preload when DB open and init is still pending
+  // on the background thread.  Updates pending in the queue to write don't
+  // prevent the sync load, the preload applies them on top of the data read
+  // from the database.
   if (mDBReady && mWALModeEnabled) {
-    bool pendingTasks;
-    {
-      MonitorAutoLock monitor(mThreadObserver->GetMonitor());
-      pendingTasks = mPendingTasks.IsOriginUpdatePending(aCache->OriginSuffix(), aCache->OriginNoSuffix()) ||
-                     mPendingTasks.IsOriginClearPending(aCache->OriginSuffix(), aCache->OriginNoSuffix());
-    }
-
-    if (!pendingTasks) {
-      // WAL is enabled, thus do the load synchronously on the main thread.
-      DBOperation preload(DBOperation::opPreload, aCache);
-      preload.PerformAndFinalize(this);
-      return;
-    }
+    // WAL is enabled, thus do the load synchronously on the main thread.
+    DBOperation preload(DBOperation::opPreload, aCache);
+    preload.PerformAndFinalize(this);
+    return;
   }
 
-  // Need to go asynchronously since WAL is not allowed or scheduled updates
-  // need to be flushed first.
+  // Need to go asynchronously since WAL is not allowed.
   // Schedule preload for this cache as the first operation.
   nsresult rv = InsertDBOp(new DBOperation(DBOperation::opPreloadUrgent, aCache));
 
@@ -269,14 +260,11 @@ DOMStorageDBThread::InsertDBOp(DOMStorageDBThread::DBOperation* aOperation)
   switch (aOperation->Type()) {
   case DBOperation::opPreload:
   case DBOperation::opPreloadUrgent:
-    if (mPendingTasks.IsOriginUpdatePending(aOperation->OriginSuffix(), aOperation->OriginNoSuffix())) {
-      // If there is a pending update operation for the scope first do the flush
-      // before we preload the cache.  This may happen in an extremely rare case
-      // when a child process throws away its cache before flush on the parent
-      // has finished.  If we would preloaded the cache as a priority operation 
-      // before the pending flush, we would have got an inconsistent cache content.
-      mFlushImmediately = true;
-    } else if (mPendingTasks.IsOriginClearPending(aOperation->OriginSuffix(), aOperation->OriginNoSuffix())) {
+    // A pending update operation for the scope doesn't need to be flushed
+    // before we preload the cache, the preload applies all pending operations
+    // of the scope on top of the data read from the database.
+    if (!mPendingTasks.IsOriginUpdatePending(aOperation->OriginSuffix(), aOperation->OriginNoSuffix()) &&
+        mPendingTasks.IsOriginClearPending(aOperation->OriginSuffix(), aOperation->OriginNoSuffix())) {
       // The scope is scheduled to be cleared, so just quickly load as empty.
       // We need to do this to prevent load of the DB data before the scope has
       // actually been cleared from the database.  Preloads are processed
@@ -895,6 +883,28 @@ DOMStorageDBThread::DBOperation::Perform(DOMStorageDBThread* aThread)
       break;
     }
 
+    // Take the operations not yet flushed to the database into account,
+    // they override what we read from it.
+    PendingOperations::OriginChanges changes;
+    {
+      MonitorAutoLock monitor(aThread->mThreadObserver->GetMonitor());
+      aThread->mPendingTasks.CollectOriginChanges(mCache->OriginSuffix(),
+                                                  mCache->OriginNoSuffix(),
+                                                  changes);
+    }
+
+    if (changes.mCleared) {
+      // Everything stored in the database is about to be deleted.
+      for (auto iter = changes.mItems.Iter(); !iter.Done(); iter.Next()) {
+        if (!iter.Data().IsVoid() && !mCache->LoadItem(iter.Key(), iter.Data())) {
+          break;
+        }
+      }
+
+      mCache->LoadDone(NS_OK);
+      break;
+    }
+
     StatementCache* statements;
     if (MOZ_UNLIKELY(NS_IsMainThread())) {
       statements = &aThread->mReaderStatements;
@@ -924,21 +934,34 @@ DOMStorageDBThread::DBOperation::Perform(DOMStorageDBThread* aThread)
                                static_cast<int32_t>(mCache->LoadedCount()));
     NS_ENSURE_SUCCESS(rv, rv);
 
+    bool loading = true;
     bool exists;
     while (NS_SUCCEEDED(rv = stmt->ExecuteStep(&exists)) && exists) {
       nsAutoString key;
       rv = stmt->GetString(0, key);
       NS_ENSURE_SUCCESS(rv, rv);
 
+      if (changes.mItems.Contains(key)) {
+        // Changed or removed by a pending operation.
+        continue;
+      }
+
       nsAutoString value;
       rv = stmt->GetString(1, value);
       NS_ENSURE_SUCCESS(rv, rv);
 
       if (!mCache->LoadItem(key, value)) {
+        loading = false;
         break;
       }
     }
 
+    for (auto iter = changes.mItems.Iter(); loading && !iter.Done(); iter.Next()) {
+      if (!iter.Data().IsVoid()) {
+        loading = mCache->LoadItem(iter.Key(), iter.Data());
+      }
+    }
+
     mCache->LoadDone(NS_OK);
     break;
   }
@@ -1479,5 +1502,52 @@ DOMStorageDBThread::PendingOperations::IsOriginUpdatePending(const nsACString& a
   return false;
 }
 
+// static
+void
+DOMStorageDBThread::PendingOperations::CollectOriginChange(DBOperation* aOperation,
+                                                           const nsACString& aOriginSuffix,
+                                                           const nsACString& aOriginNoSuffix,
+                                                           OriginChanges& aChanges)
+{
+  if (FindPendingClearForOrigin(aOriginSuffix, aOriginNoSuffix, aOperation)) {
+    aChanges.mCleared = true;
+    aChanges.mItems.Clear();
+    return;
+  }
+
+  if (!FindPendingUpdateForOrigin(aOriginSuffix, aOriginNoSuffix, aOperation)) {
+    return;
+  }
+
+  if (aOperation->Type() == DBOperation::opRemoveItem) {
+    aChanges.mItems.Put(aOperation->mKey, NullString());
+  } else {
+    aChanges.mItems.Put(aOperation->mKey, aOperation->mValue);
+  }
+}
+
+void
+DOMStorageDBThread::PendingOperations::CollectOriginChanges(const nsACString& aOriginSuffix,
+                                                            const nsACString& aOriginNoSuffix,
+                                                            OriginChanges& aChanges) const
+{
+  // Called under the lock
+
+  // The list being executed goes first, it has been prepared from operations
+  // scheduled before any of those still collected.  Clears are always executed
+  // before updates, see Prepare().
+  for (uint32_t i = 0; i < mExecList.Length(); ++i) {
+    CollectOriginChange(mExecList[i], aOriginSuffix, aOriginNoSuffix, aChanges);
+  }
+
+  for (auto iter = mClears.ConstIter(); !iter.Done(); iter.Next()) {
+    CollectOriginChange(iter.UserData(), aOriginSuffix, aOriginNoSuffix, aChanges);
+  }
+
+  for (auto iter = mUpdates.ConstIter(); !iter.Done(); iter.Next()) {
+    CollectOriginChange(iter.UserData(), aOriginSuffix, aOriginNoSuffix, aChanges);
+  }
+}
+
 } // namespace dom
 } // namespace mozilla
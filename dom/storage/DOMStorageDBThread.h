@@ -18,6 +18,7 @@
 #include "nsString.h"
 #include "nsCOMPtr.h"
 #include "nsClassHashtable.h"
+#include "nsDataHashtable.h"
 #include "nsIFile.h"
 #include "nsIThreadInternal.h"
 
@@ -187,6 +188,19 @@ public:
   // except preloads that are handled separately as priority operations
   class PendingOperations {
   public:
+    // Pending changes of a single origin, i.e. what the database will contain
+    // for the origin on top of its current content once flushed.
+    struct OriginChanges
+    {
+      OriginChanges() : mCleared(false) {}
+
+      // The origin's data stored in the database are deleted first
+      bool mCleared;
+
+      // Keys to store, a void value means the key is removed
+      nsDataHashtable<nsStringHashKey, nsString> mItems;
+    };
+
     PendingOperations();
 
     // Method responsible for coalescing redundant update operations with the same
@@ -216,7 +230,17 @@ public:
     // Checks whether there is a pending update operation for this scope.
     bool IsOriginUpdatePending(const nsACString& aOriginSuffix, const nsACString& aOriginNoSuffix) const;
 
+    // Replays all pending operations affecting the origin in the order they are
+    // going to be executed, this allows preload without flushing them first
+    void CollectOriginChanges(const nsACString& aOriginSuffix, const nsACString& aOriginNoSuffix,
+                              OriginChanges& aChanges) const;
+
   private:
+    // Applies a single operation to |aChanges| when it affects the origin
+    static void CollectOriginChange(DBOperation* aOperation,
+                                    const nsACString& aOriginSuffix, const nsACString& aOriginNoSuffix,
+                                    OriginChanges& aChanges);
+
     // Returns true iff new operation is of type newType and there is a pending 
     // operation of type pendingType for the same key (target).
     bool CheckForCoalesceOpportunity(DBOperation* aNewOp,
@@ -44,6 +44,7 @@
 #include "mozilla/ipc/BackgroundChild.h"
 #include "mozilla/DebugOnly.h"
 #include "mozilla/Preferences.h"
+#include "mozilla/ScopeExit.h"
 #include "mozilla/dom/Navigator.h"
 #include "nsContentUtils.h"
 #include "nsCycleCollector.h"
@@ -104,6 +105,10 @@ using mozilla::Preferences;
 // The maximum number of threads that can be idle at one time.
 #define MAX_IDLE_THREADS 20
 
+// After a burst of workers the idle limit grows to the number of threads that
+// were running workers at the same time, up to this many.
+#define MAX_IDLE_THREADS_BURST 64
+
 #define PREF_WORKERS_PREFIX "dom.workers."
 
 #define PREF_MAX_SCRIPT_RUN_TIME_CONTENT "dom.max_script_run_time"
@@ -1291,7 +1296,8 @@ JSSettings RuntimeService::sDefaultJSSettings;
 bool RuntimeService::sDefaultPreferences[WORKERPREF_COUNT] = { false };
 
 RuntimeService::RuntimeService()
-: mMutex("RuntimeService::mMutex"), mObserved(false),
+: mMutex("RuntimeService::mMutex"), mActiveThreadCount(0),
+  mPeakActiveThreadCount(0), mObserved(false),
   mShuttingDown(false), mNavigatorPropertiesLoaded(false)
 {
   AssertIsOnMainThread();
@@ -1624,7 +1630,21 @@ RuntimeService::ScheduleWorker(WorkerPrivate* aWorkerPrivate)
   nsCOMPtr<nsIRunnable> runnable =
     new WorkerThreadPrimaryRunnable(aWorkerPrivate, thread,
                                     JS_GetParentContext(cx));
+
+  // Count the thread before it can finish and be handed back to
+  // NoteIdleThread.
+  {
+    MutexAutoLock lock(mMutex);
+    mActiveThreadCount++;
+    mPeakActiveThreadCount = std::max(mPeakActiveThreadCount,
+                                      mActiveThreadCount);
+  }
+
   if (NS_FAILED(thread->DispatchPrimaryRunnable(friendKey, runnable.forget()))) {
+    {
+      MutexAutoLock lock(mMutex);
+      mActiveThreadCount--;
+    }
     UnregisterWorker(aWorkerPrivate);
     return false;
   }
@@ -1667,6 +1687,11 @@ RuntimeService::ShutdownIdleThreads(nsITimer* aTimer, void* /* aClosure */)
     if (!expiredThreads.IsEmpty()) {
       runtime->mIdleThreadArray.RemoveElementsAt(0, expiredThreads.Length());
     }
+
+    // Let the idle limit shrink again once a burst of workers is over.
+    runtime->mPeakActiveThreadCount =
+      std::max(runtime->mActiveThreadCount,
+               runtime->mPeakActiveThreadCount / 2);
   }
 
   if (!nextExpiration.IsNull()) {
@@ -2236,6 +2261,16 @@ RuntimeService::ForgetSharedWorker(WorkerPrivate* aWorkerPrivate)
   }
 }
 
+void
+RuntimeService::NoteAbandonedThread()
+{
+  // Called on the worker thread when its primary runnable fails before the
+  // thread could be recycled.
+  MutexAutoLock lock(mMutex);
+  MOZ_ASSERT(mActiveThreadCount);
+  mActiveThreadCount--;
+}
+
 void
 RuntimeService::NoteIdleThread(WorkerThread* aThread)
 {
@@ -2245,6 +2280,12 @@ RuntimeService::NoteIdleThread(WorkerThread* aThread)
   bool shutdownThread = mShuttingDown;
   bool scheduleTimer = false;
 
+  {
+    MutexAutoLock lock(mMutex);
+    MOZ_ASSERT(mActiveThreadCount);
+    mActiveThreadCount--;
+  }
+
   if (!shutdownThread) {
     static TimeDuration timeout =
       TimeDuration::FromSeconds(IDLE_THREAD_TIMEOUT_SEC);
@@ -2255,7 +2296,14 @@ RuntimeService::NoteIdleThread(WorkerThread* aThread)
 
     uint32_t previousIdleCount = mIdleThreadArray.Length();
 
-    if (previousIdleCount < MAX_IDLE_THREADS) {
+    // Keep enough threads around for as many workers as recently ran at once,
+    // so that the next burst of short-lived workers does not have to create
+    // them again.
+    uint32_t idleThreadLimit =
+      std::min(std::max<uint32_t>(MAX_IDLE_THREADS, mPeakActiveThreadCount),
+               uint32_t(MAX_IDLE_THREADS_BURST));
+
+    if (previousIdleCount < idleThreadLimit) {
       IdleThreadInfo* info = mIdleThreadArray.AppendElement();
       info->mThread = aThread;
       info->mExpirationTime = expirationTime;
@@ -2554,6 +2602,15 @@ WorkerThreadPrimaryRunnable::Run()
 
   mWorkerPrivate->AssertIsOnWorkerThread();
 
+  // If we bail out before the thread is handed back to NoteIdleThread, it must
+  // still stop counting as active.
+  auto abandonThread = MakeScopeExit([] {
+    RuntimeService* rts = RuntimeService::GetService();
+    if (rts) {
+      rts->NoteAbandonedThread();
+    }
+  });
+
   {
     nsCycleCollector_startup();
 
@@ -2620,6 +2677,8 @@ WorkerThreadPrimaryRunnable::Run()
     // any remaining C++ objects.
   }
 
+  abandonThread.release();
+
   threadHelper.Nullify();
 
   mWorkerPrivate->ScheduleDeletion(WorkerPrivate::WorkerRan);
@@ -70,6 +70,11 @@ class RuntimeService final : public nsIObserver
   // Protected by mMutex.
   nsTArray<IdleThreadInfo> mIdleThreadArray;
 
+  // Protected by mMutex. The number of threads running workers, and the most
+  // that have done so at once recently, which sizes mIdleThreadArray.
+  uint32_t mActiveThreadCount;
+  uint32_t mPeakActiveThreadCount;
+
   // *Not* protected by mMutex.
   nsClassHashtable<nsPtrHashKey<nsPIDOMWindowInner>,
                    nsTArray<WorkerPrivate*> > mWindowMap;
@@ -153,6 +158,9 @@ public:
   void
   NoteIdleThread(WorkerThread* aThread);
 
+  void
+  NoteAbandonedThread();
+
   static void
   GetDefaultJSSettings(JSSettings& aSettings)
   {
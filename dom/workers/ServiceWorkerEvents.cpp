@@ -404,6 +404,61 @@ void RespondWithCopyComplete(void* aClosure, nsresult aStatus)
 
 namespace {
 
+struct BodyCopyState
+{
+  nsIOutputStream* mSink;
+  nsresult mStatus;
+};
+
+NS_METHOD
+CopySegmentToSink(nsIInputStream* aInputStream, void* aClosure,
+                  const char* aBuffer, uint32_t aOffset, uint32_t aCount,
+                  uint32_t* aCountWritten)
+{
+  BodyCopyState* state = static_cast<BodyCopyState*>(aClosure);
+  state->mStatus = NS_CopySegmentToStream(aInputStream, state->mSink, aBuffer,
+                                          aOffset, aCount, aCountWritten);
+  return state->mStatus;
+}
+
+// Copies whatever part of aSource can be read without blocking into aSink on
+// the current thread. Most bodies passed to respondWith() are already in
+// memory, and copying them here saves a round trip through the stream
+// transport service for every intercepted request. *aDoneOut is set once the
+// whole body has been copied; otherwise the caller copies the rest
+// asynchronously.
+nsresult
+CopyAvailableBody(nsIInputStream* aSource, nsIOutputStream* aSink,
+                  uint32_t aSegmentSize, bool* aDoneOut)
+{
+  *aDoneOut = false;
+
+  bool nonBlocking = false;
+  nsresult rv = aSource->IsNonBlocking(&nonBlocking);
+  if (NS_FAILED(rv) || !nonBlocking) {
+    return NS_OK;
+  }
+
+  BodyCopyState state = { aSink, NS_OK };
+  for (;;) {
+    uint32_t count = 0;
+    rv = aSource->ReadSegments(CopySegmentToSink, &state, aSegmentSize,
+                               &count);
+    if (NS_FAILED(state.mStatus)) {
+      // The sink never blocks, so this is a real failure.
+      return state.mStatus;
+    }
+    if (rv == NS_BASE_STREAM_WOULD_BLOCK || rv == NS_ERROR_NOT_IMPLEMENTED) {
+      return NS_OK;
+    }
+    if (rv == NS_BASE_STREAM_CLOSED || (NS_SUCCEEDED(rv) && count == 0)) {
+      *aDoneOut = true;
+      return NS_OK;
+    }
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+}
+
 void
 ExtractErrorValues(JSContext* aCx, JS::Handle<JS::Value> aValue,
                   nsACString& aSourceSpecOut, uint32_t *aLineOut,
@@ -669,36 +724,48 @@ RespondWithHandler::ResolvedCallback(JSContext* aCx, JS::Handle<JS::Value> aValu
 
     const uint32_t kCopySegmentSize = 4096;
 
-    // Depending on how the Response passed to .respondWith() was created, we may
-    // get a non-buffered input stream.  In addition, in some configurations the
-    // destination channel's output stream can be unbuffered.  We wrap the output
-    // stream side here so that NS_AsyncCopy() works.  Wrapping the output side
-    // provides the most consistent operation since there are fewer stream types
-    // we are writing to.  The input stream can be a wide variety of concrete
-    // objects which may or many not play well with NS_InputStreamIsBuffered().
-    if (!NS_OutputStreamIsBuffered(responseBody)) {
-      nsCOMPtr<nsIOutputStream> buffered;
-      rv = NS_NewBufferedOutputStream(getter_AddRefs(buffered), responseBody,
-           kCopySegmentSize);
-      if (NS_WARN_IF(NS_FAILED(rv))) {
+    bool copied = false;
+    rv = CopyAvailableBody(body, responseBody, kCopySegmentSize, &copied);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return;
+    }
+
+    if (!copied) {
+      // Depending on how the Response passed to .respondWith() was created, we may
+      // get a non-buffered input stream.  In addition, in some configurations the
+      // destination channel's output stream can be unbuffered.  We wrap the output
+      // stream side here so that NS_AsyncCopy() works.  Wrapping the output side
+      // provides the most consistent operation since there are fewer stream types
+      // we are writing to.  The input stream can be a wide variety of concrete
+      // objects which may or many not play well with NS_InputStreamIsBuffered().
+      if (!NS_OutputStreamIsBuffered(responseBody)) {
+        nsCOMPtr<nsIOutputStream> buffered;
+        rv = NS_NewBufferedOutputStream(getter_AddRefs(buffered), responseBody,
+             kCopySegmentSize);
+        if (NS_WARN_IF(NS_FAILED(rv))) {
+          return;
+        }
+        responseBody = buffered;
+      }
+
+      nsCOMPtr<nsIEventTarget> stsThread = do_GetService(NS_STREAMTRANSPORTSERVICE_CONTRACTID, &rv);
+      if (NS_WARN_IF(!stsThread)) {
         return;
       }
-      responseBody = buffered;
-    }
 
-    nsCOMPtr<nsIEventTarget> stsThread = do_GetService(NS_STREAMTRANSPORTSERVICE_CONTRACTID, &rv);
-    if (NS_WARN_IF(!stsThread)) {
-      return;
+      // XXXnsm, Fix for Bug 1141332 means that if we decide to make this
+      // streaming at some point, we'll need a different solution to that bug.
+      rv = NS_AsyncCopy(body, responseBody, stsThread, NS_ASYNCCOPY_VIA_WRITESEGMENTS,
+                        kCopySegmentSize, RespondWithCopyComplete, closure.forget());
+      if (NS_WARN_IF(NS_FAILED(rv))) {
+        return;
+      }
     }
+  }
 
-    // XXXnsm, Fix for Bug 1141332 means that if we decide to make this
-    // streaming at some point, we'll need a different solution to that bug.
-    rv = NS_AsyncCopy(body, responseBody, stsThread, NS_ASYNCCOPY_VIA_WRITESEGMENTS,
-                      kCopySegmentSize, RespondWithCopyComplete, closure.forget());
-    if (NS_WARN_IF(NS_FAILED(rv))) {
-      return;
-    }
-  } else {
+  // Bodies that were copied synchronously, and responses without a body, are
+  // finished right away.
+  if (closure) {
     RespondWithCopyComplete(closure.forget(), NS_OK);
   }
 
@@ -115,6 +115,11 @@
 // A shrinking GC will run five seconds after the last event is processed.
 #define IDLE_GC_TIMER_DELAY_SEC 5
 
+// The most postMessage calls delivered in a single event loop turn. Once a
+// batch is full, the next message starts a new batch, so other runnables queued
+// in the meantime get to run between them.
+#define MAX_MESSAGE_BATCH_LENGTH 32
+
 #define PREF_WORKERS_ENABLED "dom.workers.enabled"
 
 static mozilla::LazyLogModule sWorkerPrivateLog("WorkerPrivate");
@@ -667,6 +672,11 @@ class MessageEventRunnable final : public WorkerRunnable
 
   RefPtr<PromiseNativeHandler> mHandler;
 
+  // Messages posted after this one that are delivered when this runs, so that
+  // a burst of postMessage calls costs a single event loop turn. Protected by
+  // the WorkerPrivate's mutex until this starts running.
+  nsTArray<RefPtr<WorkerRunnable>> mBatchedMessages;
+
 public:
   MessageEventRunnable(WorkerPrivate* aWorkerPrivate,
                        TargetAndBusyBehavior aBehavior)
@@ -676,6 +686,31 @@ public:
   {
   }
 
+  // Called with the WorkerPrivate's mutex held, while this message is still
+  // pending. Only the first message of a batch keeps the worker busy.
+  bool
+  AppendToBatch(MessageEventRunnable* aRunnable)
+  {
+    if (mEventSource || aRunnable->mEventSource ||
+        mBatchedMessages.Length() + 1 >= MAX_MESSAGE_BATCH_LENGTH) {
+      return false;
+    }
+
+    MOZ_ASSERT(aRunnable->mBehavior == mBehavior);
+    if (aRunnable->mBehavior == WorkerThreadModifyBusyCount) {
+      aRunnable->mBehavior = WorkerThreadUnchangedBusyCount;
+    }
+
+    mBatchedMessages.AppendElement(aRunnable);
+    return true;
+  }
+
+  void
+  TakeBatch(nsTArray<RefPtr<WorkerRunnable>>& aMessages)
+  {
+    aMessages.SwapElements(mBatchedMessages);
+  }
+
   void
   SetServiceWorkerData(UniquePtr<ServiceWorkerClientInfo>&& aSource,
                        PromiseNativeHandler* aHandler)
@@ -804,10 +839,22 @@ public:
     return true;
   }
 
+  nsresult
+  Cancel() override
+  {
+    // The batched messages are dropped along with this one.
+    nsTArray<RefPtr<WorkerRunnable>> batch;
+    mWorkerPrivate->CloseMessageBatch(this, batch);
+    return WorkerRunnable::Cancel();
+  }
+
 private:
   virtual bool
   WorkerRun(JSContext* aCx, WorkerPrivate* aWorkerPrivate) override
   {
+    nsTArray<RefPtr<WorkerRunnable>> batch;
+    aWorkerPrivate->CloseMessageBatch(this, batch);
+
     if (mBehavior == ParentThreadUnchangedBusyCount) {
       // Don't fire this event if the JS object has been disconnected from the
       // private object.
@@ -818,19 +865,56 @@ private:
       if (aWorkerPrivate->IsFrozen() || aWorkerPrivate->IsSuspended()) {
         MOZ_ASSERT(!IsDebuggerRunnable());
         aWorkerPrivate->QueueRunnable(this);
+        for (uint32_t index = 0; index < batch.Length(); index++) {
+          aWorkerPrivate->QueueRunnable(batch[index]);
+        }
         return true;
       }
 
       aWorkerPrivate->AssertInnerWindowIsCorrect();
 
-      return DispatchDOMEvent(aCx, aWorkerPrivate, aWorkerPrivate,
-                              !aWorkerPrivate->GetParent());
+      bool isMainThread = !aWorkerPrivate->GetParent();
+      bool result = DispatchDOMEvent(aCx, aWorkerPrivate, aWorkerPrivate,
+                                     isMainThread);
+      RunBatch(aWorkerPrivate, batch, isMainThread);
+      return result;
     }
 
     MOZ_ASSERT(aWorkerPrivate == GetWorkerPrivateFromContext(aCx));
 
-    return DispatchDOMEvent(aCx, aWorkerPrivate, aWorkerPrivate->GlobalScope(),
-                            false);
+    bool result = DispatchDOMEvent(aCx, aWorkerPrivate,
+                                   aWorkerPrivate->GlobalScope(), false);
+    RunBatch(aWorkerPrivate, batch, false);
+    return result;
+  }
+
+  // Each batched message is a separate task: it gets its own script entry
+  // point and error reporting, and microtasks queued by the previous message
+  // run before it. Once the worker has called close(), the rest of the batch is
+  // canceled, just as its queued runnables would be.
+  void
+  RunBatch(WorkerPrivate* aWorkerPrivate,
+           nsTArray<RefPtr<WorkerRunnable>>& aBatch, bool aIsMainThread)
+  {
+    bool targetIsWorkerThread = mBehavior != ParentThreadUnchangedBusyCount;
+
+    for (uint32_t index = 0; index < aBatch.Length(); index++) {
+      if (targetIsWorkerThread && aWorkerPrivate->IsClosing()) {
+        for (; index < aBatch.Length(); index++) {
+          aBatch[index]->Cancel();
+        }
+        return;
+      }
+
+      if (aIsMainThread) {
+        Promise::PerformMicroTaskCheckpoint();
+      } else {
+        Promise::PerformWorkerMicroTaskCheckpoint();
+      }
+
+      nsCOMPtr<nsIRunnable> runnable = aBatch[index].forget();
+      runnable->Run();
+    }
   }
 };
 
@@ -2424,6 +2508,11 @@ WorkerPrivateParent<Derived>::DispatchPrivate(already_AddRefed<WorkerRunnable> a
   {
     MutexAutoLock lock(mMutex);
 
+    // Messages posted after this runnable must not overtake it.
+    if (mMessageBatchToWorker != runnable) {
+      mMessageBatchToWorker = nullptr;
+    }
+
     MOZ_ASSERT_IF(aSyncLoopTarget, self->mThread);
 
     if (!self->mThread) {
@@ -2461,6 +2550,25 @@ WorkerPrivateParent<Derived>::DispatchPrivate(already_AddRefed<WorkerRunnable> a
   return NS_OK;
 }
 
+template <class Derived>
+void
+WorkerPrivateParent<Derived>::CloseMessageBatch(
+                                    WorkerRunnable* aRunnable,
+                                    nsTArray<RefPtr<WorkerRunnable>>& aMessages)
+{
+  // May be called on either thread!
+  MutexAutoLock lock(mMutex);
+
+  if (mMessageBatchToWorker == aRunnable) {
+    mMessageBatchToWorker = nullptr;
+  }
+  if (mMessageBatchToParent == aRunnable) {
+    mMessageBatchToParent = nullptr;
+  }
+
+  static_cast<MessageEventRunnable*>(aRunnable)->TakeBatch(aMessages);
+}
+
 template <class Derived>
 void
 WorkerPrivateParent<Derived>::EnableDebugger()
@@ -3026,7 +3134,21 @@ WorkerPrivateParent<Derived>::PostMessageInternal(
 
   runnable->SetServiceWorkerData(Move(aClientInfo), aHandler);
 
+  {
+    MutexAutoLock lock(mMutex);
+    if (mMessageBatchToWorker &&
+        static_cast<MessageEventRunnable*>(mMessageBatchToWorker.get())->
+          AppendToBatch(runnable)) {
+      return;
+    }
+    mMessageBatchToWorker = runnable;
+  }
+
   if (!runnable->Dispatch()) {
+    MutexAutoLock lock(mMutex);
+    if (mMessageBatchToWorker == runnable) {
+      mMessageBatchToWorker = nullptr;
+    }
     aRv.Throw(NS_ERROR_FAILURE);
   }
 }
@@ -5643,7 +5765,21 @@ WorkerPrivate::PostMessageToParentInternal(
     return;
   }
 
+  {
+    MutexAutoLock lock(mMutex);
+    if (mMessageBatchToParent &&
+        static_cast<MessageEventRunnable*>(mMessageBatchToParent.get())->
+          AppendToBatch(runnable)) {
+      return;
+    }
+    mMessageBatchToParent = runnable;
+  }
+
   if (!runnable->Dispatch()) {
+    MutexAutoLock lock(mMutex);
+    if (mMessageBatchToParent == runnable) {
+      mMessageBatchToParent = nullptr;
+    }
     aRv = NS_ERROR_FAILURE;
   }
 }
@@ -166,6 +166,13 @@ protected:
   RefPtr<EventTarget> mEventTarget;
   nsTArray<RefPtr<WorkerRunnable>> mPreStartRunnables;
 
+  // Protected by mMutex. The last message posted in each direction, as long as
+  // it hasn't started running and nothing else has been dispatched to the same
+  // thread after it. Messages posted while one of these is set are appended to
+  // it instead of being dispatched on their own.
+  RefPtr<WorkerRunnable> mMessageBatchToWorker;
+  RefPtr<WorkerRunnable> mMessageBatchToParent;
+
 private:
   WorkerPrivate* mParent;
   nsString mScriptURL;
@@ -397,6 +404,22 @@ public:
   void
   WorkerScriptLoaded();
 
+  // Stops appending messages to aRunnable and moves the messages already
+  // appended to aMessages. Called when aRunnable runs or is canceled.
+  void
+  CloseMessageBatch(WorkerRunnable* aRunnable,
+                    nsTArray<RefPtr<WorkerRunnable>>& aMessages);
+
+  // Called on the worker thread when aRunnable is dispatched to the parent.
+  void
+  NoteDispatchToParent(WorkerRunnable* aRunnable)
+  {
+    MutexAutoLock lock(mMutex);
+    if (mMessageBatchToParent != aRunnable) {
+      mMessageBatchToParent = nullptr;
+    }
+  }
+
   void
   QueueRunnable(nsIRunnable* aRunnable)
   {
@@ -1299,6 +1322,15 @@ public:
     return mCancelAllPendingRunnables;
   }
 
+  bool
+  IsClosing()
+  {
+    AssertIsOnWorkerThread();
+
+    MutexAutoLock lock(mMutex);
+    return mStatus >= Closing;
+  }
+
   void
   ClearMainEventQueue(WorkerRanOrNot aRanOrNot);
 
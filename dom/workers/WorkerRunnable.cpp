@@ -114,6 +114,8 @@ WorkerRunnable::DispatchInternal()
 
   MOZ_ASSERT(mBehavior == ParentThreadUnchangedBusyCount);
 
+  mWorkerPrivate->NoteDispatchToParent(this);
+
   if (WorkerPrivate* parent = mWorkerPrivate->GetParent()) {
     return NS_SUCCEEDED(parent->Dispatch(runnable.forget()));
   }
@@ -553,6 +555,8 @@ WorkerControlRunnable::DispatchInternal()
     return NS_SUCCEEDED(mWorkerPrivate->DispatchControlRunnable(runnable.forget()));
   }
 
+  mWorkerPrivate->NoteDispatchToParent(this);
+
   if (WorkerPrivate* parent = mWorkerPrivate->GetParent()) {
     return NS_SUCCEEDED(parent->DispatchControlRunnable(runnable.forget()));
   }
@@ -18,6 +18,7 @@
 #include "skia/include/effects/SkBlurImageFilter.h"
 #include "skia/include/effects/SkLayerRasterizer.h"
 #include "Blur.h"
+#include "CriticalSection.h"
 #include "Logging.h"
 #include "Tools.h"
 #include "DataSurfaceHelpers.h"
@@ -81,10 +82,78 @@ public:
 
   BackendType GetBackendType() const { return BackendType::SKIA; }
 
+  /**
+   * Skia rasterizes the color ramp for a gradient lazily, once per shader.
+   * Since GradientStops are shared through gfxGradientCache, we keep the most
+   * recently used shader around so that repainting the same gradient (the
+   * common case for CSS gradients in layers that get invalidated) can reuse
+   * the ramp instead of creating a new shader and interpolating the stops
+   * again. Gradients may be painted from several threads, hence the lock.
+   */
+  sk_sp<SkShader> GetShader(PatternType aType,
+                            const Point& aPoint1, const Point& aPoint2,
+                            Float aRadius1, Float aRadius2,
+                            const Matrix& aMatrix)
+  {
+    CriticalSectionAutoEnter lock(&mShaderLock);
+    if (mShader && mShaderType == aType &&
+        mShaderPoint1 == aPoint1 && mShaderPoint2 == aPoint2 &&
+        mShaderRadius1 == aRadius1 && mShaderRadius2 == aRadius2 &&
+        mShaderMatrix == aMatrix) {
+      return mShader;
+    }
+
+    SkShader::TileMode mode = ExtendModeToTileMode(mExtendMode, Axis::BOTH);
+    SkPoint points[2];
+    points[0] = SkPoint::Make(SkFloatToScalar(aPoint1.x), SkFloatToScalar(aPoint1.y));
+    points[1] = SkPoint::Make(SkFloatToScalar(aPoint2.x), SkFloatToScalar(aPoint2.y));
+
+    SkMatrix mat;
+    GfxMatrixToSkiaMatrix(aMatrix, mat);
+
+    sk_sp<SkShader> shader;
+    if (aType == PatternType::LINEAR_GRADIENT) {
+      shader = SkGradientShader::MakeLinear(points,
+                                            &mColors.front(),
+                                            &mPositions.front(),
+                                            mCount,
+                                            mode, 0, &mat);
+    } else {
+      MOZ_ASSERT(aType == PatternType::RADIAL_GRADIENT);
+      shader = SkGradientShader::MakeTwoPointConical(points[0],
+                                                     SkFloatToScalar(aRadius1),
+                                                     points[1],
+                                                     SkFloatToScalar(aRadius2),
+                                                     &mColors.front(),
+                                                     &mPositions.front(),
+                                                     mCount,
+                                                     mode, 0, &mat);
+    }
+
+    mShader = shader;
+    mShaderType = aType;
+    mShaderPoint1 = aPoint1;
+    mShaderPoint2 = aPoint2;
+    mShaderRadius1 = aRadius1;
+    mShaderRadius2 = aRadius2;
+    mShaderMatrix = aMatrix;
+    return shader;
+  }
+
   std::vector<SkColor> mColors;
   std::vector<SkScalar> mPositions;
   int mCount;
   ExtendMode mExtendMode;
+
+private:
+  CriticalSection mShaderLock;
+  sk_sp<SkShader> mShader;
+  PatternType mShaderType;
+  Point mShaderPoint1;
+  Point mShaderPoint2;
+  Float mShaderRadius1;
+  Float mShaderRadius2;
+  Matrix mShaderMatrix;
 };
 
 /**
@@ -300,19 +369,9 @@ SetPaintPattern(SkPaint& aPaint, const Pattern& aPattern, Float aAlpha = 1.0)
           !pat.mBegin.IsFinite() || !pat.mEnd.IsFinite()) {
         aPaint.setColor(SK_ColorTRANSPARENT);
       } else {
-        SkShader::TileMode mode = ExtendModeToTileMode(stops->mExtendMode, Axis::BOTH);
-        SkPoint points[2];
-        points[0] = SkPoint::Make(SkFloatToScalar(pat.mBegin.x), SkFloatToScalar(pat.mBegin.y));
-        points[1] = SkPoint::Make(SkFloatToScalar(pat.mEnd.x), SkFloatToScalar(pat.mEnd.y));
-
-        SkMatrix mat;
-        GfxMatrixToSkiaMatrix(pat.mMatrix, mat);
-        sk_sp<SkShader> shader = SkGradientShader::MakeLinear(points,
-                                                              &stops->mColors.front(),
-                                                              &stops->mPositions.front(),
-                                                              stops->mCount,
-                                                              mode, 0, &mat);
-        aPaint.setShader(shader);
+        aPaint.setShader(stops->GetShader(PatternType::LINEAR_GRADIENT,
+                                          pat.mBegin, pat.mEnd, 0, 0,
+                                          pat.mMatrix));
       }
       break;
     }
@@ -324,22 +383,10 @@ SetPaintPattern(SkPaint& aPaint, const Pattern& aPattern, Float aAlpha = 1.0)
           !pat.mCenter2.IsFinite() || !IsFinite(pat.mRadius2)) {
         aPaint.setColor(SK_ColorTRANSPARENT);
       } else {
-        SkShader::TileMode mode = ExtendModeToTileMode(stops->mExtendMode, Axis::BOTH);
-        SkPoint points[2];
-        points[0] = SkPoint::Make(SkFloatToScalar(pat.mCenter1.x), SkFloatToScalar(pat.mCenter1.y));
-        points[1] = SkPoint::Make(SkFloatToScalar(pat.mCenter2.x), SkFloatToScalar(pat.mCenter2.y));
-
-        SkMatrix mat;
-        GfxMatrixToSkiaMatrix(pat.mMatrix, mat);
-        sk_sp<SkShader> shader = SkGradientShader::MakeTwoPointConical(points[0],
-                                                                       SkFloatToScalar(pat.mRadius1),
-                                                                       points[1],
-                                                                       SkFloatToScalar(pat.mRadius2),
-                                                                       &stops->mColors.front(),
-                                                                       &stops->mPositions.front(),
-                                                                       stops->mCount,
-                                                                       mode, 0, &mat);
-        aPaint.setShader(shader);
+        aPaint.setShader(stops->GetShader(PatternType::RADIAL_GRADIENT,
+                                          pat.mCenter1, pat.mCenter2,
+                                          pat.mRadius1, pat.mRadius2,
+                                          pat.mMatrix));
       }
       break;
     }
@@ -0,0 +1,316 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MOZILLA_GFX_SWIZZLE_INL_H_
+#define MOZILLA_GFX_SWIZZLE_INL_H_
+
+#include "Swizzle.h"
+
+#include "mozilla/Alignment.h"
+
+namespace mozilla {
+namespace gfx {
+
+// sUnpremultiplyFactors[a] holds 255/a (1 for a == 0), tuned to within a few
+// units in the last place so that truncating v * sUnpremultiplyFactors[a] gives
+// exactly v * 255 / a for all a and v in [0, 255]. That is the value
+// genTables.py stores in gfxUtils::sUnpremultiplyTable (before reducing it
+// modulo 256), so the kernels can multiply instead of looking it up. Each
+// factor is repeated for the three color channels of an SSE2 register; the
+// alpha channel is multiplied by 1.
+MOZ_ALIGNED_DECL(static const float sUnpremultiplyFactors[256][4], 16) = {
+  { 1.000000000e+00f, 1.000000000e+00f, 1.000000000e+00f, 1.0f },
+  { 2.550000000e+02f, 2.550000000e+02f, 2.550000000e+02f, 1.0f },
+  { 1.275000000e+02f, 1.275000000e+02f, 1.275000000e+02f, 1.0f },
+  { 8.500000000e+01f, 8.500000000e+01f, 8.500000000e+01f, 1.0f },
+  { 6.375000000e+01f, 6.375000000e+01f, 6.375000000e+01f, 1.0f },
+  { 5.100000000e+01f, 5.100000000e+01f, 5.100000000e+01f, 1.0f },
+  { 4.250000000e+01f, 4.250000000e+01f, 4.250000000e+01f, 1.0f },
+  { 3.642857361e+01f, 3.642857361e+01f, 3.642857361e+01f, 1.0f },
+  { 3.187500000e+01f, 3.187500000e+01f, 3.187500000e+01f, 1.0f },
+  { 2.833333397e+01f, 2.833333397e+01f, 2.833333397e+01f, 1.0f },
+  { 2.550000000e+01f, 2.550000000e+01f, 2.550000000e+01f, 1.0f },
+  { 2.318181801e+01f, 2.318181801e+01f, 2.318181801e+01f, 1.0f },
+  { 2.125000000e+01f, 2.125000000e+01f, 2.125000000e+01f, 1.0f },
+  { 1.961538506e+01f, 1.961538506e+01f, 1.961538506e+01f, 1.0f },
+  { 1.821428680e+01f, 1.821428680e+01f, 1.821428680e+01f, 1.0f },
+  { 1.700000000e+01f, 1.700000000e+01f, 1.700000000e+01f, 1.0f },
+  { 1.593750000e+01f, 1.593750000e+01f, 1.593750000e+01f, 1.0f },
+  { 1.500000000e+01f, 1.500000000e+01f, 1.500000000e+01f, 1.0f },
+  { 1.416666698e+01f, 1.416666698e+01f, 1.416666698e+01f, 1.0f },
+  { 1.342105293e+01f, 1.342105293e+01f, 1.342105293e+01f, 1.0f },
+  { 1.275000000e+01f, 1.275000000e+01f, 1.275000000e+01f, 1.0f },
+  { 1.214285755e+01f, 1.214285755e+01f, 1.214285755e+01f, 1.0f },
+  { 1.159090900e+01f, 1.159090900e+01f, 1.159090900e+01f, 1.0f },
+  { 1.108695698e+01f, 1.108695698e+01f, 1.108695698e+01f, 1.0f },
+  { 1.062500000e+01f, 1.062500000e+01f, 1.062500000e+01f, 1.0f },
+  { 1.019999981e+01f, 1.019999981e+01f, 1.019999981e+01f, 1.0f },
+  { 9.807692528e+00f, 9.807692528e+00f, 9.807692528e+00f, 1.0f },
+  { 9.444444656e+00f, 9.444444656e+00f, 9.444444656e+00f, 1.0f },
+  { 9.107143402e+00f, 9.107143402e+00f, 9.107143402e+00f, 1.0f },
+  { 8.793103218e+00f, 8.793103218e+00f, 8.793103218e+00f, 1.0f },
+  { 8.500000000e+00f, 8.500000000e+00f, 8.500000000e+00f, 1.0f },
+  { 8.225806236e+00f, 8.225806236e+00f, 8.225806236e+00f, 1.0f },
+  { 7.968750000e+00f, 7.968750000e+00f, 7.968750000e+00f, 1.0f },
+  { 7.727272511e+00f, 7.727272511e+00f, 7.727272511e+00f, 1.0f },
+  { 7.500000000e+00f, 7.500000000e+00f, 7.500000000e+00f, 1.0f },
+  { 7.285714149e+00f, 7.285714149e+00f, 7.285714149e+00f, 1.0f },
+  { 7.083333492e+00f, 7.083333492e+00f, 7.083333492e+00f, 1.0f },
+  { 6.891891956e+00f, 6.891891956e+00f, 6.891891956e+00f, 1.0f },
+  { 6.710526466e+00f, 6.710526466e+00f, 6.710526466e+00f, 1.0f },
+  { 6.538461685e+00f, 6.538461685e+00f, 6.538461685e+00f, 1.0f },
+  { 6.375000000e+00f, 6.375000000e+00f, 6.375000000e+00f, 1.0f },
+  { 6.219512463e+00f, 6.219512463e+00f, 6.219512463e+00f, 1.0f },
+  { 6.071428776e+00f, 6.071428776e+00f, 6.071428776e+00f, 1.0f },
+  { 5.930232525e+00f, 5.930232525e+00f, 5.930232525e+00f, 1.0f },
+  { 5.795454502e+00f, 5.795454502e+00f, 5.795454502e+00f, 1.0f },
+  { 5.666666508e+00f, 5.666666508e+00f, 5.666666508e+00f, 1.0f },
+  { 5.543478489e+00f, 5.543478489e+00f, 5.543478489e+00f, 1.0f },
+  { 5.425531864e+00f, 5.425531864e+00f, 5.425531864e+00f, 1.0f },
+  { 5.312500000e+00f, 5.312500000e+00f, 5.312500000e+00f, 1.0f },
+  { 5.204081535e+00f, 5.204081535e+00f, 5.204081535e+00f, 1.0f },
+  { 5.099999905e+00f, 5.099999905e+00f, 5.099999905e+00f, 1.0f },
+  { 5.000000000e+00f, 5.000000000e+00f, 5.000000000e+00f, 1.0f },
+  { 4.903846264e+00f, 4.903846264e+00f, 4.903846264e+00f, 1.0f },
+  { 4.811320782e+00f, 4.811320782e+00f, 4.811320782e+00f, 1.0f },
+  { 4.722222328e+00f, 4.722222328e+00f, 4.722222328e+00f, 1.0f },
+  { 4.636363506e+00f, 4.636363506e+00f, 4.636363506e+00f, 1.0f },
+  { 4.553571701e+00f, 4.553571701e+00f, 4.553571701e+00f, 1.0f },
+  { 4.473684311e+00f, 4.473684311e+00f, 4.473684311e+00f, 1.0f },
+  { 4.396551609e+00f, 4.396551609e+00f, 4.396551609e+00f, 1.0f },
+  { 4.322033882e+00f, 4.322033882e+00f, 4.322033882e+00f, 1.0f },
+  { 4.250000000e+00f, 4.250000000e+00f, 4.250000000e+00f, 1.0f },
+  { 4.180327892e+00f, 4.180327892e+00f, 4.180327892e+00f, 1.0f },
+  { 4.112903118e+00f, 4.112903118e+00f, 4.112903118e+00f, 1.0f },
+  { 4.047619343e+00f, 4.047619343e+00f, 4.047619343e+00f, 1.0f },
+  { 3.984375000e+00f, 3.984375000e+00f, 3.984375000e+00f, 1.0f },
+  { 3.923076868e+00f, 3.923076868e+00f, 3.923076868e+00f, 1.0f },
+  { 3.863636255e+00f, 3.863636255e+00f, 3.863636255e+00f, 1.0f },
+  { 3.805970192e+00f, 3.805970192e+00f, 3.805970192e+00f, 1.0f },
+  { 3.750000000e+00f, 3.750000000e+00f, 3.750000000e+00f, 1.0f },
+  { 3.695652246e+00f, 3.695652246e+00f, 3.695652246e+00f, 1.0f },
+  { 3.642857075e+00f, 3.642857075e+00f, 3.642857075e+00f, 1.0f },
+  { 3.591549397e+00f, 3.591549397e+00f, 3.591549397e+00f, 1.0f },
+  { 3.541666746e+00f, 3.541666746e+00f, 3.541666746e+00f, 1.0f },
+  { 3.493150711e+00f, 3.493150711e+00f, 3.493150711e+00f, 1.0f },
+  { 3.445945978e+00f, 3.445945978e+00f, 3.445945978e+00f, 1.0f },
+  { 3.400000095e+00f, 3.400000095e+00f, 3.400000095e+00f, 1.0f },
+  { 3.355263233e+00f, 3.355263233e+00f, 3.355263233e+00f, 1.0f },
+  { 3.311688423e+00f, 3.311688423e+00f, 3.311688423e+00f, 1.0f },
+  { 3.269230843e+00f, 3.269230843e+00f, 3.269230843e+00f, 1.0f },
+  { 3.227848053e+00f, 3.227848053e+00f, 3.227848053e+00f, 1.0f },
+  { 3.187500000e+00f, 3.187500000e+00f, 3.187500000e+00f, 1.0f },
+  { 3.148148060e+00f, 3.148148060e+00f, 3.148148060e+00f, 1.0f },
+  { 3.109756231e+00f, 3.109756231e+00f, 3.109756231e+00f, 1.0f },
+  { 3.072289228e+00f, 3.072289228e+00f, 3.072289228e+00f, 1.0f },
+  { 3.035714388e+00f, 3.035714388e+00f, 3.035714388e+00f, 1.0f },
+  { 3.000000000e+00f, 3.000000000e+00f, 3.000000000e+00f, 1.0f },
+  { 2.965116262e+00f, 2.965116262e+00f, 2.965116262e+00f, 1.0f },
+  { 2.931034565e+00f, 2.931034565e+00f, 2.931034565e+00f, 1.0f },
+  { 2.897727251e+00f, 2.897727251e+00f, 2.897727251e+00f, 1.0f },
+  { 2.865168571e+00f, 2.865168571e+00f, 2.865168571e+00f, 1.0f },
+  { 2.833333254e+00f, 2.833333254e+00f, 2.833333254e+00f, 1.0f },
+  { 2.802197933e+00f, 2.802197933e+00f, 2.802197933e+00f, 1.0f },
+  { 2.771739244e+00f, 2.771739244e+00f, 2.771739244e+00f, 1.0f },
+  { 2.741935492e+00f, 2.741935492e+00f, 2.741935492e+00f, 1.0f },
+  { 2.712765932e+00f, 2.712765932e+00f, 2.712765932e+00f, 1.0f },
+  { 2.684210539e+00f, 2.684210539e+00f, 2.684210539e+00f, 1.0f },
+  { 2.656250000e+00f, 2.656250000e+00f, 2.656250000e+00f, 1.0f },
+  { 2.628865957e+00f, 2.628865957e+00f, 2.628865957e+00f, 1.0f },
+  { 2.602040768e+00f, 2.602040768e+00f, 2.602040768e+00f, 1.0f },
+  { 2.575757504e+00f, 2.575757504e+00f, 2.575757504e+00f, 1.0f },
+  { 2.549999952e+00f, 2.549999952e+00f, 2.549999952e+00f, 1.0f },
+  { 2.524752617e+00f, 2.524752617e+00f, 2.524752617e+00f, 1.0f },
+  { 2.500000000e+00f, 2.500000000e+00f, 2.500000000e+00f, 1.0f },
+  { 2.475728273e+00f, 2.475728273e+00f, 2.475728273e+00f, 1.0f },
+  { 2.451923132e+00f, 2.451923132e+00f, 2.451923132e+00f, 1.0f },
+  { 2.428571463e+00f, 2.428571463e+00f, 2.428571463e+00f, 1.0f },
+  { 2.405660391e+00f, 2.405660391e+00f, 2.405660391e+00f, 1.0f },
+  { 2.383177519e+00f, 2.383177519e+00f, 2.383177519e+00f, 1.0f },
+  { 2.361111164e+00f, 2.361111164e+00f, 2.361111164e+00f, 1.0f },
+  { 2.339449644e+00f, 2.339449644e+00f, 2.339449644e+00f, 1.0f },
+  { 2.318181753e+00f, 2.318181753e+00f, 2.318181753e+00f, 1.0f },
+  { 2.297297239e+00f, 2.297297239e+00f, 2.297297239e+00f, 1.0f },
+  { 2.276785851e+00f, 2.276785851e+00f, 2.276785851e+00f, 1.0f },
+  { 2.256637335e+00f, 2.256637335e+00f, 2.256637335e+00f, 1.0f },
+  { 2.236842155e+00f, 2.236842155e+00f, 2.236842155e+00f, 1.0f },
+  { 2.217391253e+00f, 2.217391253e+00f, 2.217391253e+00f, 1.0f },
+  { 2.198275805e+00f, 2.198275805e+00f, 2.198275805e+00f, 1.0f },
+  { 2.179487228e+00f, 2.179487228e+00f, 2.179487228e+00f, 1.0f },
+  { 2.161016941e+00f, 2.161016941e+00f, 2.161016941e+00f, 1.0f },
+  { 2.142857313e+00f, 2.142857313e+00f, 2.142857313e+00f, 1.0f },
+  { 2.125000000e+00f, 2.125000000e+00f, 2.125000000e+00f, 1.0f },
+  { 2.107438087e+00f, 2.107438087e+00f, 2.107438087e+00f, 1.0f },
+  { 2.090163946e+00f, 2.090163946e+00f, 2.090163946e+00f, 1.0f },
+  { 2.073170900e+00f, 2.073170900e+00f, 2.073170900e+00f, 1.0f },
+  { 2.056451559e+00f, 2.056451559e+00f, 2.056451559e+00f, 1.0f },
+  { 2.039999962e+00f, 2.039999962e+00f, 2.039999962e+00f, 1.0f },
+  { 2.023809671e+00f, 2.023809671e+00f, 2.023809671e+00f, 1.0f },
+  { 2.007874012e+00f, 2.007874012e+00f, 2.007874012e+00f, 1.0f },
+  { 1.992187500e+00f, 1.992187500e+00f, 1.992187500e+00f, 1.0f },
+  { 1.976744175e+00f, 1.976744175e+00f, 1.976744175e+00f, 1.0f },
+  { 1.961538434e+00f, 1.961538434e+00f, 1.961538434e+00f, 1.0f },
+  { 1.946564913e+00f, 1.946564913e+00f, 1.946564913e+00f, 1.0f },
+  { 1.931818128e+00f, 1.931818128e+00f, 1.931818128e+00f, 1.0f },
+  { 1.917293191e+00f, 1.917293191e+00f, 1.917293191e+00f, 1.0f },
+  { 1.902985096e+00f, 1.902985096e+00f, 1.902985096e+00f, 1.0f },
+  { 1.888888836e+00f, 1.888888836e+00f, 1.888888836e+00f, 1.0f },
+  { 1.875000000e+00f, 1.875000000e+00f, 1.875000000e+00f, 1.0f },
+  { 1.861313820e+00f, 1.861313820e+00f, 1.861313820e+00f, 1.0f },
+  { 1.847826123e+00f, 1.847826123e+00f, 1.847826123e+00f, 1.0f },
+  { 1.834532380e+00f, 1.834532380e+00f, 1.834532380e+00f, 1.0f },
+  { 1.821428537e+00f, 1.821428537e+00f, 1.821428537e+00f, 1.0f },
+  { 1.808510661e+00f, 1.808510661e+00f, 1.808510661e+00f, 1.0f },
+  { 1.795774698e+00f, 1.795774698e+00f, 1.795774698e+00f, 1.0f },
+  { 1.783216834e+00f, 1.783216834e+00f, 1.783216834e+00f, 1.0f },
+  { 1.770833373e+00f, 1.770833373e+00f, 1.770833373e+00f, 1.0f },
+  { 1.758620739e+00f, 1.758620739e+00f, 1.758620739e+00f, 1.0f },
+  { 1.746575356e+00f, 1.746575356e+00f, 1.746575356e+00f, 1.0f },
+  { 1.734693885e+00f, 1.734693885e+00f, 1.734693885e+00f, 1.0f },
+  { 1.722972989e+00f, 1.722972989e+00f, 1.722972989e+00f, 1.0f },
+  { 1.711409450e+00f, 1.711409450e+00f, 1.711409450e+00f, 1.0f },
+  { 1.700000048e+00f, 1.700000048e+00f, 1.700000048e+00f, 1.0f },
+  { 1.688741684e+00f, 1.688741684e+00f, 1.688741684e+00f, 1.0f },
+  { 1.677631617e+00f, 1.677631617e+00f, 1.677631617e+00f, 1.0f },
+  { 1.666666627e+00f, 1.666666627e+00f, 1.666666627e+00f, 1.0f },
+  { 1.655844212e+00f, 1.655844212e+00f, 1.655844212e+00f, 1.0f },
+  { 1.645161271e+00f, 1.645161271e+00f, 1.645161271e+00f, 1.0f },
+  { 1.634615421e+00f, 1.634615421e+00f, 1.634615421e+00f, 1.0f },
+  { 1.624203801e+00f, 1.624203801e+00f, 1.624203801e+00f, 1.0f },
+  { 1.613924026e+00f, 1.613924026e+00f, 1.613924026e+00f, 1.0f },
+  { 1.603773594e+00f, 1.603773594e+00f, 1.603773594e+00f, 1.0f },
+  { 1.593750000e+00f, 1.593750000e+00f, 1.593750000e+00f, 1.0f },
+  { 1.583850980e+00f, 1.583850980e+00f, 1.583850980e+00f, 1.0f },
+  { 1.574074030e+00f, 1.574074030e+00f, 1.574074030e+00f, 1.0f },
+  { 1.564417243e+00f, 1.564417243e+00f, 1.564417243e+00f, 1.0f },
+  { 1.554878116e+00f, 1.554878116e+00f, 1.554878116e+00f, 1.0f },
+  { 1.545454502e+00f, 1.545454502e+00f, 1.545454502e+00f, 1.0f },
+  { 1.536144614e+00f, 1.536144614e+00f, 1.536144614e+00f, 1.0f },
+  { 1.526946068e+00f, 1.526946068e+00f, 1.526946068e+00f, 1.0f },
+  { 1.517857194e+00f, 1.517857194e+00f, 1.517857194e+00f, 1.0f },
+  { 1.508875728e+00f, 1.508875728e+00f, 1.508875728e+00f, 1.0f },
+  { 1.500000000e+00f, 1.500000000e+00f, 1.500000000e+00f, 1.0f },
+  { 1.491228104e+00f, 1.491228104e+00f, 1.491228104e+00f, 1.0f },
+  { 1.482558131e+00f, 1.482558131e+00f, 1.482558131e+00f, 1.0f },
+  { 1.473988414e+00f, 1.473988414e+00f, 1.473988414e+00f, 1.0f },
+  { 1.465517282e+00f, 1.465517282e+00f, 1.465517282e+00f, 1.0f },
+  { 1.457142830e+00f, 1.457142830e+00f, 1.457142830e+00f, 1.0f },
+  { 1.448863626e+00f, 1.448863626e+00f, 1.448863626e+00f, 1.0f },
+  { 1.440678000e+00f, 1.440678000e+00f, 1.440678000e+00f, 1.0f },
+  { 1.432584286e+00f, 1.432584286e+00f, 1.432584286e+00f, 1.0f },
+  { 1.424581051e+00f, 1.424581051e+00f, 1.424581051e+00f, 1.0f },
+  { 1.416666627e+00f, 1.416666627e+00f, 1.416666627e+00f, 1.0f },
+  { 1.408839822e+00f, 1.408839822e+00f, 1.408839822e+00f, 1.0f },
+  { 1.401098967e+00f, 1.401098967e+00f, 1.401098967e+00f, 1.0f },
+  { 1.393442631e+00f, 1.393442631e+00f, 1.393442631e+00f, 1.0f },
+  { 1.385869622e+00f, 1.385869622e+00f, 1.385869622e+00f, 1.0f },
+  { 1.378378391e+00f, 1.378378391e+00f, 1.378378391e+00f, 1.0f },
+  { 1.370967746e+00f, 1.370967746e+00f, 1.370967746e+00f, 1.0f },
+  { 1.363636374e+00f, 1.363636374e+00f, 1.363636374e+00f, 1.0f },
+  { 1.356382966e+00f, 1.356382966e+00f, 1.356382966e+00f, 1.0f },
+  { 1.349206328e+00f, 1.349206328e+00f, 1.349206328e+00f, 1.0f },
+  { 1.342105269e+00f, 1.342105269e+00f, 1.342105269e+00f, 1.0f },
+  { 1.335078597e+00f, 1.335078597e+00f, 1.335078597e+00f, 1.0f },
+  { 1.328125000e+00f, 1.328125000e+00f, 1.328125000e+00f, 1.0f },
+  { 1.321243525e+00f, 1.321243525e+00f, 1.321243525e+00f, 1.0f },
+  { 1.314432979e+00f, 1.314432979e+00f, 1.314432979e+00f, 1.0f },
+  { 1.307692289e+00f, 1.307692289e+00f, 1.307692289e+00f, 1.0f },
+  { 1.301020384e+00f, 1.301020384e+00f, 1.301020384e+00f, 1.0f },
+  { 1.294416308e+00f, 1.294416308e+00f, 1.294416308e+00f, 1.0f },
+  { 1.287878752e+00f, 1.287878752e+00f, 1.287878752e+00f, 1.0f },
+  { 1.281406999e+00f, 1.281406999e+00f, 1.281406999e+00f, 1.0f },
+  { 1.274999976e+00f, 1.274999976e+00f, 1.274999976e+00f, 1.0f },
+  { 1.268656731e+00f, 1.268656731e+00f, 1.268656731e+00f, 1.0f },
+  { 1.262376308e+00f, 1.262376308e+00f, 1.262376308e+00f, 1.0f },
+  { 1.256157637e+00f, 1.256157637e+00f, 1.256157637e+00f, 1.0f },
+  { 1.250000000e+00f, 1.250000000e+00f, 1.250000000e+00f, 1.0f },
+  { 1.243902445e+00f, 1.243902445e+00f, 1.243902445e+00f, 1.0f },
+  { 1.237864137e+00f, 1.237864137e+00f, 1.237864137e+00f, 1.0f },
+  { 1.231884122e+00f, 1.231884122e+00f, 1.231884122e+00f, 1.0f },
+  { 1.225961566e+00f, 1.225961566e+00f, 1.225961566e+00f, 1.0f },
+  { 1.220095754e+00f, 1.220095754e+00f, 1.220095754e+00f, 1.0f },
+  { 1.214285731e+00f, 1.214285731e+00f, 1.214285731e+00f, 1.0f },
+  { 1.208530784e+00f, 1.208530784e+00f, 1.208530784e+00f, 1.0f },
+  { 1.202830195e+00f, 1.202830195e+00f, 1.202830195e+00f, 1.0f },
+  { 1.197183132e+00f, 1.197183132e+00f, 1.197183132e+00f, 1.0f },
+  { 1.191588759e+00f, 1.191588759e+00f, 1.191588759e+00f, 1.0f },
+  { 1.186046481e+00f, 1.186046481e+00f, 1.186046481e+00f, 1.0f },
+  { 1.180555582e+00f, 1.180555582e+00f, 1.180555582e+00f, 1.0f },
+  { 1.175115228e+00f, 1.175115228e+00f, 1.175115228e+00f, 1.0f },
+  { 1.169724822e+00f, 1.169724822e+00f, 1.169724822e+00f, 1.0f },
+  { 1.164383531e+00f, 1.164383531e+00f, 1.164383531e+00f, 1.0f },
+  { 1.159090877e+00f, 1.159090877e+00f, 1.159090877e+00f, 1.0f },
+  { 1.153846145e+00f, 1.153846145e+00f, 1.153846145e+00f, 1.0f },
+  { 1.148648620e+00f, 1.148648620e+00f, 1.148648620e+00f, 1.0f },
+  { 1.143497825e+00f, 1.143497825e+00f, 1.143497825e+00f, 1.0f },
+  { 1.138392925e+00f, 1.138392925e+00f, 1.138392925e+00f, 1.0f },
+  { 1.133333325e+00f, 1.133333325e+00f, 1.133333325e+00f, 1.0f },
+  { 1.128318667e+00f, 1.128318667e+00f, 1.128318667e+00f, 1.0f },
+  { 1.123347998e+00f, 1.123347998e+00f, 1.123347998e+00f, 1.0f },
+  { 1.118421078e+00f, 1.118421078e+00f, 1.118421078e+00f, 1.0f },
+  { 1.113537192e+00f, 1.113537192e+00f, 1.113537192e+00f, 1.0f },
+  { 1.108695626e+00f, 1.108695626e+00f, 1.108695626e+00f, 1.0f },
+  { 1.103896141e+00f, 1.103896141e+00f, 1.103896141e+00f, 1.0f },
+  { 1.099137902e+00f, 1.099137902e+00f, 1.099137902e+00f, 1.0f },
+  { 1.094420671e+00f, 1.094420671e+00f, 1.094420671e+00f, 1.0f },
+  { 1.089743614e+00f, 1.089743614e+00f, 1.089743614e+00f, 1.0f },
+  { 1.085106373e+00f, 1.085106373e+00f, 1.085106373e+00f, 1.0f },
+  { 1.080508471e+00f, 1.080508471e+00f, 1.080508471e+00f, 1.0f },
+  { 1.075949430e+00f, 1.075949430e+00f, 1.075949430e+00f, 1.0f },
+  { 1.071428657e+00f, 1.071428657e+00f, 1.071428657e+00f, 1.0f },
+  { 1.066945672e+00f, 1.066945672e+00f, 1.066945672e+00f, 1.0f },
+  { 1.062500000e+00f, 1.062500000e+00f, 1.062500000e+00f, 1.0f },
+  { 1.058091283e+00f, 1.058091283e+00f, 1.058091283e+00f, 1.0f },
+  { 1.053719044e+00f, 1.053719044e+00f, 1.053719044e+00f, 1.0f },
+  { 1.049382687e+00f, 1.049382687e+00f, 1.049382687e+00f, 1.0f },
+  { 1.045081973e+00f, 1.045081973e+00f, 1.045081973e+00f, 1.0f },
+  { 1.040816307e+00f, 1.040816307e+00f, 1.040816307e+00f, 1.0f },
+  { 1.036585450e+00f, 1.036585450e+00f, 1.036585450e+00f, 1.0f },
+  { 1.032388687e+00f, 1.032388687e+00f, 1.032388687e+00f, 1.0f },
+  { 1.028225780e+00f, 1.028225780e+00f, 1.028225780e+00f, 1.0f },
+  { 1.024096370e+00f, 1.024096370e+00f, 1.024096370e+00f, 1.0f },
+  { 1.019999981e+00f, 1.019999981e+00f, 1.019999981e+00f, 1.0f },
+  { 1.015936255e+00f, 1.015936255e+00f, 1.015936255e+00f, 1.0f },
+  { 1.011904836e+00f, 1.011904836e+00f, 1.011904836e+00f, 1.0f },
+  { 1.007905126e+00f, 1.007905126e+00f, 1.007905126e+00f, 1.0f },
+  { 1.003937006e+00f, 1.003937006e+00f, 1.003937006e+00f, 1.0f },
+  { 1.000000000e+00f, 1.000000000e+00f, 1.000000000e+00f, 1.0f },
+};
+
+static inline uint8_t
+PremultiplyValue(uint8_t aAlpha, uint8_t aValue)
+{
+  // (x + 1 + (x >> 8)) >> 8 is x / 255 for all x <= 255 * 255 + 254.
+  uint32_t x = aAlpha * aValue + 254;
+  return (x + 1 + (x >> 8)) >> 8;
+}
+
+static inline uint8_t
+UnpremultiplyValue(uint8_t aAlpha, uint8_t aValue)
+{
+  // The conversion to uint8_t reduces the quotient modulo 256, which only
+  // matters for invalid input where aValue > aAlpha.
+  return uint8_t(int32_t(aValue * sUnpremultiplyFactors[aAlpha][0]));
+}
+
+#ifdef USE_SSE2
+// Kernels for formats that keep alpha in the last byte (B8G8R8A8, R8G8B8A8
+// and their X variants). aSwapRB swaps the first and third bytes of each
+// pixel. aSrcStride and aDstStride are in bytes.
+void PremultiplyData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                          uint8_t* aDst, int32_t aDstStride,
+                          const IntSize& aSize, bool aSwapRB);
+void UnpremultiplyData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                            uint8_t* aDst, int32_t aDstStride,
+                            const IntSize& aSize, bool aSwapRB);
+void SwizzleData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                      uint8_t* aDst, int32_t aDstStride,
+                      const IntSize& aSize, bool aSwapRB, bool aOpaque);
+#endif
+
+} // namespace gfx
+} // namespace mozilla
+
+#endif /* MOZILLA_GFX_SWIZZLE_INL_H_ */
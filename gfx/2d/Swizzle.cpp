@@ -0,0 +1,208 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Swizzle-inl.h"
+
+#include "2D.h"
+
+namespace mozilla {
+namespace gfx {
+
+namespace {
+
+// Byte offsets of the channels within a pixel. mA is -1 for formats without
+// alpha.
+struct PixelLayout
+{
+  int32_t mR;
+  int32_t mG;
+  int32_t mB;
+  int32_t mA;
+
+  bool HasAlpha() const { return mA >= 0; }
+
+  // Whether the SSE2 kernels handle this layout.
+  bool AlphaLast() const { return mA == 3 || (mA < 0 && mB != 3); }
+  bool RedFirst() const { return mR == 0; }
+};
+
+bool
+GetPixelLayout(SurfaceFormat aFormat, PixelLayout& aLayout)
+{
+  switch (aFormat) {
+    case SurfaceFormat::B8G8R8A8:
+      aLayout = { 2, 1, 0, 3 };
+      return true;
+    case SurfaceFormat::B8G8R8X8:
+      aLayout = { 2, 1, 0, -1 };
+      return true;
+    case SurfaceFormat::R8G8B8A8:
+      aLayout = { 0, 1, 2, 3 };
+      return true;
+    case SurfaceFormat::R8G8B8X8:
+      aLayout = { 0, 1, 2, -1 };
+      return true;
+    case SurfaceFormat::A8R8G8B8:
+      aLayout = { 1, 2, 3, 0 };
+      return true;
+    case SurfaceFormat::X8R8G8B8:
+      aLayout = { 1, 2, 3, -1 };
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The padding byte of formats without alpha.
+int32_t
+PaddingOffset(const PixelLayout& aLayout)
+{
+  return aLayout.mR == 0 || aLayout.mB == 0 ? 3 : 0;
+}
+
+template<uint8_t (*Convert)(uint8_t, uint8_t)>
+void
+ConvertData_Scalar(const uint8_t* aSrc, int32_t aSrcStride,
+                   const PixelLayout& aSrcLayout,
+                   uint8_t* aDst, int32_t aDstStride,
+                   const PixelLayout& aDstLayout,
+                   const IntSize& aSize)
+{
+  int32_t dstA = aDstLayout.HasAlpha() ? aDstLayout.mA
+                                       : PaddingOffset(aDstLayout);
+  for (int32_t y = 0; y < aSize.height; y++) {
+    const uint8_t* src = aSrc + y * aSrcStride;
+    uint8_t* dst = aDst + y * aDstStride;
+    for (int32_t x = 0; x < aSize.width; x++, src += 4, dst += 4) {
+      uint8_t a = src[aSrcLayout.mA];
+      uint8_t r = Convert(a, src[aSrcLayout.mR]);
+      uint8_t g = Convert(a, src[aSrcLayout.mG]);
+      uint8_t b = Convert(a, src[aSrcLayout.mB]);
+      dst[aDstLayout.mR] = r;
+      dst[aDstLayout.mG] = g;
+      dst[aDstLayout.mB] = b;
+      dst[dstA] = a;
+    }
+  }
+}
+
+void
+SwizzleData_Scalar(const uint8_t* aSrc, int32_t aSrcStride,
+                   const PixelLayout& aSrcLayout,
+                   uint8_t* aDst, int32_t aDstStride,
+                   const PixelLayout& aDstLayout,
+                   const IntSize& aSize)
+{
+  int32_t dstA = aDstLayout.HasAlpha() ? aDstLayout.mA
+                                       : PaddingOffset(aDstLayout);
+  for (int32_t y = 0; y < aSize.height; y++) {
+    const uint8_t* src = aSrc + y * aSrcStride;
+    uint8_t* dst = aDst + y * aDstStride;
+    for (int32_t x = 0; x < aSize.width; x++, src += 4, dst += 4) {
+      uint8_t a = aSrcLayout.HasAlpha() ? src[aSrcLayout.mA] : 0xFF;
+      uint8_t r = src[aSrcLayout.mR];
+      uint8_t g = src[aSrcLayout.mG];
+      uint8_t b = src[aSrcLayout.mB];
+      dst[aDstLayout.mR] = r;
+      dst[aDstLayout.mG] = g;
+      dst[aDstLayout.mB] = b;
+      dst[dstA] = a;
+    }
+  }
+}
+
+} // namespace
+
+bool
+PremultiplyData(const uint8_t* aSrc, int32_t aSrcStride,
+                SurfaceFormat aSrcFormat,
+                uint8_t* aDst, int32_t aDstStride,
+                SurfaceFormat aDstFormat,
+                const IntSize& aSize)
+{
+  PixelLayout srcLayout, dstLayout;
+  if (!GetPixelLayout(aSrcFormat, srcLayout) ||
+      !GetPixelLayout(aDstFormat, dstLayout)) {
+    return false;
+  }
+
+  if (!srcLayout.HasAlpha()) {
+    return SwizzleData(aSrc, aSrcStride, aSrcFormat,
+                       aDst, aDstStride, aDstFormat, aSize);
+  }
+
+#ifdef USE_SSE2
+  if (Factory::HasSSE2() && srcLayout.AlphaLast() && dstLayout.AlphaLast()) {
+    PremultiplyData_SSE2(aSrc, aSrcStride, aDst, aDstStride, aSize,
+                         srcLayout.RedFirst() != dstLayout.RedFirst());
+    return true;
+  }
+#endif
+
+  ConvertData_Scalar<PremultiplyValue>(aSrc, aSrcStride, srcLayout,
+                                       aDst, aDstStride, dstLayout, aSize);
+  return true;
+}
+
+bool
+UnpremultiplyData(const uint8_t* aSrc, int32_t aSrcStride,
+                  SurfaceFormat aSrcFormat,
+                  uint8_t* aDst, int32_t aDstStride,
+                  SurfaceFormat aDstFormat,
+                  const IntSize& aSize)
+{
+  PixelLayout srcLayout, dstLayout;
+  if (!GetPixelLayout(aSrcFormat, srcLayout) ||
+      !GetPixelLayout(aDstFormat, dstLayout)) {
+    return false;
+  }
+
+  if (!srcLayout.HasAlpha()) {
+    return SwizzleData(aSrc, aSrcStride, aSrcFormat,
+                       aDst, aDstStride, aDstFormat, aSize);
+  }
+
+#ifdef USE_SSE2
+  if (Factory::HasSSE2() && srcLayout.AlphaLast() && dstLayout.AlphaLast()) {
+    UnpremultiplyData_SSE2(aSrc, aSrcStride, aDst, aDstStride, aSize,
+                           srcLayout.RedFirst() != dstLayout.RedFirst());
+    return true;
+  }
+#endif
+
+  ConvertData_Scalar<UnpremultiplyValue>(aSrc, aSrcStride, srcLayout,
+                                         aDst, aDstStride, dstLayout, aSize);
+  return true;
+}
+
+bool
+SwizzleData(const uint8_t* aSrc, int32_t aSrcStride,
+            SurfaceFormat aSrcFormat,
+            uint8_t* aDst, int32_t aDstStride,
+            SurfaceFormat aDstFormat,
+            const IntSize& aSize)
+{
+  PixelLayout srcLayout, dstLayout;
+  if (!GetPixelLayout(aSrcFormat, srcLayout) ||
+      !GetPixelLayout(aDstFormat, dstLayout)) {
+    return false;
+  }
+
+#ifdef USE_SSE2
+  if (Factory::HasSSE2() && srcLayout.AlphaLast() && dstLayout.AlphaLast()) {
+    SwizzleData_SSE2(aSrc, aSrcStride, aDst, aDstStride, aSize,
+                     srcLayout.RedFirst() != dstLayout.RedFirst(),
+                     !srcLayout.HasAlpha());
+    return true;
+  }
+#endif
+
+  SwizzleData_Scalar(aSrc, aSrcStride, srcLayout,
+                     aDst, aDstStride, dstLayout, aSize);
+  return true;
+}
+
+} // namespace gfx
+} // namespace mozilla
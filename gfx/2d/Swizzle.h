@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MOZILLA_GFX_SWIZZLE_H_
+#define MOZILLA_GFX_SWIZZLE_H_
+
+#include "Point.h"
+
+namespace mozilla {
+namespace gfx {
+
+/**
+ * The functions below convert between the 32-bit pixel formats B8G8R8A8,
+ * B8G8R8X8, R8G8B8A8, R8G8B8X8, A8R8G8B8 and X8R8G8B8, reordering the
+ * channels as needed. They return false if either format is not one of
+ * those.
+ *
+ * Their rounding matches gfxUtils::sPremultiplyTable and
+ * gfxUtils::sUnpremultiplyTable exactly, so they can replace lookups in those
+ * tables without changing any results.
+ */
+
+/**
+ * Premultiplies the color channels of aSrc by its alpha channel. A source
+ * format without alpha is treated as opaque.
+ */
+bool
+PremultiplyData(const uint8_t* aSrc, int32_t aSrcStride,
+                SurfaceFormat aSrcFormat,
+                uint8_t* aDst, int32_t aDstStride,
+                SurfaceFormat aDstFormat,
+                const IntSize& aSize);
+
+/**
+ * Divides the color channels of aSrc by its alpha channel. A source format
+ * without alpha is treated as opaque.
+ */
+bool
+UnpremultiplyData(const uint8_t* aSrc, int32_t aSrcStride,
+                  SurfaceFormat aSrcFormat,
+                  uint8_t* aDst, int32_t aDstStride,
+                  SurfaceFormat aDstFormat,
+                  const IntSize& aSize);
+
+/**
+ * Copies aSrc to aDst, reordering the channels. Alpha is set to opaque when
+ * the source format has none.
+ */
+bool
+SwizzleData(const uint8_t* aSrc, int32_t aSrcStride,
+            SurfaceFormat aSrcFormat,
+            uint8_t* aDst, int32_t aDstStride,
+            SurfaceFormat aDstFormat,
+            const IntSize& aSize);
+
+} // namespace gfx
+} // namespace mozilla
+
+#endif /* MOZILLA_GFX_SWIZZLE_H_ */
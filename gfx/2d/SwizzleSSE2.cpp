@@ -0,0 +1,182 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Swizzle-inl.h"
+
+#include <emmintrin.h>
+
+namespace mozilla {
+namespace gfx {
+
+// All of the kernels below work on four pixels at a time and fall back to
+// per-pixel code for the rest of each row. Every format they handle keeps
+// alpha (or padding) in the last byte of a pixel.
+
+static inline void
+SwapRB(uint8_t* aPixel)
+{
+  uint8_t r = aPixel[0];
+  aPixel[0] = aPixel[2];
+  aPixel[2] = r;
+}
+
+// Premultiplies two pixels held as eight 16-bit lanes.
+static inline __m128i
+PremultiplyPixels(__m128i aPixels, bool aSwapRB)
+{
+  const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+  __m128i alpha = _mm_shufflelo_epi16(aPixels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+  // (a * v + 254) / 255, computed as in PremultiplyValue. None of the
+  // intermediate values overflow 16 bits.
+  __m128i x = _mm_add_epi16(_mm_mullo_epi16(aPixels, alpha),
+                            _mm_set1_epi16(254));
+  x = _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)),
+                    _mm_srli_epi16(x, 8));
+  x = _mm_srli_epi16(x, 8);
+
+  // Keep the original alpha.
+  x = _mm_or_si128(_mm_andnot_si128(alphaMask, x),
+                   _mm_and_si128(alphaMask, aPixels));
+
+  if (aSwapRB) {
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 0, 1, 2));
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 0, 1, 2));
+  }
+  return x;
+}
+
+void
+PremultiplyData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                     uint8_t* aDst, int32_t aDstStride,
+                     const IntSize& aSize, bool aSwapRB)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int32_t alignedWidth = aSize.width & ~3;
+
+  for (int32_t y = 0; y < aSize.height; y++) {
+    const uint8_t* src = aSrc + y * aSrcStride;
+    uint8_t* dst = aDst + y * aDstStride;
+
+    for (int32_t x = 0; x < alignedWidth; x += 4, src += 16, dst += 16) {
+      __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      __m128i lo = PremultiplyPixels(_mm_unpacklo_epi8(px, zero), aSwapRB);
+      __m128i hi = PremultiplyPixels(_mm_unpackhi_epi8(px, zero), aSwapRB);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                       _mm_packus_epi16(lo, hi));
+    }
+
+    for (int32_t x = alignedWidth; x < aSize.width; x++, src += 4, dst += 4) {
+      uint8_t a = src[3];
+      dst[0] = PremultiplyValue(a, src[0]);
+      dst[1] = PremultiplyValue(a, src[1]);
+      dst[2] = PremultiplyValue(a, src[2]);
+      dst[3] = a;
+      if (aSwapRB) {
+        SwapRB(dst);
+      }
+    }
+  }
+}
+
+// Unpremultiplies one pixel held as four 32-bit lanes, multiplying by the
+// factors described at sUnpremultiplyFactors.
+static inline __m128i
+UnpremultiplyPixel(__m128i aPixel, uint8_t aAlpha, bool aSwapRB)
+{
+  __m128 factors = _mm_load_ps(sUnpremultiplyFactors[aAlpha]);
+  __m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(aPixel), factors));
+  // Reduce modulo 256 like sUnpremultiplyTable does for invalid input.
+  q = _mm_and_si128(q, _mm_set1_epi32(0xFF));
+  if (aSwapRB) {
+    q = _mm_shuffle_epi32(q, _MM_SHUFFLE(3, 0, 1, 2));
+  }
+  return q;
+}
+
+void
+UnpremultiplyData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                       uint8_t* aDst, int32_t aDstStride,
+                       const IntSize& aSize, bool aSwapRB)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int32_t alignedWidth = aSize.width & ~3;
+
+  for (int32_t y = 0; y < aSize.height; y++) {
+    const uint8_t* src = aSrc + y * aSrcStride;
+    uint8_t* dst = aDst + y * aDstStride;
+
+    for (int32_t x = 0; x < alignedWidth; x += 4, src += 16, dst += 16) {
+      __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      __m128i lo = _mm_unpacklo_epi8(px, zero);
+      __m128i hi = _mm_unpackhi_epi8(px, zero);
+      __m128i p0 = UnpremultiplyPixel(_mm_unpacklo_epi16(lo, zero), src[3],
+                                      aSwapRB);
+      __m128i p1 = UnpremultiplyPixel(_mm_unpackhi_epi16(lo, zero), src[7],
+                                      aSwapRB);
+      __m128i p2 = UnpremultiplyPixel(_mm_unpacklo_epi16(hi, zero), src[11],
+                                      aSwapRB);
+      __m128i p3 = UnpremultiplyPixel(_mm_unpackhi_epi16(hi, zero), src[15],
+                                      aSwapRB);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                       _mm_packus_epi16(_mm_packs_epi32(p0, p1),
+                                        _mm_packs_epi32(p2, p3)));
+    }
+
+    for (int32_t x = alignedWidth; x < aSize.width; x++, src += 4, dst += 4) {
+      uint8_t a = src[3];
+      dst[0] = UnpremultiplyValue(a, src[0]);
+      dst[1] = UnpremultiplyValue(a, src[1]);
+      dst[2] = UnpremultiplyValue(a, src[2]);
+      dst[3] = a;
+      if (aSwapRB) {
+        SwapRB(dst);
+      }
+    }
+  }
+}
+
+void
+SwizzleData_SSE2(const uint8_t* aSrc, int32_t aSrcStride,
+                 uint8_t* aDst, int32_t aDstStride,
+                 const IntSize& aSize, bool aSwapRB, bool aOpaque)
+{
+  const __m128i greenAlphaMask = _mm_set1_epi32(int32_t(0xFF00FF00));
+  const __m128i lowByteMask = _mm_set1_epi32(0x000000FF);
+  const __m128i opaque = _mm_set1_epi32(aOpaque ? int32_t(0xFF000000) : 0);
+  int32_t alignedWidth = aSize.width & ~3;
+
+  for (int32_t y = 0; y < aSize.height; y++) {
+    const uint8_t* src = aSrc + y * aSrcStride;
+    uint8_t* dst = aDst + y * aDstStride;
+
+    for (int32_t x = 0; x < alignedWidth; x += 4, src += 16, dst += 16) {
+      // Pixels are read as little-endian 32-bit values, with the first byte
+      // in the low bits and alpha in the high bits.
+      __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      if (aSwapRB) {
+        __m128i first = _mm_and_si128(px, lowByteMask);
+        __m128i third = _mm_and_si128(_mm_srli_epi32(px, 16), lowByteMask);
+        px = _mm_or_si128(_mm_and_si128(px, greenAlphaMask),
+                          _mm_or_si128(_mm_slli_epi32(first, 16), third));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                       _mm_or_si128(px, opaque));
+    }
+
+    for (int32_t x = alignedWidth; x < aSize.width; x++, src += 4, dst += 4) {
+      uint8_t first = src[0];
+      dst[0] = aSwapRB ? src[2] : first;
+      dst[1] = src[1];
+      dst[2] = aSwapRB ? first : src[2];
+      dst[3] = aOpaque ? 0xFF : src[3];
+    }
+  }
+}
+
+} // namespace gfx
+} // namespace mozilla
@@ -0,0 +1,145 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h"
+
+#include "gfxGradientCache.h"
+#include "mozilla/gfx/2D.h"
+#include "nsTArray.h"
+
+using namespace mozilla;
+using namespace mozilla::gfx;
+
+static already_AddRefed<DrawTarget>
+CreateSkiaDrawTarget(const IntSize& aSize)
+{
+  return Factory::CreateDrawTarget(BackendType::SKIA, aSize,
+                                   SurfaceFormat::B8G8R8A8);
+}
+
+static void
+MakeStops(nsTArray<GradientStop>& aStops)
+{
+  GradientStop stop;
+  stop.offset = 0.0f;
+  stop.color = Color(1.0f, 0.0f, 0.0f, 1.0f);
+  aStops.AppendElement(stop);
+  stop.offset = 0.3f;
+  stop.color = Color(0.0f, 1.0f, 0.0f, 0.5f);
+  aStops.AppendElement(stop);
+  stop.offset = 0.7f;
+  stop.color = Color(0.0f, 0.0f, 1.0f, 1.0f);
+  aStops.AppendElement(stop);
+  stop.offset = 1.0f;
+  stop.color = Color(1.0f, 1.0f, 1.0f, 0.0f);
+  aStops.AppendElement(stop);
+}
+
+static bool
+SurfacesEqual(SourceSurface* aA, SourceSurface* aB)
+{
+  RefPtr<DataSourceSurface> a = aA->GetDataSurface();
+  RefPtr<DataSourceSurface> b = aB->GetDataSurface();
+  DataSourceSurface::ScopedMap mapA(a, DataSourceSurface::READ);
+  DataSourceSurface::ScopedMap mapB(b, DataSourceSurface::READ);
+  IntSize size = a->GetSize();
+  for (int32_t y = 0; y < size.height; ++y) {
+    if (memcmp(mapA.GetData() + y * mapA.GetStride(),
+               mapB.GetData() + y * mapB.GetStride(),
+               size.width * BytesPerPixel(a->GetFormat())) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(GfxGradientCache, SharesStops)
+{
+  RefPtr<DrawTarget> dt = CreateSkiaDrawTarget(IntSize(16, 16));
+  ASSERT_TRUE(dt != nullptr);
+
+  nsTArray<GradientStop> stops;
+  MakeStops(stops);
+
+  RefPtr<GradientStops> first =
+    gfxGradientCache::GetOrCreateGradientStops(dt, stops, ExtendMode::REPEAT);
+  RefPtr<GradientStops> second =
+    gfxGradientCache::GetOrCreateGradientStops(dt, stops, ExtendMode::REPEAT);
+  RefPtr<GradientStops> clamped =
+    gfxGradientCache::GetOrCreateGradientStops(dt, stops, ExtendMode::CLAMP);
+
+  ASSERT_TRUE(first != nullptr);
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, clamped);
+}
+
+TEST(GfxGradientCache, RepaintMatches)
+{
+  // Painting the same gradient repeatedly reuses cached state; make sure the
+  // result is identical to the first paint, and that painting a different
+  // gradient with the same stops in between doesn't disturb it.
+  IntSize size(64, 64);
+  RefPtr<DrawTarget> dt1 = CreateSkiaDrawTarget(size);
+  RefPtr<DrawTarget> dt2 = CreateSkiaDrawTarget(size);
+  ASSERT_TRUE(dt1 != nullptr && dt2 != nullptr);
+
+  nsTArray<GradientStop> stops;
+  MakeStops(stops);
+  RefPtr<GradientStops> gs =
+    gfxGradientCache::GetOrCreateGradientStops(dt1, stops, ExtendMode::REPEAT);
+  ASSERT_TRUE(gs != nullptr);
+
+  Rect rect(0, 0, size.width, size.height);
+  LinearGradientPattern linear(Point(0, 0), Point(20, 10), gs);
+  RadialGradientPattern radial(Point(32, 32), Point(32, 32), 0, 16, gs);
+
+  // Use OP_SOURCE so that each fill replaces what was there before, rather
+  // than blending the translucent stops over the previous gradient.
+  DrawOptions source(1.0f, CompositionOp::OP_SOURCE);
+  dt1->FillRect(rect, linear, source);
+  dt2->FillRect(rect, radial, source);
+  dt2->FillRect(rect, linear, source);
+
+  RefPtr<SourceSurface> s1 = dt1->Snapshot();
+  RefPtr<SourceSurface> s2 = dt2->Snapshot();
+  EXPECT_TRUE(SurfacesEqual(s1, s2));
+}
+
+static void
+BenchRepeatingGradients(ExtendMode aExtend)
+{
+  IntSize size(1024, 768);
+  RefPtr<DrawTarget> dt = CreateSkiaDrawTarget(size);
+  ASSERT_TRUE(dt != nullptr);
+
+  nsTArray<GradientStop> stops;
+  MakeStops(stops);
+
+  // Simulate a layer full of gradient-styled UI being repainted: look the
+  // stops up through the cache each time, as gfxPattern does. The gradient
+  // itself is the same for every row, and we move it into place with the
+  // transform, so that its cached state can be reused across draws.
+  Rect rect(0, 0, size.width, 48);
+  for (int i = 0; i < 50; ++i) {
+    for (int j = 0; j < 16; ++j) {
+      RefPtr<GradientStops> gs =
+        gfxGradientCache::GetOrCreateGradientStops(dt, stops, aExtend);
+      LinearGradientPattern pattern(Point(0, 0), Point(40, 48), gs);
+      dt->SetTransform(Matrix::Translation(0, j * 48));
+      dt->FillRect(rect, pattern);
+    }
+  }
+  dt->SetTransform(Matrix());
+  dt->Flush();
+}
+
+MOZ_GTEST_BENCH(GfxGradientCache, RepeatingLinearGradients, [] {
+  BenchRepeatingGradients(ExtendMode::REPEAT);
+});
+
+MOZ_GTEST_BENCH(GfxGradientCache, ClampedLinearGradients, [] {
+  BenchRepeatingGradients(ExtendMode::CLAMP);
+});
@@ -0,0 +1,212 @@
+/* -*- Mode: C++; tab-width: 20; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h"
+
+#include "gfxUtils.h"
+#include "mozilla/gfx/Swizzle.h"
+#include "nsTArray.h"
+
+using namespace mozilla;
+using namespace mozilla::gfx;
+
+// An odd width, so that every row has pixels left over after the vectorized
+// loops, and a stride with padding that must be left alone.
+static const int32_t kWidth = 259;
+static const int32_t kStride = kWidth * 4 + 12;
+
+// Every row has a different alpha, and every pixel different colors.
+static void
+FillRGBA(nsTArray<uint8_t>& aData)
+{
+  aData.SetLength(kStride * 256);
+  memset(aData.Elements(), 0xAB, aData.Length());
+  for (int32_t y = 0; y < 256; y++) {
+    uint8_t* row = aData.Elements() + y * kStride;
+    for (int32_t x = 0; x < kWidth; x++) {
+      uint8_t c = x & 0xFF;
+      row[x * 4 + 0] = c;
+      row[x * 4 + 1] = 255 - c;
+      row[x * 4 + 2] = c * 7;
+      row[x * 4 + 3] = y;
+    }
+  }
+}
+
+static bool
+PaddingUntouched(const nsTArray<uint8_t>& aData)
+{
+  for (int32_t y = 0; y < 256; y++) {
+    const uint8_t* row = aData.Elements() + y * kStride;
+    for (int32_t i = kWidth * 4; i < kStride; i++) {
+      if (row[i] != 0xAB) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+TEST(GfxSwizzle, PremultiplyMatchesTable)
+{
+  nsTArray<uint8_t> src, dst;
+  FillRGBA(src);
+  dst.SetLength(src.Length());
+  memset(dst.Elements(), 0xAB, dst.Length());
+
+  ASSERT_TRUE(PremultiplyData(src.Elements(), kStride, SurfaceFormat::R8G8B8A8,
+                              dst.Elements(), kStride, SurfaceFormat::B8G8R8A8,
+                              IntSize(kWidth, 256)));
+
+  for (int32_t y = 0; y < 256; y++) {
+    const uint8_t* s = src.Elements() + y * kStride;
+    const uint8_t* d = dst.Elements() + y * kStride;
+    for (int32_t x = 0; x < kWidth; x++, s += 4, d += 4) {
+      uint8_t a = s[3];
+      ASSERT_EQ(d[0], gfxUtils::sPremultiplyTable[a * 256 + s[2]]);
+      ASSERT_EQ(d[1], gfxUtils::sPremultiplyTable[a * 256 + s[1]]);
+      ASSERT_EQ(d[2], gfxUtils::sPremultiplyTable[a * 256 + s[0]]);
+      ASSERT_EQ(d[3], a);
+    }
+  }
+  EXPECT_TRUE(PaddingUntouched(dst));
+}
+
+TEST(GfxSwizzle, UnpremultiplyMatchesTable)
+{
+  // Unpremultiply everything, including colors larger than their alpha,
+  // which premultiplied data should never contain.
+  nsTArray<uint8_t> src, dst;
+  FillRGBA(src);
+  dst.SetLength(src.Length());
+  memset(dst.Elements(), 0xAB, dst.Length());
+
+  ASSERT_TRUE(UnpremultiplyData(src.Elements(), kStride,
+                                SurfaceFormat::B8G8R8A8,
+                                dst.Elements(), kStride,
+                                SurfaceFormat::R8G8B8A8,
+                                IntSize(kWidth, 256)));
+
+  for (int32_t y = 0; y < 256; y++) {
+    const uint8_t* s = src.Elements() + y * kStride;
+    const uint8_t* d = dst.Elements() + y * kStride;
+    for (int32_t x = 0; x < kWidth; x++, s += 4, d += 4) {
+      uint8_t a = s[3];
+      ASSERT_EQ(d[0], gfxUtils::sUnpremultiplyTable[a * 256 + s[2]]);
+      ASSERT_EQ(d[1], gfxUtils::sUnpremultiplyTable[a * 256 + s[1]]);
+      ASSERT_EQ(d[2], gfxUtils::sUnpremultiplyTable[a * 256 + s[0]]);
+      ASSERT_EQ(d[3], a);
+    }
+  }
+  EXPECT_TRUE(PaddingUntouched(dst));
+}
+
+TEST(GfxSwizzle, OpaqueSourceIgnoresPadding)
+{
+  nsTArray<uint8_t> src, dst;
+  FillRGBA(src);
+  dst.SetLength(src.Length());
+  memset(dst.Elements(), 0xAB, dst.Length());
+
+  ASSERT_TRUE(UnpremultiplyData(src.Elements(), kStride,
+                                SurfaceFormat::B8G8R8X8,
+                                dst.Elements(), kStride,
+                                SurfaceFormat::R8G8B8A8,
+                                IntSize(kWidth, 256)));
+
+  for (int32_t y = 0; y < 256; y++) {
+    const uint8_t* s = src.Elements() + y * kStride;
+    const uint8_t* d = dst.Elements() + y * kStride;
+    for (int32_t x = 0; x < kWidth; x++, s += 4, d += 4) {
+      ASSERT_EQ(d[0], s[2]);
+      ASSERT_EQ(d[1], s[1]);
+      ASSERT_EQ(d[2], s[0]);
+      ASSERT_EQ(d[3], 0xFF);
+    }
+  }
+  EXPECT_TRUE(PaddingUntouched(dst));
+}
+
+TEST(GfxSwizzle, RoundTripIsLossless)
+{
+  // Unpremultiplying premultiplied data and premultiplying it again gives
+  // back the same pixels, which getImageData and putImageData rely on.
+  nsTArray<uint8_t> src, premultiplied, unpremultiplied, result;
+  FillRGBA(src);
+  premultiplied.SetLength(src.Length());
+  unpremultiplied.SetLength(src.Length());
+  result.SetLength(src.Length());
+
+  IntSize size(kWidth, 256);
+  PremultiplyData(src.Elements(), kStride, SurfaceFormat::R8G8B8A8,
+                  premultiplied.Elements(), kStride, SurfaceFormat::B8G8R8A8,
+                  size);
+  UnpremultiplyData(premultiplied.Elements(), kStride, SurfaceFormat::B8G8R8A8,
+                    unpremultiplied.Elements(), kStride,
+                    SurfaceFormat::R8G8B8A8, size);
+  PremultiplyData(unpremultiplied.Elements(), kStride, SurfaceFormat::R8G8B8A8,
+                  result.Elements(), kStride, SurfaceFormat::B8G8R8A8, size);
+
+  for (int32_t y = 0; y < 256; y++) {
+    EXPECT_EQ(0, memcmp(premultiplied.Elements() + y * kStride,
+                        result.Elements() + y * kStride, kWidth * 4));
+  }
+}
+
+TEST(GfxSwizzle, RejectsUnsupportedFormats)
+{
+  uint8_t src[4] = { 0 };
+  uint8_t dst[4] = { 0 };
+  EXPECT_FALSE(PremultiplyData(src, 4, SurfaceFormat::R5G6B5_UINT16,
+                               dst, 4, SurfaceFormat::B8G8R8A8,
+                               IntSize(1, 1)));
+  EXPECT_FALSE(SwizzleData(src, 4, SurfaceFormat::B8G8R8A8,
+                           dst, 4, SurfaceFormat::A8, IntSize(1, 1)));
+}
+
+// getImageData and putImageData on full HD and 4K canvases.
+
+static void
+BenchConvert(const IntSize& aSize, bool aPremultiply)
+{
+  int32_t stride = aSize.width * 4;
+  nsTArray<uint8_t> src, dst;
+  src.SetLength(stride * aSize.height);
+  dst.SetLength(stride * aSize.height);
+  for (size_t i = 0; i < src.Length(); i += 4) {
+    uint8_t a = (i / 4) % 256;
+    src[i] = src[i + 1] = src[i + 2] = a / 2;
+    src[i + 3] = a;
+  }
+
+  for (int i = 0; i < 10; i++) {
+    if (aPremultiply) {
+      PremultiplyData(src.Elements(), stride, SurfaceFormat::R8G8B8A8,
+                      dst.Elements(), stride, SurfaceFormat::B8G8R8A8,
+                      aSize);
+    } else {
+      UnpremultiplyData(src.Elements(), stride, SurfaceFormat::B8G8R8A8,
+                        dst.Elements(), stride, SurfaceFormat::R8G8B8A8,
+                        aSize);
+    }
+  }
+}
+
+MOZ_GTEST_BENCH(GfxSwizzle, Premultiply1080p, [] {
+  BenchConvert(IntSize(1920, 1080), true);
+});
+
+MOZ_GTEST_BENCH(GfxSwizzle, Premultiply4K, [] {
+  BenchConvert(IntSize(3840, 2160), true);
+});
+
+MOZ_GTEST_BENCH(GfxSwizzle, Unpremultiply1080p, [] {
+  BenchConvert(IntSize(1920, 1080), false);
+});
+
+MOZ_GTEST_BENCH(GfxSwizzle, Unpremultiply4K, [] {
+  BenchConvert(IntSize(3840, 2160), false);
+});
@@ -455,6 +455,21 @@ Decoder::PostFrameStop(Opacity aFrameOpacity
   }
 }
 
+void
+Decoder::TrimTransparentFrameBorder(uint8_t aTransparentIndex)
+{
+  MOZ_ASSERT(mInFrame, "Trimming a frame when we didn't start one");
+  MOZ_ASSERT(mCurrentFrame, "Trimming a frame when we don't have one");
+  MOZ_ASSERT(mCurrentFrame->GetIsPaletted(), "Can only trim paletted frames");
+
+  if (!mCurrentFrame->TrimTransparentBorder(aTransparentIndex)) {
+    return;
+  }
+
+  mCurrentFrame->GetImageData(&mImageData, &mImageDataLength);
+  mCurrentFrame->GetPaletteData(&mColormap, &mColormapSize);
+}
+
 void
 Decoder::PostInvalidation(const nsIntRect& aRect,
                           const Maybe<nsIntRect>& aRectAtTargetSize
@@ -348,6 +348,14 @@ protected:
                      BlendMethod aBlendMethod = BlendMethod::OVER,
                      const Maybe<nsIntRect>& aBlendRect = Nothing());
 
+  // Called by decoders before PostFrameStop() to drop the border of the
+  // current paletted frame made of pixels with palette index
+  // aTransparentIndex. Only valid for frames that are blended OVER the previous
+  // frame and kept. The frame's buffers may move, so this updates mImageData
+  // and mColormap; any other pointers into them, such as a SurfacePipe, must
+  // not be used afterwards.
+  void TrimTransparentFrameBorder(uint8_t aTransparentIndex);
+
   /**
    * Called by the decoders when they have a region to invalidate. We may not
    * actually pass these invalidations on right away.
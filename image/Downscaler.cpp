@@ -14,6 +14,7 @@
 #include "mozilla/SSE.h"
 #include "mozilla/mips.h"
 #include "convolver.h"
+#include "DownscalingFilter.h"
 #include "skia/include/core/SkTypes.h"
 
 using std::max;
@@ -104,9 +105,8 @@ Downscaler::BeginFrame(const nsIntSize& aOriginalSize,
 
   ReleaseWindow();
 
-  auto resizeMethod = skia::ImageOperations::RESIZE_LANCZOS3;
-
-  skia::resize::ComputeFilters(resizeMethod,
+  skia::resize::ComputeFilters(DownscalingResizeMethod(mOriginalSize.width,
+                                                       mTargetSize.width),
                                mOriginalSize.width, mTargetSize.width,
                                0, mTargetSize.width,
                                mXFilter.get());
@@ -116,7 +116,8 @@ Downscaler::BeginFrame(const nsIntSize& aOriginalSize,
     return NS_ERROR_OUT_OF_MEMORY;
   }
 
-  skia::resize::ComputeFilters(resizeMethod,
+  skia::resize::ComputeFilters(DownscalingResizeMethod(mOriginalSize.height,
+                                                       mTargetSize.height),
                                mOriginalSize.height, mTargetSize.height,
                                0, mTargetSize.height,
                                mYFilter.get());
@@ -86,9 +86,31 @@ protected:
 
 #else
 
+/**
+ * Chooses the resampling filter to use when downscaling from @aInputLength to
+ * @aOutputLength pixels along one axis. Lanczos gives the sharpest results, but
+ * its support grows linearly with the reduction ratio, so a 20MP photo decoded
+ * into a thumbnail would touch hundreds of input pixels per output pixel. Past
+ * the ratio given by the "image.downscale-during-decode.area-averaging-min-ratio"
+ * pref we switch to area averaging (a box filter), which reads each input pixel
+ * about once and is visually indistinguishable at such large reductions.
+ */
+inline skia::ImageOperations::ResizeMethod
+DownscalingResizeMethod(int32_t aInputLength, int32_t aOutputLength)
+{
+  const uint32_t minRatio = gfxPrefs::ImageDownscaleAreaAveragingMinRatio();
+  if (minRatio > 0 && aOutputLength > 0 &&
+      int64_t(aInputLength) >= int64_t(aOutputLength) * minRatio) {
+    return skia::ImageOperations::RESIZE_BOX;
+  }
+
+  return skia::ImageOperations::RESIZE_LANCZOS3;
+}
+
 /**
  * DownscalingFilter performs Lanczos downscaling, taking image input data at one size
- * and outputting it rescaled to a different size.
+ * and outputting it rescaled to a different size. For large reduction ratios it
+ * falls back to area averaging; see DownscalingResizeMethod().
  *
  * The 'Next' template parameter specifies the next filter in the chain.
  */
@@ -151,14 +173,14 @@ public:
 
     ReleaseWindow();
 
-    auto resizeMethod = skia::ImageOperations::RESIZE_LANCZOS3;
-
-    skia::resize::ComputeFilters(resizeMethod,
+    skia::resize::ComputeFilters(DownscalingResizeMethod(mInputSize.width,
+                                                         outputSize.width),
                                  mInputSize.width, outputSize.width,
                                  0, outputSize.width,
                                  mXFilter.get());
 
-    skia::resize::ComputeFilters(resizeMethod,
+    skia::resize::ComputeFilters(DownscalingResizeMethod(mInputSize.height,
+                                                         outputSize.height),
                                  mInputSize.height, outputSize.height,
                                  0, outputSize.height,
                                  mYFilter.get());
@@ -360,8 +382,8 @@ private:
   UniquePtr<uint8_t[]> mRowBuffer;  /// The buffer into which input is written.
   UniquePtr<uint8_t*[]> mWindow;    /// The last few rows which were written.
 
-  UniquePtr<skia::ConvolutionFilter1D> mXFilter;  /// The Lanczos filter in X.
-  UniquePtr<skia::ConvolutionFilter1D> mYFilter;  /// The Lanczos filter in Y.
+  UniquePtr<skia::ConvolutionFilter1D> mXFilter;  /// The resampling filter in X.
+  UniquePtr<skia::ConvolutionFilter1D> mYFilter;  /// The resampling filter in Y.
 
   int32_t mWindowCapacity;  /// How many rows the window contains.
 
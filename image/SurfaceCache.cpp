@@ -12,6 +12,8 @@
 #include <algorithm>
 #include "mozilla/Assertions.h"
 #include "mozilla/Attributes.h"
+#include "mozilla/Compression.h"
+#include "mozilla/CondVar.h"
 #include "mozilla/DebugOnly.h"
 #include "mozilla/Likely.h"
 #include "mozilla/Move.h"
@@ -20,20 +22,27 @@
 #include "mozilla/RefPtr.h"
 #include "mozilla/StaticPtr.h"
 #include "mozilla/Tuple.h"
+#include "mozilla/UniquePtr.h"
 #include "nsIMemoryReporter.h"
 #include "gfx2DGlue.h"
 #include "gfxPattern.h"  // Workaround for flaw in bug 921753 part 2.
 #include "gfxPlatform.h"
 #include "gfxPrefs.h"
 #include "imgFrame.h"
+#include "imgIContainer.h"
 #include "Image.h"
 #include "ISurfaceProvider.h"
 #include "LookupResult.h"
 #include "nsExpirationTracker.h"
 #include "nsHashKeys.h"
+#include "nsIEventTarget.h"
+#include "nsNetCID.h"
+#include "nsProxyRelease.h"
 #include "nsRefPtrHashtable.h"
 #include "nsSize.h"
+#include "nsServiceManagerUtils.h"
 #include "nsTArray.h"
+#include "nsThreadUtils.h"
 #include "prsystem.h"
 #include "ShutdownTracker.h"
 
@@ -56,6 +65,8 @@ class SurfaceCacheImpl;
 // The single surface cache instance.
 static StaticRefPtr<SurfaceCacheImpl> sInstance;
 
+MOZ_DEFINE_MALLOC_SIZE_OF(SurfaceCacheMallocSizeOf)
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // SurfaceCache Implementation
@@ -237,6 +248,258 @@ private:
   const SurfaceKey   mSurfaceKey;
 };
 
+/**
+ * A SurfaceSnapshot keeps the pixels of a surface which is being evicted from
+ * the cache alive until they can be compressed. Taking a snapshot is cheap, so
+ * it happens while holding the SurfaceCache mutex; the compression itself
+ * happens later on a background thread, without the mutex.
+ */
+class SurfaceSnapshot
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(SurfaceSnapshot)
+
+  SurfaceSnapshot(const ImageKey     aImageKey,
+                  const SurfaceKey&  aSurfaceKey,
+                  DataSourceSurface* aSurface,
+                  const Cost         aCost)
+    : mImageKey(aImageKey)
+    , mSurfaceKey(aSurfaceKey)
+    , mSurface(aSurface)
+    , mCost(aCost)
+  {
+    MOZ_ASSERT(mImageKey, "Must have a valid image key");
+    MOZ_ASSERT(mSurface, "Must have a surface");
+  }
+
+  /**
+   * Creates a snapshot of @aSurface, or returns null if @aSurface isn't
+   * eligible for compression. Only completely decoded, non-animated raster
+   * surfaces are eligible, since those are the only ones we can faithfully
+   * rematerialize from their pixels alone.
+   */
+  static already_AddRefed<SurfaceSnapshot> Create(CachedSurface* aSurface)
+  {
+    // Whether an image is animated can only be reliably determined on the main
+    // thread.
+    MOZ_ASSERT(NS_IsMainThread());
+
+    if (aSurface->IsPlaceholder() || !aSurface->IsDecoded()) {
+      return nullptr;
+    }
+
+    ImageKey imageKey = aSurface->GetImageKey();
+    if (imageKey->GetType() != imgIContainer::TYPE_RASTER) {
+      return nullptr;
+    }
+
+    bool animated = false;
+    if (NS_FAILED(imageKey->GetAnimated(&animated)) || animated) {
+      return nullptr;
+    }
+
+    RefPtr<ISurfaceProvider> provider = aSurface->Provider();
+    if (!provider) {
+      return nullptr;
+    }
+
+    DrawableFrameRef frameRef = provider->DrawableRef();
+    if (!frameRef || frameRef->GetIsPaletted() ||
+        frameRef->GetRect() != IntRect(IntPoint(), frameRef->GetImageSize())) {
+      return nullptr;
+    }
+
+    RefPtr<SourceSurface> surface = frameRef->GetSurface();
+    RefPtr<DataSourceSurface> dataSurface =
+      surface ? surface->GetDataSurface() : nullptr;
+    if (!dataSurface) {
+      return nullptr;
+    }
+
+    SurfaceFormat format = dataSurface->GetFormat();
+    if (format != SurfaceFormat::B8G8R8A8 && format != SurfaceFormat::B8G8R8X8) {
+      return nullptr;
+    }
+
+    RefPtr<SurfaceSnapshot> snapshot =
+      new SurfaceSnapshot(imageKey, aSurface->GetSurfaceKey(), dataSurface,
+                          aSurface->GetCostEntry().GetCost());
+    return snapshot.forget();
+  }
+
+  ImageKey GetImageKey() const { return mImageKey; }
+  const SurfaceKey& GetSurfaceKey() const { return mSurfaceKey; }
+  DataSourceSurface* GetSurface() const { return mSurface; }
+
+  /// @return the cost of the evicted surface whose pixels we're keeping alive.
+  Cost GetCost() const { return mCost; }
+
+  bool Matches(const ImageKey aImageKey, const SurfaceKey& aSurfaceKey) const
+  {
+    return mImageKey == aImageKey && mSurfaceKey == aSurfaceKey;
+  }
+
+private:
+  ~SurfaceSnapshot() { }
+
+  const ImageKey                  mImageKey;
+  const SurfaceKey                mSurfaceKey;
+  const RefPtr<DataSourceSurface> mSurface;
+  const Cost                      mCost;
+};
+
+/**
+ * A CompressedSurface holds an LZ4-compressed copy of the pixels of a decoded
+ * raster surface which was evicted from the cache. Decoded images usually
+ * compress well, so keeping these around in a separate, much smaller budget
+ * lets us rematerialize the surface on the next lookup instead of redecoding
+ * the image from scratch.
+ *
+ * CompressedSurface is immutable, so it can be compressed and decompressed
+ * without holding the SurfaceCache mutex.
+ */
+class CompressedSurface
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(CompressedSurface)
+
+  CompressedSurface(const ImageKey     aImageKey,
+                    const SurfaceKey&  aSurfaceKey,
+                    const IntSize&     aSize,
+                    SurfaceFormat      aFormat,
+                    UniquePtr<char[]>  aData,
+                    size_t             aLength)
+    : mImageKey(aImageKey)
+    , mSurfaceKey(aSurfaceKey)
+    , mSize(aSize)
+    , mFormat(aFormat)
+    , mData(Move(aData))
+    , mLength(aLength)
+  {
+    MOZ_ASSERT(mImageKey, "Must have a valid image key");
+    MOZ_ASSERT(mData, "Must have compressed data");
+  }
+
+  /**
+   * Compresses the pixels in @aSnapshot, or returns null if they can't be
+   * compressed or aren't worth compressing. This is expensive, so it must not
+   * be called while holding the SurfaceCache mutex.
+   */
+  static already_AddRefed<CompressedSurface>
+  Create(const SurfaceSnapshot& aSnapshot)
+  {
+    DataSourceSurface* dataSurface = aSnapshot.GetSurface();
+    const SurfaceFormat format = dataSurface->GetFormat();
+
+    DataSourceSurface::ScopedMap map(dataSurface, DataSourceSurface::READ);
+    if (!map.IsMapped()) {
+      return nullptr;
+    }
+
+    // We compress the surface as one contiguous buffer, so we can't handle
+    // row padding.
+    const IntSize size = dataSurface->GetSize();
+    if (map.GetStride() != size.width * int32_t(sizeof(uint32_t))) {
+      return nullptr;
+    }
+
+    const size_t length = size_t(map.GetStride()) * size_t(size.height);
+    const size_t maxCompressedLength =
+      Compression::LZ4::maxCompressedSize(length);
+    UniquePtr<char[]> buffer(new (fallible) char[maxCompressedLength]);
+    if (!buffer) {
+      return nullptr;
+    }
+
+    size_t compressedLength =
+      Compression::LZ4::compress(reinterpret_cast<const char*>(map.GetData()),
+                                 length, buffer.get());
+
+    // If the surface doesn't compress well, it's cheaper to just redecode it.
+    if (compressedLength == 0 || compressedLength > length / 2) {
+      return nullptr;
+    }
+
+    // Don't hold on to the worst case buffer size.
+    UniquePtr<char[]> data(new (fallible) char[compressedLength]);
+    if (!data) {
+      return nullptr;
+    }
+    memcpy(data.get(), buffer.get(), compressedLength);
+
+    RefPtr<CompressedSurface> compressed =
+      new CompressedSurface(aSnapshot.GetImageKey(), aSnapshot.GetSurfaceKey(),
+                            size, format, Move(data), compressedLength);
+    return compressed.forget();
+  }
+
+  /**
+   * @return a newly allocated, finished imgFrame with the original pixels.
+   * Like Create(), this must not be called while holding the mutex.
+   */
+  already_AddRefed<imgFrame> Decompress() const
+  {
+    RefPtr<imgFrame> frame = new imgFrame();
+    bool nonPremult =
+      bool(mSurfaceKey.Flags() & SurfaceFlags::NO_PREMULTIPLY_ALPHA);
+    nsresult rv = frame->InitForDecoder(mSize, IntRect(IntPoint(), mSize),
+                                        mFormat, /* aPaletteDepth = */ 0,
+                                        nonPremult);
+    if (NS_FAILED(rv)) {
+      return nullptr;
+    }
+
+    RawAccessFrameRef frameRef = frame->RawAccessRef();
+    if (!frameRef) {
+      frame->Abort();
+      return nullptr;
+    }
+
+    uint8_t* imageData = nullptr;
+    uint32_t imageLength = 0;
+    frameRef->GetImageData(&imageData, &imageLength);
+
+    size_t decompressedLength = 0;
+    if (!imageData ||
+        !Compression::LZ4::decompress(mData.get(), mLength,
+                                      reinterpret_cast<char*>(imageData),
+                                      imageLength, &decompressedLength) ||
+        decompressedLength != imageLength) {
+      frameRef->Abort();
+      return nullptr;
+    }
+
+    frameRef->Finish(mFormat == SurfaceFormat::B8G8R8X8
+                       ? Opacity::FULLY_OPAQUE
+                       : Opacity::SOME_TRANSPARENCY);
+    return frame.forget();
+  }
+
+  ImageKey GetImageKey() const { return mImageKey; }
+  const SurfaceKey& GetSurfaceKey() const { return mSurfaceKey; }
+  Cost GetCost() const { return mLength; }
+
+  size_t SizeOfIncludingThis(MallocSizeOf aMallocSizeOf) const
+  {
+    return aMallocSizeOf(this) + aMallocSizeOf(mData.get());
+  }
+
+  bool Matches(const ImageKey aImageKey, const SurfaceKey& aSurfaceKey) const
+  {
+    return mImageKey == aImageKey && mSurfaceKey == aSurfaceKey;
+  }
+
+private:
+  ~CompressedSurface() { }
+
+  const ImageKey          mImageKey;
+  const SurfaceKey        mSurfaceKey;
+  const IntSize           mSize;
+  const SurfaceFormat     mFormat;
+  const UniquePtr<char[]> mData;
+  const size_t            mLength;
+};
+
 static int64_t
 AreaOfIntSize(const IntSize& aSize) {
   return static_cast<int64_t>(aSize.width) * static_cast<int64_t>(aSize.height);
@@ -414,7 +677,8 @@ public:
 
   SurfaceCacheImpl(uint32_t aSurfaceCacheExpirationTimeMS,
                    uint32_t aSurfaceCacheDiscardFactor,
-                   uint32_t aSurfaceCacheSize)
+                   uint32_t aSurfaceCacheSize,
+                   uint32_t aCompressedSurfaceCacheSize)
     : mExpirationTracker(aSurfaceCacheExpirationTimeMS)
     , mMemoryPressureObserver(new MemoryPressureObserver)
     , mMutex("SurfaceCache")
@@ -423,11 +687,20 @@ public:
     , mAvailableCost(aSurfaceCacheSize)
     , mLockedCost(0)
     , mOverflowCount(0)
+    , mMaxCompressedCost(aCompressedSurfaceCacheSize)
+    , mCompressedCost(0)
+    , mCompressedHitCount(0)
+    , mCompressionScheduled(false)
+    , mCompressionCondVar(mMutex, "SurfaceCache::mCompressionCondVar")
   {
     nsCOMPtr<nsIObserverService> os = services::GetObserverService();
     if (os) {
       os->AddObserver(mMemoryPressureObserver, "memory-pressure", false);
     }
+
+    if (mMaxCompressedCost > 0) {
+      mCompressionTarget = do_GetService(NS_STREAMTRANSPORTSERVICE_CONTRACTID);
+    }
   }
 
 private:
@@ -463,6 +736,9 @@ public:
       RemoveEntry(aImageKey, aSurfaceKey);
     }
 
+    // A fresh surface supersedes any compressed copy we might have.
+    RemoveCompressed(aImageKey, aSurfaceKey);
+
     MOZ_ASSERT(result.Type() == MatchType::NOT_FOUND ||
                result.Type() == MatchType::PENDING,
                "A LookupResult with no surface should be NOT_FOUND or PENDING");
@@ -474,6 +750,12 @@ public:
       return InsertOutcome::FAILURE;
     }
 
+    // Surfaces which are waiting to be compressed have already expired, so
+    // they're the first thing to go if we need room.
+    if (aCost > mAvailableCost) {
+      DiscardPendingSnapshots();
+    }
+
     // Remove elements in order of cost until we can fit this in the cache. Note
     // that locked surfaces aren't in mCosts, so we never remove them here.
     while (aCost > mAvailableCost) {
@@ -511,7 +793,7 @@ public:
     return InsertOutcome::SUCCESS;
   }
 
-  void Remove(CachedSurface* aSurface)
+  void Remove(CachedSurface* aSurface, bool aNotifyImage = true)
   {
     MOZ_ASSERT(aSurface, "Should have a surface");
     ImageKey imageKey = aSurface->GetImageKey();
@@ -520,7 +802,7 @@ public:
     MOZ_ASSERT(cache, "Shouldn't try to remove a surface with no image cache");
 
     // If the surface was not a placeholder, tell its image that we discarded it.
-    if (!aSurface->IsPlaceholder()) {
+    if (aNotifyImage && !aSurface->IsPlaceholder()) {
       static_cast<Image*>(imageKey)->OnSurfaceDiscarded();
     }
 
@@ -534,6 +816,115 @@ public:
     }
   }
 
+  /**
+   * Removes a surface that we're evicting because it expired. If the surface
+   * is eligible for the compressed tier, we take a snapshot of its pixels and
+   * compress them on a background thread, so that we never compress on the
+   * main thread or while holding the mutex. Since the image may still get the
+   * surface back from a lookup, we don't tell it that the surface was
+   * discarded until we know the compressed copy didn't work out.
+   *
+   * The pixels waiting for compression keep counting against the budget until
+   * the snapshot is gone, and Insert() discards them before anything else if
+   * it needs room.
+   *
+   * Snapshots are only taken on the main thread, where surfaces expire.
+   */
+  void Evict(CachedSurface* aSurface)
+  {
+    MOZ_ASSERT(aSurface, "Should have a surface");
+
+    RefPtr<SurfaceSnapshot> snapshot;
+    if (mMaxCompressedCost > 0 && mCompressionTarget && NS_IsMainThread()) {
+      snapshot = SurfaceSnapshot::Create(aSurface);
+    }
+
+    if (!snapshot) {
+      Remove(aSurface);
+      return;
+    }
+
+    Remove(aSurface, /* aNotifyImage = */ false);
+    mPendingSnapshots.AppendElement(snapshot);
+    MOZ_ASSERT(snapshot->GetCost() <= mAvailableCost, "Costs don't balance");
+    mAvailableCost -= snapshot->GetCost();
+
+    if (mCompressionScheduled) {
+      return;  // The running compression task will pick this one up.
+    }
+
+    // SurfaceCacheImpl must be released on the main thread.
+    RefPtr<SurfaceCacheImpl> self = this;
+    nsCOMPtr<nsIRunnable> runnable = NS_NewRunnableFunction([self]() mutable {
+      self->CompressPendingSnapshots();
+      NS_ReleaseOnMainThread(self.forget());
+    });
+    if (NS_SUCCEEDED(mCompressionTarget->Dispatch(runnable,
+                                                  NS_DISPATCH_NORMAL))) {
+      mCompressionScheduled = true;
+    } else {
+      DiscardPendingSnapshots();
+    }
+  }
+
+  /**
+   * Compresses the surfaces evicted by Evict() and adds them to the compressed
+   * tier. Runs on a background thread. The mutex is only held while taking and
+   * returning the snapshots, not during the compression itself. Snapshots
+   * which were cancelled in the meantime (by a fresh Insert(), RemoveImage(),
+   * or a discard) are dropped, and snapshots taken in the meantime are
+   * compressed before we return.
+   */
+  void CompressPendingSnapshots()
+  {
+    MOZ_ASSERT(!NS_IsMainThread());
+
+    MutexAutoLock lock(mMutex);
+    MOZ_ASSERT(mCompressionScheduled);
+
+    while (!mPendingSnapshots.IsEmpty()) {
+      // Leave the snapshots in mPendingSnapshots so they can be cancelled
+      // while we're compressing them.
+      nsTArray<RefPtr<SurfaceSnapshot>> snapshots(mPendingSnapshots);
+      nsTArray<RefPtr<CompressedSurface>> compressed;
+      {
+        MutexAutoUnlock unlock(mMutex);
+        for (const RefPtr<SurfaceSnapshot>& snapshot : snapshots) {
+          compressed.AppendElement(CompressedSurface::Create(*snapshot));
+        }
+      }
+
+      for (uint32_t i = 0; i < snapshots.Length(); ++i) {
+        if (!RemovePendingSnapshot(snapshots[i])) {
+          continue;  // Cancelled.
+        }
+        InsertCompressed(snapshots[i]->GetImageKey(), compressed[i].forget());
+      }
+    }
+
+    mCompressionScheduled = false;
+    mCompressionCondVar.NotifyAll();
+  }
+
+  /**
+   * Drops the pending snapshots without notifying their images, which may not
+   * outlive us. A compression task that is still running will find that its
+   * snapshots were cancelled.
+   */
+  void CancelCompression()
+  {
+    while (!mPendingSnapshots.IsEmpty()) {
+      RemovePendingSnapshotAt(mPendingSnapshots.Length() - 1);
+    }
+  }
+
+  void WaitForCompression()
+  {
+    while (mCompressionScheduled) {
+      mCompressionCondVar.Wait();
+    }
+  }
+
   void StartTracking(CachedSurface* aSurface)
   {
     CostEntry costEntry = aSurface->GetCostEntry();
@@ -631,6 +1022,7 @@ public:
     RefPtr<CachedSurface> surface;
     MatchType matchType = MatchType::NOT_FOUND;
     Tie(surface, matchType) = cache->LookupBestMatch(aSurfaceKey);
+
     if (!surface) {
       return LookupResult(matchType);  // Lookup in the per-image cache missed.
     }
@@ -708,7 +1100,10 @@ public:
   {
     RefPtr<ImageSurfaceCache> cache = GetImageCache(aImageKey);
     if (!cache) {
-      return;  // No cached surfaces for this image, so nothing to do.
+      // No cached surfaces for this image, but we may still have compressed
+      // copies of some.
+      RemoveCompressedForImage(aImageKey);
+      return;
     }
 
     // Discard all of the cached surfaces for this image.
@@ -723,6 +1118,8 @@ public:
     // The per-image cache isn't needed anymore, so remove it as well.
     // This implicitly unlocks the image if it was locked.
     mImageCaches.Remove(aImageKey);
+
+    RemoveCompressedForImage(aImageKey);
   }
 
   void DiscardAll()
@@ -733,10 +1130,15 @@ public:
     while (!mCosts.IsEmpty()) {
       Remove(mCosts.LastElement().GetSurface());
     }
+
+    DiscardAllCompressed();
   }
 
   void DiscardForMemoryPressure()
   {
+    // Compressed surfaces are the coldest data we have, so drop them first.
+    DiscardAllCompressed();
+
     // Compute our discardable cost. Since locked surfaces aren't discardable,
     // we exclude them.
     const Cost discardableCost = (mMaxCost - mAvailableCost) - mLockedCost;
@@ -800,6 +1202,28 @@ public:
                             "imagelib surface cache.");
     NS_ENSURE_SUCCESS(rv, rv);
 
+    size_t compressedSize = 0;
+    for (const RefPtr<CompressedSurface>& compressed : mCompressedSurfaces) {
+      compressedSize +=
+        compressed->SizeOfIncludingThis(SurfaceCacheMallocSizeOf);
+    }
+
+    rv = MOZ_COLLECT_REPORT("explicit/images/surface-cache-compressed",
+                            KIND_HEAP, UNITS_BYTES,
+                            compressedSize,
+                            "Memory used by LZ4-compressed copies of surfaces "
+                            "which were evicted from the imagelib surface "
+                            "cache.");
+    NS_ENSURE_SUCCESS(rv, rv);
+
+    rv = MOZ_COLLECT_REPORT("imagelib-surface-cache-compressed-hit-count",
+                            KIND_OTHER, UNITS_COUNT,
+                            mCompressedHitCount,
+                            "Count of how many times a lookup in the surface "
+                            "cache was satisfied by decompressing a surface "
+                            "instead of redecoding it.");
+    NS_ENSURE_SUCCESS(rv, rv);
+
     rv = MOZ_COLLECT_REPORT("imagelib-surface-cache-overflow-count",
                             KIND_OTHER, UNITS_COUNT,
                             mOverflowCount,
@@ -827,6 +1251,106 @@ public:
     }
   }
 
+  /// @return the compressed copy of the given surface, if we have one.
+  already_AddRefed<CompressedSurface>
+  LookupCompressed(const ImageKey aImageKey, const SurfaceKey& aSurfaceKey)
+  {
+    int32_t index = IndexOfCompressed(aImageKey, aSurfaceKey);
+    if (index < 0) {
+      return nullptr;
+    }
+
+    RefPtr<CompressedSurface> compressed = mCompressedSurfaces[index];
+    return compressed.forget();
+  }
+
+  /**
+   * Decompresses @aCompressed, which was returned by LookupCompressed(), and
+   * puts the result back into the cache. The mutex must *not* be held by the
+   * caller, since decompression is expensive; we only take it to move the
+   * result into the cache.
+   *
+   * The compressed copy stays in the tier while we decompress it, so that it
+   * can still be dropped concurrently. If that happens, or if the surface
+   * can't be restored, we return whatever Lookup() now finds, or @aFallback.
+   */
+  LookupResult RestoreCompressed(CompressedSurface* aCompressed,
+                                 LookupResult&&     aFallback)
+  {
+    MOZ_ASSERT(aCompressed);
+    const ImageKey imageKey = aCompressed->GetImageKey();
+    const SurfaceKey surfaceKey = aCompressed->GetSurfaceKey();
+
+    RefPtr<imgFrame> frame = aCompressed->Decompress();
+
+    MutexAutoLock lock(mMutex);
+
+    size_t index = mCompressedSurfaces.IndexOf(aCompressed);
+    if (index == mCompressedSurfaces.NoIndex) {
+      // Another thread may have restored this surface in the meantime.
+      LookupResult result = Lookup(imageKey, surfaceKey);
+      return result ? Move(result) : Move(aFallback);
+    }
+
+    RemoveCompressedAt(index, /* aNotifyImage = */ !frame);
+    if (!frame) {
+      return Move(aFallback);
+    }
+
+    RefPtr<ISurfaceProvider> provider =
+      new SimpleSurfaceProvider(WrapNotNull(frame.get()));
+    const Cost cost = ComputeCost(frame->GetSize(), frame->GetBytesPerPixel());
+    if (Insert(provider, cost, imageKey, surfaceKey) !=
+          InsertOutcome::SUCCESS) {
+      static_cast<Image*>(imageKey)->OnSurfaceDiscarded();
+      return Move(aFallback);
+    }
+
+    mCompressedHitCount++;
+
+    // Insert() may have evicted other surfaces, but not this one, and we need
+    // to touch it so it's locked if the image is locked.
+    return Lookup(imageKey, surfaceKey);
+  }
+
+  void ExpireImage(const ImageKey aImageKey)
+  {
+    RefPtr<ImageSurfaceCache> cache = GetImageCache(aImageKey);
+    if (!cache) {
+      return;  // No surfaces for this image.
+    }
+
+    nsTArray<RefPtr<CachedSurface>> surfaces;
+    for (auto iter = cache->ConstIter(); !iter.Done(); iter.Next()) {
+      CachedSurface* surface = iter.UserData();
+      if (!surface->IsLocked()) {
+        surfaces.AppendElement(surface);
+      }
+    }
+
+    for (CachedSurface* surface : surfaces) {
+      Evict(surface);
+    }
+  }
+
+  Cost SetMaxCompressedCost(const Cost aMaxCost)
+  {
+    const Cost previousMaxCost = mMaxCompressedCost;
+    mMaxCompressedCost = aMaxCost;
+
+    if (mMaxCompressedCost > 0 && !mCompressionTarget) {
+      mCompressionTarget = do_GetService(NS_STREAMTRANSPORTSERVICE_CONTRACTID);
+    }
+
+    while (mCompressedCost > mMaxCompressedCost) {
+      RemoveCompressedAt(0);
+    }
+
+    return previousMaxCost;
+  }
+
+  Cost GetCompressedCost() const { return mCompressedCost; }
+
 private:
   already_AddRefed<ImageSurfaceCache> GetImageCache(const ImageKey aImageKey)
   {
@@ -868,6 +1392,127 @@ private:
     }
   }
 
+  int32_t IndexOfCompressed(const ImageKey    aImageKey,
+                            const SurfaceKey& aSurfaceKey) const
+  {
+    // The compressed tier is small and only consulted on cache misses, so a
+    // linear scan is fine.
+    for (uint32_t i = 0; i < mCompressedSurfaces.Length(); ++i) {
+      if (mCompressedSurfaces[i]->Matches(aImageKey, aSurfaceKey)) {
+        return int32_t(i);
+      }
+    }
+    return -1;
+  }
+
+  void InsertCompressed(const ImageKey                      aImageKey,
+                        already_AddRefed<CompressedSurface> aCompressed)
+  {
+    RefPtr<CompressedSurface> compressed = aCompressed;
+    if (!compressed || compressed->GetCost() > mMaxCompressedCost) {
+      // The surface is really gone now.
+      static_cast<Image*>(aImageKey)->OnSurfaceDiscarded();
+      return;
+    }
+
+    // Make room by dropping the oldest compressed surfaces first.
+    while (mCompressedCost + compressed->GetCost() > mMaxCompressedCost) {
+      MOZ_ASSERT(!mCompressedSurfaces.IsEmpty(),
+                 "Removed everything and it still won't fit");
+      RemoveCompressedAt(0);
+    }
+
+    mCompressedCost += compressed->GetCost();
+    mCompressedSurfaces.AppendElement(Move(compressed));
+  }
+
+  void RemoveCompressed(const ImageKey    aImageKey,
+                        const SurfaceKey& aSurfaceKey)
+  {
+    for (int32_t i = mPendingSnapshots.Length() - 1; i >= 0; --i) {
+      if (mPendingSnapshots[i]->Matches(aImageKey, aSurfaceKey)) {
+        RemovePendingSnapshotAt(i);
+      }
+    }
+
+    int32_t index = IndexOfCompressed(aImageKey, aSurfaceKey);
+    if (index >= 0) {
+      RemoveCompressedAt(index, /* aNotifyImage = */ false);
+    }
+  }
+
+  void RemoveCompressedForImage(const ImageKey aImageKey)
+  {
+    // The image is going away, so there's nobody to notify.
+    for (int32_t i = mPendingSnapshots.Length() - 1; i >= 0; --i) {
+      if (mPendingSnapshots[i]->GetImageKey() == aImageKey) {
+        RemovePendingSnapshotAt(i);
+      }
+    }
+
+    for (int32_t i = mCompressedSurfaces.Length() - 1; i >= 0; --i) {
+      if (mCompressedSurfaces[i]->GetImageKey() == aImageKey) {
+        RemoveCompressedAt(i, /* aNotifyImage = */ false);
+      }
+    }
+  }
+
+  void RemoveCompressedAt(uint32_t aIndex, bool aNotifyImage = true)
+  {
+    MOZ_ASSERT(aIndex < mCompressedSurfaces.Length());
+    const RefPtr<CompressedSurface>& compressed = mCompressedSurfaces[aIndex];
+
+    MOZ_ASSERT(mCompressedCost >= compressed->GetCost(), "Costs don't balance");
+    mCompressedCost -= compressed->GetCost();
+
+    // Once the compressed copy is gone, the image really has lost its surface.
+    if (aNotifyImage) {
+      static_cast<Image*>(compressed->GetImageKey())->OnSurfaceDiscarded();
+    }
+
+    mCompressedSurfaces.RemoveElementAt(aIndex);
+  }
+
+  bool RemovePendingSnapshot(SurfaceSnapshot* aSnapshot)
+  {
+    size_t index = mPendingSnapshots.IndexOf(aSnapshot);
+    if (index == mPendingSnapshots.NoIndex) {
+      return false;
+    }
+
+    RemovePendingSnapshotAt(index);
+    return true;
+  }
+
+  void RemovePendingSnapshotAt(uint32_t aIndex)
+  {
+    MOZ_ASSERT(aIndex < mPendingSnapshots.Length());
+    mAvailableCost += mPendingSnapshots[aIndex]->GetCost();
+    MOZ_ASSERT(mAvailableCost <= mMaxCost,
+               "More available cost than we started with");
+    mPendingSnapshots.RemoveElementAt(aIndex);
+  }
+
+  void DiscardPendingSnapshots()
+  {
+    while (!mPendingSnapshots.IsEmpty()) {
+      const uint32_t index = mPendingSnapshots.Length() - 1;
+      static_cast<Image*>(mPendingSnapshots[index]->GetImageKey())
+        ->OnSurfaceDiscarded();
+      RemovePendingSnapshotAt(index);
+    }
+  }
+
+  void DiscardAllCompressed()
+  {
+    DiscardPendingSnapshots();
+
+    while (!mCompressedSurfaces.IsEmpty()) {
+      RemoveCompressedAt(mCompressedSurfaces.Length() - 1);
+    }
+    MOZ_ASSERT(mCompressedCost == 0, "Costs don't balance");
+  }
+
   void RemoveEntry(const ImageKey    aImageKey,
                    const SurfaceKey& aSurfaceKey)
   {
@@ -896,7 +1541,7 @@ private:
     {
       if (sInstance) {
         MutexAutoLock lock(sInstance->GetMutex());
-        sInstance->Remove(aSurface);
+        sInstance->Evict(aSurface);
       }
     }
   };
@@ -931,6 +1576,14 @@ private:
   Cost                                    mAvailableCost;
   Cost                                    mLockedCost;
   size_t                                  mOverflowCount;
+  nsCOMPtr<nsIEventTarget>                mCompressionTarget;
+  nsTArray<RefPtr<SurfaceSnapshot>>       mPendingSnapshots;
+  nsTArray<RefPtr<CompressedSurface>>     mCompressedSurfaces;  // Oldest first.
+  Cost                                    mMaxCompressedCost;
+  Cost                                    mCompressedCost;
+  size_t                                  mCompressedHitCount;
+  bool                                    mCompressionScheduled;
+  CondVar                                 mCompressionCondVar;
 };
 
 NS_IMPL_ISUPPORTS(SurfaceCacheImpl, nsIMemoryReporter)
@@ -987,12 +1640,19 @@ SurfaceCache::Initialize()
   uint32_t finalSurfaceCacheSizeBytes =
     min(surfaceCacheSizeBytes, uint64_t(UINT32_MAX));
 
+  // Maximum size of the compressed tier of the surface cache, in kilobytes.
+  // Zero disables it.
+  uint64_t compressedSurfaceCacheSizeBytes =
+    min(uint64_t(gfxPrefs::ImageMemSurfaceCacheCompressedMaxSizeKB()) * 1024,
+        uint64_t(finalSurfaceCacheSizeBytes));
+
   // Create the surface cache singleton with the requested settings.  Note that
   // the size is a limit that the cache may not grow beyond, but we do not
   // actually allocate any storage for surfaces at this time.
   sInstance = new SurfaceCacheImpl(surfaceCacheExpirationTimeMS,
                                    surfaceCacheDiscardFactor,
-                                   finalSurfaceCacheSizeBytes);
+                                   finalSurfaceCacheSizeBytes,
+                                   uint32_t(compressedSurfaceCacheSizeBytes));
   sInstance->InitMemoryReporter();
 }
 
@@ -1001,6 +1661,12 @@ SurfaceCache::Shutdown()
 {
   MOZ_ASSERT(NS_IsMainThread());
   MOZ_ASSERT(sInstance, "No singleton - was Shutdown() called twice?");
+
+  {
+    MutexAutoLock lock(sInstance->GetMutex());
+    sInstance->CancelCompression();
+  }
+
   sInstance = nullptr;
 }
 
@@ -1012,8 +1678,23 @@ SurfaceCache::Lookup(const ImageKey         aImageKey,
     return LookupResult(MatchType::NOT_FOUND);
   }
 
-  MutexAutoLock lock(sInstance->GetMutex());
-  return sInstance->Lookup(aImageKey, aSurfaceKey);
+  RefPtr<CompressedSurface> compressed;
+  {
+    MutexAutoLock lock(sInstance->GetMutex());
+    LookupResult result = sInstance->Lookup(aImageKey, aSurfaceKey);
+    if (result.Type() != MatchType::NOT_FOUND) {
+      return result;
+    }
+
+    compressed = sInstance->LookupCompressed(aImageKey, aSurfaceKey);
+    if (!compressed) {
+      return result;
+    }
+  }
+
+  // Decompress without holding the mutex.
+  return sInstance->RestoreCompressed(compressed,
+                                      LookupResult(MatchType::NOT_FOUND));
 }
 
 /* static */ LookupResult
@@ -1024,8 +1705,27 @@ SurfaceCache::LookupBestMatch(const ImageKey         aImageKey,
     return LookupResult(MatchType::NOT_FOUND);
   }
 
-  MutexAutoLock lock(sInstance->GetMutex());
-  return sInstance->LookupBestMatch(aImageKey, aSurfaceKey);
+  RefPtr<CompressedSurface> compressed;
+  LookupResult result(MatchType::NOT_FOUND);
+  {
+    MutexAutoLock lock(sInstance->GetMutex());
+    result = sInstance->LookupBestMatch(aImageKey, aSurfaceKey);
+
+    // Rematerializing a compressed copy of the exact surface we want is better
+    // than any substitute.
+    if (result.Type() != MatchType::NOT_FOUND &&
+        result.Type() != MatchType::SUBSTITUTE_BECAUSE_NOT_FOUND) {
+      return result;
+    }
+
+    compressed = sInstance->LookupCompressed(aImageKey, aSurfaceKey);
+    if (!compressed) {
+      return result;
+    }
+  }
+
+  // Decompress without holding the mutex.
+  return sInstance->RestoreCompressed(compressed, Move(result));
 }
 
 /* static */ InsertOutcome
@@ -1144,5 +1844,41 @@ SurfaceCache::MaximumCapacity()
   return sInstance->MaximumCapacity();
 }
 
+/* static */ size_t
+SurfaceCache::SetCompressedMaxSizeForTesting(size_t aMaxSizeBytes)
+{
+  MOZ_ASSERT(NS_IsMainThread());
+  if (!sInstance) {
+    return 0;
+  }
+
+  MutexAutoLock lock(sInstance->GetMutex());
+  return sInstance->SetMaxCompressedCost(aMaxSizeBytes);
+}
+
+/* static */ void
+SurfaceCache::ExpireImageForTesting(const ImageKey aImageKey)
+{
+  MOZ_ASSERT(NS_IsMainThread());
+  if (!sInstance) {
+    return;
+  }
+
+  MutexAutoLock lock(sInstance->GetMutex());
+  sInstance->ExpireImage(aImageKey);
+  sInstance->WaitForCompression();
+}
+
+/* static */ size_t
+SurfaceCache::CompressedSizeForTesting()
+{
+  if (!sInstance) {
+    return 0;
+  }
+
+  MutexAutoLock lock(sInstance->GetMutex());
+  return sInstance->GetCompressedCost();
+}
+
 } // namespace image
 } // namespace mozilla
@@ -144,6 +144,14 @@ enum class InsertOutcome : uint8_t {
  * the surface. SurfaceCache supports this through the use of image locking; see
  * the comments for Insert() and LockImage() for more details.
  *
+ * If the "image.mem.surfacecache.compressed.max_size_kb" pref is nonzero, decoded
+ * raster surfaces which expire are not thrown away immediately. Instead, an
+ * LZ4-compressed copy of their pixels is kept in a separate, smaller budget, and
+ * a later Lookup() of the same surface transparently decompresses it back into
+ * the cache. Compression happens on a background thread and decompression
+ * happens without holding the SurfaceCache lock. The image is only told that
+ * its surface was discarded once the compressed copy is dropped as well.
+ *
  * Any image which stores surfaces in the SurfaceCache *must* ensure that it
  * calls RemoveImage() before it is destroyed. See the comments for
  * RemoveImage() for more details.
@@ -404,6 +412,28 @@ struct SurfaceCache
    */
   static size_t MaximumCapacity();
 
+  /**
+   * Sets the budget of the compressed tier to @aMaxSizeBytes, dropping
+   * compressed surfaces as needed to fit. Zero stops new surfaces from being
+   * compressed. Only for use by tests.
+   *
+   * @return the previous budget, in bytes.
+   */
+  static size_t SetCompressedMaxSizeForTesting(size_t aMaxSizeBytes);
+
+  /**
+   * Evicts all unlocked surfaces of the given image as if they had expired,
+   * and waits until any compression this triggers has finished. Only for use
+   * by tests.
+   */
+  static void ExpireImageForTesting(const ImageKey aImageKey);
+
+  /**
+   * @return the total size of the compressed surfaces in the compressed tier.
+   * Only for use by tests.
+   */
+  static size_t CompressedSizeForTesting();
+
 private:
   virtual ~SurfaceCache() = 0;  // Forbid instantiation.
 };
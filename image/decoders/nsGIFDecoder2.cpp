@@ -247,6 +247,20 @@ nsGIFDecoder2::EndImageFrame()
     }
   }
 
+  // Later frames are paletted and blended over the previous frame. If they're
+  // kept afterwards, their transparent pixels have no effect on the result, so
+  // we can drop any transparent border. Many animated GIFs encode every frame
+  // at full size even though only a small region changes.
+  const DisposalMethod disposalMethod =
+    DisposalMethod(mGIFStruct.disposal_method);
+  if (mGIFStruct.images_decoded > 0 && mGIFStruct.is_transparent &&
+      (disposalMethod == DisposalMethod::KEEP ||
+       disposalMethod == DisposalMethod::NOT_SPECIFIED)) {
+    // The pipe writes directly into the frame's buffer, which may move.
+    mPipe = SurfacePipe();
+    TrimTransparentFrameBorder(mGIFStruct.tpixel);
+  }
+
   // Unconditionally increment images_decoded, because we unconditionally
   // append frames in BeginImageFrame(). This ensures that images_decoded
   // always refers to the frame in mImage we're currently decoding,
@@ -255,7 +269,7 @@ nsGIFDecoder2::EndImageFrame()
 
   // Tell the superclass we finished a frame
   PostFrameStop(opacity,
-                DisposalMethod(mGIFStruct.disposal_method),
+                disposalMethod,
                 FrameTimeout::FromRawMilliseconds(mGIFStruct.delay_time));
 
   // Reset the transparent pixel
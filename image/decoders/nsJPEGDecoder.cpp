@@ -23,6 +23,7 @@
 #include "jerror.h"
 
 #include "gfxPlatform.h"
+#include "gfxPrefs.h"
 #include "mozilla/EndianUtils.h"
 #include "mozilla/Telemetry.h"
 
@@ -78,6 +79,7 @@ nsJPEGDecoder::nsJPEGDecoder(RasterImage* aImage,
           Transition::TerminateSuccess())
  , mDecodeStyle(aDecodeStyle)
  , mSampleSize(0)
+ , mDCTScaleDenom(1)
 {
   mState = JPEG_HEADER;
   mReading = true;
@@ -382,6 +384,11 @@ nsJPEGDecoder::ReadJPEGData(const char* aData, size_t aLength)
       }
     }
 
+    if (mDownscaler && mSampleSize == 0 &&
+        gfxPrefs::ImageJPEGDCTScalingEnabled()) {
+      SetDCTScaleForDownscaling();
+    }
+
     // Don't allocate a giant and superfluous memory buffer
     // when not doing a progressive decode.
     mInfo.buffered_image = mDecodeStyle == PROGRESSIVE &&
@@ -402,7 +409,8 @@ nsJPEGDecoder::ReadJPEGData(const char* aData, size_t aLength)
     MOZ_ASSERT(mImageData, "Should have a buffer now");
 
     if (mDownscaler) {
-      nsresult rv = mDownscaler->BeginFrame(GetSize(), Nothing(),
+      nsIntSize scaledSize(mInfo.output_width, mInfo.output_height);
+      nsresult rv = mDownscaler->BeginFrame(scaledSize, Nothing(),
                                             mImageData,
                                             /* aHasAlpha = */ false);
       if (NS_FAILED(rv)) {
@@ -730,6 +738,14 @@ nsJPEGDecoder::OutputScanlines(bool* suspend)
 
   if (mDownscaler && mDownscaler->HasInvalidation()) {
     DownscalerInvalidRect invalidRect = mDownscaler->TakeInvalidRect();
+    if (mDCTScaleDenom > 1) {
+      // The Downscaler's "original size" is the DCT-scaled size; convert it
+      // back into the space of the full-size image.
+      invalidRect.mOriginalSizeRect.ScaleRoundOut(mDCTScaleDenom);
+      invalidRect.mOriginalSizeRect =
+        invalidRect.mOriginalSizeRect.Intersect(nsIntRect(nsIntPoint(),
+                                                          GetSize()));
+    }
     PostInvalidation(invalidRect.mOriginalSizeRect,
                      Some(invalidRect.mTargetSizeRect));
     MOZ_ASSERT(!mDownscaler->HasInvalidation());
@@ -740,6 +756,39 @@ nsJPEGDecoder::OutputScanlines(bool* suspend)
   }
 }
 
+void
+nsJPEGDecoder::SetDCTScaleForDownscaling()
+{
+  MOZ_ASSERT(mDownscaler);
+  MOZ_ASSERT(mDCTScaleDenom == 1);
+
+  // libjpeg can scale by 1/2, 1/4 or 1/8 while decoding, skipping most of the
+  // IDCT, upsampling and color conversion work for the discarded detail. We
+  // pick the largest reduction that still leaves the Downscaler some work to
+  // do, so the final resampling quality is unaffected.
+  const nsIntSize targetSize = mDownscaler->TargetSize();
+  for (uint32_t denom = 8; denom > 1; denom /= 2) {
+    uint32_t scaledWidth = (mInfo.image_width + denom - 1) / denom;
+    uint32_t scaledHeight = (mInfo.image_height + denom - 1) / denom;
+    if (scaledWidth < uint32_t(targetSize.width) ||
+        scaledHeight < uint32_t(targetSize.height)) {
+      continue;
+    }
+    if (scaledWidth == uint32_t(targetSize.width) &&
+        scaledHeight == uint32_t(targetSize.height)) {
+      continue;  // The Downscaler requires that we actually downscale.
+    }
+
+    mInfo.scale_num = 1;
+    mInfo.scale_denom = denom;
+    jpeg_calc_output_dimensions(&mInfo);
+    MOZ_ASSERT(mInfo.output_width == scaledWidth &&
+               mInfo.output_height == scaledHeight);
+    mDCTScaleDenom = denom;
+    return;
+  }
+}
+
 // Override the standard error method in the IJG JPEG decoder code.
 METHODDEF(void)
 my_error_exit (j_common_ptr cinfo)
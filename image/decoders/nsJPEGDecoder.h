@@ -68,6 +68,7 @@ public:
 protected:
   Orientation ReadOrientationFromEXIF();
   void OutputScanlines(bool* suspend);
+  void SetDCTScaleForDownscaling();
 
 private:
   friend class DecoderFactory;
@@ -115,6 +116,10 @@ public:
   uint32_t mCMSMode;
 
   int mSampleSize;
+
+  // The factor by which libjpeg scales the image in the DCT domain before
+  // handing rows to mDownscaler. 1 if we're not scaling in the DCT domain.
+  uint32_t mDCTScaleDenom;
 };
 
 } // namespace image
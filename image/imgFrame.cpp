@@ -730,6 +730,69 @@ imgFrame::Finish(Opacity aFrameOpacity /* = Opacity::SOME_TRANSPARENCY */,
   mMonitor.NotifyAll();
 }
 
+bool
+imgFrame::TrimTransparentBorder(uint8_t aTransparentIndex)
+{
+  MonitorAutoLock lock(mMonitor);
+  MOZ_ASSERT(mPalettedImageData, "Only paletted frames can be trimmed");
+  MOZ_ASSERT(mLockCount > 0, "Image data should be locked");
+  MOZ_ASSERT(!mFinished, "Trimming a frame which may already be in use");
+
+  if (aTransparentIndex >= (1 << mPaletteDepth)) {
+    return false;  // No pixel can be transparent.
+  }
+
+  // Find the bounds of the non-transparent pixels, relative to mFrameRect.
+  uint8_t* data = mPalettedImageData + PaletteDataLength();
+  const int32_t width = mFrameRect.width;
+  const int32_t height = mFrameRect.height;
+  int32_t minX = width, maxX = -1, minY = height, maxY = -1;
+  for (int32_t y = 0; y < height; ++y) {
+    const uint8_t* row = data + y * width;
+    for (int32_t x = 0; x < width; ++x) {
+      if (row[x] != aTransparentIndex) {
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = y;
+      }
+    }
+  }
+
+  IntRect opaqueRect;
+  if (maxX < 0) {
+    // The frame is entirely transparent; keep a single (transparent) pixel so
+    // that the frame rect is never empty.
+    opaqueRect = IntRect(0, 0, 1, 1);
+  } else {
+    opaqueRect = IntRect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+  }
+
+  // Only bother if we'd save a meaningful amount of memory.
+  if (opaqueRect.Area() * 4 > mFrameRect.Area() * 3) {
+    return false;
+  }
+
+  // Compact the rows in place. Each row only moves toward the start of the
+  // buffer, so copying in order never overwrites data we still need.
+  for (int32_t y = 0; y < opaqueRect.height; ++y) {
+    memmove(data + y * opaqueRect.width,
+            data + (opaqueRect.y + y) * width + opaqueRect.x,
+            opaqueRect.width);
+  }
+
+  size_t dataSize = PaletteDataLength() + opaqueRect.Area();
+  uint8_t* shrunk = static_cast<uint8_t*>(realloc(mPalettedImageData,
+                                                  dataSize));
+  if (shrunk) {
+    mPalettedImageData = shrunk;
+  }
+
+  mFrameRect = opaqueRect + mFrameRect.TopLeft();
+  mDecoded.IntersectRect(mDecoded, mFrameRect);
+  return true;
+}
+
 uint32_t
 imgFrame::GetImageBytesPerRow() const
 {
@@ -257,6 +257,20 @@ public:
 
   nsresult ImageUpdated(const nsIntRect& aUpdateRect);
 
+  /**
+   * Shrink the frame rect of this paletted imgFrame to the bounds of the pixels
+   * which don't use palette index @aTransparentIndex, and reallocate the image
+   * data to match. Callers must only do this for frames which are blended OVER
+   * the previous frame and then kept, since only then do transparent pixels
+   * have no effect on the composited result.
+   *
+   * This must be called before Finish(). It invalidates any pointers to the
+   * palette and image data, so callers must get them again afterwards.
+   *
+   * @return true if the frame was trimmed.
+   */
+  bool TrimTransparentBorder(uint8_t aTransparentIndex);
+
   /**
    * Mark this imgFrame as completely decoded, and set final options.
    *
@@ -425,7 +439,9 @@ private: // data
 
 
   //////////////////////////////////////////////////////////////////////////////
-  // Effectively const data, only mutated in the Init methods.
+  // Effectively const data, only mutated in the Init methods. (mFrameRect and
+  // mPalettedImageData may also shrink in TrimTransparentBorder(), before the
+  // frame is finished.)
   //////////////////////////////////////////////////////////////////////////////
 
   IntSize      mImageSize;
@@ -614,6 +614,15 @@ ImageTestCase ExtraImageSubBlocksAnimatedGIFTestCase()
                        IntSize(100, 100));
 }
 
+ImageTestCase TransparentBorderAnimatedGIFTestCase()
+{
+  // A solid green first frame, followed by two full size frames which are
+  // transparent (palette index 3) except for a red (palette index 0) 5x3 block
+  // at (4, 6). The second frame is kept; the third is cleared.
+  return ImageTestCase("animated-with-transparent-border.gif", "image/gif",
+                       IntSize(16, 16));
+}
+
 ImageTestCase DownscaledPNGTestCase()
 {
   // This testcase (and all the other "downscaled") testcases) consists of 25
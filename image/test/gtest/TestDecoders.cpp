@@ -3,10 +3,12 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h"
 
 #include "Common.h"
 #include "Decoder.h"
 #include "DecoderFactory.h"
+#include "gfxPrefs.h"
 #include "decoders/nsBMPDecoder.h"
 #include "IDecodingTask.h"
 #include "imgIContainer.h"
@@ -204,6 +206,56 @@ CheckDownscaleDuringDecode(const ImageTestCase& aTestCase)
   });
 }
 
+static RefPtr<SourceSurface>
+DecodeDownscaled(const ImageTestCase& aTestCase, const IntSize& aOutputSize)
+{
+  RefPtr<SourceSurface> surface;
+  WithSingleChunkDecode(aTestCase, Some(aOutputSize), [&](Decoder* aDecoder) {
+    surface = CheckDecoderState(aTestCase, aDecoder);
+  });
+  return surface;
+}
+
+static void
+CheckJPEGDCTScalingMatchesFullDecode(const ImageTestCase& aTestCase)
+{
+  // Decode the image to 20x20 both with libjpeg's DCT-domain scaling and
+  // without it, and check that the two results agree. As in
+  // CheckDownscaleDuringDecode(), we skip the rows near the transitions
+  // between colors, where the two resampling paths legitimately differ.
+  IntSize outputSize(20, 20);
+
+  RefPtr<SourceSurface> dctScaled = DecodeDownscaled(aTestCase, outputSize);
+  gfxPrefs::SetImageJPEGDCTScalingEnabled(false);
+  RefPtr<SourceSurface> fullDecode = DecodeDownscaled(aTestCase, outputSize);
+  gfxPrefs::SetImageJPEGDCTScalingEnabled(true);
+
+  ASSERT_TRUE(dctScaled != nullptr);
+  ASSERT_TRUE(fullDecode != nullptr);
+
+  RefPtr<DataSourceSurface> dctData = dctScaled->GetDataSurface();
+  RefPtr<DataSourceSurface> fullData = fullDecode->GetDataSurface();
+  ASSERT_TRUE(dctData != nullptr);
+  ASSERT_TRUE(fullData != nullptr);
+
+  DataSourceSurface::ScopedMap dctMap(dctData, DataSourceSurface::READ);
+  DataSourceSurface::ScopedMap fullMap(fullData, DataSourceSurface::READ);
+  ASSERT_TRUE(dctMap.IsMapped());
+  ASSERT_TRUE(fullMap.IsMapped());
+
+  const int32_t rows[] = { 0, 1, 2, 3, 6, 7, 8, 11, 12, 13, 16, 17, 18, 19 };
+  for (int32_t row : rows) {
+    for (int32_t col = 0; col < outputSize.width; ++col) {
+      uint8_t* a = dctMap.GetData() + row * dctMap.GetStride() + col * 4;
+      uint8_t* b = fullMap.GetData() + row * fullMap.GetStride() + col * 4;
+      for (int32_t c = 0; c < 3; ++c) {
+        EXPECT_LE(abs(int32_t(a[c]) - int32_t(b[c])), 16)
+          << "row " << row << ", col " << col << ", channel " << c;
+      }
+    }
+  }
+}
+
 class ImageDecoders : public ::testing::Test
 {
 protected:
@@ -255,6 +307,11 @@ TEST_F(ImageDecoders, JPGDownscaleDuringDecode)
   CheckDownscaleDuringDecode(DownscaledJPGTestCase());
 }
 
+TEST_F(ImageDecoders, JPGDCTScalingMatchesFullDecode)
+{
+  CheckJPEGDCTScalingMatchesFullDecode(DownscaledJPGTestCase());
+}
+
 TEST_F(ImageDecoders, BMPSingleChunk)
 {
   CheckDecoderSingleChunk(GreenBMPTestCase());
@@ -433,3 +490,114 @@ TEST_F(ImageDecoders, AnimatedGIFWithExtraImageSubBlocks)
                                           /* aFrameNum = */ 1));
   EXPECT_EQ(MatchType::EXACT, secondFrameLookupResult.Type());
 }
+
+TEST_F(ImageDecoders, AnimatedGIFWithTransparentBorder)
+{
+  ImageTestCase testCase = TransparentBorderAnimatedGIFTestCase();
+
+  // Create an image.
+  RefPtr<Image> image =
+    ImageFactory::CreateAnonymousImage(nsDependentCString(testCase.mMimeType));
+  ASSERT_TRUE(!image->HasError());
+
+  nsCOMPtr<nsIInputStream> inputStream = LoadFile(testCase.mPath);
+  ASSERT_TRUE(inputStream);
+
+  // Figure out how much data we have.
+  uint64_t length;
+  nsresult rv = inputStream->Available(&length);
+  ASSERT_TRUE(NS_SUCCEEDED(rv));
+
+  // Write the data into the image.
+  rv = image->OnImageDataAvailable(nullptr, nullptr, inputStream, 0,
+                                   static_cast<uint32_t>(length));
+  ASSERT_TRUE(NS_SUCCEEDED(rv));
+
+  // Let the image know we've sent all the data.
+  rv = image->OnImageDataComplete(nullptr, nullptr, NS_OK, true);
+  ASSERT_TRUE(NS_SUCCEEDED(rv));
+
+  RefPtr<ProgressTracker> tracker = image->GetProgressTracker();
+  tracker->SyncNotifyProgress(FLAG_LOAD_COMPLETE);
+
+  // Use GetFrame() to force a sync decode of the image.
+  RefPtr<SourceSurface> surface =
+    image->GetFrame(imgIContainer::FRAME_CURRENT,
+                    imgIContainer::FLAG_SYNC_DECODE);
+  ASSERT_TRUE(surface != nullptr);
+
+  auto lookupFrame = [&](uint32_t aFrameNum) {
+    LookupResult result =
+      SurfaceCache::Lookup(ImageKey(image.get()),
+                           RasterSurfaceKey(testCase.mSize,
+                                            DefaultSurfaceFlags(),
+                                            aFrameNum));
+    EXPECT_EQ(MatchType::EXACT, result.Type());
+    return result ? result.Provider()->DrawableRef()->RawAccessRef()
+                  : RawAccessFrameRef();
+  };
+
+  // The first frame has no transparent pixels, so it's untouched.
+  EXPECT_TRUE(IsSolidColor(surface, BGRAColor::Green()));
+
+  // The second frame is kept after it's blended, so its transparent border
+  // should have been trimmed down to the red block. Palette index 0 is red in
+  // this image, not transparent, so the block itself must survive.
+  RawAccessFrameRef secondFrame = lookupFrame(1);
+  ASSERT_TRUE(bool(secondFrame));
+  ASSERT_TRUE(secondFrame->GetIsPaletted());
+  EXPECT_EQ(IntRect(4, 6, 5, 3), secondFrame->GetRect());
+
+  uint8_t* imageData = nullptr;
+  uint32_t imageLength = 0;
+  secondFrame->GetImageData(&imageData, &imageLength);
+  ASSERT_TRUE(imageData != nullptr);
+  ASSERT_EQ(5u * 3u, imageLength);
+  for (uint32_t i = 0; i < imageLength; ++i) {
+    EXPECT_EQ(0u, imageData[i]);
+  }
+
+  uint32_t* palette = nullptr;
+  uint32_t paletteLength = 0;
+  secondFrame->GetPaletteData(&palette, &paletteLength);
+  ASSERT_TRUE(palette != nullptr);
+  EXPECT_EQ(BGRAColor::Red().AsPixel(), palette[0]);
+  EXPECT_EQ(0u, palette[3]);  // The transparent index.
+
+  // The third frame is cleared after it's shown, so its transparent pixels
+  // matter and it must keep its full size.
+  RawAccessFrameRef thirdFrame = lookupFrame(2);
+  ASSERT_TRUE(bool(thirdFrame));
+  EXPECT_EQ(IntRect(IntPoint(0, 0), testCase.mSize), thirdFrame->GetRect());
+}
+
+static void
+BenchDecode(const ImageTestCase& aTestCase, const Maybe<IntSize>& aOutputSize)
+{
+  AutoInitializeImageLib init;
+
+  // The test images are small, so decode each one repeatedly to get a
+  // measurable per-image decode time.
+  for (uint32_t i = 0; i < 100; ++i) {
+    WithSingleChunkDecode(aTestCase, aOutputSize, [](Decoder* aDecoder) {
+      EXPECT_TRUE(aDecoder->GetDecodeDone());
+    });
+  }
+}
+
+MOZ_GTEST_BENCH(ImageDecodersBench, JPGFullSize, []{
+  BenchDecode(DownscaledJPGTestCase(), Nothing());
+});
+
+MOZ_GTEST_BENCH(ImageDecodersBench, JPGDownscaleDuringDecode, []{
+  // Exercises DCT-domain scaling followed by the Downscaler.
+  BenchDecode(DownscaledJPGTestCase(), Some(IntSize(20, 20)));
+});
+
+MOZ_GTEST_BENCH(ImageDecodersBench, PNGFullSize, []{
+  BenchDecode(DownscaledPNGTestCase(), Nothing());
+});
+
+MOZ_GTEST_BENCH(ImageDecodersBench, PNGDownscaleDuringDecode, []{
+  BenchDecode(DownscaledPNGTestCase(), Some(IntSize(20, 20)));
+});
@@ -5,6 +5,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h"
 
 #include "mozilla/gfx/2D.h"
 #include "Common.h"
@@ -110,6 +111,28 @@ TEST(ImageDownscalingFilter, WritePixels100_100to1_99)
   });
 }
 
+TEST(ImageDownscalingFilter, WritePixels1000_1000to10_10)
+{
+  // This is a large enough reduction that we use area averaging.
+  WithDownscalingFilter(IntSize(1000, 1000), IntSize(10, 10),
+                        [](Decoder* aDecoder, SurfaceFilter* aFilter) {
+    CheckWritePixels(aDecoder, aFilter,
+                     /* aOutputRect = */ Some(IntRect(0, 0, 10, 10)),
+                     /* aInputRect = */ Some(IntRect(0, 0, 1000, 1000)));
+  });
+}
+
+TEST(ImageDownscalingFilter, WritePixels1000_100to10_99)
+{
+  // Area averaging in X, Lanczos in Y.
+  WithDownscalingFilter(IntSize(1000, 100), IntSize(10, 99),
+                        [](Decoder* aDecoder, SurfaceFilter* aFilter) {
+    CheckWritePixels(aDecoder, aFilter,
+                     /* aOutputRect = */ Some(IntRect(0, 0, 10, 99)),
+                     /* aInputRect = */ Some(IntRect(0, 0, 1000, 100)));
+  });
+}
+
 TEST(ImageDownscalingFilter, DownscalingFailsFor100_100to101_101)
 {
   // Upscaling is disallowed.
@@ -229,3 +252,29 @@ TEST(ImageDownscalingFilter, ConfiguringPalettedDownscaleFails)
                                                          SurfaceFormat::B8G8R8A8, 8,
                                                          false });
 }
+
+static void
+BenchDownscale(const IntSize& aInputSize, const IntSize& aOutputSize)
+{
+  WithDownscalingFilter(aInputSize, aOutputSize,
+                        [&](Decoder* aDecoder, SurfaceFilter* aFilter) {
+    auto result = aFilter->WritePixels<uint32_t>([&] {
+      return AsVariant(BGRAColor::Green().AsPixel());
+    });
+    EXPECT_EQ(WriteState::FINISHED, result);
+  });
+}
+
+// Photo-sized input decoded at several typical target sizes, from a small
+// thumbnail (area averaging) to a modest reduction (Lanczos).
+MOZ_GTEST_BENCH(ImageDownscalingFilterBench, Downscale5184_3456to128_85, []{
+  BenchDownscale(IntSize(5184, 3456), IntSize(128, 85));
+});
+
+MOZ_GTEST_BENCH(ImageDownscalingFilterBench, Downscale5184_3456to512_341, []{
+  BenchDownscale(IntSize(5184, 3456), IntSize(512, 341));
+});
+
+MOZ_GTEST_BENCH(ImageDownscalingFilterBench, Downscale5184_3456to1920_1280, []{
+  BenchDownscale(IntSize(5184, 3456), IntSize(1920, 1280));
+});
@@ -0,0 +1,206 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+
+#include "Common.h"
+#include "imgIContainer.h"
+#include "ImageFactory.h"
+#include "mozilla/gfx/2D.h"
+#include "mozilla/RefPtr.h"
+#include "nsIInputStream.h"
+#include "nsString.h"
+#include "ProgressTracker.h"
+#include "SurfaceCache.h"
+
+using namespace mozilla;
+using namespace mozilla::gfx;
+using namespace mozilla::image;
+
+static already_AddRefed<Image>
+CreateDecodedImage(const ImageTestCase& aTestCase)
+{
+  RefPtr<Image> image =
+    ImageFactory::CreateAnonymousImage(nsDependentCString(aTestCase.mMimeType));
+  EXPECT_TRUE(!image->HasError());
+
+  nsCOMPtr<nsIInputStream> inputStream = LoadFile(aTestCase.mPath);
+  EXPECT_TRUE(inputStream);
+
+  uint64_t length;
+  nsresult rv = inputStream->Available(&length);
+  EXPECT_TRUE(NS_SUCCEEDED(rv));
+
+  rv = image->OnImageDataAvailable(nullptr, nullptr, inputStream, 0,
+                                   static_cast<uint32_t>(length));
+  EXPECT_TRUE(NS_SUCCEEDED(rv));
+
+  rv = image->OnImageDataComplete(nullptr, nullptr, NS_OK, true);
+  EXPECT_TRUE(NS_SUCCEEDED(rv));
+
+  RefPtr<ProgressTracker> tracker = image->GetProgressTracker();
+  tracker->SyncNotifyProgress(FLAG_LOAD_COMPLETE);
+
+  // Use GetFrame() to force a sync decode of the image.
+  RefPtr<SourceSurface> surface =
+    image->GetFrame(imgIContainer::FRAME_CURRENT,
+                    imgIContainer::FLAG_SYNC_DECODE);
+  EXPECT_TRUE(surface != nullptr);
+
+  return image.forget();
+}
+
+static LookupResult
+LookupDecodedSurface(Image* aImage, const ImageTestCase& aTestCase)
+{
+  return SurfaceCache::Lookup(ImageKey(aImage),
+                              RasterSurfaceKey(aTestCase.mSize,
+                                               DefaultSurfaceFlags(),
+                                               /* aFrameNum = */ 0));
+}
+
+static void
+CheckRestoredSurface(LookupResult& aResult)
+{
+  ASSERT_EQ(MatchType::EXACT, aResult.Type());
+
+  DrawableFrameRef frameRef = aResult.Provider()->DrawableRef();
+  ASSERT_TRUE(bool(frameRef));
+
+  RefPtr<SourceSurface> surface = frameRef->GetSurface();
+  ASSERT_TRUE(surface != nullptr);
+  EXPECT_TRUE(IsSolidColor(surface, BGRAColor::Green()));
+}
+
+class ImageSurfaceCacheCompression : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    mPreviousMaxSize =
+      SurfaceCache::SetCompressedMaxSizeForTesting(1024 * 1024);
+  }
+
+  void TearDown() override
+  {
+    SurfaceCache::SetCompressedMaxSizeForTesting(mPreviousMaxSize);
+  }
+
+  AutoInitializeImageLib mInit;
+  size_t mPreviousMaxSize;
+};
+
+TEST_F(ImageSurfaceCacheCompression, EvictAndRestore)
+{
+  ImageTestCase testCase = GreenPNGTestCase();
+  RefPtr<Image> image = CreateDecodedImage(testCase);
+
+  {
+    LookupResult result = LookupDecodedSurface(image, testCase);
+    ASSERT_EQ(MatchType::EXACT, result.Type());
+  }
+
+  const size_t sizeBefore = SurfaceCache::CompressedSizeForTesting();
+
+  // Evicting the surface should leave a compressed copy behind which is much
+  // smaller than the surface itself.
+  SurfaceCache::ExpireImageForTesting(ImageKey(image.get()));
+  const size_t compressedSize =
+    SurfaceCache::CompressedSizeForTesting() - sizeBefore;
+  EXPECT_LT(0u, compressedSize);
+  EXPECT_GT(size_t(testCase.mSize.width * testCase.mSize.height * 4) / 2,
+            compressedSize);
+
+  // A lookup restores the surface with its original pixels and takes it out
+  // of the compressed tier.
+  {
+    LookupResult result = LookupDecodedSurface(image, testCase);
+    CheckRestoredSurface(result);
+  }
+  EXPECT_EQ(sizeBefore, SurfaceCache::CompressedSizeForTesting());
+
+  // The restored surface is in the cache like any other.
+  {
+    LookupResult result = LookupDecodedSurface(image, testCase);
+    EXPECT_EQ(MatchType::EXACT, result.Type());
+  }
+
+  // Removing the image drops its compressed copies.
+  SurfaceCache::ExpireImageForTesting(ImageKey(image.get()));
+  EXPECT_LT(sizeBefore, SurfaceCache::CompressedSizeForTesting());
+  SurfaceCache::RemoveImage(ImageKey(image.get()));
+  EXPECT_EQ(sizeBefore, SurfaceCache::CompressedSizeForTesting());
+  {
+    LookupResult result = LookupDecodedSurface(image, testCase);
+    EXPECT_EQ(MatchType::NOT_FOUND, result.Type());
+  }
+}
+
+TEST_F(ImageSurfaceCacheCompression, BestMatchPrefersRestoredSurface)
+{
+  ImageTestCase testCase = GreenPNGTestCase();
+  RefPtr<Image> image = CreateDecodedImage(testCase);
+
+  SurfaceCache::ExpireImageForTesting(ImageKey(image.get()));
+
+  LookupResult result =
+    SurfaceCache::LookupBestMatch(ImageKey(image.get()),
+                                  RasterSurfaceKey(testCase.mSize,
+                                                   DefaultSurfaceFlags(),
+                                                   /* aFrameNum = */ 0));
+  CheckRestoredSurface(result);
+
+  SurfaceCache::RemoveImage(ImageKey(image.get()));
+}
+
+TEST_F(ImageSurfaceCacheCompression, Budget)
+{
+  SurfaceCache::DiscardAll();
+  ASSERT_EQ(0u, SurfaceCache::CompressedSizeForTesting());
+
+  ImageTestCase testCase = GreenPNGTestCase();
+  RefPtr<Image> image = CreateDecodedImage(testCase);
+
+  SurfaceCache::ExpireImageForTesting(ImageKey(image.get()));
+  const size_t compressedSize = SurfaceCache::CompressedSizeForTesting();
+  ASSERT_LT(0u, compressedSize);
+
+  // Shrinking the budget below what we hold drops compressed surfaces.
+  SurfaceCache::SetCompressedMaxSizeForTesting(compressedSize - 1);
+  EXPECT_EQ(0u, SurfaceCache::CompressedSizeForTesting());
+  {
+    LookupResult result = LookupDecodedSurface(image, testCase);
+    EXPECT_EQ(MatchType::NOT_FOUND, result.Type());
+  }
+
+  // Surfaces that don't fit in the budget at all aren't kept.
+  image = CreateDecodedImage(testCase);
+  SurfaceCache::ExpireImageForTesting(ImageKey(image.get()));
+  EXPECT_EQ(0u, SurfaceCache::CompressedSizeForTesting());
+
+  // With room for only one compressed surface, compressing another one drops
+  // the oldest.
+  SurfaceCache::SetCompressedMaxSizeForTesting(compressedSize);
+  RefPtr<Image> oldImage = CreateDecodedImage(testCase);
+  SurfaceCache::ExpireImageForTesting(ImageKey(oldImage.get()));
+  EXPECT_EQ(compressedSize, SurfaceCache::CompressedSizeForTesting());
+
+  RefPtr<Image> newImage = CreateDecodedImage(testCase);
+  SurfaceCache::ExpireImageForTesting(ImageKey(newImage.get()));
+  EXPECT_EQ(compressedSize, SurfaceCache::CompressedSizeForTesting());
+  {
+    LookupResult result = LookupDecodedSurface(oldImage, testCase);
+    EXPECT_EQ(MatchType::NOT_FOUND, result.Type());
+  }
+  {
+    LookupResult result = LookupDecodedSurface(newImage, testCase);
+    CheckRestoredSurface(result);
+  }
+  EXPECT_EQ(0u, SurfaceCache::CompressedSizeForTesting());
+
+  SurfaceCache::RemoveImage(ImageKey(image.get()));
+  SurfaceCache::RemoveImage(ImageKey(oldImage.get()));
+  SurfaceCache::RemoveImage(ImageKey(newImage.get()));
+}
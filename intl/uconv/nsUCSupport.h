@@ -217,6 +217,8 @@ protected:
   uMappingTable             * mMappingTable;
   char16_t                 mFastTable[ONE_BYTE_TABLE_SIZE];
   bool                      mFastTableCreated;
+  // Whether mFastTable maps ASCII to itself, so ASCII runs skip the lookups.
+  bool                      mASCIICompatible;
   mozilla::Mutex            mFastTableMutex;
 
   //--------------------------------------------------------------------
@@ -6,8 +6,8 @@
 
 #include "nsUCSupport.h"
 #include "nsUTF8ToUnicode.h"
+#include "nsUnicodeDecodeHelper.h"
 #include "mozilla/CheckedInt.h"
-#include "mozilla/SSE.h"
 #include "nsCharTraits.h"
 #include <algorithm>
 
@@ -84,102 +84,6 @@ NS_IMETHODIMP nsUTF8ToUnicode::Reset()
 //----------------------------------------------------------------------
 // Subclassing of nsBasicDecoderSupport class [implementation]
 
-// Fast ASCII -> UTF16 inner loop implementations
-//
-// Convert_ascii_run will update src and dst to the new values, and
-// len must be the maximum number ascii chars that it would be valid
-// to take from src and place into dst.  (That is, the minimum of the
-// number of bytes left in src and the number of unichars available in
-// dst.)
-
-#if defined(__arm__) || defined(_M_ARM)
-
-// on ARM, do extra work to avoid byte/halfword reads/writes by
-// reading/writing a word at a time for as long as we can
-static inline void
-Convert_ascii_run (const char *&src,
-                   char16_t *&dst,
-                   int32_t len)
-{
-  const uint32_t *src32;
-  uint32_t *dst32;
-
-  // with some alignments, we'd never actually break out of the slow loop, so
-  // check and do the faster slow loop
-  if ((((NS_PTR_TO_UINT32(dst) & 3) == 0) && ((NS_PTR_TO_UINT32(src) & 1) == 0)) ||
-      (((NS_PTR_TO_UINT32(dst) & 3) == 2) && ((NS_PTR_TO_UINT32(src) & 1) == 1)))
-  {
-    while (((NS_PTR_TO_UINT32(src) & 3) ||
-            (NS_PTR_TO_UINT32(dst) & 3)) &&
-           len > 0)
-    {
-      if (*src & 0x80U)
-        return;
-      *dst++ = (char16_t) *src++;
-      len--;
-    }
-  } else {
-    goto finish;
-  }
-
-  // then go 4 bytes at a time
-  src32 = (const uint32_t*) src;
-  dst32 = (uint32_t*) dst;
-
-  while (len > 4) {
-    uint32_t in = *src32++;
-
-    if (in & 0x80808080U) {
-      src32--;
-      break;
-    }
-
-    *dst32++ = ((in & 0x000000ff) >>  0) | ((in & 0x0000ff00) << 8);
-    *dst32++ = ((in & 0x00ff0000) >> 16) | ((in & 0xff000000) >> 8);
-
-    len -= 4;
-  }
-
-  src = (const char *) src32;
-  dst = (char16_t *) dst32;
-
-finish:
-  while (len-- > 0 && (*src & 0x80U) == 0) {
-    *dst++ = (char16_t) *src++;
-  }
-}
-
-#else
-
-#ifdef MOZILLA_MAY_SUPPORT_SSE2
-namespace mozilla {
-namespace SSE2 {
-
-void Convert_ascii_run(const char *&src, char16_t *&dst, int32_t len);
-
-} // namespace SSE2
-} // namespace mozilla
-#endif
-
-static inline void
-Convert_ascii_run (const char *&src,
-                   char16_t *&dst,
-                   int32_t len)
-{
-#ifdef MOZILLA_MAY_SUPPORT_SSE2
-  if (mozilla::supports_sse2()) {
-    mozilla::SSE2::Convert_ascii_run(src, dst, len);
-    return;
-  }
-#endif
-
-  while (len-- > 0 && (*src & 0x80U) == 0) {
-    *dst++ = (char16_t) *src++;
-  }
-}
-
-#endif
-
 NS_IMETHODIMP nsUTF8ToUnicode::Convert(const char * aSrc,
                                        int32_t * aSrcLength,
                                        char16_t * aDest,
@@ -229,7 +133,7 @@ NS_IMETHODIMP nsUTF8ToUnicode::Convert(const char * aSrc,
       // multi-octet sequence.
       if (c < 0x80) {  // 00..7F
         int32_t max_loops = std::min(inend - in, outend - out);
-        Convert_ascii_run(in, out, max_loops);
+        nsUnicodeDecodeHelper::ConvertASCIIRun(in, out, max_loops);
         --in; // match the rest of the cases
         mBytes = 1;
       } else if (c < 0xC2) {  // C0/C1
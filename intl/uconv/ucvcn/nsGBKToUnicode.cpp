@@ -13,6 +13,7 @@
 #include "nsGBKToUnicode.h"
 #include "gbku.h"
 #include "nsUnicodeDecodeHelper.h"
+#include <algorithm>
 
 static const uint16_t g_utGB18030Unique2Bytes[] = {
 #include "gb18030uniq2b.ut"
@@ -158,9 +159,17 @@ NS_IMETHODIMP nsGB18030ToUnicode::ConvertNoBuff(const char* aSrc,
     } else {
       if(IS_ASCII(*aSrc))
       {
-        // The source is an ASCII
-        *aDest = CAST_CHAR_TO_UNICHAR(*aSrc);
-        aSrc++;
+        // The source is an ASCII run; widen as much of it as fits at once
+        // and leave the last character to the common bookkeeping below.
+        const char* run = aSrc;
+        char16_t* dest = aDest;
+        nsUnicodeDecodeHelper::ConvertASCIIRun(run, dest,
+          std::min(iSrcLength - i, *aDestLength - iDestlen));
+        int32_t count = run - aSrc;
+        aSrc = run;
+        aDest += count - 1;
+        iDestlen += count - 1;
+        i += count - 1;
       } else {
         if(IS_GBK_EURO(*aSrc)) {
           *aDest = UCS2_EURO;
@@ -5,12 +5,15 @@
 #include "nsJapaneseToUnicode.h"
 
 #include "nsUCSupport.h"
+#include "nsUnicodeDecodeHelper.h"
 
 #include "japanese.map"
 
 #include "mozilla/Assertions.h"
 #include "mozilla/dom/EncodingUtils.h"
 
+#include <algorithm>
+
 using mozilla::dom::EncodingUtils;
 
 // HTML5 says to use Windows-31J instead of the real Shift_JIS for decoding
@@ -23,6 +26,19 @@ using mozilla::dom::EncodingUtils;
 #define IN_GR_RANGE(b) \
   ((uint8_t(0xa1) <= uint8_t(b)) && (uint8_t(b) <= uint8_t(0xfe)))
 
+// Widens the run of ASCII bytes starting at aSrc, as much of it as fits in
+// aDest, and leaves aSrc on the last byte converted, since the decoding loops
+// below step past the current byte themselves.
+static inline void
+DecodeASCIIRun(const unsigned char*& aSrc, const unsigned char* aSrcEnd,
+               char16_t*& aDest, const char16_t* aDestEnd)
+{
+  const char* run = (const char*)aSrc;
+  nsUnicodeDecodeHelper::ConvertASCIIRun(run, aDest,
+    int32_t(std::min(aSrcEnd - aSrc, aDestEnd - aDest)));
+  aSrc = (const unsigned char*)run - 1;
+}
+
 NS_IMETHODIMP nsShiftJISToUnicode::Convert(
    const char * aSrc, int32_t * aSrcLen,
      char16_t * aDest, int32_t * aDestLen)
@@ -72,7 +88,11 @@ NS_IMETHODIMP nsShiftJISToUnicode::Convert(
           case 0:
           if (*src <= 0x80) {
             // ASCII
-            *dest++ = (char16_t) *src;
+            if (*src < 0x80) {
+              DecodeASCIIRun(src, srcEnd, dest, destEnd);
+            } else {
+              *dest++ = (char16_t) *src;
+            }
             if (dest >= destEnd) {
               goto error1;
             }
@@ -256,7 +276,11 @@ NS_IMETHODIMP nsEUCJPToUnicodeV2::Convert(
             }
           } else {
             // ASCII
-            *dest++ = (char16_t) *src;
+            if (*src < 0x80) {
+              DecodeASCIIRun(src, srcEnd, dest, destEnd);
+            } else {
+              *dest++ = (char16_t) *src;
+            }
             if(dest >= destEnd)
               goto error1;
           }
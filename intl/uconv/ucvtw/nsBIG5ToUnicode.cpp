@@ -7,6 +7,8 @@
 #include "mozilla/BinarySearch.h"
 #include "mozilla/ArrayUtils.h"
 #include "nsBIG5Data.h"
+#include "nsUnicodeDecodeHelper.h"
+#include <algorithm>
 
 nsBIG5ToUnicode::nsBIG5ToUnicode()
  : mPendingTrail(0)
@@ -49,7 +51,11 @@ nsBIG5ToUnicode::Convert(const char* aSrc,
     uint8_t b = *in++;
     if (!mBig5Lead) {
       if (b <= 0x7F) {
-        *out++ = (char16_t)b;
+        // Widen the rest of the ASCII run in one go.
+        const char* run = reinterpret_cast<const char*>(--in);
+        nsUnicodeDecodeHelper::ConvertASCIIRun(run, out,
+          int32_t(std::min(inEnd - in, outEnd - out)));
+        in = reinterpret_cast<const uint8_t*>(run);
         continue;
       }
       if (b >= 0x81 && b <= 0xFE) {
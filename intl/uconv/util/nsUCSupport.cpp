@@ -243,6 +243,7 @@ nsOneByteDecoderSupport::nsOneByteDecoderSupport(
   : nsBasicDecoderSupport()
   , mMappingTable(aMappingTable)
   , mFastTableCreated(false)
+  , mASCIICompatible(false)
   , mFastTableMutex("nsOneByteDecoderSupport mFastTableMutex")
 {
 }
@@ -266,6 +267,8 @@ NS_IMETHODIMP nsOneByteDecoderSupport::Convert(const char* aSrc,
       nsresult res = nsUnicodeDecodeHelper::CreateFastTable(
                          mMappingTable, mFastTable, ONE_BYTE_TABLE_SIZE);
       if (NS_FAILED(res)) return res;
+      mASCIICompatible = nsUnicodeDecodeHelper::IsASCIICompatibleFastTable(
+                             mFastTable, ONE_BYTE_TABLE_SIZE);
       mFastTableCreated = true;
     }
   }
@@ -274,7 +277,8 @@ NS_IMETHODIMP nsOneByteDecoderSupport::Convert(const char* aSrc,
                                                    aDest, aDestLength,
                                                    mFastTable,
                                                    ONE_BYTE_TABLE_SIZE,
-                                                   mErrBehavior == kOnError_Signal);
+                                                   mErrBehavior == kOnError_Signal,
+                                                   mASCIICompatible);
 }
 
 NS_IMETHODIMP nsOneByteDecoderSupport::GetMaxLength(const char* aSrc,
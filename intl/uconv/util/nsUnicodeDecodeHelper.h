@@ -36,12 +36,31 @@ public:
       const uRange * aRangeArray, uScanClassID * aScanClassArray,
       uMappingTable ** aMappingTable, bool aErrorSignal = false);
 
+  /**
+   * Copies the run of ASCII bytes at the start of aSrc to aDest, widening
+   * them to UTF-16, and advances both pointers past it.  aLength is the
+   * maximum number of characters to copy, i.e. the minimum of the bytes left
+   * in aSrc and the characters left in aDest.  Stops at the first byte with
+   * the high bit set.
+   */
+  static void ConvertASCIIRun(const char *& aSrc, char16_t *& aDest,
+                              int32_t aLength);
+
   /**
    * Converts data using a fast lookup table.
+   *
+   * If aASCIICompatible is set, the table must map all of 0x00-0x7F to
+   * themselves, and runs of ASCII bytes are widened without table lookups.
+   */
+  static nsresult ConvertByFastTable(const char * aSrc, int32_t * aSrcLength,
+      char16_t * aDest, int32_t * aDestLength, const char16_t * aFastTable,
+      int32_t aTableSize, bool aErrorSignal, bool aASCIICompatible);
+
+  /**
+   * Returns whether a fast lookup table maps all of 0x00-0x7F to themselves.
    */
-  static nsresult ConvertByFastTable(const char * aSrc, int32_t * aSrcLength, 
-      char16_t * aDest, int32_t * aDestLength, const char16_t * aFastTable, 
-      int32_t aTableSize, bool aErrorSignal);
+  static bool IsASCIICompatibleFastTable(const char16_t * aFastTable,
+                                         int32_t aTableSize);
 
   /**
    * Create a cache-like fast lookup table from a normal one.
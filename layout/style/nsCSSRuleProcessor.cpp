@@ -96,7 +96,7 @@ struct RuleSelectorPair {
  */
 struct RuleValue : RuleSelectorPair {
   enum {
-    eMaxAncestorHashes = 4
+    eMaxAncestorHashes = nsCSSRuleProcessor::eMaxAncestorHashes
   };
 
   RuleValue(const RuleSelectorPair& aRuleSelectorPair, int32_t aIndex,
@@ -112,58 +112,8 @@ struct RuleValue : RuleSelectorPair {
 
 private:
   void CollectAncestorHashes(bool aQuirksMode) {
-    // Collect up our mAncestorSelectorHashes.  It's not clear whether it's
-    // better to stop once we've found eMaxAncestorHashes of them or to keep
-    // going and preferentially collect information from selectors higher up the
-    // chain...  Let's do the former for now.
-    size_t hashIndex = 0;
-    for (nsCSSSelector* sel = mSelector->mNext; sel; sel = sel->mNext) {
-      if (!NS_IS_ANCESTOR_OPERATOR(sel->mOperator)) {
-        // |sel| is going to select something that's not actually one of our
-        // ancestors, so don't add it to mAncestorSelectorHashes.  But keep
-        // going, because it'll select a sibling of one of our ancestors, so its
-        // ancestors would be our ancestors too.
-        continue;
-      }
-
-      // Now sel is supposed to select one of our ancestors.  Grab
-      // whatever info we can from it into mAncestorSelectorHashes.
-      // But in qurks mode, don't grab IDs and classes because those
-      // need to be matched case-insensitively.
-      if (!aQuirksMode) {
-        nsAtomList* ids = sel->mIDList;
-        while (ids) {
-          mAncestorSelectorHashes[hashIndex++] = ids->mAtom->hash();
-          if (hashIndex == eMaxAncestorHashes) {
-            return;
-          }
-          ids = ids->mNext;
-        }
-
-        nsAtomList* classes = sel->mClassList;
-        while (classes) {
-          mAncestorSelectorHashes[hashIndex++] = classes->mAtom->hash();
-          if (hashIndex == eMaxAncestorHashes) {
-            return;
-          }
-          classes = classes->mNext;
-        }
-      }
-
-      // Only put in the tag name if it's all-lowercase.  Otherwise we run into
-      // trouble because we may test the wrong one of mLowercaseTag and
-      // mCasedTag against the filter.
-      if (sel->mLowercaseTag && sel->mCasedTag == sel->mLowercaseTag) {
-        mAncestorSelectorHashes[hashIndex++] = sel->mLowercaseTag->hash();
-        if (hashIndex == eMaxAncestorHashes) {
-          return;
-        }
-      }
-    }
-
-    while (hashIndex != eMaxAncestorHashes) {
-      mAncestorSelectorHashes[hashIndex++] = 0;
-    }
+    nsCSSRuleProcessor::GetAncestorHashes(mSelector, aQuirksMode,
+                                          mAncestorSelectorHashes);
   }
 };
 
@@ -3888,6 +3838,27 @@ nsCSSRuleProcessor::RefreshRuleCascade(nsPresContext* aPresContext)
   return;
 }
 
+// Returns whether aElement matches aSelector, the rightmost compound
+// selector of one of the selectors of a selector list.
+static bool
+ListedSelectorMatches(Element* aElement,
+                      TreeMatchContext& aTreeMatchContext,
+                      nsCSSSelector* aSelector)
+{
+  NS_ASSERTION(aSelector, "Should have *some* selectors");
+  NS_ASSERTION(!aSelector->IsPseudoElement(), "Shouldn't have been called");
+  NodeMatchContext nodeContext(EventStates(), false);
+  if (!SelectorMatches(aElement, aSelector, nodeContext, aTreeMatchContext,
+                       SelectorMatchesFlags::NONE)) {
+    return false;
+  }
+
+  nsCSSSelector* next = aSelector->mNext;
+  return !next ||
+         SelectorMatchesTree(aElement, next, aTreeMatchContext,
+                             SelectorMatchesTreeFlags(0));
+}
+
 /* static */ bool
 nsCSSRuleProcessor::SelectorListMatches(Element* aElement,
                                         TreeMatchContext& aTreeMatchContext,
@@ -3898,18 +3869,9 @@ nsCSSRuleProcessor::SelectorListMatches(Element* aElement,
              "SelectorMatchesTree call");
 
   while (aSelectorList) {
-    nsCSSSelector* sel = aSelectorList->mSelectors;
-    NS_ASSERTION(sel, "Should have *some* selectors");
-    NS_ASSERTION(!sel->IsPseudoElement(), "Shouldn't have been called");
-    NodeMatchContext nodeContext(EventStates(), false);
-    if (SelectorMatches(aElement, sel, nodeContext, aTreeMatchContext,
-                        SelectorMatchesFlags::NONE)) {
-      nsCSSSelector* next = sel->mNext;
-      if (!next ||
-          SelectorMatchesTree(aElement, next, aTreeMatchContext,
-                              SelectorMatchesTreeFlags(0))) {
-        return true;
-      }
+    if (ListedSelectorMatches(aElement, aTreeMatchContext,
+                              aSelectorList->mSelectors)) {
+      return true;
     }
 
     aSelectorList = aSelectorList->mNext;
@@ -3918,6 +3880,101 @@ nsCSSRuleProcessor::SelectorListMatches(Element* aElement,
   return false;
 }
 
+/* static */ bool
+nsCSSRuleProcessor::SelectorListMatches(Element* aElement,
+                                        TreeMatchContext& aTreeMatchContext,
+                                        nsCSSSelectorList* aSelectorList,
+                                        const uint32_t* aAncestorHashes)
+{
+  MOZ_ASSERT(!aTreeMatchContext.mForScopedStyle,
+             "mCurrentStyleScope will need to be saved and restored after the "
+             "SelectorMatchesTree call");
+
+  const AncestorFilter* filter =
+    aTreeMatchContext.mAncestorFilter.HasFilter() ?
+      &aTreeMatchContext.mAncestorFilter : nullptr;
+#ifdef DEBUG
+  if (filter) {
+    filter->AssertHasAllAncestors(aElement);
+  }
+#endif
+
+  for (; aSelectorList;
+       aSelectorList = aSelectorList->mNext,
+       aAncestorHashes += eMaxAncestorHashes) {
+    if (filter &&
+        !filter->MightHaveMatchingAncestor<eMaxAncestorHashes>(
+          aAncestorHashes)) {
+      continue;
+    }
+    if (ListedSelectorMatches(aElement, aTreeMatchContext,
+                              aSelectorList->mSelectors)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* static */ void
+nsCSSRuleProcessor::GetAncestorHashes(nsCSSSelector* aSelector,
+                                      bool aQuirksMode,
+                                      uint32_t* aHashes)
+{
+  // Collect up our ancestor hashes.  It's not clear whether it's
+  // better to stop once we've found eMaxAncestorHashes of them or to keep
+  // going and preferentially collect information from selectors higher up the
+  // chain...  Let's do the former for now.
+  size_t hashIndex = 0;
+  for (nsCSSSelector* sel = aSelector->mNext; sel; sel = sel->mNext) {
+    if (!NS_IS_ANCESTOR_OPERATOR(sel->mOperator)) {
+      // |sel| is going to select something that's not actually one of our
+      // ancestors, so don't add it to aHashes.  But keep
+      // going, because it'll select a sibling of one of our ancestors, so its
+      // ancestors would be our ancestors too.
+      continue;
+    }
+
+    // Now sel is supposed to select one of our ancestors.  Grab
+    // whatever info we can from it into aHashes.
+    // But in qurks mode, don't grab IDs and classes because those
+    // need to be matched case-insensitively.
+    if (!aQuirksMode) {
+      nsAtomList* ids = sel->mIDList;
+      while (ids) {
+        aHashes[hashIndex++] = ids->mAtom->hash();
+        if (hashIndex == eMaxAncestorHashes) {
+          return;
+        }
+        ids = ids->mNext;
+      }
+
+      nsAtomList* classes = sel->mClassList;
+      while (classes) {
+        aHashes[hashIndex++] = classes->mAtom->hash();
+        if (hashIndex == eMaxAncestorHashes) {
+          return;
+        }
+        classes = classes->mNext;
+      }
+    }
+
+    // Only put in the tag name if it's all-lowercase.  Otherwise we run into
+    // trouble because we may test the wrong one of mLowercaseTag and
+    // mCasedTag against the filter.
+    if (sel->mLowercaseTag && sel->mCasedTag == sel->mLowercaseTag) {
+      aHashes[hashIndex++] = sel->mLowercaseTag->hash();
+      if (hashIndex == eMaxAncestorHashes) {
+        return;
+      }
+    }
+  }
+
+  while (hashIndex != eMaxAncestorHashes) {
+    aHashes[hashIndex++] = 0;
+  }
+}
+
 void
 nsCSSRuleProcessor::TakeDocumentRulesAndCacheKey(
     nsPresContext* aPresContext,
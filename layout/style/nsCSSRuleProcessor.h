@@ -96,6 +96,31 @@ public:
                                     TreeMatchContext& aTreeMatchContext,
                                     nsCSSSelectorList* aSelectorList);
 
+  // The number of ancestor hashes GetAncestorHashes collects per selector.
+  enum {
+    eMaxAncestorHashes = 4
+  };
+
+  /*
+   * Fills aHashes, which must have room for eMaxAncestorHashes hashes,
+   * with the hashes of ids, classes and tags that ancestors of an element
+   * need to have for aSelector to match the element, followed by zeroes.
+   * aSelector is the rightmost compound selector of a selector.
+   */
+  static void GetAncestorHashes(nsCSSSelector* aSelector, bool aQuirksMode,
+                                uint32_t* aHashes);
+
+  /*
+   * Like SelectorListMatches, but if aTreeMatchContext has an ancestor
+   * filter, selectors whose ancestor hashes are not all in it are skipped
+   * without being matched.  aAncestorHashes holds the result of
+   * GetAncestorHashes for each of the selectors in aSelectorList, in order.
+   */
+  static bool SelectorListMatches(mozilla::dom::Element* aElement,
+                                  TreeMatchContext& aTreeMatchContext,
+                                  nsCSSSelectorList* aSelectorList,
+                                  const uint32_t* aAncestorHashes);
+
   /*
    * Helper to get the content state for a content node.  This may be
    * slightly adjusted from IntrinsicState().
@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h" // For MOZ_GTEST_BENCH
+
+#include "nsHtml5AtomTable.h"
+#include "nsHtml5DependentUTF16Buffer.h"
+#include "nsHtml5Tokenizer.h"
+#include "nsHtml5TreeBuilder.h"
+#include "nsString.h"
+
+/**
+ * Runs the tokenizer and a tree builder without an op sink, which throws
+ * the tree ops away, over a string the way the stream parser runs them over
+ * network data.
+ */
+class TokenizerHarness
+{
+public:
+  TokenizerHarness()
+    : mTreeBuilder(nullptr, nullptr)
+    , mTokenizer(&mTreeBuilder, false)
+  {
+    mTokenizer.setInterner(&mAtomTable);
+  }
+
+  ~TokenizerHarness()
+  {
+    mTokenizer.end();
+  }
+
+  /**
+   * @return the number of lines the tokenizer counted
+   */
+  int32_t Tokenize(const nsAString& aSource)
+  {
+    mTokenizer.start();
+    int32_t firstLine = mTokenizer.getLineNumber();
+    bool lastWasCR = false;
+    nsHtml5DependentUTF16Buffer buffer(aSource);
+    while (buffer.hasMore()) {
+      buffer.adjust(lastWasCR);
+      lastWasCR = false;
+      if (buffer.hasMore()) {
+        EXPECT_TRUE(mTokenizer.EnsureBufferSpace(buffer.getLength()));
+        lastWasCR = mTokenizer.tokenizeBuffer(&buffer);
+        mTreeBuilder.Flush();
+      }
+    }
+    int32_t lines = mTokenizer.getLineNumber() - firstLine + 1;
+    mTokenizer.eof();
+    mTreeBuilder.Flush();
+    return lines;
+  }
+
+private:
+  nsHtml5AtomTable mAtomTable;
+  nsHtml5TreeBuilder mTreeBuilder;
+  nsHtml5Tokenizer mTokenizer;
+};
+
+/**
+ * Builds a server-rendered style document of about aSize code units, made
+ * of long text runs, long quoted attribute values and comments.
+ *
+ * @return the number of lines in the document
+ */
+static int32_t
+BuildDocument(nsAString& aDocument, uint32_t aSize)
+{
+  int32_t lines = 1;
+  aDocument.AssignLiteral("<!DOCTYPE html>\n<html><head><title>Test</title>"
+                          "</head>\n<body>\n");
+  lines += 3;
+  for (uint32_t i = 0; aDocument.Length() < aSize; i++) {
+    aDocument.AppendLiteral("<div class=\"row item item-");
+    aDocument.AppendInt(i);
+    aDocument.AppendLiteral(" clearfix\" data-title='Lorem ipsum dolor sit "
+                            "amet, consectetur adipiscing elit'>\n");
+    aDocument.AppendLiteral("  <!-- generated row, see template rows.html -->\n");
+    aDocument.AppendLiteral("  <p>Sed ut perspiciatis unde omnis iste natus "
+                            "error sit voluptatem accusantium doloremque "
+                            "laudantium, totam rem aperiam &amp; eaque ipsa "
+                            "quae ab illo inventore veritatis et quasi\n"
+                            "  architecto beatae vitae dicta sunt explicabo. "
+                            "Nemo enim ipsam voluptatem quia voluptas sit "
+                            "aspernatur aut odit aut fugit.</p>\n");
+    aDocument.AppendLiteral("  <textarea>Ut enim ad minima veniam, quis "
+                            "nostrum exercitationem\n</textarea>\n</div>\n");
+    lines += 7;
+  }
+  aDocument.AppendLiteral("</body></html>\n");
+  return lines + 1;
+}
+
+TEST(Html5Tokenizer, LineNumbers)
+{
+  nsAutoString document;
+  int32_t lines = BuildDocument(document, 1 << 16);
+
+  TokenizerHarness harness;
+  ASSERT_EQ(lines, harness.Tokenize(document));
+}
+
+TEST(Html5Tokenizer, CarriageReturnsAndNulls)
+{
+  // CRs and NULs end the plain text runs; CRLF counts as one line break.
+  nsAutoString document;
+  document.AssignLiteral("<p title=\"a\r\nb\">text\r\nmore\r\n");
+  document.Append(char16_t(0));
+  document.AppendLiteral("text\r<!-- comment\r\n-->\n</p>\n");
+
+  TokenizerHarness harness;
+  ASSERT_EQ(8, harness.Tokenize(document));
+}
+
+MOZ_GTEST_BENCH(Html5Tokenizer, Throughput, [] {
+  nsAutoString document;
+  int32_t lines = BuildDocument(document, 8 << 20);
+
+  for (int i = 0; i < 4; i++) {
+    TokenizerHarness harness;
+    ASSERT_EQ(lines, harness.Tokenize(document));
+  }
+});
@@ -423,6 +423,7 @@ nsHtml5Tokenizer::stateLoop(int32_t state, char16_t c, int32_t pos, char16_t* bu
           if (reconsume) {
             reconsume = false;
           } else {
+            pos = skipPlainText(buf, pos, endPos, '<', '&');
             if (++pos == endPos) {
               NS_HTML5_BREAK(stateloop);
             }
@@ -764,6 +765,7 @@ nsHtml5Tokenizer::stateLoop(int32_t state, char16_t c, int32_t pos, char16_t* bu
           if (reconsume) {
             reconsume = false;
           } else {
+            pos = appendPlainTextToStrBuf(buf, pos, endPos, '\"', '&');
             if (++pos == endPos) {
               NS_HTML5_BREAK(stateloop);
             }
@@ -1099,6 +1101,7 @@ nsHtml5Tokenizer::stateLoop(int32_t state, char16_t c, int32_t pos, char16_t* bu
       }
       case NS_HTML5TOKENIZER_COMMENT: {
         for (; ; ) {
+          pos = appendPlainTextToStrBuf(buf, pos, endPos, '-', '-');
           if (++pos == endPos) {
             NS_HTML5_BREAK(stateloop);
           }
@@ -1398,6 +1401,7 @@ nsHtml5Tokenizer::stateLoop(int32_t state, char16_t c, int32_t pos, char16_t* bu
           if (reconsume) {
             reconsume = false;
           } else {
+            pos = appendPlainTextToStrBuf(buf, pos, endPos, '\'', '&');
             if (++pos == endPos) {
               NS_HTML5_BREAK(stateloop);
             }
@@ -1901,6 +1905,7 @@ nsHtml5Tokenizer::stateLoop(int32_t state, char16_t c, int32_t pos, char16_t* bu
           if (reconsume) {
             reconsume = false;
           } else {
+            pos = skipPlainText(buf, pos, endPos, '<', '&');
             if (++pos == endPos) {
               NS_HTML5_BREAK(stateloop);
             }
@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "mozilla/Likely.h"
+#include "nsHtml5TokenizerSSE2.h"
 
 bool
 nsHtml5Tokenizer::EnsureBufferSpace(int32_t aLength)
@@ -42,6 +43,36 @@ nsHtml5Tokenizer::EnsureBufferSpace(int32_t aLength)
   return true;
 }
 
+int32_t
+nsHtml5Tokenizer::scanPlainText(char16_t* aBuf,
+                                int32_t aPos,
+                                int32_t aEndPos,
+                                char16_t aStop1,
+                                char16_t aStop2)
+{
+  int32_t lineFeeds = 0;
+  int32_t i = aPos;
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2()) {
+    i = nsHtml5ScanPlainTextSSE2(aBuf, aPos, aEndPos, aStop1, aStop2,
+                                 &lineFeeds);
+    line += lineFeeds;
+    return i;
+  }
+#endif
+  for (; i < aEndPos; ++i) {
+    char16_t c = aBuf[i];
+    if (c == aStop1 || c == aStop2 || c == '\0' || c == '\r') {
+      break;
+    }
+    if (c == '\n') {
+      ++lineFeeds;
+    }
+  }
+  line += lineFeeds;
+  return i;
+}
+
 void
 nsHtml5Tokenizer::StartPlainText()
 {
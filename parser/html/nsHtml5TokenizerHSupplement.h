@@ -17,6 +17,58 @@ inline nsHtml5HtmlAttributes* GetAttributes()
  */
 bool EnsureBufferSpace(int32_t aLength);
 
+/**
+ * Finds the end of a run of code units that the current state merely
+ * consumes, so that the state loop can skip over it in bulk.
+ *
+ * @param aBuf the buffer being tokenized
+ * @param aPos the index of the first code unit not yet consumed
+ * @param aEndPos the end of the buffer
+ * @param aStop1 a code unit that ends the run besides NUL and CR
+ * @param aStop2 another code unit that ends the run
+ * @return the index of the first code unit that ends the run, or aEndPos.
+ *         Line feeds inside the run have been counted.
+ */
+int32_t scanPlainText(char16_t* aBuf,
+                      int32_t aPos,
+                      int32_t aEndPos,
+                      char16_t aStop1,
+                      char16_t aStop2);
+
+/**
+ * Skips the plain text run after aPos in the states that emit characters
+ * straight from the buffer.
+ *
+ * @return the index of the last code unit of the run, or aPos if empty
+ */
+inline int32_t skipPlainText(char16_t* aBuf,
+                             int32_t aPos,
+                             int32_t aEndPos,
+                             char16_t aStop1,
+                             char16_t aStop2)
+{
+  return scanPlainText(aBuf, aPos + 1, aEndPos, aStop1, aStop2) - 1;
+}
+
+/**
+ * Appends the plain text run after aPos to strBuf in the states that
+ * accumulate characters there.
+ *
+ * @return the index of the last code unit of the run, or aPos if empty
+ */
+inline int32_t appendPlainTextToStrBuf(char16_t* aBuf,
+                                       int32_t aPos,
+                                       int32_t aEndPos,
+                                       char16_t aStop1,
+                                       char16_t aStop2)
+{
+  int32_t end = scanPlainText(aBuf, aPos + 1, aEndPos, aStop1, aStop2);
+  if (end > aPos + 1) {
+    appendStrBuf(aBuf, aPos + 1, end - aPos - 1);
+  }
+  return end - 1;
+}
+
 nsAutoPtr<nsHtml5Highlighter> mViewSource;
 
 /**
@@ -0,0 +1,68 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsHtml5TokenizerSSE2.h"
+
+#include "mozilla/MathAlgorithms.h"
+#include <emmintrin.h>
+
+int32_t
+nsHtml5ScanPlainTextSSE2(const char16_t* aBuf,
+                         int32_t aPos,
+                         int32_t aEndPos,
+                         char16_t aStop1,
+                         char16_t aStop2,
+                         int32_t* aLineFeeds)
+{
+  const __m128i nul = _mm_setzero_si128();
+  const __m128i cr = _mm_set1_epi16('\r');
+  const __m128i lf = _mm_set1_epi16('\n');
+  const __m128i stop1 = _mm_set1_epi16(aStop1);
+  const __m128i stop2 = _mm_set1_epi16(aStop2);
+
+  int32_t i = aPos;
+  int32_t lineFeeds = 0;
+  // Walk 16 code units (two XMM registers) at a time. movemask yields two
+  // bits per 16-bit lane, so a lane index is a bit index divided by two.
+  for (; aEndPos - i >= 16; i += 16) {
+    __m128i a =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(aBuf + i));
+    __m128i b =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(aBuf + i + 8));
+
+    __m128i stopA = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi16(a, nul), _mm_cmpeq_epi16(a, cr)),
+      _mm_or_si128(_mm_cmpeq_epi16(a, stop1), _mm_cmpeq_epi16(a, stop2)));
+    __m128i stopB = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi16(b, nul), _mm_cmpeq_epi16(b, cr)),
+      _mm_or_si128(_mm_cmpeq_epi16(b, stop1), _mm_cmpeq_epi16(b, stop2)));
+    uint32_t stops = uint32_t(_mm_movemask_epi8(stopA)) |
+                     (uint32_t(_mm_movemask_epi8(stopB)) << 16);
+    uint32_t lineFeedBits =
+      uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi16(a, lf))) |
+      (uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi16(b, lf))) << 16);
+
+    if (stops) {
+      uint32_t stopBit = mozilla::CountTrailingZeroes32(stops);
+      // Only count the line feeds before the stop.
+      lineFeedBits &= (uint32_t(1) << stopBit) - 1;
+      *aLineFeeds += lineFeeds + (mozilla::CountPopulation32(lineFeedBits) >> 1);
+      return i + int32_t(stopBit >> 1);
+    }
+    lineFeeds += mozilla::CountPopulation32(lineFeedBits) >> 1;
+  }
+
+  // Finish up the rest.
+  for (; i < aEndPos; ++i) {
+    char16_t c = aBuf[i];
+    if (c == aStop1 || c == aStop2 || c == '\0' || c == '\r') {
+      break;
+    }
+    if (c == '\n') {
+      ++lineFeeds;
+    }
+  }
+  *aLineFeeds += lineFeeds;
+  return i;
+}
@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsHtml5TokenizerSSE2_h
+#define nsHtml5TokenizerSSE2_h
+
+#include "mozilla/SSE.h"
+
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+/**
+ * SSE2 version of nsHtml5Tokenizer::scanPlainText(). Lives in its own
+ * translation unit so that only it gets compiled with SSE2 enabled.
+ */
+int32_t
+nsHtml5ScanPlainTextSSE2(const char16_t* aBuf,
+                         int32_t aPos,
+                         int32_t aEndPos,
+                         char16_t aStop1,
+                         char16_t aStop2,
+                         int32_t* aLineFeeds);
+#endif
+
+#endif // nsHtml5TokenizerSSE2_h
@@ -0,0 +1,144 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "PreparedStatementCache.h"
+
+#include "nsCRT.h"
+#include "nsReadableUtils.h"
+
+#include "sqlite3.h"
+
+namespace mozilla {
+namespace storage {
+
+namespace {
+
+/**
+ * sqlite3_sql only returns the text of the first SQL statement in the string
+ * it was prepared from, so the string may have had trailing whitespace the
+ * statement text lacks.  Such a string still compiles to the same statement.
+ */
+bool
+CompilesTo(const nsCString &aSQL, const nsCString &aStatementSQL)
+{
+  if (!StringBeginsWith(aSQL, aStatementSQL)) {
+    return false;
+  }
+
+  for (uint32_t i = aStatementSQL.Length(); i < aSQL.Length(); i++) {
+    if (!nsCRT::IsAsciiSpace(aSQL[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+PreparedStatementCache::PreparedStatementCache(uint32_t aCapacity)
+: mMutex("PreparedStatementCache::mMutex")
+, mCapacity(aCapacity)
+, mClosed(false)
+, mHits(0)
+, mMisses(0)
+, mEvictions(0)
+{
+}
+
+PreparedStatementCache::~PreparedStatementCache()
+{
+  MOZ_ASSERT(mEntries.IsEmpty(),
+             "Statements should have been finalized when closing!");
+}
+
+sqlite3_stmt *
+PreparedStatementCache::take(const nsCString &aSQL)
+{
+  sqlite3_stmt *stmt = nullptr;
+  {
+    MutexAutoLock lockedScope(mMutex);
+
+    // Search the most recently used statements first.
+    for (size_t i = mEntries.Length(); i-- > 0; ) {
+      if (CompilesTo(aSQL, mEntries[i].sql)) {
+        stmt = mEntries[i].statement;
+        mEntries.RemoveElementAt(i);
+        break;
+      }
+    }
+  }
+
+  // The schema may have changed since the statement was cached.
+  if (stmt && ::sqlite3_expired(stmt)) {
+    (void)::sqlite3_finalize(stmt);
+    stmt = nullptr;
+  }
+
+  MutexAutoLock lockedScope(mMutex);
+  if (stmt)
+    mHits++;
+  else
+    mMisses++;
+  return stmt;
+}
+
+bool
+PreparedStatementCache::put(sqlite3_stmt *aStatement)
+{
+  // There is no point in keeping a statement that has to be compiled again.
+  if (::sqlite3_expired(aStatement))
+    return false;
+
+  Entry entry;
+  entry.sql.Assign(::sqlite3_sql(aStatement));
+  entry.statement = aStatement;
+
+  sqlite3_stmt *evicted = nullptr;
+  {
+    MutexAutoLock lockedScope(mMutex);
+    if (mClosed || !mCapacity)
+      return false;
+
+    if (mEntries.Length() >= mCapacity) {
+      evicted = mEntries[0].statement;
+      mEntries.RemoveElementAt(0);
+      mEvictions++;
+    }
+    mEntries.AppendElement(entry);
+  }
+
+  if (evicted)
+    (void)::sqlite3_finalize(evicted);
+  return true;
+}
+
+void
+PreparedStatementCache::close()
+{
+  nsTArray<Entry> entries;
+  {
+    MutexAutoLock lockedScope(mMutex);
+    mClosed = true;
+    entries.SwapElements(mEntries);
+  }
+
+  for (uint32_t i = 0; i < entries.Length(); i++) {
+    (void)::sqlite3_finalize(entries[i].statement);
+  }
+}
+
+void
+PreparedStatementCache::getStats(Stats &_stats)
+{
+  MutexAutoLock lockedScope(mMutex);
+  _stats.hits = mHits;
+  _stats.misses = mMisses;
+  _stats.evictions = mEvictions;
+  _stats.cached = mEntries.Length();
+}
+
+} // namespace storage
+} // namespace mozilla
@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_storage_PreparedStatementCache_h_
+#define mozilla_storage_PreparedStatementCache_h_
+
+#include "nsString.h"
+#include "nsTArray.h"
+#include "mozilla/Mutex.h"
+
+struct sqlite3_stmt;
+
+namespace mozilla {
+namespace storage {
+
+/**
+ * Keeps the sqlite3_stmts of finalized Statements and AsyncStatements of a
+ * connection around, so that creating a statement for the same SQL again does
+ * not have to compile it again.  Only idle statements are held: a statement
+ * is removed from the cache while it is in use, so it is never shared.  The
+ * least recently used statement is finalized when the cache is full.
+ *
+ * Changing the schema, or registering functions or collations, expires all of
+ * a connection's statements.  Expired statements are never handed out again:
+ * SQLite would only recompile them when they are stepped, after the
+ * Statement has read its result columns, and SQL that no longer compiles
+ * would not fail when the statement is created.
+ *
+ * The cache is used from both the opener thread and the async execution
+ * thread.  It never calls into SQLite while holding its mutex, as callers may
+ * hold the connection's SQLite mutex.
+ */
+class PreparedStatementCache final
+{
+public:
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint32_t cached;
+  };
+
+  /**
+   * @param aCapacity
+   *        The maximum number of idle statements to hold.
+   */
+  explicit PreparedStatementCache(uint32_t aCapacity);
+  ~PreparedStatementCache();
+
+  /**
+   * Removes an idle statement compiled from aSQL from the cache.
+   *
+   * @return the statement, or nullptr if there is none or it has expired.
+   */
+  sqlite3_stmt *take(const nsCString &aSQL);
+
+  /**
+   * Hands an idle statement to the cache.  aStatement must have been reset and
+   * have its bindings cleared.
+   *
+   * @return true if the cache now owns aStatement, false if the caller still
+   *         needs to finalize it.
+   */
+  bool put(sqlite3_stmt *aStatement);
+
+  /**
+   * Finalizes all of the cached statements and stops caching new ones.  Must
+   * be called before the connection is closed.
+   */
+  void close();
+
+  void getStats(Stats &_stats);
+
+private:
+  struct Entry
+  {
+    // A copy of the statement's SQL text, so lookups need not ask SQLite for
+    // it while holding mMutex.
+    nsCString sql;
+    sqlite3_stmt *statement;
+  };
+
+  Mutex mMutex;
+
+  /**
+   * The idle statements, least recently used first.  Protected by mMutex, as
+   * are all of the members below.
+   */
+  nsTArray<Entry> mEntries;
+
+  const uint32_t mCapacity;
+  bool mClosed;
+
+  uint64_t mHits;
+  uint64_t mMisses;
+  uint64_t mEvictions;
+};
+
+} // namespace storage
+} // namespace mozilla
+
+#endif // mozilla_storage_PreparedStatementCache_h_
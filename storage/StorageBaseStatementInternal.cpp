@@ -45,7 +45,7 @@ public:
   NS_IMETHOD Run()
   {
     if (mStatement->mAsyncStatement) {
-      sqlite3_finalize(mStatement->mAsyncStatement);
+      (void)mConnection->releaseStatement(mStatement->mAsyncStatement);
       mStatement->mAsyncStatement = nullptr;
     }
 
@@ -90,7 +90,7 @@ public:
 
   NS_IMETHOD Run()
   {
-    (void)::sqlite3_finalize(mAsyncStatement);
+    (void)mConnection->releaseStatement(mAsyncStatement);
     mAsyncStatement = nullptr;
 
     nsCOMPtr<nsIThread> target(mConnection->threadOpenedOn);
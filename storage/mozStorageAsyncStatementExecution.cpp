@@ -4,6 +4,8 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <algorithm>
+
 #include "nsAutoPtr.h"
 
 #include "sqlite3.h"
@@ -11,6 +13,7 @@
 #include "mozIStorageStatementCallback.h"
 #include "mozStorageBindingParams.h"
 #include "mozStorageHelper.h"
+#include "mozStorageColumnarResultSet.h"
 #include "mozStorageResultSet.h"
 #include "mozStorageRow.h"
 #include "mozStorageConnection.h"
@@ -18,6 +21,7 @@
 #include "mozStoragePrivateHelpers.h"
 #include "mozStorageStatementData.h"
 #include "mozStorageAsyncStatementExecution.h"
+#include "mozStorageService.h"
 
 #include "mozilla/DebugOnly.h"
 #include "mozilla/Telemetry.h"
@@ -39,6 +43,16 @@ namespace storage {
 #define MAX_MILLISECONDS_BETWEEN_RESULTS 75
 #define MAX_ROWS_PER_RESULT 15
 
+/**
+ * Columnar result sets are much cheaper to build and to hand over per row, so
+ * their row limit starts at MAX_ROWS_PER_RESULT, to get the first results to
+ * the consumer quickly, and doubles with every full set up to
+ * MAX_ROWS_PER_COLUMNAR_RESULT.  MAX_BYTES_PER_COLUMNAR_RESULT bounds the
+ * memory of a single set when rows are large.
+ */
+#define MAX_ROWS_PER_COLUMNAR_RESULT 1920
+#define MAX_BYTES_PER_COLUMNAR_RESULT (256 * 1024)
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Local Classes
 
@@ -204,6 +218,8 @@ AsyncExecuteStatements::AsyncExecuteStatements(StatementDataArray &aStatements,
 , mHasTransaction(false)
 , mCallback(aCallback)
 , mCallingThread(::do_GetCurrentThread())
+, mColumnarResults(Service::useColumnarResults())
+, mMaxRowsPerResult(MAX_ROWS_PER_RESULT)
 , mMaxWait(TimeDuration::FromMilliseconds(MAX_MILLISECONDS_BETWEEN_RESULTS))
 , mIntervalStart(TimeStamp::Now())
 , mState(PENDING)
@@ -395,6 +411,9 @@ AsyncExecuteStatements::buildAndNotifyResults(sqlite3_stmt *aStatement)
   NS_ASSERTION(mCallback, "Trying to dispatch results without a callback!");
   mMutex.AssertNotCurrentThreadOwns();
 
+  if (mColumnarResults)
+    return buildAndNotifyColumnarResults(aStatement);
+
   // Build result object if we need it.
   if (!mResultSet)
     mResultSet = new ResultSet();
@@ -427,6 +446,49 @@ AsyncExecuteStatements::buildAndNotifyResults(sqlite3_stmt *aStatement)
   return NS_OK;
 }
 
+nsresult
+AsyncExecuteStatements::buildAndNotifyColumnarResults(sqlite3_stmt *aStatement)
+{
+  // A columnar result set only holds rows of a single statement, so hand over
+  // the rows of the previous statement first.
+  if (mColumnarResultSet && !mColumnarResultSet->isFrom(aStatement)) {
+    nsresult rv = notifyResults();
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+
+  // Build result object if we need it.
+  if (!mColumnarResultSet)
+    mColumnarResultSet = new ColumnarResultSet(aStatement);
+
+  nsresult rv = mColumnarResultSet->add(aStatement);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  // Notify the calling thread once we have hit the current row limit, the
+  // byte budget, or the maximum amount of time we want to wait for results.
+  TimeStamp now = TimeStamp::Now();
+  TimeDuration delta = now - mIntervalStart;
+  bool rowLimitReached = mColumnarResultSet->rows() >= mMaxRowsPerResult;
+  if (rowLimitReached ||
+      mColumnarResultSet->dataSize() >= MAX_BYTES_PER_COLUMNAR_RESULT ||
+      delta > mMaxWait) {
+    // Notify the caller
+    rv = notifyResults();
+    if (NS_FAILED(rv))
+      return NS_OK; // we'll try again with the next result
+
+    // Rows are coming in faster than we hand them over, so batch more of them
+    // together next time.
+    if (rowLimitReached)
+      mMaxRowsPerResult = std::min(mMaxRowsPerResult * 2,
+                                   uint32_t(MAX_ROWS_PER_COLUMNAR_RESULT));
+
+    // Reset our start time
+    mIntervalStart = now;
+  }
+
+  return NS_OK;
+}
+
 nsresult
 AsyncExecuteStatements::notifyComplete()
 {
@@ -515,13 +577,19 @@ AsyncExecuteStatements::notifyResults()
   mMutex.AssertNotCurrentThreadOwns();
   NS_ASSERTION(mCallback, "notifyResults called without a callback!");
 
+  mozIStorageResultSet *results = mColumnarResults ?
+    static_cast<mozIStorageResultSet *>(mColumnarResultSet) :
+    static_cast<mozIStorageResultSet *>(mResultSet);
   RefPtr<CallbackResultNotifier> notifier =
-    new CallbackResultNotifier(mCallback, mResultSet, this);
+    new CallbackResultNotifier(mCallback, results, this);
   NS_ENSURE_TRUE(notifier, NS_ERROR_OUT_OF_MEMORY);
 
   nsresult rv = mCallingThread->Dispatch(notifier, NS_DISPATCH_NORMAL);
-  if (NS_SUCCEEDED(rv))
-    mResultSet = nullptr; // we no longer own it on success
+  if (NS_SUCCEEDED(rv)) {
+    // we no longer own it on success
+    mResultSet = nullptr;
+    mColumnarResultSet = nullptr;
+  }
   return rv;
 }
 
@@ -640,7 +708,7 @@ AsyncExecuteStatements::Run()
 
   // If we still have results that we haven't notified about, take care of
   // them now.
-  if (mResultSet)
+  if (mResultSet || mColumnarResultSet)
     (void)notifyResults();
 
   // Notify about completion
@@ -25,6 +25,7 @@ struct sqlite3_stmt;
 namespace mozilla {
 namespace storage {
 
+class ColumnarResultSet;
 class Connection;
 class ResultSet;
 class StatementData;
@@ -144,6 +145,17 @@ private:
    */
   nsresult buildAndNotifyResults(sqlite3_stmt *aStatement);
 
+  /**
+   * The columnar counterpart of buildAndNotifyResults, used when
+   * mColumnarResults is set.
+   *
+   * @pre mMutex is not held
+   *
+   * @param aStatement
+   *        The statement to get the row data from.
+   */
+  nsresult buildAndNotifyColumnarResults(sqlite3_stmt *aStatement);
+
   /**
    * Notifies callback about completion, and does any necessary cleanup.
    *
@@ -189,6 +201,19 @@ private:
   mozIStorageStatementCallback *mCallback;
   nsCOMPtr<nsIThread> mCallingThread;
   RefPtr<ResultSet> mResultSet;
+  RefPtr<ColumnarResultSet> mColumnarResultSet;
+
+  /**
+   * Indicates whether results are delivered in ColumnarResultSets rather than
+   * in ResultSets of Rows.  Set at construction from the storage service.
+   */
+  const bool mColumnarResults;
+
+  /**
+   * The number of rows after which the current columnar result set is handed
+   * to the callback.  Grows as long as sets fill up before mMaxWait elapses.
+   */
+  uint32_t mMaxRowsPerResult;
 
   /**
    * The maximum amount of time we want to wait between results.  Defined by
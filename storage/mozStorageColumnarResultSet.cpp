@@ -0,0 +1,455 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsString.h"
+
+#include "sqlite3.h"
+#include "mozStoragePrivateHelpers.h"
+#include "Variant.h"
+#include "mozStorageColumnarResultSet.h"
+
+namespace mozilla {
+namespace storage {
+
+////////////////////////////////////////////////////////////////////////////////
+//// ColumnarResultSet
+
+ColumnarResultSet::ColumnarResultSet(sqlite3_stmt *aStatement)
+: mStatement(aStatement)
+, mNumRows(0)
+, mCurrentIndex(0)
+{
+  uint32_t numCols = ::sqlite3_column_count(aStatement);
+  mColumns.SetLength(numCols);
+
+  // Associate the names (if any) with their index
+  for (uint32_t i = 0; i < numCols; i++) {
+    const char *name = ::sqlite3_column_name(aStatement, i);
+    if (!name) break;
+    nsAutoCString colName(name);
+    mNameHashtable.Put(colName, i);
+  }
+}
+
+nsresult
+ColumnarResultSet::add(sqlite3_stmt *aStatement)
+{
+  MOZ_ASSERT(isFrom(aStatement));
+
+  for (uint32_t i = 0; i < mColumns.Length(); i++) {
+    Column &column = mColumns[i];
+    uint32_t slot = 0;
+    int type = ::sqlite3_column_type(aStatement, i);
+    switch (type) {
+      case SQLITE_INTEGER:
+        slot = column.mIntegers.Length();
+        column.mIntegers.AppendElement(::sqlite3_column_int64(aStatement, i));
+        break;
+      case SQLITE_FLOAT:
+        slot = column.mFloats.Length();
+        column.mFloats.AppendElement(::sqlite3_column_double(aStatement, i));
+        break;
+      case SQLITE_TEXT:
+      {
+        const char16_t *text =
+          static_cast<const char16_t *>(::sqlite3_column_text16(aStatement, i));
+        uint32_t length = ::sqlite3_column_bytes16(aStatement, i) /
+                          sizeof(char16_t);
+        Extent extent = { static_cast<uint32_t>(mTextArena.Length()), length };
+        NS_ENSURE_TRUE(mTextArena.AppendElements(text, length, fallible),
+                       NS_ERROR_OUT_OF_MEMORY);
+        slot = column.mTexts.Length();
+        column.mTexts.AppendElement(extent);
+        break;
+      }
+      case SQLITE_NULL:
+        break;
+      case SQLITE_BLOB:
+      {
+        const uint8_t *data =
+          static_cast<const uint8_t *>(::sqlite3_column_blob(aStatement, i));
+        uint32_t size = ::sqlite3_column_bytes(aStatement, i);
+        Extent extent = { static_cast<uint32_t>(mBlobArena.Length()), size };
+        NS_ENSURE_TRUE(mBlobArena.AppendElements(data, size, fallible),
+                       NS_ERROR_OUT_OF_MEMORY);
+        slot = column.mBlobs.Length();
+        column.mBlobs.AppendElement(extent);
+        break;
+      }
+      default:
+        return NS_ERROR_UNEXPECTED;
+    }
+
+    column.mTypes.AppendElement(static_cast<uint8_t>(type));
+    column.mSlots.AppendElement(slot);
+  }
+
+  mNumRows++;
+  return NS_OK;
+}
+
+size_t
+ColumnarResultSet::dataSize() const
+{
+  size_t size = mTextArena.Length() * sizeof(char16_t) + mBlobArena.Length();
+  for (uint32_t i = 0; i < mColumns.Length(); i++) {
+    const Column &column = mColumns[i];
+    size += column.mIntegers.Length() * sizeof(int64_t) +
+            column.mFloats.Length() * sizeof(double);
+  }
+  return size;
+}
+
+int64_t
+ColumnarResultSet::integerAt(uint32_t aRow, uint32_t aColumn) const
+{
+  const Column &column = mColumns[aColumn];
+  MOZ_ASSERT(column.mTypes[aRow] == SQLITE_INTEGER);
+  return column.mIntegers[column.mSlots[aRow]];
+}
+
+double
+ColumnarResultSet::floatAt(uint32_t aRow, uint32_t aColumn) const
+{
+  const Column &column = mColumns[aColumn];
+  MOZ_ASSERT(column.mTypes[aRow] == SQLITE_FLOAT);
+  return column.mFloats[column.mSlots[aRow]];
+}
+
+const char16_t *
+ColumnarResultSet::textAt(uint32_t aRow, uint32_t aColumn,
+                          uint32_t *_length) const
+{
+  const Column &column = mColumns[aColumn];
+  MOZ_ASSERT(column.mTypes[aRow] == SQLITE_TEXT);
+  const Extent &extent = column.mTexts[column.mSlots[aRow]];
+  *_length = extent.length;
+  return mTextArena.Elements() + extent.offset;
+}
+
+const uint8_t *
+ColumnarResultSet::blobAt(uint32_t aRow, uint32_t aColumn,
+                          uint32_t *_size) const
+{
+  const Column &column = mColumns[aColumn];
+  MOZ_ASSERT(column.mTypes[aRow] == SQLITE_BLOB);
+  const Extent &extent = column.mBlobs[column.mSlots[aRow]];
+  *_size = extent.length;
+  return mBlobArena.Elements() + extent.offset;
+}
+
+/**
+ * Note:  This object is only ever accessed on one thread at a time.  It it not
+ *        threadsafe, but it does need threadsafe AddRef and Release.
+ */
+NS_IMPL_ISUPPORTS(
+  ColumnarResultSet,
+  mozIStorageResultSet
+)
+
+////////////////////////////////////////////////////////////////////////////////
+//// mozIStorageResultSet
+
+NS_IMETHODIMP
+ColumnarResultSet::GetNextRow(mozIStorageRow **_row)
+{
+  NS_ENSURE_ARG_POINTER(_row);
+
+  if (mCurrentIndex >= mNumRows) {
+    // Just return null here
+    return NS_OK;
+  }
+
+  NS_ADDREF(*_row = new ColumnarRow(this, mCurrentIndex++));
+  return NS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// ColumnarRow
+
+/**
+ * Note:  This object is only ever accessed on one thread at a time.  It it not
+ *        threadsafe, but it does need threadsafe AddRef and Release.
+ */
+NS_IMPL_ISUPPORTS(
+  ColumnarRow,
+  mozIStorageRow,
+  mozIStorageValueArray
+)
+
+////////////////////////////////////////////////////////////////////////////////
+//// mozIStorageRow
+
+NS_IMETHODIMP
+ColumnarRow::GetResultByIndex(uint32_t aIndex,
+                              nsIVariant **_result)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  nsCOMPtr<nsIVariant> variant;
+  switch (mResultSet->typeAt(mIndex, aIndex)) {
+    case SQLITE_INTEGER:
+      variant = new IntegerVariant(mResultSet->integerAt(mIndex, aIndex));
+      break;
+    case SQLITE_FLOAT:
+      variant = new FloatVariant(mResultSet->floatAt(mIndex, aIndex));
+      break;
+    case SQLITE_TEXT:
+    {
+      uint32_t length;
+      const char16_t *text = mResultSet->textAt(mIndex, aIndex, &length);
+      variant = new TextVariant(nsDependentString(text, length));
+      break;
+    }
+    case SQLITE_BLOB:
+    {
+      uint32_t size;
+      const uint8_t *data = mResultSet->blobAt(mIndex, aIndex, &size);
+      variant = new BlobVariant(std::pair<const void *, int>(data, size));
+      break;
+    }
+    default:
+      variant = new NullVariant();
+      break;
+  }
+
+  variant.forget(_result);
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetResultByName(const nsACString &aName,
+                             nsIVariant **_result)
+{
+  uint32_t index;
+  NS_ENSURE_TRUE(mResultSet->indexOfName(aName, &index),
+                 NS_ERROR_NOT_AVAILABLE);
+  return GetResultByIndex(index, _result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// mozIStorageValueArray
+
+// The typed getters read the buffers directly when the stored value already
+// has the requested type, and otherwise go through a variant so that type
+// conversions behave exactly as they do for Row.
+
+NS_IMETHODIMP
+ColumnarRow::GetNumEntries(uint32_t *_entries)
+{
+  *_entries = mResultSet->columns();
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetTypeOfIndex(uint32_t aIndex,
+                            int32_t *_type)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  switch (mResultSet->typeAt(mIndex, aIndex)) {
+    case SQLITE_INTEGER:
+      *_type = mozIStorageValueArray::VALUE_TYPE_INTEGER;
+      break;
+    case SQLITE_FLOAT:
+      *_type = mozIStorageValueArray::VALUE_TYPE_FLOAT;
+      break;
+    case SQLITE_TEXT:
+      *_type = mozIStorageValueArray::VALUE_TYPE_TEXT;
+      break;
+    case SQLITE_BLOB:
+      *_type = mozIStorageValueArray::VALUE_TYPE_BLOB;
+      break;
+    default:
+      *_type = mozIStorageValueArray::VALUE_TYPE_NULL;
+      break;
+  }
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetInt32(uint32_t aIndex,
+                      int32_t *_value)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  if (mResultSet->typeAt(mIndex, aIndex) == SQLITE_INTEGER) {
+    int64_t value = mResultSet->integerAt(mIndex, aIndex);
+    if (value > INT32_MAX || value < INT32_MIN)
+      return NS_ERROR_CANNOT_CONVERT_DATA;
+    *_value = static_cast<int32_t>(value);
+    return NS_OK;
+  }
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+  return variant->GetAsInt32(_value);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetInt64(uint32_t aIndex,
+                      int64_t *_value)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  if (mResultSet->typeAt(mIndex, aIndex) == SQLITE_INTEGER) {
+    *_value = mResultSet->integerAt(mIndex, aIndex);
+    return NS_OK;
+  }
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+  return variant->GetAsInt64(_value);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetDouble(uint32_t aIndex,
+                       double *_value)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  if (mResultSet->typeAt(mIndex, aIndex) == SQLITE_FLOAT) {
+    *_value = mResultSet->floatAt(mIndex, aIndex);
+    return NS_OK;
+  }
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+  return variant->GetAsDouble(_value);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetUTF8String(uint32_t aIndex,
+                           nsACString &_value)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  if (mResultSet->typeAt(mIndex, aIndex) == SQLITE_TEXT) {
+    uint32_t length;
+    const char16_t *text = mResultSet->textAt(mIndex, aIndex, &length);
+    CopyUTF16toUTF8(Substring(text, length), _value);
+    return NS_OK;
+  }
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+  return variant->GetAsAUTF8String(_value);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetString(uint32_t aIndex,
+                       nsAString &_value)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  if (mResultSet->typeAt(mIndex, aIndex) == SQLITE_TEXT) {
+    uint32_t length;
+    const char16_t *text = mResultSet->textAt(mIndex, aIndex, &length);
+    _value.Assign(text, length);
+    return NS_OK;
+  }
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+  return variant->GetAsAString(_value);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetBlob(uint32_t aIndex,
+                     uint32_t *_size,
+                     uint8_t **_blob)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  nsCOMPtr<nsIVariant> variant;
+  nsresult rv = GetResultByIndex(aIndex, getter_AddRefs(variant));
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  uint16_t type;
+  nsIID interfaceIID;
+  return variant->GetAsArray(&type, &interfaceIID, _size,
+                             reinterpret_cast<void **>(_blob));
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetBlobAsString(uint32_t aIndex, nsAString& aValue)
+{
+  return DoGetBlobAsString(this, aIndex, aValue);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetBlobAsUTF8String(uint32_t aIndex, nsACString& aValue)
+{
+  return DoGetBlobAsString(this, aIndex, aValue);
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetIsNull(uint32_t aIndex,
+                       bool *_isNull)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+  NS_ENSURE_ARG_POINTER(_isNull);
+
+  *_isNull = mResultSet->typeAt(mIndex, aIndex) == SQLITE_NULL;
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetSharedUTF8String(uint32_t,
+                                 uint32_t *,
+                                 char const **)
+{
+  // Text is only kept as UTF-16.
+  return NS_ERROR_NOT_IMPLEMENTED;
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetSharedString(uint32_t aIndex,
+                             uint32_t *_length,
+                             const char16_t **_string)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  switch (mResultSet->typeAt(mIndex, aIndex)) {
+    case SQLITE_TEXT:
+      *_string = mResultSet->textAt(mIndex, aIndex, _length);
+      return NS_OK;
+    case SQLITE_NULL:
+      *_length = 0;
+      *_string = nullptr;
+      return NS_OK;
+    default:
+      return NS_ERROR_NOT_IMPLEMENTED;
+  }
+}
+
+NS_IMETHODIMP
+ColumnarRow::GetSharedBlob(uint32_t aIndex,
+                           uint32_t *_size,
+                           const uint8_t **_blob)
+{
+  ENSURE_INDEX_VALUE(aIndex, mResultSet->columns());
+
+  switch (mResultSet->typeAt(mIndex, aIndex)) {
+    case SQLITE_BLOB:
+      *_blob = mResultSet->blobAt(mIndex, aIndex, _size);
+      return NS_OK;
+    case SQLITE_NULL:
+      *_size = 0;
+      *_blob = nullptr;
+      return NS_OK;
+    default:
+      return NS_ERROR_NOT_IMPLEMENTED;
+  }
+}
+
+} // namespace storage
+} // namespace mozilla
@@ -0,0 +1,184 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozStorageColumnarResultSet_h
+#define mozStorageColumnarResultSet_h
+
+#include "mozIStorageResultSet.h"
+#include "mozIStorageRow.h"
+#include "nsDataHashtable.h"
+#include "nsTArray.h"
+#include "mozilla/Attributes.h"
+#include "mozilla/RefPtr.h"
+struct sqlite3_stmt;
+
+namespace mozilla {
+namespace storage {
+
+/**
+ * A result set that copies the values of its rows into per-column buffers
+ * instead of creating a Row of variants for every tuple.  Integers and floats
+ * go into typed arrays, while all of the text and blob values of the set are
+ * packed into two shared arenas and referenced by offset.
+ *
+ * The set is filled on the background thread and only read after it has been
+ * handed to the calling thread, so the buffers never move once a row can be
+ * looked at.
+ */
+class ColumnarResultSet final : public mozIStorageResultSet
+{
+public:
+  NS_DECL_THREADSAFE_ISUPPORTS
+  NS_DECL_MOZISTORAGERESULTSET
+
+  /**
+   * Creates a result set for the rows of the given statement.  The column
+   * names are copied once here rather than for every row.
+   *
+   * @param aStatement
+   *        The sqlite statement the rows will be pulled from.
+   */
+  explicit ColumnarResultSet(sqlite3_stmt *aStatement);
+
+  /**
+   * Copies the values of the current row of aStatement into this result set.
+   *
+   * @pre isFrom(aStatement)
+   */
+  nsresult add(sqlite3_stmt *aStatement);
+
+  /**
+   * @returns true if this result set was created for aStatement, and can thus
+   *          take its rows.
+   */
+  bool isFrom(sqlite3_stmt *aStatement) const
+  {
+    return mStatement == aStatement;
+  }
+
+  /**
+   * @returns the number of rows this result set holds.
+   */
+  uint32_t rows() const { return mNumRows; }
+
+  /**
+   * @returns an estimate, in bytes, of the memory used by the values held.
+   */
+  size_t dataSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  //// Accessors used by ColumnarRow
+
+  uint32_t columns() const { return mColumns.Length(); }
+
+  /**
+   * @returns the SQLITE_* fundamental type of the given value.
+   */
+  int typeAt(uint32_t aRow, uint32_t aColumn) const
+  {
+    return mColumns[aColumn].mTypes[aRow];
+  }
+
+  int64_t integerAt(uint32_t aRow, uint32_t aColumn) const;
+  double floatAt(uint32_t aRow, uint32_t aColumn) const;
+  const char16_t *textAt(uint32_t aRow, uint32_t aColumn,
+                         uint32_t *_length) const;
+  const uint8_t *blobAt(uint32_t aRow, uint32_t aColumn,
+                        uint32_t *_size) const;
+
+  bool indexOfName(const nsACString &aName, uint32_t *_index) const
+  {
+    return mNameHashtable.Get(aName, _index);
+  }
+
+private:
+  ~ColumnarResultSet() {}
+
+  /**
+   * Locates a text or blob value in one of the arenas.
+   */
+  struct Extent
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  /**
+   * The values of a single column.  mTypes and mSlots have an entry for every
+   * row; mSlots gives the index of the value in the array matching its type,
+   * and is unused for NULL values.
+   */
+  struct Column
+  {
+    nsTArray<uint8_t> mTypes;
+    nsTArray<uint32_t> mSlots;
+    nsTArray<int64_t> mIntegers;
+    nsTArray<double> mFloats;
+    nsTArray<Extent> mTexts;
+    nsTArray<Extent> mBlobs;
+  };
+
+  /**
+   * The statement this result set was created for.  Only used as an identity,
+   * it is never dereferenced.
+   */
+  sqlite3_stmt *mStatement;
+
+  uint32_t mNumRows;
+
+  /**
+   * Stores the index of the next row GetNextRow will return.
+   */
+  uint32_t mCurrentIndex;
+
+  nsTArray<Column> mColumns;
+
+  /**
+   * The characters of every text value, and the bytes of every blob value,
+   * held by this result set.
+   */
+  nsTArray<char16_t> mTextArena;
+  nsTArray<uint8_t> mBlobArena;
+
+  /**
+   * Maps a given name to a column index.
+   */
+  nsDataHashtable<nsCStringHashKey, uint32_t> mNameHashtable;
+};
+
+/**
+ * A view of a single row of a ColumnarResultSet.  Values are read straight out
+ * of the result set's buffers; variants are only created for consumers that
+ * ask for them.
+ */
+class ColumnarRow final : public mozIStorageRow
+{
+public:
+  NS_DECL_THREADSAFE_ISUPPORTS
+  NS_DECL_MOZISTORAGEROW
+  NS_DECL_MOZISTORAGEVALUEARRAY
+
+  ColumnarRow(ColumnarResultSet *aResultSet, uint32_t aIndex)
+  : mResultSet(aResultSet)
+  , mIndex(aIndex)
+  {
+  }
+
+private:
+  ~ColumnarRow() {}
+
+  RefPtr<ColumnarResultSet> mResultSet;
+
+  /**
+   * The index of this row in mResultSet.
+   */
+  const uint32_t mIndex;
+};
+
+} // namespace storage
+} // namespace mozilla
+
+#endif // mozStorageColumnarResultSet_h
@@ -50,6 +50,9 @@
 // Maximum size of the pages cache per connection.
 #define MAX_CACHE_SIZE_KIBIBYTES 2048 // 2 MiB
 
+// Maximum number of idle prepared statements kept per connection.
+#define MAX_CACHED_STATEMENTS 32
+
 mozilla::LazyLogModule gStorageLog("mozStorage");
 
 // Checks that the protected code is running on the main-thread only if the
@@ -480,6 +483,7 @@ Connection::Connection(Service *aService,
 , mAsyncExecutionThreadIsAlive(false)
 #endif
 , mConnectionClosed(false)
+, mStatementCache(MAX_CACHED_STATEMENTS)
 , mTransactionInProgress(false)
 , mProgressHandler(nullptr)
 , mFlags(aFlags)
@@ -940,6 +944,9 @@ Connection::internalClose(sqlite3 *aNativeConnection)
     mConnectionClosed = true;
   }
 
+  // Idle cached statements are not leftovers; finalize them quietly.
+  mStatementCache.close();
+
   // Nothing else needs to be done if we don't have a connection here.
   if (!aNativeConnection)
     return NS_OK;
@@ -1119,6 +1126,34 @@ Connection::prepareStatement(sqlite3 *aNativeConnection, const nsCString &aSQL,
   return rc;
 }
 
+int
+Connection::prepareCachedStatement(sqlite3 *aNativeConnection,
+                                   const nsCString &aSQL,
+                                   sqlite3_stmt **_stmt)
+{
+  if (isClosed())
+    return SQLITE_MISUSE;
+
+  *_stmt = mStatementCache.take(aSQL);
+  if (*_stmt)
+    return SQLITE_OK;
+
+  return prepareStatement(aNativeConnection, aSQL, _stmt);
+}
+
+int
+Connection::releaseStatement(sqlite3_stmt *aStatement)
+{
+  MOZ_ASSERT(!isClosed());
+
+  int srv = ::sqlite3_reset(aStatement);
+  (void)::sqlite3_clear_bindings(aStatement);
+
+  if (!mStatementCache.put(aStatement))
+    (void)::sqlite3_finalize(aStatement);
+
+  return srv;
+}
 
 int
 Connection::executeSql(sqlite3 *aNativeConnection, const char *aSqlString)
@@ -17,6 +17,7 @@
 #include "nsDataHashtable.h"
 #include "mozIStorageProgressHandler.h"
 #include "SQLiteMutex.h"
+#include "PreparedStatementCache.h"
 #include "mozIStorageConnection.h"
 #include "mozStorageService.h"
 #include "mozIStorageAsyncConnection.h"
@@ -190,6 +191,43 @@ public:
   int prepareStatement(sqlite3* aNativeConnection,
                        const nsCString &aSQL, sqlite3_stmt **_stmt);
 
+  /**
+   * Like prepareStatement, but reuses an idle statement compiled from the same
+   * SQL if the connection's prepared statement cache holds one.  Statements
+   * obtained this way must be given back with releaseStatement.
+   *
+   * @param aNativeConnection
+   *        The underlying Sqlite connection to prepare the statement with.
+   * @param aSQL
+   *        The SQL statement string to compile.
+   * @param _stmt
+   *        The sqlite3_stmt object, owned by the caller until released.
+   * @return the result from sqlite3_prepare_v2.
+   */
+  int prepareCachedStatement(sqlite3* aNativeConnection,
+                             const nsCString &aSQL, sqlite3_stmt **_stmt);
+
+  /**
+   * Resets a statement obtained from prepareCachedStatement and gives it back
+   * to the prepared statement cache, finalizing it if the cache does not take
+   * it.  The connection must not be closed.
+   *
+   * @param aStatement
+   *        The sqlite3_stmt object to release.
+   * @return the result from sqlite3_reset, which is what sqlite3_finalize
+   *         would have returned.
+   */
+  int releaseStatement(sqlite3_stmt* aStatement);
+
+  /**
+   * Obtains the hit and miss counts of the prepared statement cache, for the
+   * memory reporter.
+   */
+  void getStatementCacheStats(PreparedStatementCache::Stats &_stats)
+  {
+    mStatementCache.getStats(_stats);
+  }
+
   /**
    * Performs a sqlite3_step on aStatement, while properly handling SQLITE_LOCKED
    * when not on the main thread by waiting until we are notified.
@@ -333,6 +371,12 @@ private:
    */
   bool mConnectionClosed;
 
+  /**
+   * Holds the idle prepared statements of Statements and AsyncStatements that
+   * have been finalized.  Has its own lock.
+   */
+  PreparedStatementCache mStatementCache;
+
   /**
    * Tracks if we have a transaction in progress or not.  Access protected by
    * sharedDBMutex.
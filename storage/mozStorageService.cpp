@@ -54,6 +54,9 @@
 // db/sqlite3/src/Makefile.in.
 #define PREF_TS_PAGESIZE_DEFAULT 32768
 
+#define PREF_TS_COLUMNAR_RESULTS "toolkit.storage.asyncColumnarResults"
+#define PREF_TS_COLUMNAR_RESULTS_DEFAULT true
+
 namespace mozilla {
 namespace storage {
 
@@ -116,6 +119,42 @@ ReportConn(nsIHandleReportCallback *aHandleReport,
   return NS_OK;
 }
 
+/**
+ * Passes a single prepared statement cache statistic to a memory reporter
+ * callback.
+ *
+ * @param aHandleReport
+ *        The callback.
+ * @param aData
+ *        The data for the callback.
+ * @param aPathHead
+ *        Head of the path for the report.
+ * @param aKind
+ *        The statistic, one of "hits", "misses", "evictions" or "cached".
+ * @param aUnits
+ *        The nsIMemoryReporter units of the statistic.
+ * @param aValue
+ *        The value of the statistic.
+ * @param aDesc
+ *        The report description.
+ */
+nsresult
+ReportStatementCache(nsIHandleReportCallback *aHandleReport,
+                     nsISupports *aData,
+                     const nsACString &aPathHead,
+                     const nsACString &aKind,
+                     int32_t aUnits,
+                     int64_t aValue,
+                     const nsACString &aDesc)
+{
+  nsCString path(aPathHead);
+  path.Append(aKind);
+
+  return aHandleReport->Callback(EmptyCString(), path,
+                                 nsIMemoryReporter::KIND_OTHER, aUnits,
+                                 aValue, aDesc, aData);
+}
+
 // Warning: To get a Connection's measurements requires holding its lock.
 // There may be a delay getting the lock if another thread is accessing the
 // Connection.  This isn't very nice if CollectReports is called from the main
@@ -172,6 +211,45 @@ Service::CollectReports(nsIHandleReportCallback *aHandleReport,
                       NS_LITERAL_CSTRING("schema"), schemaDesc,
                       SQLITE_DBSTATUS_SCHEMA_USED, &totalConnSize);
       NS_ENSURE_SUCCESS(rv, rv);
+
+      PreparedStatementCache::Stats stats;
+      conn->getStatementCacheStats(stats);
+
+      nsCString cachePathHead("storage-statement-cache/");
+      cachePathHead.Append(conn->getFilename());
+      cachePathHead.Append('/');
+
+      rv = ReportStatementCache(aHandleReport, aData, cachePathHead,
+             NS_LITERAL_CSTRING("hits"),
+             nsIMemoryReporter::UNITS_COUNT_CUMULATIVE, int64_t(stats.hits),
+             NS_LITERAL_CSTRING("Number of statements that reused an idle "
+                                "cached prepared statement instead of "
+                                "compiling their SQL."));
+      NS_ENSURE_SUCCESS(rv, rv);
+
+      rv = ReportStatementCache(aHandleReport, aData, cachePathHead,
+             NS_LITERAL_CSTRING("misses"),
+             nsIMemoryReporter::UNITS_COUNT_CUMULATIVE, int64_t(stats.misses),
+             NS_LITERAL_CSTRING("Number of statements whose SQL had to be "
+                                "compiled because no cached prepared "
+                                "statement matched."));
+      NS_ENSURE_SUCCESS(rv, rv);
+
+      rv = ReportStatementCache(aHandleReport, aData, cachePathHead,
+             NS_LITERAL_CSTRING("evictions"),
+             nsIMemoryReporter::UNITS_COUNT_CUMULATIVE,
+             int64_t(stats.evictions),
+             NS_LITERAL_CSTRING("Number of idle prepared statements finalized "
+                                "to make room in the cache."));
+      NS_ENSURE_SUCCESS(rv, rv);
+
+      rv = ReportStatementCache(aHandleReport, aData, cachePathHead,
+             NS_LITERAL_CSTRING("cached"),
+             nsIMemoryReporter::UNITS_COUNT, int64_t(stats.cached),
+             NS_LITERAL_CSTRING("Number of idle prepared statements held in "
+                                "the cache.  Their memory is included in "
+                                "stmt-used."));
+      NS_ENSURE_SUCCESS(rv, rv);
     }
 
 #ifdef MOZ_DMD
@@ -275,6 +353,8 @@ Service::getSynchronousPref()
 
 int32_t Service::sDefaultPageSize = PREF_TS_PAGESIZE_DEFAULT;
 
+bool Service::sColumnarResultsPref = PREF_TS_COLUMNAR_RESULTS_DEFAULT;
+
 Service::Service()
 : mMutex("Service::mMutex")
 , mSqliteVFS(nullptr)
@@ -580,6 +660,11 @@ Service::initialize()
   sDefaultPageSize =
       Preferences::GetInt(PREF_TS_PAGESIZE, PREF_TS_PAGESIZE_DEFAULT);
 
+  // Asynchronous statements check this when they are created, possibly off the
+  // main thread, so keep it in a var cache rather than reading it once.
+  Preferences::AddBoolVarCache(&sColumnarResultsPref, PREF_TS_COLUMNAR_RESULTS,
+                               PREF_TS_COLUMNAR_RESULTS_DEFAULT);
+
   mozilla::RegisterWeakMemoryReporter(this);
   mozilla::RegisterStorageSQLiteDistinguishedAmount(StorageSQLiteDistinguishedAmount);
 
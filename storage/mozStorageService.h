@@ -70,6 +70,16 @@ public:
    */
   static int32_t getSynchronousPref();
 
+  /**
+   * Indicates whether asynchronous statements should deliver their results in
+   * columnar result sets rather than as rows of variants.  Backed by the
+   * toolkit.storage.asyncColumnarResults preference.
+   */
+  static bool useColumnarResults()
+  {
+    return sColumnarResultsPref;
+  }
+
   /**
    * Obtains the default page size for this platform. The default value is
    * specified in the SQLite makefile (SQLITE_DEFAULT_PAGE_SIZE) but it may be
@@ -189,6 +199,7 @@ private:
 
   static int32_t sSynchronousPref;
   static int32_t sDefaultPageSize;
+  static bool sColumnarResultsPref;
 };
 
 } // namespace storage
@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "gtest/MozGTestBench.h" // For MOZ_GTEST_BENCH
+
+#include "mozilla/Preferences.h"
+#include "mozIStorageAsyncStatement.h"
+#include "mozIStorageCompletionCallback.h"
+#include "mozIStorageConnection.h"
+#include "mozIStoragePendingStatement.h"
+#include "mozIStorageResultSet.h"
+#include "mozIStorageRow.h"
+#include "mozIStorageService.h"
+#include "mozIStorageStatement.h"
+#include "mozIStorageStatementCallback.h"
+#include "mozStorageHelper.h"
+#include "nsServiceManagerUtils.h"
+#include "nsThreadUtils.h"
+
+using namespace mozilla;
+
+/**
+ * Measures reading a large table with an async statement, with the results
+ * delivered as columnar result sets and as rows of variants.
+ * storage/test/test_async_columnar_results.cpp checks that both deliver the
+ * same values.
+ */
+
+#define COLUMNAR_RESULTS_PREF "toolkit.storage.asyncColumnarResults"
+#define NUM_ROWS 20000
+#define NUM_READS 4
+
+class ResultReader final : public mozIStorageStatementCallback
+                         , public mozIStorageCompletionCallback
+{
+public:
+  NS_DECL_ISUPPORTS
+
+  ResultReader()
+    : mRowCount(0)
+    , mCompleted(false)
+    , mReason(0)
+  {}
+
+  NS_IMETHOD HandleResult(mozIStorageResultSet* aResultSet) override
+  {
+    // Read every column, the way a consumer would.
+    nsCOMPtr<mozIStorageRow> row;
+    while (NS_SUCCEEDED(aResultSet->GetNextRow(getter_AddRefs(row))) && row) {
+      mRowCount++;
+
+      int64_t integer;
+      EXPECT_TRUE(NS_SUCCEEDED(row->GetInt64(0, &integer)));
+
+      double number;
+      EXPECT_TRUE(NS_SUCCEEDED(row->GetDouble(1, &number)));
+
+      nsAutoString text;
+      EXPECT_TRUE(NS_SUCCEEDED(row->GetString(2, text)));
+
+      uint32_t size;
+      uint8_t* blob;
+      EXPECT_TRUE(NS_SUCCEEDED(row->GetBlob(3, &size, &blob)));
+      free(blob);
+    }
+    return NS_OK;
+  }
+
+  NS_IMETHOD HandleError(mozIStorageError* aError) override
+  {
+    ADD_FAILURE() << "Unexpected statement error";
+    return NS_OK;
+  }
+
+  NS_IMETHOD HandleCompletion(uint16_t aReason) override
+  {
+    mReason = aReason;
+    mCompleted = true;
+    return NS_OK;
+  }
+
+  NS_IMETHOD Complete(nsresult aStatus, nsISupports* aValue) override
+  {
+    mCompleted = true;
+    return NS_OK;
+  }
+
+  void SpinUntilCompleted()
+  {
+    nsCOMPtr<nsIThread> thread = do_GetCurrentThread();
+    while (!mCompleted) {
+      NS_ProcessNextEvent(thread);
+    }
+  }
+
+  uint32_t mRowCount;
+  bool mCompleted;
+  uint16_t mReason;
+
+private:
+  ~ResultReader() {}
+};
+
+NS_IMPL_ISUPPORTS(ResultReader, mozIStorageStatementCallback,
+                  mozIStorageCompletionCallback)
+
+static already_AddRefed<mozIStorageConnection>
+CreateTable()
+{
+  nsCOMPtr<mozIStorageService> ss =
+    do_GetService("@mozilla.org/storage/service;1");
+  MOZ_RELEASE_ASSERT(ss);
+
+  nsCOMPtr<mozIStorageConnection> db;
+  nsresult rv = ss->OpenSpecialDatabase("memory", getter_AddRefs(db));
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+  rv = db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "CREATE TABLE test (id INTEGER PRIMARY KEY, number REAL, text TEXT, data BLOB)"
+  ));
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+  nsCOMPtr<mozIStorageStatement> stmt;
+  rv = db->CreateStatement(NS_LITERAL_CSTRING(
+    "INSERT INTO test (number, text, data) VALUES (:number, :text, :data)"
+  ), getter_AddRefs(stmt));
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+
+  mozStorageTransaction transaction(db, false);
+  const uint8_t data[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  for (uint32_t i = 0; i < NUM_ROWS; i++) {
+    mozStorageStatementScoper scoper(stmt);
+    nsAutoString text(NS_LITERAL_STRING("http://example.com/page/"));
+    text.AppendInt(i);
+    (void)stmt->BindDoubleByName(NS_LITERAL_CSTRING("number"), i / 4.0);
+    (void)stmt->BindStringByName(NS_LITERAL_CSTRING("text"), text);
+    (void)stmt->BindBlobByName(NS_LITERAL_CSTRING("data"), data,
+                               i % ArrayLength(data));
+    rv = stmt->Execute();
+    MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+  }
+  rv = transaction.Commit();
+  MOZ_RELEASE_ASSERT(NS_SUCCEEDED(rv));
+  stmt->Finalize();
+
+  return db.forget();
+}
+
+static void
+ReadTable(bool aColumnar)
+{
+  Preferences::SetBool(COLUMNAR_RESULTS_PREF, aColumnar);
+
+  nsCOMPtr<mozIStorageConnection> db = CreateTable();
+
+  nsCOMPtr<mozIStorageAsyncStatement> stmt;
+  nsresult rv = db->CreateAsyncStatement(NS_LITERAL_CSTRING(
+    "SELECT id, number, text, data FROM test"
+  ), getter_AddRefs(stmt));
+  ASSERT_TRUE(NS_SUCCEEDED(rv));
+
+  for (int i = 0; i < NUM_READS; i++) {
+    RefPtr<ResultReader> reader = new ResultReader();
+    nsCOMPtr<mozIStoragePendingStatement> pending;
+    rv = stmt->ExecuteAsync(reader, getter_AddRefs(pending));
+    ASSERT_TRUE(NS_SUCCEEDED(rv));
+    reader->SpinUntilCompleted();
+
+    ASSERT_EQ(mozIStorageStatementCallback::REASON_FINISHED, reader->mReason);
+    ASSERT_EQ(uint32_t(NUM_ROWS), reader->mRowCount);
+  }
+  stmt->Finalize();
+
+  RefPtr<ResultReader> closer = new ResultReader();
+  rv = db->AsyncClose(closer);
+  ASSERT_TRUE(NS_SUCCEEDED(rv));
+  closer->SpinUntilCompleted();
+
+  Preferences::ClearUser(COLUMNAR_RESULTS_PREF);
+}
+
+MOZ_GTEST_BENCH(StorageAsyncResults, VariantRows, [] {
+  ReadTable(false);
+});
+
+MOZ_GTEST_BENCH(StorageAsyncResults, ColumnarResultSets, [] {
+  ReadTable(true);
+});
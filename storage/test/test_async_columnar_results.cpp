@@ -0,0 +1,194 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "storage_test_harness.h"
+
+#include "mozStorageHelper.h"
+#include "mozIStorageResultSet.h"
+#include "mozIStorageRow.h"
+#include "nsIPrefBranch.h"
+#include "nsIPrefService.h"
+
+using namespace mozilla;
+
+/**
+ * This file tests that async statements deliver the same values whether the
+ * results are columnar or rows of variants. gtest/TestAsyncColumnarResults.cpp
+ * measures how long each takes to read a large table.
+ */
+
+#define COLUMNAR_RESULTS_PREF "toolkit.storage.asyncColumnarResults"
+#define NUM_ROWS 20000
+
+////////////////////////////////////////////////////////////////////////////////
+//// Helpers
+
+class ResultReader : public AsyncStatementSpinner
+{
+public:
+  NS_IMETHOD HandleResult(mozIStorageResultSet *aResultSet) override;
+
+  ResultReader()
+  : rowCount(0)
+  , resultCount(0)
+  , integerSum(0)
+  , floatSum(0)
+  , textLength(0)
+  , blobSize(0)
+  , nullCount(0)
+  , sharedMismatches(0)
+  {
+  }
+
+  uint32_t rowCount;
+  uint32_t resultCount;
+  int64_t integerSum;
+  double floatSum;
+  uint64_t textLength;
+  uint64_t blobSize;
+  uint32_t nullCount;
+  uint32_t sharedMismatches;
+
+protected:
+  ~ResultReader() {}
+};
+
+NS_IMETHODIMP
+ResultReader::HandleResult(mozIStorageResultSet *aResultSet)
+{
+  resultCount++;
+
+  nsCOMPtr<mozIStorageRow> row;
+  while (NS_SUCCEEDED(aResultSet->GetNextRow(getter_AddRefs(row))) && row) {
+    rowCount++;
+
+    int64_t integer;
+    do_check_success(row->GetInt64(0, &integer));
+    integerSum += integer;
+
+    double number;
+    do_check_success(row->GetDouble(1, &number));
+    floatSum += number;
+
+    nsAutoString text;
+    do_check_success(row->GetString(2, text));
+    textLength += text.Length();
+
+    // Where the shared getter is supported it must agree with the copy.
+    uint32_t length;
+    const char16_t *shared;
+    if (NS_SUCCEEDED(row->GetSharedString(2, &length, &shared)) &&
+        !text.Equals(Substring(shared, length))) {
+      sharedMismatches++;
+    }
+
+    uint32_t size;
+    uint8_t *blob;
+    do_check_success(row->GetBlob(3, &size, &blob));
+    blobSize += size;
+    free(blob);
+
+    bool isNull;
+    do_check_success(row->GetIsNull(4, &isNull));
+    nullCount += isNull;
+  }
+
+  return NS_OK;
+}
+
+void
+set_columnar_results(bool aEnabled)
+{
+  nsCOMPtr<nsIPrefBranch> prefs(do_GetService(NS_PREFSERVICE_CONTRACTID));
+  do_check_true(prefs);
+  do_check_success(prefs->SetBoolPref(COLUMNAR_RESULTS_PREF, aEnabled));
+}
+
+already_AddRefed<ResultReader>
+read_table(mozIStorageConnection *aDB, bool aColumnar)
+{
+  set_columnar_results(aColumnar);
+
+  nsCOMPtr<mozIStorageAsyncStatement> stmt;
+  do_check_success(aDB->CreateAsyncStatement(NS_LITERAL_CSTRING(
+    "SELECT id, number, text, data, nothing FROM test"
+  ), getter_AddRefs(stmt)));
+
+  RefPtr<ResultReader> reader = new ResultReader();
+  nsCOMPtr<mozIStoragePendingStatement> pendingStmt;
+  do_check_success(stmt->ExecuteAsync(reader, getter_AddRefs(pendingStmt)));
+  reader->SpinUntilCompleted();
+  stmt->Finalize();
+
+  do_check_eq(reader->completionReason,
+              mozIStorageStatementCallback::REASON_FINISHED);
+  return reader.forget();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Tests
+
+void
+test_ColumnarResultsMatchVariantResults()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+
+  nsresult rv = db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "CREATE TABLE test ("
+      "id INTEGER PRIMARY KEY, number REAL, text TEXT, data BLOB, nothing"
+    ")"
+  ));
+  do_check_success(rv);
+
+  nsCOMPtr<mozIStorageStatement> stmt;
+  rv = db->CreateStatement(NS_LITERAL_CSTRING(
+    "INSERT INTO test (number, text, data, nothing) "
+    "VALUES (:number, :text, :data, NULL)"
+  ), getter_AddRefs(stmt));
+  do_check_success(rv);
+
+  mozStorageTransaction transaction(db, false);
+  const uint8_t data[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  for (uint32_t i = 0; i < NUM_ROWS; i++) {
+    mozStorageStatementScoper scoper(stmt);
+    nsAutoString text(NS_LITERAL_STRING("http://example.com/page/"));
+    text.AppendInt(i);
+    (void)stmt->BindDoubleByName(NS_LITERAL_CSTRING("number"), i / 4.0);
+    (void)stmt->BindStringByName(NS_LITERAL_CSTRING("text"), text);
+    (void)stmt->BindBlobByName(NS_LITERAL_CSTRING("data"), data,
+                               i % ArrayLength(data));
+    do_check_success(stmt->Execute());
+  }
+  do_check_success(transaction.Commit());
+  stmt->Finalize();
+
+  RefPtr<ResultReader> variant = read_table(db, false);
+  RefPtr<ResultReader> columnar = read_table(db, true);
+
+  do_check_eq(variant->rowCount, uint32_t(NUM_ROWS));
+  do_check_eq(columnar->rowCount, uint32_t(NUM_ROWS));
+  do_check_eq(columnar->integerSum, variant->integerSum);
+  do_check_true(columnar->floatSum == variant->floatSum);
+  do_check_eq(columnar->textLength, variant->textLength);
+  do_check_eq(columnar->blobSize, variant->blobSize);
+  do_check_eq(columnar->nullCount, uint32_t(NUM_ROWS));
+  do_check_eq(variant->nullCount, uint32_t(NUM_ROWS));
+  do_check_eq(columnar->sharedMismatches, uint32_t(0));
+
+  // Adaptive batching must hand over fewer, larger result sets.
+  do_check_true(columnar->resultCount < variant->resultCount);
+
+  blocking_async_close(db);
+}
+
+void (*gTests[])(void) = {
+  test_ColumnarResultsMatchVariantResults,
+};
+
+const char *file = __FILE__;
+#define TEST_NAME "async columnar results"
+#define TEST_FILE file
+#include "storage_test_harness_tail.h"
@@ -0,0 +1,270 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+ * vim: sw=2 ts=2 et lcs=trail\:.,tab\:>~ :
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "storage_test_harness.h"
+
+#include "nsIMemoryReporter.h"
+#include "nsReadableUtils.h"
+
+/**
+ * This file tests the connection-level cache of prepared statements, through
+ * the statistics the storage service reports.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+//// Helpers
+
+class StatementCacheStats final : public nsIHandleReportCallback
+{
+public:
+  NS_DECL_ISUPPORTS
+
+  StatementCacheStats()
+  : hits(0)
+  , misses(0)
+  , evictions(0)
+  , cached(0)
+  {
+  }
+
+  NS_IMETHOD Callback(const nsACString &aProcess, const nsACString &aPath,
+                      int32_t aKind, int32_t aUnits, int64_t aAmount,
+                      const nsACString &aDescription,
+                      nsISupports *aData) override
+  {
+    if (!StringBeginsWith(aPath, NS_LITERAL_CSTRING("storage-statement-cache/")))
+      return NS_OK;
+
+    if (StringEndsWith(aPath, NS_LITERAL_CSTRING("/hits")))
+      hits += aAmount;
+    else if (StringEndsWith(aPath, NS_LITERAL_CSTRING("/misses")))
+      misses += aAmount;
+    else if (StringEndsWith(aPath, NS_LITERAL_CSTRING("/evictions")))
+      evictions += aAmount;
+    else if (StringEndsWith(aPath, NS_LITERAL_CSTRING("/cached")))
+      cached += aAmount;
+    return NS_OK;
+  }
+
+  int64_t hits;
+  int64_t misses;
+  int64_t evictions;
+  int64_t cached;
+
+private:
+  ~StatementCacheStats() {}
+};
+
+NS_IMPL_ISUPPORTS(StatementCacheStats, nsIHandleReportCallback)
+
+already_AddRefed<StatementCacheStats>
+get_stats()
+{
+  nsCOMPtr<mozIStorageService> service = getService();
+  nsCOMPtr<nsIMemoryReporter> reporter = do_QueryInterface(service);
+  do_check_true(reporter);
+
+  RefPtr<StatementCacheStats> stats = new StatementCacheStats();
+  do_check_success(reporter->CollectReports(stats, nullptr, false));
+  return stats.forget();
+}
+
+void
+create_and_finalize(mozIStorageConnection *aDB, const nsACString &aSQL)
+{
+  nsCOMPtr<mozIStorageStatement> stmt;
+  do_check_success(aDB->CreateStatement(aSQL, getter_AddRefs(stmt)));
+  do_check_success(stmt->Finalize());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Tests
+
+void
+test_SyncStatementsAreReused()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+  NS_NAMED_LITERAL_CSTRING(sql, "SELECT 1");
+
+  RefPtr<StatementCacheStats> before = get_stats();
+  create_and_finalize(db, sql);
+  create_and_finalize(db, sql);
+  // Trailing whitespace does not change the statement.
+  create_and_finalize(db, NS_LITERAL_CSTRING("SELECT 1 \n"));
+  RefPtr<StatementCacheStats> after = get_stats();
+
+  do_check_eq(after->misses - before->misses, 1);
+  do_check_eq(after->hits - before->hits, 2);
+  do_check_eq(after->cached, 1);
+
+  blocking_async_close(db);
+}
+
+void
+test_AsyncStatementsAreReused()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+  NS_NAMED_LITERAL_CSTRING(sql, "SELECT 2");
+
+  RefPtr<StatementCacheStats> before = get_stats();
+  for (int i = 0; i < 2; i++) {
+    nsCOMPtr<mozIStorageAsyncStatement> stmt;
+    do_check_success(db->CreateAsyncStatement(sql, getter_AddRefs(stmt)));
+    blocking_async_execute(stmt);
+    // The statement is handed back to the cache on the async thread, before
+    // the next statement is executed there.
+    do_check_success(stmt->Finalize());
+  }
+
+  // Make sure the last finalization has happened.
+  nsCOMPtr<mozIStorageAsyncStatement> stmt;
+  do_check_success(db->CreateAsyncStatement(
+    NS_LITERAL_CSTRING("SELECT 3"), getter_AddRefs(stmt)));
+  blocking_async_execute(stmt);
+  do_check_success(stmt->Finalize());
+
+  RefPtr<StatementCacheStats> after = get_stats();
+  do_check_eq(after->hits - before->hits, 1);
+
+  blocking_async_close(db);
+}
+
+void
+test_ReusedStatementsHaveNoBindings()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+  NS_NAMED_LITERAL_CSTRING(sql, "SELECT :value");
+
+  nsCOMPtr<mozIStorageStatement> stmt;
+  do_check_success(db->CreateStatement(sql, getter_AddRefs(stmt)));
+  do_check_success(stmt->BindInt32ByName(NS_LITERAL_CSTRING("value"), 5));
+  bool hasResult;
+  do_check_success(stmt->ExecuteStep(&hasResult));
+  do_check_true(hasResult);
+  // Finalize in the middle of the results.
+  do_check_success(stmt->Finalize());
+
+  do_check_success(db->CreateStatement(sql, getter_AddRefs(stmt)));
+  do_check_success(stmt->ExecuteStep(&hasResult));
+  do_check_true(hasResult);
+  bool isNull;
+  do_check_success(stmt->GetIsNull(0, &isNull));
+  do_check_true(isNull);
+  do_check_success(stmt->Finalize());
+
+  blocking_async_close(db);
+}
+
+void
+test_LeastRecentlyUsedStatementsAreEvicted()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+
+  RefPtr<StatementCacheStats> before = get_stats();
+  for (int i = 0; i < 100; i++) {
+    nsAutoCString sql("SELECT ");
+    sql.AppendInt(i);
+    create_and_finalize(db, sql);
+  }
+  // The most recent statement is still cached, the first one is not.
+  create_and_finalize(db, NS_LITERAL_CSTRING("SELECT 99"));
+  create_and_finalize(db, NS_LITERAL_CSTRING("SELECT 0"));
+  RefPtr<StatementCacheStats> after = get_stats();
+
+  do_check_eq(after->hits - before->hits, 1);
+  do_check_eq(after->misses - before->misses, 101);
+  do_check_true(after->evictions > before->evictions);
+  do_check_true(after->cached < 100);
+
+  blocking_async_close(db);
+}
+
+void
+test_AlteredTablesAreSeen()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+  do_check_success(db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "CREATE TABLE test (a INTEGER)")));
+  do_check_success(db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "INSERT INTO test (a) VALUES (1)")));
+
+  NS_NAMED_LITERAL_CSTRING(sql, "SELECT * FROM test");
+  create_and_finalize(db, sql);
+
+  do_check_success(db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "ALTER TABLE test ADD COLUMN b TEXT DEFAULT 'added'")));
+
+  // The statement cached before the table changed must not be reused.
+  nsCOMPtr<mozIStorageStatement> stmt;
+  do_check_success(db->CreateStatement(sql, getter_AddRefs(stmt)));
+  uint32_t columnCount;
+  do_check_success(stmt->GetColumnCount(&columnCount));
+  do_check_eq(columnCount, 2u);
+
+  nsAutoCString name;
+  do_check_success(stmt->GetColumnName(1, name));
+  do_check_true(name.EqualsLiteral("b"));
+
+  bool hasResult;
+  do_check_success(stmt->ExecuteStep(&hasResult));
+  do_check_true(hasResult);
+  nsAutoCString value;
+  do_check_success(stmt->GetUTF8String(1, value));
+  do_check_true(value.EqualsLiteral("added"));
+  do_check_success(stmt->Finalize());
+
+  blocking_async_close(db);
+}
+
+void
+test_DroppedTablesFailToCompile()
+{
+  nsCOMPtr<mozIStorageConnection> db(getMemoryDatabase());
+  do_check_success(db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "CREATE TABLE test (a INTEGER)")));
+
+  NS_NAMED_LITERAL_CSTRING(sql, "SELECT a FROM test");
+  create_and_finalize(db, sql);
+
+  nsCOMPtr<mozIStorageAsyncStatement> asyncStmt;
+  do_check_success(db->CreateAsyncStatement(sql, getter_AddRefs(asyncStmt)));
+  blocking_async_execute(asyncStmt);
+  do_check_success(asyncStmt->Finalize());
+
+  do_check_success(db->ExecuteSimpleSQL(NS_LITERAL_CSTRING(
+    "DROP TABLE test")));
+
+  // Creating the statement fails as it would have without the cache.
+  nsCOMPtr<mozIStorageStatement> stmt;
+  do_check_false(NS_SUCCEEDED(db->CreateStatement(sql,
+                                                  getter_AddRefs(stmt))));
+
+  // The statement cached on the async thread is not reused either.
+  do_check_success(db->CreateAsyncStatement(sql, getter_AddRefs(asyncStmt)));
+  RefPtr<AsyncStatementSpinner> spinner = new AsyncStatementSpinner();
+  nsCOMPtr<mozIStoragePendingStatement> pending;
+  (void)asyncStmt->ExecuteAsync(spinner, getter_AddRefs(pending));
+  spinner->SpinUntilCompleted();
+  do_check_eq(spinner->completionReason,
+              mozIStorageStatementCallback::REASON_ERROR);
+  do_check_success(asyncStmt->Finalize());
+
+  blocking_async_close(db);
+}
+
+void (*gTests[])(void) = {
+  test_SyncStatementsAreReused,
+  test_AsyncStatementsAreReused,
+  test_ReusedStatementsHaveNoBindings,
+  test_LeastRecentlyUsedStatementsAreEvicted,
+  test_AlteredTablesAreSeen,
+  test_DroppedTablesFailToCompile,
+};
+
+const char *file = __FILE__;
+#define TEST_NAME "prepared statement cache"
+#define TEST_FILE file
+#include "storage_test_harness_tail.h"